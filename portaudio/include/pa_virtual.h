@@ -0,0 +1,233 @@
+#ifndef PA_VIRTUAL_H
+#define PA_VIRTUAL_H
+
+/*
+ * $Id$
+ * PortAudio Portable Real-Time Audio Library
+ * Virtual host API extensions
+ *
+ * Copyright (c) 1999-2000 Ross Bencina and Phil Burk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * The text above constitutes the entire PortAudio license; however, 
+ * the PortAudio community also makes the following non-binding requests:
+ *
+ * Any person wishing to distribute modifications to the Software is
+ * requested to send the modifications to the original developer so that
+ * they can be incorporated into the canonical version. It is also 
+ * requested that these non-binding requests be included along with the 
+ * license above.
+ */
+
+/** @file
+ *  @ingroup public_header
+ *  @brief Virtual host API extension header file.
+ *
+ * The virtual host API provides devices which are not backed by any audio
+ * hardware. A virtual stream reads its input from, and writes its output to,
+ * a raw sample file, a WAV file or a memory buffer, or it uses silence and
+ * discards its output. It is paced either by a high resolution timer, at real
+ * time or at any multiple of it, or runs as fast as the stream callback allows
+ * (offline rendering). Virtual streams are opened, started and stopped through
+ * the ordinary Pa_OpenStream() API, with callbacks or blocking read/write.
+ *
+ * The virtual host API only appears when at least one device has been
+ * configured, with PaVirtual_AddDevice() or the PA_VIRTUAL_DEVICES
+ * environment variable, before Pa_Initialize() is called. PA_VIRTUAL_DEVICES
+ * holds one or more semicolon separated device descriptions of the form
+ * name:inputChannels:outputChannels[:sampleRate[:speed]], for example
+ * "Virtual Device:2:2:48000:100" for a stereo device which runs 100 times
+ * faster than real time.
+ */
+
+#include "portaudio.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+
+/** Pass as a speed to run a virtual stream as fast as possible, without
+ * waiting for a timer.
+ * @see PaVirtualDeviceInfo, PaVirtualStreamInfo
+ */
+#define paVirtualFreeRunning (-1.0)
+
+
+/** The configuration of a virtual device.
+ * @see PaVirtual_AddDevice
+ */
+typedef struct PaVirtualDeviceInfo
+{
+    /** The device name. NULL for "Virtual Device". The name is copied. */
+    const char *name;
+
+    int maxInputChannels;
+    int maxOutputChannels;
+
+    /** The default sample rate. 0 for 48000. */
+    double defaultSampleRate;
+
+    /** The range of sample rates the device accepts, inclusive. 0 for no
+     * limit. */
+    double minSampleRate;
+    double maxSampleRate;
+
+    /** The sample formats the device handles natively, a combination of
+     * paFloat32, paInt32, paInt24, paInt16, paInt8 and paUInt8. Streams are
+     * converted to and from the closest of them. 0 for all of them. */
+    PaSampleFormat sampleFormats;
+
+    /** The device's period: the number of frames it transfers at a time.
+     * Streams on the device adapt to it like they would to hardware. 0 to
+     * use the stream's framesPerBuffer, or 256 if that is unspecified. */
+    unsigned long framesPerHostBuffer;
+
+    /** The speed of the device's streams relative to real time: 1 or 0 runs
+     * at real time, 100 runs 100 times faster, paVirtualFreeRunning as fast
+     * as possible. A stream may override it with PaVirtualStreamInfo. */
+    double speed;
+}
+PaVirtualDeviceInfo;
+
+
+/** Initialize a device configuration to a stereo, full duplex, real time
+ * 48000Hz device which accepts all standard sample formats.
+ */
+void PaVirtual_InitializeDeviceInfo( PaVirtualDeviceInfo *info );
+
+
+/** Add a virtual device.
+ *
+ * This function must be called before Pa_Initialize(), otherwise the device
+ * only appears after PortAudio is terminated and initialized again. Devices
+ * are listed in the order they are added; the first with input channels is
+ * the default input device, and the first with output channels the default
+ * output device. Devices added with this function replace those described by
+ * PA_VIRTUAL_DEVICES.
+ *
+ * @return paNoError, paInvalidChannelCount if the device has no channels,
+ * paInvalidSampleRate if its sample rates are inconsistent,
+ * paSampleFormatNotSupported if sampleFormats holds no standard format, or
+ * paInsufficientMemory if PA_VIRTUAL_MAX_DEVICES devices were added already.
+ */
+PaError PaVirtual_AddDevice( const PaVirtualDeviceInfo *info );
+
+
+/** Remove all the devices added with PaVirtual_AddDevice(). Like that
+ * function it only takes effect at the next Pa_Initialize().
+ */
+void PaVirtual_RemoveAllDevices( void );
+
+
+/** The maximum number of devices PaVirtual_AddDevice() accepts. */
+#define PA_VIRTUAL_MAX_DEVICES (16)
+
+
+/** Where a virtual stream's input comes from, or its output goes to. */
+typedef enum PaVirtualEndpointType
+{
+    /** Input is silence; output is discarded. */
+    paVirtualNull = 0,
+
+    /** Interleaved samples in sampleFormat, in the host's byte order, with no
+     * header. */
+    paVirtualRawFile = 1,
+
+    /** A WAV file. For input, the file's sample format, channel count and
+     * sample rate must match the stream's. Output is written as PCM or IEEE
+     * float in sampleFormat; paInt8 is written as 8 bit (unsigned) PCM. */
+    paVirtualWaveFile = 2,
+
+    /** Interleaved samples in sampleFormat, in a buffer of bufferFrames
+     * frames owned by the client. */
+    paVirtualMemory = 3
+}
+PaVirtualEndpointType;
+
+
+/** Restart input from the beginning of the file or buffer when it ends,
+ * rather than continuing with silence. */
+#define paVirtualLoop ((unsigned long) 0x01)
+
+/** Complete a callback stream, as if the callback had returned paComplete,
+ * once its input file or buffer has ended or its output buffer is full. */
+#define paVirtualCompleteAtEnd ((unsigned long) 0x02)
+
+
+/** Virtual host API specific stream information, passed as
+ * PaStreamParameters::hostApiSpecificStreamInfo. The input and output of a
+ * stream are configured independently. Without it, a stream's input is
+ * silence and its output is discarded.
+ */
+typedef struct PaVirtualStreamInfo
+{
+    unsigned long size;             /**< sizeof(PaVirtualStreamInfo) */
+    PaHostApiTypeId hostApiType;    /**< paVirtual */
+    unsigned long version;          /**< 1 */
+
+    /** A combination of paVirtualLoop and paVirtualCompleteAtEnd. */
+    unsigned long flags;
+
+    /** Overrides the device's speed when non-zero; see
+     * PaVirtualDeviceInfo::speed. When the input and output of a stream both
+     * set a speed, they must agree. */
+    double speed;
+
+    PaVirtualEndpointType endpointType;
+
+    /** The file to read or write, for paVirtualRawFile and
+     * paVirtualWaveFile. An output file is created, or truncated. */
+    const char *fileName;
+
+    /** The buffer to read or write, for paVirtualMemory. */
+    void *buffer;
+    unsigned long bufferFrames;
+
+    /** The sample format of a raw file, a memory buffer or an output WAV
+     * file: one of the device's sampleFormats. 0 for the one closest to the
+     * stream's sample format. */
+    PaSampleFormat sampleFormat;
+}
+PaVirtualStreamInfo;
+
+
+/** Initialize host API specific stream information for a paVirtualNull
+ * endpoint at the device's speed. Call this before setting other fields.
+ */
+void PaVirtual_InitializeStreamInfo( PaVirtualStreamInfo *info );
+
+
+/** Get the number of frames a virtual stream has read from its input
+ * endpoint and written to its output endpoint. Either pointer may be NULL.
+ * Frames beyond the end of an output buffer are not counted.
+ */
+PaError PaVirtual_GetStreamFrames( PaStream *stream, unsigned long *inputFrames,
+        unsigned long *outputFrames );
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PA_VIRTUAL_H */
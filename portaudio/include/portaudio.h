@@ -183,6 +183,41 @@ const char *Pa_GetErrorText( PaError errorCode );
 PaError Pa_Initialize( void );
 
 
+/** Flags used to select how Pa_InitializeWithFlags() brings up host APIs.
+ Flags may be ORed together.
+
+ @see Pa_InitializeWithFlags, paInitializeParallel, paInitializeDeferProbe
+*/
+typedef unsigned long PaInitializeFlags;
+#define paInitializeDefault      ((PaInitializeFlags) 0)
+
+/** Initialize the host APIs concurrently, one thread each, instead of one
+ after another. Host API and device indices are the same as for a serial
+ initialization. Only available where POSIX threads are; elsewhere this
+ flag is ignored.
+*/
+#define paInitializeParallel     ((PaInitializeFlags) 0x00000001)
+
+/** Let host APIs that support it (currently ALSA) enumerate devices without
+ fully probing them. The expensive part of the probe (default sample rate
+ and latencies) runs the first time Pa_GetDeviceInfo() is called for that
+ device, so that call may block while the device is opened. Concurrent
+ callers asking for the same device wait for that probe to finish.
+*/
+#define paInitializeDeferProbe   ((PaInitializeFlags) 0x00000002)
+
+
+/** Same as Pa_Initialize(), but allows the way host APIs are initialized to
+ be chosen. The flags only take effect on the call that actually initializes
+ PortAudio; nested calls behave like Pa_Initialize().
+
+ @param flags A combination of the paInitialize* flags.
+
+ @see Pa_Initialize, PaInitializeFlags
+*/
+PaError Pa_InitializeWithFlags( PaInitializeFlags flags );
+
+
 /** Library termination function - call this when finished using PortAudio.
  This function deallocates all resources allocated by PortAudio since it was
  initialized by a call to Pa_Initialize(). In cases where Pa_Initialise() has
@@ -287,7 +322,8 @@ typedef enum PaHostApiTypeId
     paWDMKS=11,
     paJACK=12,
     paWASAPI=13,
-    paAudioScienceHPI=14
+    paAudioScienceHPI=14,
+    paVirtual=15
 } PaHostApiTypeId;
 
 
@@ -528,7 +564,10 @@ typedef struct PaDeviceInfo
  the client must not manipulate or free the memory. The pointer is only
  guaranteed to be valid between calls to Pa_Initialize() and Pa_Terminate().
 
- @see PaDeviceInfo, PaDeviceIndex
+ @note If PortAudio was initialized with paInitializeDeferProbe, the first
+ call for a device may block while the host API opens it to finish probing.
+
+ @see PaDeviceInfo, PaDeviceIndex, paInitializeDeferProbe
 */
 const PaDeviceInfo* Pa_GetDeviceInfo( PaDeviceIndex device );
 
@@ -648,7 +687,8 @@ typedef void PaStream;
 
  @see Pa_OpenStream, Pa_OpenDefaultStream
  @see paNoFlag, paClipOff, paDitherOff, paNeverDropInput,
-  paPrimeOutputBuffersUsingStreamCallback, paPlatformSpecificFlags
+  paPrimeOutputBuffersUsingStreamCallback, paDitherNoiseShapedFirstOrder,
+  paDitherNoiseShapedSecondOrder, paPlatformSpecificFlags
 */
 typedef unsigned long PaStreamFlags;
 
@@ -684,6 +724,24 @@ typedef unsigned long PaStreamFlags;
 */
 #define   paPrimeOutputBuffersUsingStreamCallback ((PaStreamFlags) 0x00000008)
 
+/** Use first-order noise-shaped dither (noise transfer function 1 - z^-1)
+ rather than triangular dither when converting Float32 output to Int16.
+ Noise-shaped conversion always clips. Other conversions use triangular
+ dither. Ignored when paDitherOff is set, and may not be combined with
+ paDitherNoiseShapedSecondOrder.
+ @see PaStreamFlags
+*/
+#define   paDitherNoiseShapedFirstOrder ((PaStreamFlags) 0x00000010)
+
+/** Use second-order noise-shaped dither (noise transfer function
+ 1 - z^-1 + 0.5z^-2) rather than triangular dither when converting Float32
+ output to Int16. Noise-shaped conversion always clips. Other conversions
+ use triangular dither. Ignored when paDitherOff is set, and may not be
+ combined with paDitherNoiseShapedFirstOrder.
+ @see PaStreamFlags
+*/
+#define   paDitherNoiseShapedSecondOrder ((PaStreamFlags) 0x00000020)
+
 /** A mask specifying the platform specific bits.
  @see PaStreamFlags
 */
@@ -1122,6 +1180,75 @@ PaTime Pa_GetStreamTime( PaStream *stream );
 double Pa_GetStreamCpuLoad( PaStream* stream );
 
 
+/** A snapshot of the callback timing statistics gathered for a stream.
+ Unlike the smoothed average returned by Pa_GetStreamCpuLoad(), the
+ percentiles and maxima preserve the isolated slow callbacks that cause
+ dropouts.
+
+ Times are taken from log-linear histograms with eight buckets per octave,
+ so percentiles are reported as the upper edge of the bucket they fall in
+ (within 12.5% of the true value). Maxima are exact.
+
+ @see Pa_GetStreamProfile, Pa_ResetStreamProfile
+*/
+typedef struct PaStreamProfile
+{
+    /** The number of callbacks measured. */
+    unsigned long callbackCount;
+
+    /** Time spent inside PortAudio's buffer processing and the stream
+     callback, in seconds. */
+    PaTime callbackTimeP50;
+    PaTime callbackTimeP99;
+    PaTime callbackTimeP999;
+    PaTime callbackTimeMax;
+
+    /** Deviation of the interval between the start of successive callbacks
+     from the duration of the previous buffer, in seconds. */
+    PaTime jitterP50;
+    PaTime jitterP99;
+    PaTime jitterP999;
+    PaTime jitterMax;
+
+    /** The number of callbacks which took longer than the duration of the
+     buffer they processed. */
+    unsigned long overloadCount;
+
+    /** The number of callbacks flagged with each of the
+     PaStreamCallbackFlags xrun causes. */
+    unsigned long inputUnderflowCount;
+    unsigned long inputOverflowCount;
+    unsigned long outputUnderflowCount;
+    unsigned long outputOverflowCount;
+} PaStreamProfile;
+
+
+/** Retrieve the callback timing statistics gathered since the stream was
+ opened or since the last call to Pa_ResetStreamProfile(). The statistics
+ are recorded without locking and may be read while the stream is running.
+
+ @param stream A pointer to an open stream previously created with Pa_OpenStream.
+
+ @param profile A pointer to a PaStreamProfile which receives the snapshot.
+
+ @return paNoError on success, or an error code if the stream pointer is
+ invalid. All values are zero for blocking read/write streams and for host
+ APIs which do not gather statistics.
+*/
+PaError Pa_GetStreamProfile( PaStream* stream, PaStreamProfile *profile );
+
+
+/** Discard the callback timing statistics gathered for a stream. The
+ statistics are cleared by the callback thread at the start of the next
+ callback; snapshots taken in the meantime read as zero.
+
+ @param stream A pointer to an open stream previously created with Pa_OpenStream.
+
+ @return paNoError on success, or an error code if the stream pointer is invalid.
+*/
+PaError Pa_ResetStreamProfile( PaStream* stream );
+
+
 /** Read samples from an input stream. The function doesn't return until
  the entire buffer has been filled - this may involve waiting for the operating
  system to supply the data.
@@ -22,8 +22,11 @@ HEADERS += ../include/*.h \
     ../src/common/pa_memorybarrier.h \
     ../src/common/pa_process.h \
     ../src/common/pa_ringbuffer.h \
+    ../src/common/pa_simd_converters.h \
+    ../src/common/pa_spscringbuffer.h \
     ../src/common/pa_stream.h \
     ../src/common/pa_trace.h \
+    ../src/common/pa_tracering.h \
     ../src/common/pa_types.h \
     ../src/common/pa_util.h \
     ../src/hostapi/coreaudio/pa_mac_core_blocking.h \
@@ -48,12 +51,16 @@ SOURCES += \
     ../src/common/pa_front.c \
     ../src/common/pa_process.c \
     ../src/common/pa_ringbuffer.c \
+    ../src/common/pa_simd_converters.c \
+    ../src/common/pa_spscringbuffer.c \
     ../src/common/pa_stream.c \
     ../src/common/pa_trace.c \
+    ../src/common/pa_tracering.c \
     ../src/hostapi/coreaudio/pa_mac_core.c \
     ../src/hostapi/coreaudio/pa_mac_core_blocking.c \
     ../src/hostapi/coreaudio/pa_mac_core_old.c \
     ../src/hostapi/coreaudio/pa_mac_core_utilities.c \
     ../src/hostapi/oss/pa_unix_oss.c \
     ../src/hostapi/oss/recplay.c \
+    ../src/hostapi/virtual/pa_virtual.c \
     ../src/os/unix/pa_unix_util.c
@@ -156,6 +156,17 @@ PaSampleFormat PaUtil_SelectClosestAvailableFormat(
 
 /* -------------------------------------------------------------------------- */
 
+/* noise shaping only applies to Float32 to Int16, which always clips */
+#define PA_SELECT_FLOAT32_TO_INT16_( flags )                                   \
+    if( !(flags & paDitherOff)                                                 \
+            && (flags & (paDitherNoiseShapedFirstOrder | paDitherNoiseShapedSecondOrder)) ){ \
+        return paConverters.Float32_To_Int16_NoiseShapedDither;                \
+    }else{                                                                     \
+        PA_SELECT_CONVERTER_DITHER_CLIP_( flags, Float32, Int16 )              \
+    }
+
+/* -------------------------------------------------------------------------- */
+
 #define PA_SELECT_CONVERTER_DITHER_( flags, source, destination )              \
     if( flags & paDitherOff ){ /* no dither */                                 \
         return paConverters. source ## _To_ ## destination;                    \
@@ -184,7 +195,7 @@ PaUtilConverter* PaUtil_SelectConverter( PaSampleFormat sourceFormat,
                                           /* paFloat32: */        PA_UNITY_CONVERSION_( 32 ),
                                           /* paInt32: */          PA_SELECT_CONVERTER_DITHER_CLIP_( flags, Float32, Int32 ),
                                           /* paInt24: */          PA_SELECT_CONVERTER_DITHER_CLIP_( flags, Float32, Int24 ),
-                                          /* paInt16: */          PA_SELECT_CONVERTER_DITHER_CLIP_( flags, Float32, Int16 ),
+                                          /* paInt16: */          PA_SELECT_FLOAT32_TO_INT16_( flags ),
                                           /* paInt8: */           PA_SELECT_CONVERTER_DITHER_CLIP_( flags, Float32, Int8 ),
                                           /* paUInt8: */          PA_SELECT_CONVERTER_DITHER_CLIP_( flags, Float32, UInt8 )
                                         ),
@@ -257,6 +268,7 @@ PaUtilConverterTable paConverters = {
     0, /* PaUtilConverter *Float32_To_Int16_Dither; */
     0, /* PaUtilConverter *Float32_To_Int16_Clip; */
     0, /* PaUtilConverter *Float32_To_Int16_DitherClip; */
+    0, /* PaUtilConverter *Float32_To_Int16_NoiseShapedDither; */
 
     0, /* PaUtilConverter *Float32_To_Int8; */
     0, /* PaUtilConverter *Float32_To_Int8_Dither; */
@@ -363,25 +375,36 @@ static void Float32_To_Int32_Dither(
     void *sourceBuffer, signed int sourceStride,
     unsigned int count, struct PaUtilTriangularDitherGenerator *ditherGenerator )
 {
+    float ditherBlock[PA_DITHER_BLOCK_SIZE];
     float *src = (float*)sourceBuffer;
     PaInt32 *dest =  (PaInt32*)destinationBuffer;
 
-    while( count-- )
+    while( count > 0 )
     {
-        /* REVIEW */
+        unsigned int blockCount = (count < PA_DITHER_BLOCK_SIZE) ? count : PA_DITHER_BLOCK_SIZE;
+        unsigned int i;
+
+        PaUtil_GenerateFloatTriangularDitherBlock( ditherGenerator, ditherBlock, blockCount );
+
+        for( i=0; i<blockCount; ++i )
+        {
+            /* REVIEW */
 #ifdef PA_USE_C99_LRINTF
-        float dither  = PaUtil_GenerateFloatTriangularDither( ditherGenerator );
-        /* use smaller scaler to prevent overflow when we add the dither */
-        float dithered = ((float)*src * (2147483646.0f)) + dither;
-        *dest = lrintf(dithered - 0.5f);
+            float dither  = ditherBlock[i];
+            /* use smaller scaler to prevent overflow when we add the dither */
+            float dithered = ((float)*src * (2147483646.0f)) + dither;
+            *dest = lrintf(dithered - 0.5f);
 #else
-        double dither  = PaUtil_GenerateFloatTriangularDither( ditherGenerator );
-        /* use smaller scaler to prevent overflow when we add the dither */
-        double dithered = ((double)*src * (2147483646.0)) + dither;
-        *dest = (PaInt32) dithered;
+            double dither  = ditherBlock[i];
+            /* use smaller scaler to prevent overflow when we add the dither */
+            double dithered = ((double)*src * (2147483646.0)) + dither;
+            *dest = (PaInt32) dithered;
 #endif
-        src += sourceStride;
-        dest += destinationStride;
+            src += sourceStride;
+            dest += destinationStride;
+        }
+
+        count -= blockCount;
     }
 }
 
@@ -421,28 +444,39 @@ static void Float32_To_Int32_DitherClip(
     void *sourceBuffer, signed int sourceStride,
     unsigned int count, struct PaUtilTriangularDitherGenerator *ditherGenerator )
 {
+    float ditherBlock[PA_DITHER_BLOCK_SIZE];
     float *src = (float*)sourceBuffer;
     PaInt32 *dest =  (PaInt32*)destinationBuffer;
 
-    while( count-- )
+    while( count > 0 )
     {
-        /* REVIEW */
+        unsigned int blockCount = (count < PA_DITHER_BLOCK_SIZE) ? count : PA_DITHER_BLOCK_SIZE;
+        unsigned int i;
+
+        PaUtil_GenerateFloatTriangularDitherBlock( ditherGenerator, ditherBlock, blockCount );
+
+        for( i=0; i<blockCount; ++i )
+        {
+            /* REVIEW */
 #ifdef PA_USE_C99_LRINTF
-        float dither  = PaUtil_GenerateFloatTriangularDither( ditherGenerator );
-        /* use smaller scaler to prevent overflow when we add the dither */
-        float dithered = ((float)*src * (2147483646.0f)) + dither;
-        PA_CLIP_( dithered, -2147483648.f, 2147483647.f  );
-        *dest = lrintf(dithered-0.5f);
+            float dither  = ditherBlock[i];
+            /* use smaller scaler to prevent overflow when we add the dither */
+            float dithered = ((float)*src * (2147483646.0f)) + dither;
+            PA_CLIP_( dithered, -2147483648.f, 2147483647.f  );
+            *dest = lrintf(dithered-0.5f);
 #else
-        double dither  = PaUtil_GenerateFloatTriangularDither( ditherGenerator );
-        /* use smaller scaler to prevent overflow when we add the dither */
-        double dithered = ((double)*src * (2147483646.0)) + dither;
-        PA_CLIP_( dithered, -2147483648., 2147483647.  );
-        *dest = (PaInt32) dithered;
+            double dither  = ditherBlock[i];
+            /* use smaller scaler to prevent overflow when we add the dither */
+            double dithered = ((double)*src * (2147483646.0)) + dither;
+            PA_CLIP_( dithered, -2147483648., 2147483647.  );
+            *dest = (PaInt32) dithered;
 #endif
 
-        src += sourceStride;
-        dest += destinationStride;
+            src += sourceStride;
+            dest += destinationStride;
+        }
+
+        count -= blockCount;
     }
 }
 
@@ -487,32 +521,43 @@ static void Float32_To_Int24_Dither(
     void *sourceBuffer, signed int sourceStride,
     unsigned int count, struct PaUtilTriangularDitherGenerator *ditherGenerator )
 {
+    float ditherBlock[PA_DITHER_BLOCK_SIZE];
     float *src = (float*)sourceBuffer;
     unsigned char *dest = (unsigned char*)destinationBuffer;
     PaInt32 temp;
 
-    while( count-- )
+    while( count > 0 )
     {
-        /* convert to 32 bit and drop the low 8 bits */
+        unsigned int blockCount = (count < PA_DITHER_BLOCK_SIZE) ? count : PA_DITHER_BLOCK_SIZE;
+        unsigned int i;
 
-        double dither  = PaUtil_GenerateFloatTriangularDither( ditherGenerator );
-        /* use smaller scaler to prevent overflow when we add the dither */
-        double dithered = ((double)*src * (2147483646.0)) + dither;
-        
-        temp = (PaInt32) dithered;
+        PaUtil_GenerateFloatTriangularDitherBlock( ditherGenerator, ditherBlock, blockCount );
+
+        for( i=0; i<blockCount; ++i )
+        {
+            /* convert to 32 bit and drop the low 8 bits */
+
+            double dither  = ditherBlock[i];
+            /* use smaller scaler to prevent overflow when we add the dither */
+            double dithered = ((double)*src * (2147483646.0)) + dither;
+
+            temp = (PaInt32) dithered;
 
 #if defined(PA_LITTLE_ENDIAN)
-        dest[0] = (unsigned char)(temp >> 8);
-        dest[1] = (unsigned char)(temp >> 16);
-        dest[2] = (unsigned char)(temp >> 24);
+            dest[0] = (unsigned char)(temp >> 8);
+            dest[1] = (unsigned char)(temp >> 16);
+            dest[2] = (unsigned char)(temp >> 24);
 #elif defined(PA_BIG_ENDIAN)
-        dest[0] = (unsigned char)(temp >> 24);
-        dest[1] = (unsigned char)(temp >> 16);
-        dest[2] = (unsigned char)(temp >> 8);
+            dest[0] = (unsigned char)(temp >> 24);
+            dest[1] = (unsigned char)(temp >> 16);
+            dest[2] = (unsigned char)(temp >> 8);
 #endif
 
-        src += sourceStride;
-        dest += destinationStride * 3;
+            src += sourceStride;
+            dest += destinationStride * 3;
+        }
+
+        count -= blockCount;
     }
 }
 
@@ -558,33 +603,44 @@ static void Float32_To_Int24_DitherClip(
     void *sourceBuffer, signed int sourceStride,
     unsigned int count, struct PaUtilTriangularDitherGenerator *ditherGenerator )
 {
+    float ditherBlock[PA_DITHER_BLOCK_SIZE];
     float *src = (float*)sourceBuffer;
     unsigned char *dest = (unsigned char*)destinationBuffer;
     PaInt32 temp;
     
-    while( count-- )
+    while( count > 0 )
     {
-        /* convert to 32 bit and drop the low 8 bits */
-        
-        double dither  = PaUtil_GenerateFloatTriangularDither( ditherGenerator );
-        /* use smaller scaler to prevent overflow when we add the dither */
-        double dithered = ((double)*src * (2147483646.0)) + dither;
-        PA_CLIP_( dithered, -2147483648., 2147483647.  );
-        
-        temp = (PaInt32) dithered;
+        unsigned int blockCount = (count < PA_DITHER_BLOCK_SIZE) ? count : PA_DITHER_BLOCK_SIZE;
+        unsigned int i;
+
+        PaUtil_GenerateFloatTriangularDitherBlock( ditherGenerator, ditherBlock, blockCount );
+
+        for( i=0; i<blockCount; ++i )
+        {
+            /* convert to 32 bit and drop the low 8 bits */
+
+            double dither  = ditherBlock[i];
+            /* use smaller scaler to prevent overflow when we add the dither */
+            double dithered = ((double)*src * (2147483646.0)) + dither;
+            PA_CLIP_( dithered, -2147483648., 2147483647.  );
+
+            temp = (PaInt32) dithered;
 
 #if defined(PA_LITTLE_ENDIAN)
-        dest[0] = (unsigned char)(temp >> 8);
-        dest[1] = (unsigned char)(temp >> 16);
-        dest[2] = (unsigned char)(temp >> 24);
+            dest[0] = (unsigned char)(temp >> 8);
+            dest[1] = (unsigned char)(temp >> 16);
+            dest[2] = (unsigned char)(temp >> 24);
 #elif defined(PA_BIG_ENDIAN)
-        dest[0] = (unsigned char)(temp >> 24);
-        dest[1] = (unsigned char)(temp >> 16);
-        dest[2] = (unsigned char)(temp >> 8);
+            dest[0] = (unsigned char)(temp >> 24);
+            dest[1] = (unsigned char)(temp >> 16);
+            dest[2] = (unsigned char)(temp >> 8);
 #endif
 
-        src += sourceStride;
-        dest += destinationStride * 3;
+            src += sourceStride;
+            dest += destinationStride * 3;
+        }
+
+        count -= blockCount;
     }
 }
 
@@ -621,24 +677,35 @@ static void Float32_To_Int16_Dither(
     void *sourceBuffer, signed int sourceStride,
     unsigned int count, struct PaUtilTriangularDitherGenerator *ditherGenerator )
 {
+    float ditherBlock[PA_DITHER_BLOCK_SIZE];
     float *src = (float*)sourceBuffer;
     PaInt16 *dest = (PaInt16*)destinationBuffer;
 
-    while( count-- )
+    while( count > 0 )
     {
+        unsigned int blockCount = (count < PA_DITHER_BLOCK_SIZE) ? count : PA_DITHER_BLOCK_SIZE;
+        unsigned int i;
+
+        PaUtil_GenerateFloatTriangularDitherBlock( ditherGenerator, ditherBlock, blockCount );
+
+        for( i=0; i<blockCount; ++i )
+        {
 
-        float dither  = PaUtil_GenerateFloatTriangularDither( ditherGenerator );
-        /* use smaller scaler to prevent overflow when we add the dither */
-        float dithered = (*src * (32766.0f)) + dither;
+            float dither  = ditherBlock[i];
+            /* use smaller scaler to prevent overflow when we add the dither */
+            float dithered = (*src * (32766.0f)) + dither;
 
 #ifdef PA_USE_C99_LRINTF
-        *dest = lrintf(dithered-0.5f);
+            *dest = lrintf(dithered-0.5f);
 #else
-        *dest = (PaInt16) dithered;
+            *dest = (PaInt16) dithered;
 #endif
 
-        src += sourceStride;
-        dest += destinationStride;
+            src += sourceStride;
+            dest += destinationStride;
+        }
+
+        count -= blockCount;
     }
 }
 
@@ -675,31 +742,98 @@ static void Float32_To_Int16_DitherClip(
     void *sourceBuffer, signed int sourceStride,
     unsigned int count, struct PaUtilTriangularDitherGenerator *ditherGenerator )
 {
+    float ditherBlock[PA_DITHER_BLOCK_SIZE];
     float *src = (float*)sourceBuffer;
     PaInt16 *dest =  (PaInt16*)destinationBuffer;
     (void)ditherGenerator; /* unused parameter */
 
-    while( count-- )
+    while( count > 0 )
     {
+        unsigned int blockCount = (count < PA_DITHER_BLOCK_SIZE) ? count : PA_DITHER_BLOCK_SIZE;
+        unsigned int i;
 
-        float dither  = PaUtil_GenerateFloatTriangularDither( ditherGenerator );
-        /* use smaller scaler to prevent overflow when we add the dither */
-        float dithered = (*src * (32766.0f)) + dither;
-        PaInt32 samp = (PaInt32) dithered;
-        PA_CLIP_( samp, -0x8000, 0x7FFF );
+        PaUtil_GenerateFloatTriangularDitherBlock( ditherGenerator, ditherBlock, blockCount );
+
+        for( i=0; i<blockCount; ++i )
+        {
+
+            float dither  = ditherBlock[i];
+            /* use smaller scaler to prevent overflow when we add the dither */
+            float dithered = (*src * (32766.0f)) + dither;
+            PaInt32 samp = (PaInt32) dithered;
+            PA_CLIP_( samp, -0x8000, 0x7FFF );
 #ifdef PA_USE_C99_LRINTF
-        *dest = lrintf(samp-0.5f);
+            *dest = lrintf(samp-0.5f);
 #else
-        *dest = (PaInt16) samp;
+            *dest = (PaInt16) samp;
 #endif
 
-        src += sourceStride;
-        dest += destinationStride;
+            src += sourceStride;
+            dest += destinationStride;
+        }
+
+        count -= blockCount;
     }
 }
 
 /* -------------------------------------------------------------------------- */
 
+static void Float32_To_Int16_NoiseShapedDither(
+    void *destinationBuffer, signed int destinationStride,
+    void *sourceBuffer, signed int sourceStride,
+    unsigned int count, struct PaUtilTriangularDitherGenerator *ditherGenerator )
+{
+    float ditherBlock[PA_DITHER_BLOCK_SIZE];
+    float *src = (float*)sourceBuffer;
+    PaInt16 *dest =  (PaInt16*)destinationBuffer;
+    /* keep the error feedback state in locals for the whole buffer */
+    float c0 = ditherGenerator->shapingCoefficients[0];
+    float c1 = ditherGenerator->shapingCoefficients[1];
+    float e0 = ditherGenerator->shapingError[0];
+    float e1 = ditherGenerator->shapingError[1];
+
+    while( count > 0 )
+    {
+        unsigned int blockCount = (count < PA_DITHER_BLOCK_SIZE) ? count : PA_DITHER_BLOCK_SIZE;
+        unsigned int i;
+
+        PaUtil_GenerateFloatTriangularDitherBlock( ditherGenerator, ditherBlock, blockCount );
+
+        for( i=0; i<blockCount; ++i )
+        {
+            /* use smaller scaler to prevent overflow when we add the dither */
+            float shaped = (*src * (32766.0f)) - c0 * e0 - c1 * e1;
+            /* round to nearest: the error must be centred for the feedback to work */
+            float dithered = shaped + ditherBlock[i] + 0.5f;
+            PaInt32 samp;
+
+            PA_CLIP_( dithered, -65536.0f, 65536.0f );
+            samp = (PaInt32) dithered;
+            if( dithered < (float)samp )
+                --samp;
+
+            e1 = e0;
+            e0 = (float)samp - shaped;
+            /* overload (or NaN input) would make the feedback diverge */
+            if( !(e0 > -4.0f && e0 < 4.0f) )
+                e0 = 0.0f;
+
+            PA_CLIP_( samp, -0x8000, 0x7FFF );
+            *dest = (PaInt16) samp;
+
+            src += sourceStride;
+            dest += destinationStride;
+        }
+
+        count -= blockCount;
+    }
+
+    ditherGenerator->shapingError[0] = e0;
+    ditherGenerator->shapingError[1] = e1;
+}
+
+/* -------------------------------------------------------------------------- */
+
 static void Float32_To_Int8(
     void *destinationBuffer, signed int destinationStride,
     void *sourceBuffer, signed int sourceStride,
@@ -726,19 +860,30 @@ static void Float32_To_Int8_Dither(
     void *sourceBuffer, signed int sourceStride,
     unsigned int count, struct PaUtilTriangularDitherGenerator *ditherGenerator )
 {
+    float ditherBlock[PA_DITHER_BLOCK_SIZE];
     float *src = (float*)sourceBuffer;
     signed char *dest =  (signed char*)destinationBuffer;
     
-    while( count-- )
+    while( count > 0 )
     {
-        float dither  = PaUtil_GenerateFloatTriangularDither( ditherGenerator );
-        /* use smaller scaler to prevent overflow when we add the dither */
-        float dithered = (*src * (126.0f)) + dither;
-        PaInt32 samp = (PaInt32) dithered;
-        *dest = (signed char) samp;
+        unsigned int blockCount = (count < PA_DITHER_BLOCK_SIZE) ? count : PA_DITHER_BLOCK_SIZE;
+        unsigned int i;
 
-        src += sourceStride;
-        dest += destinationStride;
+        PaUtil_GenerateFloatTriangularDitherBlock( ditherGenerator, ditherBlock, blockCount );
+
+        for( i=0; i<blockCount; ++i )
+        {
+            float dither  = ditherBlock[i];
+            /* use smaller scaler to prevent overflow when we add the dither */
+            float dithered = (*src * (126.0f)) + dither;
+            PaInt32 samp = (PaInt32) dithered;
+            *dest = (signed char) samp;
+
+            src += sourceStride;
+            dest += destinationStride;
+        }
+
+        count -= blockCount;
     }
 }
 
@@ -771,21 +916,32 @@ static void Float32_To_Int8_DitherClip(
     void *sourceBuffer, signed int sourceStride,
     unsigned int count, struct PaUtilTriangularDitherGenerator *ditherGenerator )
 {
+    float ditherBlock[PA_DITHER_BLOCK_SIZE];
     float *src = (float*)sourceBuffer;
     signed char *dest =  (signed char*)destinationBuffer;
     (void)ditherGenerator; /* unused parameter */
 
-    while( count-- )
+    while( count > 0 )
     {
-        float dither  = PaUtil_GenerateFloatTriangularDither( ditherGenerator );
-        /* use smaller scaler to prevent overflow when we add the dither */
-        float dithered = (*src * (126.0f)) + dither;
-        PaInt32 samp = (PaInt32) dithered;
-        PA_CLIP_( samp, -0x80, 0x7F );
-        *dest = (signed char) samp;
+        unsigned int blockCount = (count < PA_DITHER_BLOCK_SIZE) ? count : PA_DITHER_BLOCK_SIZE;
+        unsigned int i;
 
-        src += sourceStride;
-        dest += destinationStride;
+        PaUtil_GenerateFloatTriangularDitherBlock( ditherGenerator, ditherBlock, blockCount );
+
+        for( i=0; i<blockCount; ++i )
+        {
+            float dither  = ditherBlock[i];
+            /* use smaller scaler to prevent overflow when we add the dither */
+            float dithered = (*src * (126.0f)) + dither;
+            PaInt32 samp = (PaInt32) dithered;
+            PA_CLIP_( samp, -0x80, 0x7F );
+            *dest = (signed char) samp;
+
+            src += sourceStride;
+            dest += destinationStride;
+        }
+
+        count -= blockCount;
     }
 }
 
@@ -817,19 +973,30 @@ static void Float32_To_UInt8_Dither(
     void *sourceBuffer, signed int sourceStride,
     unsigned int count, struct PaUtilTriangularDitherGenerator *ditherGenerator )
 {
+    float ditherBlock[PA_DITHER_BLOCK_SIZE];
     float *src = (float*)sourceBuffer;
     unsigned char *dest =  (unsigned char*)destinationBuffer;
     
-    while( count-- )
+    while( count > 0 )
     {
-        float dither  = PaUtil_GenerateFloatTriangularDither( ditherGenerator );
-        /* use smaller scaler to prevent overflow when we add the dither */
-        float dithered = (*src * (126.0f)) + dither;
-        PaInt32 samp = (PaInt32) dithered;
-        *dest = (unsigned char) (128 + samp);
-        
-        src += sourceStride;
-        dest += destinationStride;
+        unsigned int blockCount = (count < PA_DITHER_BLOCK_SIZE) ? count : PA_DITHER_BLOCK_SIZE;
+        unsigned int i;
+
+        PaUtil_GenerateFloatTriangularDitherBlock( ditherGenerator, ditherBlock, blockCount );
+
+        for( i=0; i<blockCount; ++i )
+        {
+            float dither  = ditherBlock[i];
+            /* use smaller scaler to prevent overflow when we add the dither */
+            float dithered = (*src * (126.0f)) + dither;
+            PaInt32 samp = (PaInt32) dithered;
+            *dest = (unsigned char) (128 + samp);
+
+            src += sourceStride;
+            dest += destinationStride;
+        }
+
+        count -= blockCount;
     }
 }
 
@@ -862,21 +1029,32 @@ static void Float32_To_UInt8_DitherClip(
     void *sourceBuffer, signed int sourceStride,
     unsigned int count, struct PaUtilTriangularDitherGenerator *ditherGenerator )
 {
+    float ditherBlock[PA_DITHER_BLOCK_SIZE];
     float *src = (float*)sourceBuffer;
     unsigned char *dest =  (unsigned char*)destinationBuffer;
     (void)ditherGenerator; /* unused parameter */
 
-    while( count-- )
+    while( count > 0 )
     {
-        float dither  = PaUtil_GenerateFloatTriangularDither( ditherGenerator );
-        /* use smaller scaler to prevent overflow when we add the dither */
-        float dithered = (*src * (126.0f)) + dither;
-        PaInt32 samp = 128 + (PaInt32) dithered;
-        PA_CLIP_( samp, 0x0000, 0x00FF );
-        *dest = (unsigned char) samp;
+        unsigned int blockCount = (count < PA_DITHER_BLOCK_SIZE) ? count : PA_DITHER_BLOCK_SIZE;
+        unsigned int i;
 
-        src += sourceStride;
-        dest += destinationStride;
+        PaUtil_GenerateFloatTriangularDitherBlock( ditherGenerator, ditherBlock, blockCount );
+
+        for( i=0; i<blockCount; ++i )
+        {
+            float dither  = ditherBlock[i];
+            /* use smaller scaler to prevent overflow when we add the dither */
+            float dithered = (*src * (126.0f)) + dither;
+            PaInt32 samp = 128 + (PaInt32) dithered;
+            PA_CLIP_( samp, 0x0000, 0x00FF );
+            *dest = (unsigned char) samp;
+
+            src += sourceStride;
+            dest += destinationStride;
+        }
+
+        count -= blockCount;
     }
 }
 
@@ -971,18 +1149,29 @@ static void Int32_To_Int16_Dither(
     void *sourceBuffer, signed int sourceStride,
     unsigned int count, struct PaUtilTriangularDitherGenerator *ditherGenerator )
 {
+    PaInt32 ditherBlock[PA_DITHER_BLOCK_SIZE];
     PaInt32 *src = (PaInt32*)sourceBuffer;
     PaInt16 *dest =  (PaInt16*)destinationBuffer;
     PaInt32 dither;
 
-    while( count-- )
+    while( count > 0 )
     {
-        /* REVIEW */
-        dither = PaUtil_Generate16BitTriangularDither( ditherGenerator );
-        *dest = (PaInt16) ((((*src)>>1) + dither) >> 15);
+        unsigned int blockCount = (count < PA_DITHER_BLOCK_SIZE) ? count : PA_DITHER_BLOCK_SIZE;
+        unsigned int i;
 
-        src += sourceStride;
-        dest += destinationStride;
+        PaUtil_Generate16BitTriangularDitherBlock( ditherGenerator, ditherBlock, blockCount );
+
+        for( i=0; i<blockCount; ++i )
+        {
+            /* REVIEW */
+            dither = ditherBlock[i];
+            *dest = (PaInt16) ((((*src)>>1) + dither) >> 15);
+
+            src += sourceStride;
+            dest += destinationStride;
+        }
+
+        count -= blockCount;
     }
 }
 
@@ -1013,18 +1202,29 @@ static void Int32_To_Int8_Dither(
     void *sourceBuffer, signed int sourceStride,
     unsigned int count, struct PaUtilTriangularDitherGenerator *ditherGenerator )
 {
+    PaInt32 ditherBlock[PA_DITHER_BLOCK_SIZE];
     PaInt32 *src = (PaInt32*)sourceBuffer;
     signed char *dest =  (signed char*)destinationBuffer;
     PaInt32 dither;
 
-    while( count-- )
+    while( count > 0 )
     {
-        /* REVIEW */
-        dither = PaUtil_Generate16BitTriangularDither( ditherGenerator );
-        *dest = (signed char) ((((*src)>>1) + dither) >> 23);
+        unsigned int blockCount = (count < PA_DITHER_BLOCK_SIZE) ? count : PA_DITHER_BLOCK_SIZE;
+        unsigned int i;
 
-        src += sourceStride;
-        dest += destinationStride;
+        PaUtil_Generate16BitTriangularDitherBlock( ditherGenerator, ditherBlock, blockCount );
+
+        for( i=0; i<blockCount; ++i )
+        {
+            /* REVIEW */
+            dither = ditherBlock[i];
+            *dest = (signed char) ((((*src)>>1) + dither) >> 23);
+
+            src += sourceStride;
+            dest += destinationStride;
+        }
+
+        count -= blockCount;
     }
 }
 
@@ -1175,30 +1375,41 @@ static void Int24_To_Int16_Dither(
     void *sourceBuffer, signed int sourceStride,
     unsigned int count, struct PaUtilTriangularDitherGenerator *ditherGenerator )
 {
+    PaInt32 ditherBlock[PA_DITHER_BLOCK_SIZE];
     unsigned char *src = (unsigned char*)sourceBuffer;
     PaInt16 *dest = (PaInt16*)destinationBuffer;
 
     PaInt32 temp, dither;
 
-    while( count-- )
+    while( count > 0 )
     {
+        unsigned int blockCount = (count < PA_DITHER_BLOCK_SIZE) ? count : PA_DITHER_BLOCK_SIZE;
+        unsigned int i;
+
+        PaUtil_Generate16BitTriangularDitherBlock( ditherGenerator, ditherBlock, blockCount );
+
+        for( i=0; i<blockCount; ++i )
+        {
 
 #if defined(PA_LITTLE_ENDIAN)
-        temp = (((PaInt32)src[0]) << 8);  
-        temp = temp | (((PaInt32)src[1]) << 16);
-        temp = temp | (((PaInt32)src[2]) << 24);
+            temp = (((PaInt32)src[0]) << 8);  
+            temp = temp | (((PaInt32)src[1]) << 16);
+            temp = temp | (((PaInt32)src[2]) << 24);
 #elif defined(PA_BIG_ENDIAN)
-        temp = (((PaInt32)src[0]) << 24);
-        temp = temp | (((PaInt32)src[1]) << 16);
-        temp = temp | (((PaInt32)src[2]) << 8);
+            temp = (((PaInt32)src[0]) << 24);
+            temp = temp | (((PaInt32)src[1]) << 16);
+            temp = temp | (((PaInt32)src[2]) << 8);
 #endif
 
-        /* REVIEW */
-        dither = PaUtil_Generate16BitTriangularDither( ditherGenerator );
-        *dest = (PaInt16) (((temp >> 1) + dither) >> 15);
+            /* REVIEW */
+            dither = ditherBlock[i];
+            *dest = (PaInt16) (((temp >> 1) + dither) >> 15);
 
-        src  += sourceStride * 3;
-        dest += destinationStride;
+            src  += sourceStride * 3;
+            dest += destinationStride;
+        }
+
+        count -= blockCount;
     }
 }
 
@@ -1239,30 +1450,41 @@ static void Int24_To_Int8_Dither(
     void *sourceBuffer, signed int sourceStride,
     unsigned int count, struct PaUtilTriangularDitherGenerator *ditherGenerator )
 {
+    PaInt32 ditherBlock[PA_DITHER_BLOCK_SIZE];
     unsigned char *src = (unsigned char*)sourceBuffer;
     signed char  *dest = (signed char*)destinationBuffer;
     
     PaInt32 temp, dither;
 
-    while( count-- )
+    while( count > 0 )
     {
+        unsigned int blockCount = (count < PA_DITHER_BLOCK_SIZE) ? count : PA_DITHER_BLOCK_SIZE;
+        unsigned int i;
+
+        PaUtil_Generate16BitTriangularDitherBlock( ditherGenerator, ditherBlock, blockCount );
+
+        for( i=0; i<blockCount; ++i )
+        {
 
 #if defined(PA_LITTLE_ENDIAN)
-        temp = (((PaInt32)src[0]) << 8);  
-        temp = temp | (((PaInt32)src[1]) << 16);
-        temp = temp | (((PaInt32)src[2]) << 24);
+            temp = (((PaInt32)src[0]) << 8);  
+            temp = temp | (((PaInt32)src[1]) << 16);
+            temp = temp | (((PaInt32)src[2]) << 24);
 #elif defined(PA_BIG_ENDIAN)
-        temp = (((PaInt32)src[0]) << 24);
-        temp = temp | (((PaInt32)src[1]) << 16);
-        temp = temp | (((PaInt32)src[2]) << 8);
+            temp = (((PaInt32)src[0]) << 24);
+            temp = temp | (((PaInt32)src[1]) << 16);
+            temp = temp | (((PaInt32)src[2]) << 8);
 #endif
 
-        /* REVIEW */
-        dither = PaUtil_Generate16BitTriangularDither( ditherGenerator );
-        *dest = (signed char) (((temp >> 1) + dither) >> 23);
+            /* REVIEW */
+            dither = ditherBlock[i];
+            *dest = (signed char) (((temp >> 1) + dither) >> 23);
 
-        src += sourceStride * 3;
-        dest += destinationStride;
+            src += sourceStride * 3;
+            dest += destinationStride;
+        }
+
+        count -= blockCount;
     }
 }
 
@@ -1792,6 +2014,7 @@ PaUtilConverterTable paConverters = {
     Float32_To_Int16_Dither,       /* PaUtilConverter *Float32_To_Int16_Dither; */
     Float32_To_Int16_Clip,         /* PaUtilConverter *Float32_To_Int16_Clip; */
     Float32_To_Int16_DitherClip,   /* PaUtilConverter *Float32_To_Int16_DitherClip; */
+    Float32_To_Int16_NoiseShapedDither, /* PaUtilConverter *Float32_To_Int16_NoiseShapedDither; */
 
     Float32_To_Int8,               /* PaUtilConverter *Float32_To_Int8; */
     Float32_To_Int8_Dither,        /* PaUtilConverter *Float32_To_Int8_Dither; */
@@ -150,6 +150,7 @@ typedef struct{
     PaUtilConverter *Float32_To_Int16_Dither;
     PaUtilConverter *Float32_To_Int16_Clip;
     PaUtilConverter *Float32_To_Int16_DitherClip;
+    PaUtilConverter *Float32_To_Int16_NoiseShapedDither; /* clips, see PaUtil_SetDitherNoiseShaping() */
 
     PaUtilConverter *Float32_To_Int8;
     PaUtilConverter *Float32_To_Int8_Dither;
@@ -41,7 +41,8 @@
  @ingroup common_src
 
  @brief Functions to assist in measuring the CPU utilization of a callback
- stream. Used to implement the Pa_GetStreamCpuLoad() function.
+ stream. Used to implement the Pa_GetStreamCpuLoad() and
+ Pa_GetStreamProfile() functions.
 
  @todo Dynamically calculate the coefficients used to smooth the CPU Load
  Measurements over time to provide a uniform characterisation of CPU Load
@@ -53,8 +54,29 @@
 #include "pa_cpuload.h"
 
 #include <assert.h>
+#include <math.h>   /* for ceil() */
+#include <string.h> /* for memset() */
 
 #include "pa_util.h"   /* for PaUtil_GetTime() */
+#include "pa_memorybarrier.h"
+#include "pa_tracering.h"
+
+
+/* Profile fields are written by the callback thread and read concurrently
+    by other threads. Each is a single aligned 32 bit word, so relaxed atomic
+    loads and stores are sufficient; ordering is only needed around
+    resetAcknowledge, where explicit barriers are used. */
+#if defined(__ATOMIC_RELAXED)
+#define PA_PROFILE_LOAD_( x )       __atomic_load_n( &(x), __ATOMIC_RELAXED )
+#define PA_PROFILE_STORE_( x, v )   __atomic_store_n( &(x), (v), __ATOMIC_RELAXED )
+#else
+#define PA_PROFILE_LOAD_( x )       (*(volatile PaUint32*)&(x))
+#define PA_PROFILE_STORE_( x, v )   (*(volatile PaUint32*)&(x) = (v))
+#endif
+
+#define PA_PROFILE_INCREMENT_( x )  PA_PROFILE_STORE_( x, PA_PROFILE_LOAD_( x ) + 1 )
+
+#define PA_PROFILE_MAX_NANOSECONDS_ (0xFFFFFFFFUL)
 
 
 void PaUtil_InitializeCpuLoadMeasurer( PaUtilCpuLoadMeasurer* measurer, double sampleRate )
@@ -63,16 +85,129 @@ void PaUtil_InitializeCpuLoadMeasurer( PaUtilCpuLoadMeasurer* measurer, double s
 
     measurer->samplingPeriod = 1. / sampleRate;
     measurer->averageLoad = 0.;
+    measurer->profile = NULL;
+    measurer->previousStartTime = 0.;
+    measurer->previousPeriod = 0.;
+    measurer->previousStartCount = 0;
 }
 
 void PaUtil_ResetCpuLoadMeasurer( PaUtilCpuLoadMeasurer* measurer )
 {
     measurer->averageLoad = 0.;
+    measurer->previousStartTime = 0.;
+}
+
+
+static PaUint32 ToNanoseconds( double seconds )
+{
+    double nanoseconds = seconds * 1e9;
+
+    if( nanoseconds <= 0. )
+        return 0;
+    else if( nanoseconds >= (double)PA_PROFILE_MAX_NANOSECONDS_ )
+        return (PaUint32)PA_PROFILE_MAX_NANOSECONDS_;
+    else
+        return (PaUint32)nanoseconds;
 }
 
+
+/*
+    Histogram buckets are log-linear: values below 8ns have a bucket each,
+    above that each power of two is split into eight equal sub-buckets, so
+    a bucket's width is never more than 1/8 of its lower edge.
+*/
+static int BucketIndex( PaUint32 nanoseconds )
+{
+    int octave = 3;
+
+    if( nanoseconds < 8 )
+        return (int)nanoseconds;
+
+    while( octave < 31 && (nanoseconds >> (octave + 1)) != 0 )
+        ++octave;
+
+    return 8 + (octave - 3) * 8 + (int)((nanoseconds >> (octave - 3)) & 7);
+}
+
+
+static double BucketUpperEdge( int bucket )
+{
+    int octave, subBucket;
+    double width;
+
+    if( bucket < 8 )
+        return (double)bucket;
+
+    octave = (bucket - 8) / 8 + 3;
+    subBucket = (bucket - 8) % 8;
+    width = ldexp( 1., octave - 3 );
+
+    return (8 + subBucket) * width + width - 1.;
+}
+
+
+static void RecordValue( PaUint32 *histogram, PaUint32 *maximum, PaUint32 nanoseconds )
+{
+    PA_PROFILE_INCREMENT_( histogram[ BucketIndex( nanoseconds ) ] );
+
+    if( nanoseconds > PA_PROFILE_LOAD_( *maximum ) )
+        PA_PROFILE_STORE_( *maximum, nanoseconds );
+}
+
+
+static void ClearCallbackStatistics( PaUtilCallbackProfile* profile )
+{
+    int i;
+
+    PA_PROFILE_STORE_( profile->callbackCount, 0 );
+    PA_PROFILE_STORE_( profile->callbackTimeMax, 0 );
+    PA_PROFILE_STORE_( profile->jitterMax, 0 );
+    PA_PROFILE_STORE_( profile->overloadCount, 0 );
+    PA_PROFILE_STORE_( profile->inputUnderflowCount, 0 );
+    PA_PROFILE_STORE_( profile->inputOverflowCount, 0 );
+    PA_PROFILE_STORE_( profile->outputUnderflowCount, 0 );
+    PA_PROFILE_STORE_( profile->outputOverflowCount, 0 );
+
+    for( i=0; i < PA_CALLBACK_PROFILE_BUCKETS; ++i )
+    {
+        PA_PROFILE_STORE_( profile->callbackTime[i], 0 );
+        PA_PROFILE_STORE_( profile->jitter[i], 0 );
+    }
+}
+
+
 void PaUtil_BeginCpuLoadMeasurement( PaUtilCpuLoadMeasurer* measurer )
 {
-    measurer->measurementStartTime = PaUtil_GetTime();
+    PaUtilCallbackProfile *profile = measurer->profile;
+    double startTime = PaUtil_GetTime();
+    PaUint32 resetRequest, startCount;
+
+    measurer->measurementStartTime = startTime;
+
+    PaUtil_TraceEvent( paUtilTraceCallbackBegin, 0, 0 );
+
+    if( profile )
+    {
+        resetRequest = PA_PROFILE_LOAD_( profile->resetRequest );
+        startCount = PA_PROFILE_LOAD_( profile->startCount );
+
+        if( resetRequest != PA_PROFILE_LOAD_( profile->resetAcknowledge ) )
+        {
+            ClearCallbackStatistics( profile );
+            PaUtil_WriteMemoryBarrier();
+            PA_PROFILE_STORE_( profile->resetAcknowledge, resetRequest );
+        }
+        else if( startCount == measurer->previousStartCount
+                && measurer->previousStartTime > 0. && measurer->previousPeriod > 0. )
+        {
+            RecordValue( profile->jitter, &profile->jitterMax,
+                    ToNanoseconds( fabs( (startTime - measurer->previousStartTime)
+                            - measurer->previousPeriod ) ) );
+        }
+
+        measurer->previousStartTime = startTime;
+        measurer->previousStartCount = startCount;
+    }
 }
 
 
@@ -95,7 +230,23 @@ void PaUtil_EndCpuLoadMeasurement( PaUtilCpuLoadMeasurer* measurer, unsigned lon
 
         measurer->averageLoad = (LOWPASS_COEFFICIENT_0 * measurer->averageLoad) +
                                (LOWPASS_COEFFICIENT_1 * measuredLoad);
+
+        if( measurer->profile )
+        {
+            PaUtilCallbackProfile *profile = measurer->profile;
+
+            PA_PROFILE_INCREMENT_( profile->callbackCount );
+            RecordValue( profile->callbackTime, &profile->callbackTimeMax,
+                    ToNanoseconds( measurementEndTime - measurer->measurementStartTime ) );
+
+            if( measuredLoad > 1. )
+                PA_PROFILE_INCREMENT_( profile->overloadCount );
+        }
     }
+
+    measurer->previousPeriod = framesProcessed * measurer->samplingPeriod;
+
+    PaUtil_TraceEvent( paUtilTraceCallbackEnd, (PaInt32)framesProcessed, 0 );
 }
 
 
@@ -103,3 +254,115 @@ double PaUtil_GetCpuLoad( PaUtilCpuLoadMeasurer* measurer )
 {
     return measurer->averageLoad;
 }
+
+
+void PaUtil_InitializeCallbackProfile( PaUtilCallbackProfile* profile )
+{
+    memset( profile, 0, sizeof(PaUtilCallbackProfile) );
+}
+
+
+void PaUtil_SetCpuLoadProfile( PaUtilCpuLoadMeasurer* measurer, PaUtilCallbackProfile* profile )
+{
+    measurer->profile = profile;
+    measurer->previousStartTime = 0.;
+    measurer->previousStartCount = profile ? PA_PROFILE_LOAD_( profile->startCount ) : 0;
+}
+
+
+void PaUtil_StartCallbackProfile( PaUtilCallbackProfile* profile )
+{
+    PA_PROFILE_INCREMENT_( profile->startCount );
+}
+
+
+void PaUtil_CountCallbackFlags( PaUtilCallbackProfile* profile, PaStreamCallbackFlags callbackStatusFlags )
+{
+    if( callbackStatusFlags & paInputUnderflow )
+        PA_PROFILE_INCREMENT_( profile->inputUnderflowCount );
+    if( callbackStatusFlags & paInputOverflow )
+        PA_PROFILE_INCREMENT_( profile->inputOverflowCount );
+    if( callbackStatusFlags & paOutputUnderflow )
+        PA_PROFILE_INCREMENT_( profile->outputUnderflowCount );
+    if( callbackStatusFlags & paOutputOverflow )
+        PA_PROFILE_INCREMENT_( profile->outputOverflowCount );
+}
+
+
+void PaUtil_ResetCallbackProfile( PaUtilCallbackProfile* profile )
+{
+    PA_PROFILE_INCREMENT_( profile->resetRequest );
+}
+
+
+static PaTime Percentile( const PaUint32 *histogram, PaUint32 total,
+        double fraction, PaUint32 maximum )
+{
+    PaUint32 rank, count = 0;
+    double edge;
+    int i;
+
+    if( total == 0 )
+        return 0.;
+
+    rank = (PaUint32)ceil( fraction * total );
+    if( rank < 1 )
+        rank = 1;
+
+    for( i=0; i < PA_CALLBACK_PROFILE_BUCKETS; ++i )
+    {
+        count += histogram[i];
+        if( count >= rank )
+            break;
+    }
+
+    edge = (i < PA_CALLBACK_PROFILE_BUCKETS) ? BucketUpperEdge( i ) : (double)maximum;
+    if( edge > maximum )
+        edge = maximum;
+
+    return edge * 1e-9;
+}
+
+
+void PaUtil_GetCallbackProfile( PaUtilCallbackProfile* profile, PaStreamProfile* result )
+{
+    PaUint32 callbackTime[ PA_CALLBACK_PROFILE_BUCKETS ];
+    PaUint32 jitter[ PA_CALLBACK_PROFILE_BUCKETS ];
+    PaUint32 callbackTimeTotal = 0, jitterTotal = 0;
+    PaUint32 callbackTimeMax, jitterMax;
+    int i;
+
+    memset( result, 0, sizeof(PaStreamProfile) );
+
+    if( PA_PROFILE_LOAD_( profile->resetRequest ) != PA_PROFILE_LOAD_( profile->resetAcknowledge ) )
+        return; /* a reset is pending, report the statistics as already cleared */
+    PaUtil_ReadMemoryBarrier();
+
+    /* the histograms are copied first so that the totals used for the
+        percentiles are consistent with the counts being searched */
+    for( i=0; i < PA_CALLBACK_PROFILE_BUCKETS; ++i )
+    {
+        callbackTime[i] = PA_PROFILE_LOAD_( profile->callbackTime[i] );
+        callbackTimeTotal += callbackTime[i];
+        jitter[i] = PA_PROFILE_LOAD_( profile->jitter[i] );
+        jitterTotal += jitter[i];
+    }
+    callbackTimeMax = PA_PROFILE_LOAD_( profile->callbackTimeMax );
+    jitterMax = PA_PROFILE_LOAD_( profile->jitterMax );
+
+    result->callbackCount = PA_PROFILE_LOAD_( profile->callbackCount );
+    result->callbackTimeP50 = Percentile( callbackTime, callbackTimeTotal, .5, callbackTimeMax );
+    result->callbackTimeP99 = Percentile( callbackTime, callbackTimeTotal, .99, callbackTimeMax );
+    result->callbackTimeP999 = Percentile( callbackTime, callbackTimeTotal, .999, callbackTimeMax );
+    result->callbackTimeMax = callbackTimeMax * 1e-9;
+    result->jitterP50 = Percentile( jitter, jitterTotal, .5, jitterMax );
+    result->jitterP99 = Percentile( jitter, jitterTotal, .99, jitterMax );
+    result->jitterP999 = Percentile( jitter, jitterTotal, .999, jitterMax );
+    result->jitterMax = jitterMax * 1e-9;
+
+    result->overloadCount = PA_PROFILE_LOAD_( profile->overloadCount );
+    result->inputUnderflowCount = PA_PROFILE_LOAD_( profile->inputUnderflowCount );
+    result->inputOverflowCount = PA_PROFILE_LOAD_( profile->inputOverflowCount );
+    result->outputUnderflowCount = PA_PROFILE_LOAD_( profile->outputUnderflowCount );
+    result->outputOverflowCount = PA_PROFILE_LOAD_( profile->outputOverflowCount );
+}
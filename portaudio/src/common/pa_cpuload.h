@@ -43,20 +43,63 @@
  @ingroup common_src
 
  @brief Functions to assist in measuring the CPU utilization of a callback
- stream. Used to implement the Pa_GetStreamCpuLoad() function.
+ stream. Used to implement the Pa_GetStreamCpuLoad() and
+ Pa_GetStreamProfile() functions.
 */
 
 
+#include "portaudio.h"
+#include "pa_types.h"
+
 #ifdef __cplusplus
 extern "C"
 {
 #endif /* __cplusplus */
 
 
+/** The number of histogram buckets used by PaUtilCallbackProfile: eight
+ exact buckets below 8ns followed by eight buckets per octave up to 2^32ns.
+*/
+#define PA_CALLBACK_PROFILE_BUCKETS    (8 + 29 * 8)
+
+
+/** Callback timing statistics for one stream. Written only by the callback
+ thread and read without locking by Pa_GetStreamProfile(), so every field is
+ a single 32 bit word which is stored and loaded whole.
+
+ A reset is requested by the reader incrementing resetRequest; the writer
+ clears the statistics at the start of the next callback and then sets
+ resetAcknowledge to match. startCount is incremented each time the stream
+ is started so that the gap between a stop and the next start is not
+ recorded as jitter.
+
+ @see PaUtil_InitializeCallbackProfile, PaUtil_AttachCallbackProfile
+*/
+typedef struct PaUtilCallbackProfile {
+    PaUint32 callbackCount;
+    PaUint32 callbackTimeMax;       /**< nanoseconds */
+    PaUint32 jitterMax;             /**< nanoseconds */
+    PaUint32 overloadCount;
+    PaUint32 inputUnderflowCount;
+    PaUint32 inputOverflowCount;
+    PaUint32 outputUnderflowCount;
+    PaUint32 outputOverflowCount;
+    PaUint32 callbackTime[ PA_CALLBACK_PROFILE_BUCKETS ];
+    PaUint32 jitter[ PA_CALLBACK_PROFILE_BUCKETS ];
+    PaUint32 resetRequest;
+    PaUint32 resetAcknowledge;
+    PaUint32 startCount;
+} PaUtilCallbackProfile;
+
+
 typedef struct {
     double samplingPeriod;
     double measurementStartTime;
     double averageLoad;
+    PaUtilCallbackProfile *profile; /**< NULL unless attached */
+    double previousStartTime;
+    double previousPeriod;
+    PaUint32 previousStartCount;
 } PaUtilCpuLoadMeasurer; /**< @todo need better name than measurer */
 
 void PaUtil_InitializeCpuLoadMeasurer( PaUtilCpuLoadMeasurer* measurer, double sampleRate );
@@ -66,6 +109,35 @@ void PaUtil_ResetCpuLoadMeasurer( PaUtilCpuLoadMeasurer* measurer );
 double PaUtil_GetCpuLoad( PaUtilCpuLoadMeasurer* measurer );
 
 
+/** Clear all statistics in a callback profile. Only safe to call before the
+ profile is attached to a running stream.
+*/
+void PaUtil_InitializeCallbackProfile( PaUtilCallbackProfile* profile );
+
+/** Make measurer record the duration and start time jitter of each
+ measured callback into profile. Called by PaUtil_AttachCallbackProfile().
+*/
+void PaUtil_SetCpuLoadProfile( PaUtilCpuLoadMeasurer* measurer, PaUtilCallbackProfile* profile );
+
+/** Count the xrun causes in callbackStatusFlags. Called from the callback
+ thread by PaUtil_BeginBufferProcessing().
+*/
+void PaUtil_CountCallbackFlags( PaUtilCallbackProfile* profile, PaStreamCallbackFlags callbackStatusFlags );
+
+/** Note that the stream owning profile is about to be started. Called by
+ Pa_StartStream() while the stream is stopped.
+*/
+void PaUtil_StartCallbackProfile( PaUtilCallbackProfile* profile );
+
+/** Ask the callback thread to clear profile. Safe to call from any thread.
+*/
+void PaUtil_ResetCallbackProfile( PaUtilCallbackProfile* profile );
+
+/** Fill result with a snapshot of profile. Safe to call from any thread.
+*/
+void PaUtil_GetCallbackProfile( PaUtilCallbackProfile* profile, PaStreamProfile* result );
+
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */     
@@ -46,75 +46,169 @@
 #include "pa_dither.h"
 
 
-/* Note that the linear congruential algorithm requires 32 bit integers
- * because it uses arithmetic overflow. So use PaUint32 instead of
- * unsigned long so it will work on 64 bit systems.
+/* The generator hashes a Weyl sequence of the value index, keyed by the
+ * generator's key, through Chris Wellons' lowbias32 integer hash. The upper
+ * and lower halves of each hash supply the two rectangular distributions
+ * which add up to the triangular one. Nothing is carried from one value to the
+ * next except through the high pass filter, which is applied in a separate
+ * pass, so the loops below vectorize.
  */
 
 #define PA_DITHER_BITS_   (15)
 
+#define PA_DITHER_DEFAULT_KEY_  (0x2C1B3C6DU)
+
+#define PA_DITHER_LANES_  (8) /* divides PA_DITHER_BLOCK_SIZE */
+
+/* Generate triangular distribution about 0.
+ * Shift before adding to prevent overflow which would skew the distribution.
+ * Also shift an extra bit for the high pass filter.
+ */
+#define DITHER_SHIFT_  ((sizeof(PaInt32)*8 - PA_DITHER_BITS_) + 1)
+
+/* Multiply by PA_FLOAT_DITHER_SCALE_ to get a float between -2.0 and +1.99999 */
+#define PA_FLOAT_DITHER_SCALE_  (1.0f / ((1<<PA_DITHER_BITS_)-1))
+static const float const_float_dither_scale_ = PA_FLOAT_DITHER_SCALE_;
+
+
+static PaUint32 DitherHash( PaUint32 x )
+{
+    x ^= x >> 16;
+    x *= 0x7FEB352DU;
+    x ^= x >> 15;
+    x *= 0x846CA68BU;
+    x ^= x >> 16;
+    return x;
+}
+
 
 void PaUtil_InitializeTriangularDitherState( PaUtilTriangularDitherGenerator *state )
 {
     state->previous = 0;
-    state->randSeed1 = 22222;
-    state->randSeed2 = 5555555;
+    state->key = PA_DITHER_DEFAULT_KEY_;
+    state->counter = 0;
+    PaUtil_SetDitherNoiseShaping( state, paUtilDitherTriangular );
 }
 
 
-PaInt32 PaUtil_Generate16BitTriangularDither( PaUtilTriangularDitherGenerator *state )
+void PaUtil_SeedTriangularDitherState( PaUtilTriangularDitherGenerator *state, PaUint32 seed )
 {
-    PaInt32 current, highPass;
+    state->previous = 0;
+    state->key = DitherHash( seed + PA_DITHER_DEFAULT_KEY_ );
+    state->counter = 0;
+    PaUtil_SetDitherNoiseShaping( state, paUtilDitherTriangular );
+}
 
-    /* Generate two random numbers. */
-    state->randSeed1 = (state->randSeed1 * 196314165) + 907633515;
-    state->randSeed2 = (state->randSeed2 * 196314165) + 907633515;
 
-    /* Generate triangular distribution about 0.
-     * Shift before adding to prevent overflow which would skew the distribution.
-     * Also shift an extra bit for the high pass filter. 
-     */
-#define DITHER_SHIFT_  ((sizeof(PaInt32)*8 - PA_DITHER_BITS_) + 1)
-	
-    current = (((PaInt32)state->randSeed1)>>DITHER_SHIFT_) +
-              (((PaInt32)state->randSeed2)>>DITHER_SHIFT_);
+void PaUtil_SetDitherNoiseShaping( PaUtilTriangularDitherGenerator *state, PaUtilDitherMode mode )
+{
+    switch( mode )
+    {
+    case paUtilDitherNoiseShapedFirstOrder:
+        state->shapingCoefficients[0] = 1.0f;
+        state->shapingCoefficients[1] = 0.0f;
+        break;
+    case paUtilDitherNoiseShapedSecondOrder:
+        /* the filter from Paul Kellett's noise shaped dither, quoted below */
+        state->shapingCoefficients[0] = 1.0f;
+        state->shapingCoefficients[1] = -0.5f;
+        break;
+    default:
+        state->shapingCoefficients[0] = 0.0f;
+        state->shapingCoefficients[1] = 0.0f;
+        break;
+    }
+
+    state->shapingError[0] = 0.0f;
+    state->shapingError[1] = 0.0f;
+}
 
-    /* High pass filter to reduce audibility. */
-    highPass = current - state->previous;
-    state->previous = current;
-    return highPass;
+
+void PaUtil_Generate16BitTriangularDitherBlock( PaUtilTriangularDitherGenerator *state,
+        PaInt32 *dither, unsigned int count )
+{
+    PaInt32 current[PA_DITHER_BLOCK_SIZE + 1];
+    PaUint32 key = state->key;
+
+    while( count > 0 )
+    {
+        unsigned int blockCount = (count < PA_DITHER_BLOCK_SIZE) ? count : PA_DITHER_BLOCK_SIZE;
+        PaUint32 counter = state->counter;
+        unsigned int i;
+
+        /* values are computed in groups of PA_DITHER_LANES_ so that the inner
+            loop has a fixed trip count, surplus values are recomputed by the
+            next call. */
+        current[0] = state->previous;
+        for( i=0; i<blockCount; i+=PA_DITHER_LANES_ )
+        {
+            unsigned int j;
+
+            for( j=0; j<PA_DITHER_LANES_; ++j )
+            {
+                PaUint32 r = DitherHash( ((counter + i + j) * 0x9E3779B9U) ^ key );
+
+                current[i + j + 1] = (((PaInt32)r)>>DITHER_SHIFT_) +
+                        (((PaInt32)(r << 16))>>DITHER_SHIFT_);
+            }
+        }
+
+        /* High pass filter to reduce audibility. */
+        for( i=0; i<blockCount; ++i )
+            dither[i] = current[i + 1] - current[i];
+
+        state->previous = current[blockCount];
+        state->counter = counter + blockCount;
+
+        dither += blockCount;
+        count -= blockCount;
+    }
 }
 
 
-/* Multiply by PA_FLOAT_DITHER_SCALE_ to get a float between -2.0 and +1.99999 */
-#define PA_FLOAT_DITHER_SCALE_  (1.0f / ((1<<PA_DITHER_BITS_)-1))
-static const float const_float_dither_scale_ = PA_FLOAT_DITHER_SCALE_;
+void PaUtil_GenerateFloatTriangularDitherBlock( PaUtilTriangularDitherGenerator *state,
+        float *dither, unsigned int count )
+{
+    PaInt32 highPass[PA_DITHER_BLOCK_SIZE];
+
+    while( count > 0 )
+    {
+        unsigned int blockCount = (count < PA_DITHER_BLOCK_SIZE) ? count : PA_DITHER_BLOCK_SIZE;
+        unsigned int i;
+
+        PaUtil_Generate16BitTriangularDitherBlock( state, highPass, blockCount );
+
+        for( i=0; i<blockCount; ++i )
+            dither[i] = ((float)highPass[i]) * const_float_dither_scale_;
+
+        dither += blockCount;
+        count -= blockCount;
+    }
+}
+
+
+PaInt32 PaUtil_Generate16BitTriangularDither( PaUtilTriangularDitherGenerator *state )
+{
+    PaInt32 highPass;
+
+    PaUtil_Generate16BitTriangularDitherBlock( state, &highPass, 1 );
+    return highPass;
+}
+
 
 float PaUtil_GenerateFloatTriangularDither( PaUtilTriangularDitherGenerator *state )
 {
-    PaInt32 current, highPass;
-
-    /* Generate two random numbers. */
-    state->randSeed1 = (state->randSeed1 * 196314165) + 907633515;
-    state->randSeed2 = (state->randSeed2 * 196314165) + 907633515;
-
-    /* Generate triangular distribution about 0.
-     * Shift before adding to prevent overflow which would skew the distribution.
-     * Also shift an extra bit for the high pass filter. 
-     */
-    current = (((PaInt32)state->randSeed1)>>DITHER_SHIFT_) +
-              (((PaInt32)state->randSeed2)>>DITHER_SHIFT_);
-
-    /* High pass filter to reduce audibility. */
-    highPass = current - state->previous;
-    state->previous = current;
+    PaInt32 highPass;
+
+    PaUtil_Generate16BitTriangularDitherBlock( state, &highPass, 1 );
     return ((float)highPass) * const_float_dither_scale_;
 }
 
 
 /*
 The following alternate dither algorithms (from musicdsp.org) could be
-considered
+considered. The second order noise shaping filter of the first one is
+available through PaUtil_SetDitherNoiseShaping().
 */
 
 /*Noise shaped dither  (March 2000)
@@ -52,16 +52,40 @@ extern "C"
 {
 #endif /* __cplusplus */
 
-/* Note that the linear congruential algorithm requires 32 bit integers
- * because it uses arithmetic overflow. So use PaUint32 instead of
- * unsigned long so it will work on 64 bit systems.
- */
+/** The number of dither values generated per block by the converters. Callers
+ of the block functions may pass any count; this is merely a convenient size
+ for stack buffers.
+*/
+#define PA_DITHER_BLOCK_SIZE (64)
+
+
+/** The dither applied when converting to a narrower sample format. The buffer
+ processor derives it from the paDitherOff and paDitherNoiseShaped* stream
+ flags.
+*/
+typedef enum PaUtilDitherMode
+{
+    paUtilDitherOff,
+    paUtilDitherTriangular,
+    paUtilDitherNoiseShapedFirstOrder,  /* noise transfer function 1 - z^-1 */
+    paUtilDitherNoiseShapedSecondOrder  /* noise transfer function 1 - z^-1 + 0.5z^-2 */
+} PaUtilDitherMode;
 
-/** @brief State needed to generate a dither signal */
+
+/** @brief State needed to generate a dither signal
+
+ The noise is produced by a counter based generator: each value is a hash of
+ the generator's key and the value's index in the sequence, so blocks of
+ values can be computed independently of each other (and vectorized).
+ Generators with different keys produce independent sequences; use one per
+ channel.
+*/
 typedef struct PaUtilTriangularDitherGenerator{
-    PaUint32 previous;
-    PaUint32 randSeed1;
-    PaUint32 randSeed2;
+    PaInt32 previous;   /* last unfiltered value, for the high pass filter */
+    PaUint32 key;
+    PaUint32 counter;   /* index of the next value */
+    float shapingCoefficients[2];   /* error feedback filter, zero unless noise shaped */
+    float shapingError[2];          /* the last two quantization errors, newest first */
 } PaUtilTriangularDitherGenerator;
 
 
@@ -69,6 +93,25 @@ typedef struct PaUtilTriangularDitherGenerator{
 void PaUtil_InitializeTriangularDitherState( PaUtilTriangularDitherGenerator *ditherState );
 
 
+/** @brief Initialize dither state with a sequence selected by seed.
+ Generators initialized with different seeds produce independent sequences,
+ eg. seed with the channel index to give each channel its own dither.
+*/
+void PaUtil_SeedTriangularDitherState( PaUtilTriangularDitherGenerator *ditherState, PaUint32 seed );
+
+
+/** @brief Configure the error feedback filter used by the noise shaped
+ converters, and clear its history. paUtilDitherOff and
+ paUtilDitherTriangular disable noise shaping.
+
+ The noise shaped converters quantize v = x - c0*e[n-1] - c1*e[n-2], where
+ e[n] = y[n] - v[n] is the total error of output sample y[n] (dither
+ included), so the error reaching the output is filtered by
+ 1 - c0*z^-1 - c1*z^-2.
+*/
+void PaUtil_SetDitherNoiseShaping( PaUtilTriangularDitherGenerator *ditherState, PaUtilDitherMode mode );
+
+
 /**
  @brief Calculate 2 LSB dither signal with a triangular distribution.
  Ranged for adding to a 1 bit right-shifted 32 bit integer
@@ -99,6 +142,22 @@ PaInt32 PaUtil_Generate16BitTriangularDither( PaUtilTriangularDitherGenerator *d
 float PaUtil_GenerateFloatTriangularDither( PaUtilTriangularDitherGenerator *ditherState );
 
 
+/** @brief Fill dither with the next count values of
+ PaUtil_Generate16BitTriangularDither(). Calling this is equivalent to, but
+ much faster than, calling PaUtil_Generate16BitTriangularDither() count times.
+*/
+void PaUtil_Generate16BitTriangularDitherBlock( PaUtilTriangularDitherGenerator *ditherState,
+        PaInt32 *dither, unsigned int count );
+
+
+/** @brief Fill dither with the next count values of
+ PaUtil_GenerateFloatTriangularDither(). Calling this is equivalent to, but
+ much faster than, calling PaUtil_GenerateFloatTriangularDither() count times.
+*/
+void PaUtil_GenerateFloatTriangularDitherBlock( PaUtilTriangularDitherGenerator *ditherState,
+        float *dither, unsigned int count );
+
+
 
 #ifdef __cplusplus
 }
@@ -68,6 +68,11 @@
 #include <stdlib.h> /* needed for strtol() */
 #include <assert.h> /* needed by PA_VALIDATE_ENDIANNESS */
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <pthread.h>
+#define PA_FRONT_HAS_THREADS_
+#endif
+
 #include "portaudio.h"
 #include "pa_util.h"
 #include "pa_endianness.h"
@@ -76,6 +81,8 @@
 #include "pa_stream.h"
 #include "pa_trace.h" /* still useful?*/
 #include "pa_debugprint.h"
+#include "pa_simd_converters.h"
+#include "pa_tracering.h"
 
 #ifndef PA_GIT_REVISION
 #include "pa_gitrevision.h"
@@ -158,6 +165,21 @@ static int hostApisCount_ = 0;
 static int defaultHostApiIndex_ = 0;
 static int initializationCount_ = 0;
 static int deviceCount_ = 0;
+static PaInitializeFlags initializeFlags_ = paInitializeDefault;
+
+/* deferred device probes registered by host APIs, at most one per initializer */
+typedef struct
+{
+    PaUtilHostApiRepresentation *hostApi;
+    PaUtilDeviceProbeFunction *probe;
+} PaFrontDeviceProbe;
+
+static PaFrontDeviceProbe *deviceProbes_ = 0;
+static int deviceProbesCount_ = 0;
+static int deviceProbesCapacity_ = 0;
+#ifdef PA_FRONT_HAS_THREADS_
+static pthread_mutex_t deviceProbesMutex_ = PTHREAD_MUTEX_INITIALIZER;
+#endif
 
 PaUtilStreamRepresentation *firstOpenStream_ = NULL;
 
@@ -193,24 +215,187 @@ static void TerminateHostApis( void )
         PaUtil_FreeMemory( hostApis_ );
     hostApis_ = 0;
 
+    if( deviceProbes_ != 0 )
+        PaUtil_FreeMemory( deviceProbes_ );
+    deviceProbes_ = 0;
+    deviceProbesCount_ = 0;
+    deviceProbesCapacity_ = 0;
+
     PA_DEBUG(("TerminateHostApis out\n"));
 }
 
 
+PaInitializeFlags PaUtil_GetInitializeFlags( void )
+{
+    return initializeFlags_;
+}
+
+
+PaError PaUtil_SetDeviceProbeFunction( PaUtilHostApiRepresentation *hostApi,
+        PaUtilDeviceProbeFunction *probe )
+{
+    PaError result = paNoError;
+
+#ifdef PA_FRONT_HAS_THREADS_
+    pthread_mutex_lock( &deviceProbesMutex_ );
+#endif
+    if( deviceProbesCount_ < deviceProbesCapacity_ )
+    {
+        deviceProbes_[deviceProbesCount_].hostApi = hostApi;
+        deviceProbes_[deviceProbesCount_].probe = probe;
+        ++deviceProbesCount_;
+    }
+    else
+    {
+        result = paInsufficientMemory;
+    }
+#ifdef PA_FRONT_HAS_THREADS_
+    pthread_mutex_unlock( &deviceProbesMutex_ );
+#endif
+
+    return result;
+}
+
+
+static void ProbeDevice( PaUtilHostApiRepresentation *hostApi, int hostApiDevice )
+{
+    int i;
+
+    for( i=0; i < deviceProbesCount_; ++i )
+    {
+        if( deviceProbes_[i].hostApi == hostApi )
+        {
+            deviceProbes_[i].probe( hostApi, hostApiDevice );
+            return;
+        }
+    }
+}
+
+
+/* one host API initializer, possibly run on its own thread */
+typedef struct
+{
+    PaUtilHostApiInitializer *initializer;
+    PaUtilHostApiRepresentation *hostApi;
+    PaHostApiIndex hostApiIndex; /* the index it was initialized with */
+    PaError result;
+#ifdef PA_FRONT_HAS_THREADS_
+    pthread_t thread;
+    int threadStarted;
+#endif
+} PaFrontInitJob;
+
+
+static void RunInitJob( PaFrontInitJob *job )
+{
+    PA_DEBUG(( "before paHostApiInitializers[%d].\n", job->hostApiIndex ));
+    job->hostApi = NULL;
+    job->result = job->initializer( &job->hostApi, job->hostApiIndex );
+    PA_DEBUG(( "after paHostApiInitializers[%d].\n", job->hostApiIndex ));
+}
+
+
+#ifdef PA_FRONT_HAS_THREADS_
+static void *InitJobThreadFunc( void *userData )
+{
+    RunInitJob( (PaFrontInitJob*)userData );
+    return NULL;
+}
+#endif
+
+
+/* Starts every initializer on its own thread and waits for all of them.
+   Each is given the index it would get if all earlier ones produce a host
+   API; AddHostApi() corrects that afterwards if one of them did not. */
+static void RunInitJobsInParallel( PaFrontInitJob *jobs, int count )
+{
+    int i;
+
+    for( i=0; i < count; ++i )
+    {
+        jobs[i].hostApiIndex = i;
+#ifdef PA_FRONT_HAS_THREADS_
+        jobs[i].threadStarted =
+                pthread_create( &jobs[i].thread, NULL, InitJobThreadFunc, &jobs[i] ) == 0;
+        if( !jobs[i].threadStarted )
+#endif
+            RunInitJob( &jobs[i] );
+    }
+
+#ifdef PA_FRONT_HAS_THREADS_
+    for( i=0; i < count; ++i )
+    {
+        if( jobs[i].threadStarted )
+            pthread_join( jobs[i].thread, NULL );
+    }
+#endif
+}
+
+
+/* appends an initialized host API to hostApis_, assigning its device range */
+static void AddHostApi( PaUtilHostApiRepresentation *hostApi, PaHostApiIndex initializedIndex,
+        int *baseDeviceIndex )
+{
+    int i;
+
+    assert( hostApi->info.defaultInputDevice < hostApi->info.deviceCount );
+    assert( hostApi->info.defaultOutputDevice < hostApi->info.deviceCount );
+
+    /* a host API initialized in parallel guessed its index; fix it up if an
+       earlier initializer turned out not to produce a host API */
+    if( initializedIndex != hostApisCount_ )
+    {
+        for( i=0; i < hostApi->info.deviceCount; ++i )
+            hostApi->deviceInfos[i]->hostApi = hostApisCount_;
+    }
+
+    /* the first successfully initialized host API with a default input *or*
+       output device is used as the default host API.
+    */
+    if( (defaultHostApiIndex_ == -1) &&
+            ( hostApi->info.defaultInputDevice != paNoDevice
+                || hostApi->info.defaultOutputDevice != paNoDevice ) )
+    {
+        defaultHostApiIndex_ = hostApisCount_;
+    }
+
+    hostApi->privatePaFrontInfo.baseDeviceIndex = *baseDeviceIndex;
+
+    if( hostApi->info.defaultInputDevice != paNoDevice )
+        hostApi->info.defaultInputDevice += *baseDeviceIndex;
+
+    if( hostApi->info.defaultOutputDevice != paNoDevice )
+        hostApi->info.defaultOutputDevice += *baseDeviceIndex;
+
+    *baseDeviceIndex += hostApi->info.deviceCount;
+    deviceCount_ += hostApi->info.deviceCount;
+
+    hostApis_[hostApisCount_] = hostApi;
+    ++hostApisCount_;
+}
+
+
 static PaError InitializeHostApis( void )
 {
     PaError result = paNoError;
     int i, initializerCount, baseDeviceIndex;
+    PaFrontInitJob *jobs = NULL;
 
     initializerCount = CountHostApiInitializers();
 
     hostApis_ = (PaUtilHostApiRepresentation**)PaUtil_AllocateMemory(
             sizeof(PaUtilHostApiRepresentation*) * initializerCount );
-    if( !hostApis_ )
+    deviceProbes_ = (PaFrontDeviceProbe*)PaUtil_AllocateMemory(
+            sizeof(PaFrontDeviceProbe) * initializerCount );
+    jobs = (PaFrontInitJob*)PaUtil_AllocateMemory(
+            sizeof(PaFrontInitJob) * initializerCount );
+    if( !hostApis_ || !deviceProbes_ || !jobs )
     {
         result = paInsufficientMemory;
         goto error;
     }
+    deviceProbesCount_ = 0;
+    deviceProbesCapacity_ = initializerCount;
 
     hostApisCount_ = 0;
     defaultHostApiIndex_ = -1; /* indicates that we haven't determined the default host API yet */
@@ -219,44 +404,45 @@ static PaError InitializeHostApis( void )
 
     for( i=0; i< initializerCount; ++i )
     {
-        hostApis_[hostApisCount_] = NULL;
+        jobs[i].initializer = paHostApiInitializers[i];
+        jobs[i].hostApi = NULL;
+        jobs[i].result = paNoError;
+    }
 
-        PA_DEBUG(( "before paHostApiInitializers[%d].\n",i));
+    if( (initializeFlags_ & paInitializeParallel) && initializerCount > 1 )
+    {
+        RunInitJobsInParallel( jobs, initializerCount );
 
-        result = paHostApiInitializers[i]( &hostApis_[hostApisCount_], hostApisCount_ );
+        for( i=0; i< initializerCount; ++i )
+        {
+            if( jobs[i].result != paNoError )
+            {
+                result = jobs[i].result;
+                break;
+            }
+        }
+        for( i=0; i< initializerCount; ++i )
+        {
+            if( jobs[i].hostApi )
+                AddHostApi( jobs[i].hostApi, jobs[i].hostApiIndex, &baseDeviceIndex );
+        }
         if( result != paNoError )
             goto error;
-
-        PA_DEBUG(( "after paHostApiInitializers[%d].\n",i));
-
-        if( hostApis_[hostApisCount_] )
+    }
+    else
+    {
+        for( i=0; i< initializerCount; ++i )
         {
-            PaUtilHostApiRepresentation* hostApi = hostApis_[hostApisCount_];
-            assert( hostApi->info.defaultInputDevice < hostApi->info.deviceCount );
-            assert( hostApi->info.defaultOutputDevice < hostApi->info.deviceCount );
-
-            /* the first successfully initialized host API with a default input *or*
-               output device is used as the default host API.
-            */
-            if( (defaultHostApiIndex_ == -1) &&
-                    ( hostApi->info.defaultInputDevice != paNoDevice
-                        || hostApi->info.defaultOutputDevice != paNoDevice ) )
+            jobs[i].hostApiIndex = hostApisCount_;
+            RunInitJob( &jobs[i] );
+            if( jobs[i].result != paNoError )
             {
-                defaultHostApiIndex_ = hostApisCount_;
+                result = jobs[i].result;
+                goto error;
             }
 
-            hostApi->privatePaFrontInfo.baseDeviceIndex = baseDeviceIndex;
-
-            if( hostApi->info.defaultInputDevice != paNoDevice )
-                hostApi->info.defaultInputDevice += baseDeviceIndex;
-
-            if( hostApi->info.defaultOutputDevice != paNoDevice )
-                hostApi->info.defaultOutputDevice += baseDeviceIndex;
-
-            baseDeviceIndex += hostApi->info.deviceCount;
-            deviceCount_ += hostApi->info.deviceCount;
-
-            ++hostApisCount_;
+            if( jobs[i].hostApi )
+                AddHostApi( jobs[i].hostApi, jobs[i].hostApiIndex, &baseDeviceIndex );
         }
     }
 
@@ -264,9 +450,12 @@ static PaError InitializeHostApis( void )
     if( defaultHostApiIndex_ == -1 )
         defaultHostApiIndex_ = 0;
 
+    PaUtil_FreeMemory( jobs );
     return result;
 
 error:
+    if( jobs )
+        PaUtil_FreeMemory( jobs );
     TerminateHostApis();
     return result;
 }
@@ -353,10 +542,17 @@ static void CloseOpenStreams( void )
 
 
 PaError Pa_Initialize( void )
+{
+    return Pa_InitializeWithFlags( paInitializeDefault );
+}
+
+
+PaError Pa_InitializeWithFlags( PaInitializeFlags flags )
 {
     PaError result;
 
-    PA_LOGAPI_ENTER( "Pa_Initialize" );
+    PA_LOGAPI_ENTER_PARAMS( "Pa_InitializeWithFlags" );
+    PA_LOGAPI(("\tPaInitializeFlags flags: 0x%lx\n", flags ));
 
     if( PA_IS_INITIALISED_ )
     {
@@ -369,14 +565,19 @@ PaError Pa_Initialize( void )
         PA_VALIDATE_ENDIANNESS;
 
         PaUtil_InitializeClock();
+        PaUtil_InitializeSimdConverters();
         PaUtil_ResetTraceMessages();
+        PaUtil_InitializeTrace();
 
+        initializeFlags_ = flags;
         result = InitializeHostApis();
         if( result == paNoError )
             ++initializationCount_;
+        else
+            PaUtil_StopTrace();
     }
 
-    PA_LOGAPI_EXIT_PAERROR( "Pa_Initialize", result );
+    PA_LOGAPI_EXIT_PAERROR( "Pa_InitializeWithFlags", result );
 
     return result;
 }
@@ -398,6 +599,7 @@ PaError Pa_Terminate( void )
             TerminateHostApis();
 
             PaUtil_DumpTraceMessages();
+            PaUtil_StopTrace();
         }
         --initializationCount_;
         result = paNoError;
@@ -766,6 +968,7 @@ const PaDeviceInfo* Pa_GetDeviceInfo( PaDeviceIndex device )
     }
     else
     {
+        ProbeDevice( hostApis_[hostApiIndex], hostSpecificDeviceIndex );
         result = hostApis_[hostApiIndex]->deviceInfos[ hostSpecificDeviceIndex ];
 
         PA_LOGAPI(("Pa_GetDeviceInfo returned:\n" ));
@@ -1009,7 +1212,12 @@ static PaError ValidateOpenStreamParameters(
     if( (sampleRate < 1000.0) || (sampleRate > 384000.0) )
         return paInvalidSampleRate;
 
-    if( ((streamFlags & ~paPlatformSpecificFlags) & ~(paClipOff | paDitherOff | paNeverDropInput | paPrimeOutputBuffersUsingStreamCallback ) ) != 0 )
+    if( ((streamFlags & ~paPlatformSpecificFlags) & ~(paClipOff | paDitherOff | paNeverDropInput | paPrimeOutputBuffersUsingStreamCallback
+            | paDitherNoiseShapedFirstOrder | paDitherNoiseShapedSecondOrder ) ) != 0 )
+        return paInvalidFlag;
+
+    /* only one noise shaping order may be selected */
+    if( (streamFlags & paDitherNoiseShapedFirstOrder) && (streamFlags & paDitherNoiseShapedSecondOrder) )
         return paInvalidFlag;
 
     if( streamFlags & paNeverDropInput )
@@ -1444,6 +1652,7 @@ PaError Pa_StartStream( PaStream *stream )
         }
         else if( result == 1 )
         {
+            PaUtil_StartCallbackProfile( &PA_STREAM_REP(stream)->profile );
             result = PA_STREAM_INTERFACE(stream)->Start( stream );
         }
     }
@@ -1634,6 +1843,49 @@ double Pa_GetStreamCpuLoad( PaStream* stream )
 }
 
 
+PaError Pa_GetStreamProfile( PaStream* stream, PaStreamProfile *profile )
+{
+    PaError result = PaUtil_ValidateStreamPointer( stream );
+
+    PA_LOGAPI_ENTER_PARAMS( "Pa_GetStreamProfile" );
+    PA_LOGAPI(("\tPaStream* stream: 0x%p\n", stream ));
+    PA_LOGAPI(("\tPaStreamProfile* profile: 0x%p\n", profile ));
+
+    if( result == paNoError && profile == NULL )
+        result = paBadBufferPtr;
+
+    if( result == paNoError )
+    {
+        PaUtil_GetCallbackProfile( &PA_STREAM_REP(stream)->profile, profile );
+
+        PA_LOGAPI(("Pa_GetStreamProfile returned:\n" ));
+        PA_LOGAPI(("\tPaStreamProfile.callbackCount: %lu\n", profile->callbackCount ));
+        PA_LOGAPI(("\tPaStreamProfile.callbackTimeMax: %g\n", profile->callbackTimeMax ));
+        PA_LOGAPI(("\tPaStreamProfile.jitterMax: %g\n", profile->jitterMax ));
+    }
+
+    PA_LOGAPI_EXIT_PAERROR( "Pa_GetStreamProfile", result );
+
+    return result;
+}
+
+
+PaError Pa_ResetStreamProfile( PaStream* stream )
+{
+    PaError result = PaUtil_ValidateStreamPointer( stream );
+
+    PA_LOGAPI_ENTER_PARAMS( "Pa_ResetStreamProfile" );
+    PA_LOGAPI(("\tPaStream* stream: 0x%p\n", stream ));
+
+    if( result == paNoError )
+        PaUtil_ResetCallbackProfile( &PA_STREAM_REP(stream)->profile );
+
+    PA_LOGAPI_EXIT_PAERROR( "Pa_ResetStreamProfile", result );
+
+    return result;
+}
+
+
 PaError Pa_ReadStream( PaStream* stream,
                        void *buffer,
                        unsigned long frames )
@@ -67,6 +67,13 @@ are defaulted to 1.
 #define PA_USE_SKELETON 1
 #endif 
 
+#ifndef PA_USE_VIRTUAL
+#define PA_USE_VIRTUAL 0
+#elif (PA_USE_VIRTUAL != 0) && (PA_USE_VIRTUAL != 1)
+#undef PA_USE_VIRTUAL
+#define PA_USE_VIRTUAL 1
+#endif
+
 #if defined(PA_NO_ASIO) || defined(PA_NO_DS) || defined(PA_NO_WMME) || defined(PA_NO_WASAPI) || defined(PA_NO_WDMKS)
 #error "Portaudio: PA_NO_<APINAME> is no longer supported, please remove definition and use PA_USE_<APINAME> instead"
 #endif
@@ -356,6 +363,31 @@ typedef PaError PaUtilHostApiInitializer( PaUtilHostApiRepresentation**, PaHostA
 extern PaUtilHostApiInitializer *paHostApiInitializers[];
 
 
+/** Returns the flags passed to Pa_InitializeWithFlags() (paInitializeDefault
+ for Pa_Initialize()). Host API initializers may use this to decide whether
+ to defer device probing.
+*/
+PaInitializeFlags PaUtil_GetInitializeFlags( void );
+
+
+/** Prototype for a function that finishes probing a device whose probe was
+ deferred. hostApiDevice is the host API's own 0 based device index. It is
+ called every time the device's PaDeviceInfo is requested, so it must return
+ immediately once the device has been probed.
+*/
+typedef void PaUtilDeviceProbeFunction( struct PaUtilHostApiRepresentation *hostApi,
+        int hostApiDevice );
+
+
+/** Register a deferred probe function for a host API. Call this from the host
+ API initializer, which may be running on a worker thread when
+ paInitializeParallel is in effect. Returns paInsufficientMemory if it could
+ not be registered, in which case the host API must probe eagerly.
+*/
+PaError PaUtil_SetDeviceProbeFunction( struct PaUtilHostApiRepresentation *hostApi,
+        PaUtilDeviceProbeFunction *probe );
+
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
@@ -49,6 +49,7 @@
 
 #include "pa_process.h"
 #include "pa_util.h"
+#include "pa_tracering.h"
 
 
 #define PA_FRAMES_PER_TEMP_BUFFER_WHEN_HOST_BUFFER_SIZE_IS_UNKNOWN_    1024
@@ -103,6 +104,7 @@ PaError PaUtil_InitializeBufferProcessor( PaUtilBufferProcessor* bp,
     PaError bytesPerSample;
     unsigned long tempInputBufferSize, tempOutputBufferSize;
     PaStreamFlags tempInputStreamFlags;
+    int i, ditherGeneratorCount;
 
     if( streamFlags & paNeverDropInput )
     {
@@ -117,6 +119,8 @@ PaError PaUtil_InitializeBufferProcessor( PaUtilBufferProcessor* bp,
     bp->tempInputBufferPtrs = 0;
     bp->tempOutputBuffer = 0;
     bp->tempOutputBufferPtrs = 0;
+    bp->ditherGenerators = 0;
+    bp->profile = 0;
 
     bp->framesPerUserBuffer = framesPerUserBuffer;
     bp->framesPerHostBuffer = framesPerHostBuffer;
@@ -227,7 +231,8 @@ PaError PaUtil_InitializeBufferProcessor( PaUtilBufferProcessor* bp,
             we disable dithering when host input format is paInt32 and user format is paInt24, 
             since the host samples will just be padded with zeros anyway. */
 
-        tempInputStreamFlags = streamFlags;
+        /* noise shaping applies to output conversion only */
+        tempInputStreamFlags = streamFlags & ~(paDitherNoiseShapedFirstOrder | paDitherNoiseShapedSecondOrder);
         if( !(tempInputStreamFlags & paDitherOff) /* dither is on */
                 && (hostInputSampleFormat & paInt32) /* host input format is int32 */
                 && (userInputSampleFormat & paInt24) /* user requested format is int24 */ ){
@@ -351,7 +356,30 @@ PaError PaUtil_InitializeBufferProcessor( PaUtilBufferProcessor* bp,
         bp->hostOutputChannels[1] = &bp->hostOutputChannels[0][outputChannelCount];
     }
 
-    PaUtil_InitializeTriangularDitherState( &bp->ditherGenerator );
+    /* each channel gets its own dither sequence */
+    ditherGeneratorCount = PA_MAX_( inputChannelCount, outputChannelCount );
+    bp->ditherGenerators = (PaUtilTriangularDitherGenerator*)
+            PaUtil_AllocateMemory( sizeof(PaUtilTriangularDitherGenerator) * ditherGeneratorCount );
+    if( bp->ditherGenerators == 0 )
+    {
+        result = paInsufficientMemory;
+        goto error;
+    }
+
+    if( streamFlags & paDitherOff )
+        bp->ditherMode = paUtilDitherOff;
+    else if( streamFlags & paDitherNoiseShapedFirstOrder )
+        bp->ditherMode = paUtilDitherNoiseShapedFirstOrder;
+    else if( streamFlags & paDitherNoiseShapedSecondOrder )
+        bp->ditherMode = paUtilDitherNoiseShapedSecondOrder;
+    else
+        bp->ditherMode = paUtilDitherTriangular;
+
+    for( i=0; i<ditherGeneratorCount; ++i )
+    {
+        PaUtil_SeedTriangularDitherState( &bp->ditherGenerators[i], i );
+        PaUtil_SetDitherNoiseShaping( &bp->ditherGenerators[i], bp->ditherMode );
+    }
 
     bp->samplePeriod = 1. / sampleRate;
 
@@ -379,6 +407,9 @@ error:
     if( bp->hostOutputChannels[0] )
         PaUtil_FreeMemory( bp->hostOutputChannels[0] );
 
+    if( bp->ditherGenerators )
+        PaUtil_FreeMemory( bp->ditherGenerators );
+
     return result;
 }
 
@@ -402,6 +433,17 @@ void PaUtil_TerminateBufferProcessor( PaUtilBufferProcessor* bp )
 
     if( bp->hostOutputChannels[0] )
         PaUtil_FreeMemory( bp->hostOutputChannels[0] );
+
+    if( bp->ditherGenerators )
+        PaUtil_FreeMemory( bp->ditherGenerators );
+}
+
+
+void PaUtil_AttachCallbackProfile( PaUtilBufferProcessor* bp,
+        PaUtilCpuLoadMeasurer* cpuLoadMeasurer, PaUtilCallbackProfile* profile )
+{
+    bp->profile = profile;
+    PaUtil_SetCpuLoadProfile( cpuLoadMeasurer, profile );
 }
 
 
@@ -687,11 +729,84 @@ void PaUtil_BeginBufferProcessing( PaUtilBufferProcessor* bp,
 
     bp->callbackStatusFlags = callbackStatusFlags;
 
+    if( bp->profile && callbackStatusFlags )
+        PaUtil_CountCallbackFlags( bp->profile, callbackStatusFlags );
+
+    if( callbackStatusFlags & (paInputUnderflow | paInputOverflow | paOutputUnderflow | paOutputOverflow) )
+        PaUtil_TraceEvent( paUtilTraceXrun, (PaInt32)callbackStatusFlags, 0 );
+
     bp->hostInputFrameCount[1] = 0;
     bp->hostOutputFrameCount[1] = 0;
 }
 
 
+/*
+    IsInterleavedRun() returns non-zero if the channel descriptors describe a
+    single interleaved buffer holding exactly channelCount channels, in which
+    case all channels can be converted as one unit-stride run of
+    frameCount * channelCount samples, allowing the vectorized converters to
+    be used.
+*/
+static int IsInterleavedRun( PaUtilChannelDescriptor *channels,
+        unsigned int channelCount, unsigned int bytesPerSample )
+{
+    unsigned int i;
+
+    for( i=0; i<channelCount; ++i )
+    {
+        if( channels[i].stride != channelCount
+                || channels[i].data != ((unsigned char*)channels[0].data) + i * bytesPerSample )
+            return 0;
+    }
+
+    return 1;
+}
+
+
+/*
+    DitherIsNoiseShaped() returns non-zero if the output converter keeps per
+    channel error feedback state, in which case each channel must be converted
+    separately with its own dither generator.
+*/
+static int DitherIsNoiseShaped( PaUtilBufferProcessor *bp )
+{
+    return bp->ditherMode == paUtilDitherNoiseShapedFirstOrder
+            || bp->ditherMode == paUtilDitherNoiseShapedSecondOrder;
+}
+
+
+/*
+    IsZeroCopyBuffer() returns non-zero if the user buffer can point straight
+    into the host buffer described by channels, skipping the temp buffer and
+    the converter. This requires the user and host sample formats to be equal
+    (so no conversion, clipping or dither applies) and the host channels to be
+    laid out exactly as the user expects: a single interleaved buffer holding
+    exactly channelCount channels, or unit stride non-interleaved channels.
+    Host buffers carrying extra channels (eg with some Alsa hw: devices) still
+    go through the temp buffer.
+*/
+static int IsZeroCopyBuffer( PaUtilChannelDescriptor *channels,
+        unsigned int channelCount, unsigned int bytesPerSample,
+        int formatIsEqualToHost, int userIsInterleaved, int hostIsInterleaved )
+{
+    unsigned int i;
+
+    if( channelCount == 0 || !formatIsEqualToHost || userIsInterleaved != hostIsInterleaved )
+        return 0;
+
+    if( userIsInterleaved )
+        return channels[0].data && IsInterleavedRun( channels, channelCount, bytesPerSample );
+
+    for( i=0; i<channelCount; ++i )
+    {
+        if( !channels[i].data || channels[i].stride != 1 )
+            return 0;
+    }
+
+    return 1;
+}
+
+
 /*
     NonAdaptingProcess() is a simple buffer copying adaptor that can handle
     both full and half duplex copies. It processes framesToProcess frames,
@@ -717,9 +832,19 @@ static unsigned long NonAdaptingProcess( PaUtilBufferProcessor *bp,
     unsigned long frameCount;
     unsigned long framesToGo = framesToProcess;
     unsigned long framesProcessed = 0;
-    int skipOutputConvert = 0;
-    int skipInputConvert = 0;
-
+    int skipOutputConvert;
+    int skipInputConvert;
+
+    /* hand the callback pointers into the host buffers when no conversion is
+        needed. the layout can't change between blocks so decide once here */
+    skipInputConvert = bp->inputChannelCount != 0 && bp->hostInputChannels[0][0].data
+            && IsZeroCopyBuffer( hostInputChannels, bp->inputChannelCount,
+                    bp->bytesPerHostInputSample, bp->userInputSampleFormatIsEqualToHost,
+                    bp->userInputIsInterleaved, bp->hostInputIsInterleaved );
+    skipOutputConvert = bp->outputChannelCount != 0 && bp->hostOutputChannels[0][0].data
+            && IsZeroCopyBuffer( hostOutputChannels, bp->outputChannelCount,
+                    bp->bytesPerHostOutputSample, bp->userOutputSampleFormatIsEqualToHost,
+                    bp->userOutputIsInterleaved, bp->hostOutputIsInterleaved );
 
     if( *streamCallbackResult == paContinue )
     {
@@ -745,12 +870,10 @@ static unsigned long NonAdaptingProcess( PaUtilBufferProcessor *bp,
 
                     /* process host buffer directly, or use temp buffer if formats differ or host buffer non-interleaved,
                      * or if num channels differs between the host (set in stride) and the user (eg with some Alsa hw:) */
-                    if( bp->userInputSampleFormatIsEqualToHost && bp->hostInputIsInterleaved
-                        && bp->hostInputChannels[0][0].data && bp->inputChannelCount == hostInputChannels[0].stride )
+                    if( skipInputConvert )
                     {
                         userInput = hostInputChannels[0].data;
                         destBytePtr = (unsigned char *)hostInputChannels[0].data;
-                        skipInputConvert = 1;
                     }
                     else
                     {
@@ -763,13 +886,12 @@ static unsigned long NonAdaptingProcess( PaUtilBufferProcessor *bp,
                     destChannelStrideBytes = frameCount * bp->bytesPerUserInputSample;
 
                     /* setup non-interleaved ptrs */
-                    if( bp->userInputSampleFormatIsEqualToHost && !bp->hostInputIsInterleaved && bp->hostInputChannels[0][0].data )
+                    if( skipInputConvert )
                     {
                         for( i=0; i<bp->inputChannelCount; ++i )
                         {
                             bp->tempInputBufferPtrs[i] = hostInputChannels[i].data;
                         }
-                        skipInputConvert = 1;
                     }
                     else
                     {
@@ -805,6 +927,21 @@ static unsigned long NonAdaptingProcess( PaUtilBufferProcessor *bp,
                                     frameCount * hostInputChannels[i].stride * bp->bytesPerHostInputSample;
                         }
                     }
+                    else if( bp->userInputIsInterleaved && bp->hostInputIsInterleaved
+                            && IsInterleavedRun( hostInputChannels, bp->inputChannelCount, bp->bytesPerHostInputSample ) )
+                    {
+                        /* the counter based dither generator gives every sample of the
+                            run independent noise, so one generator serves all channels */
+                        bp->inputConverter( destBytePtr, 1, hostInputChannels[0].data, 1,
+                                frameCount * bp->inputChannelCount, &bp->ditherGenerators[0] );
+
+                        for( i=0; i<bp->inputChannelCount; ++i )
+                        {
+                            /* advance src ptr for next iteration */
+                            hostInputChannels[i].data = ((unsigned char*)hostInputChannels[i].data) +
+                                    frameCount * hostInputChannels[i].stride * bp->bytesPerHostInputSample;
+                        }
+                    }
                     else
                     {
                         for( i=0; i<bp->inputChannelCount; ++i )
@@ -812,7 +949,7 @@ static unsigned long NonAdaptingProcess( PaUtilBufferProcessor *bp,
                             bp->inputConverter( destBytePtr, destSampleStrideSamples,
                                                     hostInputChannels[i].data,
                                                     hostInputChannels[i].stride,
-                                                    frameCount, &bp->ditherGenerator );
+                                                    frameCount, &bp->ditherGenerators[i] );
 
                             destBytePtr += destChannelStrideBytes;  /* skip to next destination channel */
 
@@ -836,11 +973,9 @@ static unsigned long NonAdaptingProcess( PaUtilBufferProcessor *bp,
                 {
                     /* process host buffer directly, or use temp buffer if formats differ or host buffer non-interleaved,
                      * or if num channels differs between the host (set in stride) and the user (eg with some Alsa hw:) */
-                    if( bp->userOutputSampleFormatIsEqualToHost && bp->hostOutputIsInterleaved
-                          && bp->outputChannelCount == hostOutputChannels[0].stride )
+                    if( skipOutputConvert )
                     {
                         userOutput = hostOutputChannels[0].data;
-                        skipOutputConvert = 1;
                     }
                     else
                     {
@@ -849,13 +984,12 @@ static unsigned long NonAdaptingProcess( PaUtilBufferProcessor *bp,
                 }
                 else /* user output is not interleaved */
                 {
-                    if( bp->userOutputSampleFormatIsEqualToHost && !bp->hostOutputIsInterleaved )
+                    if( skipOutputConvert )
                     {
                         for( i=0; i<bp->outputChannelCount; ++i )
                         {
                             bp->tempOutputBufferPtrs[i] = hostOutputChannels[i].data;
                         }
-                        skipOutputConvert = 1;
                     }
                     else
                     {
@@ -896,6 +1030,20 @@ static unsigned long NonAdaptingProcess( PaUtilBufferProcessor *bp,
                             	    frameCount * hostOutputChannels[i].stride * bp->bytesPerHostOutputSample;
                     	}
 					}
+                    else if( bp->userOutputIsInterleaved && bp->hostOutputIsInterleaved
+                            && !DitherIsNoiseShaped( bp )
+                            && IsInterleavedRun( hostOutputChannels, bp->outputChannelCount, bp->bytesPerHostOutputSample ) )
+                    {
+                        bp->outputConverter( hostOutputChannels[0].data, 1, bp->tempOutputBuffer, 1,
+                                frameCount * bp->outputChannelCount, &bp->ditherGenerators[0] );
+
+                        for( i=0; i<bp->outputChannelCount; ++i )
+                        {
+                            /* advance dest ptr for next iteration */
+                            hostOutputChannels[i].data = ((unsigned char*)hostOutputChannels[i].data) +
+                                    frameCount * hostOutputChannels[i].stride * bp->bytesPerHostOutputSample;
+                        }
+                    }
 					else
 					{
 
@@ -917,7 +1065,7 @@ static unsigned long NonAdaptingProcess( PaUtilBufferProcessor *bp,
                         	bp->outputConverter(    hostOutputChannels[i].data,
                                                 	hostOutputChannels[i].stride,
                                                 	srcBytePtr, srcSampleStrideSamples,
-                                                	frameCount, &bp->ditherGenerator );
+                                                	frameCount, &bp->ditherGenerators[i] );
 
                         	srcBytePtr += srcChannelStrideBytes;  /* skip to next source channel */
 
@@ -1027,7 +1175,7 @@ static unsigned long AdaptingInputOnlyProcess( PaUtilBufferProcessor *bp,
             bp->inputConverter( destBytePtr, destSampleStrideSamples,
                                     hostInputChannels[i].data,
                                     hostInputChannels[i].stride,
-                                    frameCount, &bp->ditherGenerator );
+                                    frameCount, &bp->ditherGenerators[i] );
 
             destBytePtr += destChannelStrideBytes;  /* skip to next destination channel */
 
@@ -1160,7 +1308,7 @@ static unsigned long AdaptingOutputOnlyProcess( PaUtilBufferProcessor *bp,
                 bp->outputConverter(    hostOutputChannels[i].data,
                                         hostOutputChannels[i].stride,
                                         srcBytePtr, srcSampleStrideSamples,
-                                        frameCount, &bp->ditherGenerator );
+                                        frameCount, &bp->ditherGenerators[i] );
 
                 srcBytePtr += srcChannelStrideBytes;  /* skip to next source channel */
 
@@ -1258,7 +1406,7 @@ static void CopyTempOutputBuffersToHostOutputBuffers( PaUtilBufferProcessor *bp)
              bp->outputConverter(    hostOutputChannels[i].data,
                                      hostOutputChannels[i].stride,
                                      srcBytePtr, srcSampleStrideSamples,
-                                     frameCount, &bp->ditherGenerator );
+                                     frameCount, &bp->ditherGenerators[i] );
 
              srcBytePtr += srcChannelStrideBytes;  /* skip to next source channel */
 
@@ -1385,7 +1533,7 @@ static unsigned long AdaptingProcess( PaUtilBufferProcessor *bp,
                 bp->inputConverter( destBytePtr, destSampleStrideSamples,
                                         hostInputChannels[i].data,
                                         hostInputChannels[i].stride,
-                                        frameCount, &bp->ditherGenerator );
+                                        frameCount, &bp->ditherGenerators[i] );
 
                 destBytePtr += destChannelStrideBytes;  /* skip to next destination channel */
 
@@ -1685,7 +1833,7 @@ unsigned long PaUtil_CopyInput( PaUtilBufferProcessor* bp,
             bp->inputConverter( destBytePtr, destSampleStrideSamples,
                                 hostInputChannels[i].data,
                                 hostInputChannels[i].stride,
-                                framesToCopy, &bp->ditherGenerator );
+                                framesToCopy, &bp->ditherGenerators[i] );
 
             destBytePtr += destChannelStrideBytes;  /* skip to next dest channel */
 
@@ -1713,7 +1861,7 @@ unsigned long PaUtil_CopyInput( PaUtilBufferProcessor* bp,
             bp->inputConverter( destBytePtr, destSampleStrideSamples,
                                 hostInputChannels[i].data,
                                 hostInputChannels[i].stride,
-                                framesToCopy, &bp->ditherGenerator );
+                                framesToCopy, &bp->ditherGenerators[i] );
 
             /* advance callers dest pointer (nonInterleavedDestPtrs[i]) */
             destBytePtr += bp->bytesPerUserInputSample * framesToCopy;
@@ -1756,7 +1904,7 @@ unsigned long PaUtil_CopyOutput( PaUtilBufferProcessor* bp,
             bp->outputConverter(    hostOutputChannels[i].data,
                                     hostOutputChannels[i].stride,
                                     srcBytePtr, srcSampleStrideSamples,
-                                    framesToCopy, &bp->ditherGenerator );
+                                    framesToCopy, &bp->ditherGenerators[i] );
 
             srcBytePtr += srcChannelStrideBytes;  /* skip to next source channel */
 
@@ -1785,7 +1933,7 @@ unsigned long PaUtil_CopyOutput( PaUtilBufferProcessor* bp,
             bp->outputConverter(    hostOutputChannels[i].data,
                                     hostOutputChannels[i].stride,
                                     srcBytePtr, srcSampleStrideSamples,
-                                    framesToCopy, &bp->ditherGenerator );
+                                    framesToCopy, &bp->ditherGenerators[i] );
 
 
             /* advance callers source pointer (nonInterleavedSrcPtrs[i]) */
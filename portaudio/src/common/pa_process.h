@@ -203,6 +203,7 @@
 #include "portaudio.h"
 #include "pa_converters.h"
 #include "pa_dither.h"
+#include "pa_cpuload.h"
 
 #ifdef __cplusplus
 extern "C"
@@ -304,12 +305,16 @@ typedef struct {
                                                          calls PaUtil_SetNoOutput()
                                                          */
 
-    PaUtilTriangularDitherGenerator ditherGenerator;
+    PaUtilDitherMode ditherMode;
+    PaUtilTriangularDitherGenerator *ditherGenerators; /**< one per channel, sized for the larger of
+                                                            the input and output channel counts */
 
     double samplePeriod;
 
     PaStreamCallback *streamCallback;
     void *userData;
+
+    PaUtilCallbackProfile *profile; /**< NULL unless attached */
 } PaUtilBufferProcessor;
 
 
@@ -397,6 +402,23 @@ PaError PaUtil_InitializeBufferProcessor( PaUtilBufferProcessor* bufferProcessor
 void PaUtil_TerminateBufferProcessor( PaUtilBufferProcessor* bufferProcessor );
 
 
+/** Record callback timing and xrun statistics into a stream's profile, so
+ that they can be retrieved with Pa_GetStreamProfile(). Call from your
+ OpenStream routine after PaUtil_InitializeBufferProcessor and
+ PaUtil_InitializeCpuLoadMeasurer, passing the profile member of the
+ stream's PaUtilStreamRepresentation.
+
+ @param bufferProcessor The buffer processor which counts the xrun flags
+ passed to PaUtil_BeginBufferProcessing.
+
+ @param cpuLoadMeasurer The measurer which times each callback.
+
+ @param profile The profile to record into.
+*/
+void PaUtil_AttachCallbackProfile( PaUtilBufferProcessor* bufferProcessor,
+        PaUtilCpuLoadMeasurer* cpuLoadMeasurer, PaUtilCallbackProfile* profile );
+
+
 /** Clear any internally buffered data. If you call
  PaUtil_InitializeBufferProcessor in your OpenStream routine, make sure you
  call PaUtil_ResetBufferProcessor in your StartStream call.
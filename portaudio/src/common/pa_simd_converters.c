@@ -0,0 +1,976 @@
+/*
+ * $Id$
+ * Portable Audio I/O Library vectorized sample converters
+ *
+ * Based on the Open Source API proposed by Ross Bencina
+ * Copyright (c) 1999-2002 Phil Burk, Ross Bencina
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * The text above constitutes the entire PortAudio license; however,
+ * the PortAudio community also makes the following non-binding requests:
+ *
+ * Any person wishing to distribute modifications to the Software is
+ * requested to send the modifications to the original developer so that
+ * they can be incorporated into the canonical version. It is also
+ * requested that these non-binding requests be included along with the
+ * license above.
+ */
+
+/** @file
+ @ingroup common_src
+
+ @brief SSE2, AVX2 and NEON implementations of the Float32 <-> Int16/24/32
+ sample converters.
+
+ Each instruction set supplies a small set of kernels which convert a
+ multiple of PaUtilSimdKernels::width contiguous samples. The converters
+ installed into paConverters check the strides, run the kernels over the
+ largest multiple of the width and pass the remainder (or the whole buffer
+ when either stride is not 1) to the converter which was previously
+ installed, normally the standard one from pa_converters.c.
+
+ The kernels reproduce the standard converters bit for bit (as long as the
+ compiler doesn't contract their multiply-adds into FMA instructions),
+ including the way they handle out of range values on each architecture:
+
+ - Float32_To_Int32, Float32_To_Int32_Clip and Float32_To_Int24_Clip scale
+ in single precision (*src * 0x7FFFFFFF promotes 0x7FFFFFFF to float).
+ - Float32_To_Int24 and all Int32/Int24 dither variants scale in double
+ precision.
+ - Float32_To_Int16 variants truncate to 32 bits and then either keep the low
+ 16 bits or saturate.
+
+ The dither variants fill a block with
+ PaUtil_GenerateFloatTriangularDitherBlock() ahead of each kernel call,
+ consuming the generator in the same order as the scalar loop.
+*/
+
+
+#include <string.h> /* memcpy */
+
+#include "pa_simd_converters.h"
+#include "pa_converters.h"
+#include "pa_dither.h"
+#include "pa_endianness.h"
+#include "pa_types.h"
+
+
+#if !defined(PA_NO_STANDARD_CONVERTERS) && !defined(PA_NO_SIMD_CONVERTERS) \
+        && !defined(PA_USE_C99_LRINTF) && defined(PA_LITTLE_ENDIAN)
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__SSE2__) \
+        || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PA_SIMD_X86_
+#include <emmintrin.h>
+#if defined(_MSC_VER) || defined(__GNUC__) || defined(__clang__)
+#define PA_SIMD_AVX2_
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define PA_SIMD_AVX2_FUNCTION_
+#else
+#define PA_SIMD_AVX2_FUNCTION_ __attribute__((target("avx2")))
+#endif
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define PA_SIMD_NEON_
+#include <arm_neon.h>
+#endif
+
+#endif
+
+
+#if defined(PA_SIMD_X86_) || defined(PA_SIMD_NEON_)
+
+/* the number of samples converted through the stack buffers of the dither
+    and packed 24 bit converters per kernel call. a multiple of all widths. */
+#define PA_SIMD_BLOCK_  PA_DITHER_BLOCK_SIZE
+
+static const float const_float_2147483648_ = 2147483648.0f; /* (float)0x7FFFFFFF */
+static const float const_float_1_div_2147483648_ = 1.0f / 2147483648.0f;
+static const float const_float_1_div_32768_ = 1.0f / 32768.0f;
+
+
+typedef struct PaUtilSimdKernels
+{
+    const char *name;
+    unsigned int width; /* every count passed to a kernel is a multiple of this */
+
+    /* dest = (PaInt16)( src * scale + dither ), saturated when clip is set,
+        otherwise the low 16 bits of the truncated 32 bit value. dither may be NULL. */
+    void (*Float32_To_Int16)( PaInt16 *dest, const float *src, unsigned int count,
+            float scale, const float *dither, int clip );
+
+    /* dest = (PaInt32)( src * 2147483648.0f ), computed in single precision */
+    void (*Float32_To_Int32Single)( PaInt32 *dest, const float *src, unsigned int count,
+            int clip );
+
+    /* dest = (PaInt32)( (double)src * scale + dither ), computed in double precision */
+    void (*Float32_To_Int32Double)( PaInt32 *dest, const float *src, unsigned int count,
+            double scale, const float *dither, int clip );
+
+    void (*Int32_To_Float32)( float *dest, const PaInt32 *src, unsigned int count );
+    void (*Int16_To_Float32)( float *dest, const PaInt16 *src, unsigned int count );
+
+    /* packed little endian 24 bit <-> the high 24 bits of 32 bit samples */
+    void (*Int24_To_Int32)( PaInt32 *dest, const unsigned char *src, unsigned int count );
+    void (*Int32_To_Int24)( unsigned char *dest, const PaInt32 *src, unsigned int count );
+} PaUtilSimdKernels;
+
+
+static const PaUtilSimdKernels *kernels_ = 0;
+
+/* the converters which were installed before the vectorized ones */
+static PaUtilConverterTable fallbackConverters_;
+
+
+/* -------------------------------------------------------------------------- */
+
+#if defined(PA_SIMD_X86_)
+
+/* SSE2 has no byte shuffle, so packing and unpacking 24 bit samples stays scalar */
+
+static void Int24_To_Int32_Scalar( PaInt32 *dest, const unsigned char *src, unsigned int count )
+{
+    while( count-- )
+    {
+        *dest++ = (((PaInt32)src[0]) << 8) | (((PaInt32)src[1]) << 16) | (((PaInt32)src[2]) << 24);
+        src += 3;
+    }
+}
+
+
+static void Int32_To_Int24_Scalar( unsigned char *dest, const PaInt32 *src, unsigned int count )
+{
+    while( count-- )
+    {
+        dest[0] = (unsigned char)(*src >> 8);
+        dest[1] = (unsigned char)(*src >> 16);
+        dest[2] = (unsigned char)(*src >> 24);
+        ++src;
+        dest += 3;
+    }
+}
+
+
+static void Float32_To_Int16_Sse2( PaInt16 *dest, const float *src, unsigned int count,
+        float scale, const float *dither, int clip )
+{
+    const __m128 s = _mm_set1_ps( scale );
+    unsigned int i;
+
+    for( i = 0; i < count; i += 8 )
+    {
+        __m128 a = _mm_mul_ps( _mm_loadu_ps( src + i ), s );
+        __m128 b = _mm_mul_ps( _mm_loadu_ps( src + i + 4 ), s );
+        __m128i ia, ib;
+
+        if( dither )
+        {
+            a = _mm_add_ps( a, _mm_loadu_ps( dither + i ) );
+            b = _mm_add_ps( b, _mm_loadu_ps( dither + i + 4 ) );
+        }
+
+        ia = _mm_cvttps_epi32( a );
+        ib = _mm_cvttps_epi32( b );
+        if( !clip )
+        {
+            /* wrap, keeping the low 16 bits as the (PaInt16) cast does */
+            ia = _mm_srai_epi32( _mm_slli_epi32( ia, 16 ), 16 );
+            ib = _mm_srai_epi32( _mm_slli_epi32( ib, 16 ), 16 );
+        }
+        _mm_storeu_si128( (__m128i*)(dest + i), _mm_packs_epi32( ia, ib ) );
+    }
+}
+
+
+static void Float32_To_Int32Single_Sse2( PaInt32 *dest, const float *src, unsigned int count,
+        int clip )
+{
+    const __m128 s = _mm_set1_ps( const_float_2147483648_ );
+    unsigned int i;
+
+    for( i = 0; i < count; i += 4 )
+    {
+        __m128 scaled = _mm_mul_ps( _mm_loadu_ps( src + i ), s );
+        __m128i r = _mm_cvttps_epi32( scaled );
+
+        if( clip )
+        {
+            /* positive overflow converts to 0x80000000, flip it to 0x7FFFFFFF.
+                negative overflow already yields the clipped value. */
+            r = _mm_xor_si128( r, _mm_castps_si128( _mm_cmpge_ps( scaled, s ) ) );
+        }
+        _mm_storeu_si128( (__m128i*)(dest + i), r );
+    }
+}
+
+
+static void Float32_To_Int32Double_Sse2( PaInt32 *dest, const float *src, unsigned int count,
+        double scale, const float *dither, int clip )
+{
+    const __m128d s = _mm_set1_pd( scale );
+    const __m128d lower = _mm_set1_pd( -2147483648. );
+    const __m128d upper = _mm_set1_pd( 2147483647. );
+    unsigned int i;
+
+    for( i = 0; i < count; i += 4 )
+    {
+        __m128 f = _mm_loadu_ps( src + i );
+        __m128d lo = _mm_mul_pd( _mm_cvtps_pd( f ), s );
+        __m128d hi = _mm_mul_pd( _mm_cvtps_pd( _mm_movehl_ps( f, f ) ), s );
+
+        if( dither )
+        {
+            __m128 d = _mm_loadu_ps( dither + i );
+            lo = _mm_add_pd( lo, _mm_cvtps_pd( d ) );
+            hi = _mm_add_pd( hi, _mm_cvtps_pd( _mm_movehl_ps( d, d ) ) );
+        }
+
+        if( clip )
+        {
+            /* max returns its second operand for NaN, matching the scalar
+                conversion of NaN to 0x80000000 */
+            lo = _mm_min_pd( _mm_max_pd( lo, lower ), upper );
+            hi = _mm_min_pd( _mm_max_pd( hi, lower ), upper );
+        }
+
+        _mm_storeu_si128( (__m128i*)(dest + i),
+                _mm_unpacklo_epi64( _mm_cvttpd_epi32( lo ), _mm_cvttpd_epi32( hi ) ) );
+    }
+}
+
+
+static void Int32_To_Float32_Sse2( float *dest, const PaInt32 *src, unsigned int count )
+{
+    const __m128 s = _mm_set1_ps( const_float_1_div_2147483648_ );
+    unsigned int i;
+
+    for( i = 0; i < count; i += 4 )
+    {
+        __m128i x = _mm_loadu_si128( (const __m128i*)(src + i) );
+        _mm_storeu_ps( dest + i, _mm_mul_ps( _mm_cvtepi32_ps( x ), s ) );
+    }
+}
+
+
+static void Int16_To_Float32_Sse2( float *dest, const PaInt16 *src, unsigned int count )
+{
+    const __m128 s = _mm_set1_ps( const_float_1_div_32768_ );
+    unsigned int i;
+
+    for( i = 0; i < count; i += 8 )
+    {
+        __m128i x = _mm_loadu_si128( (const __m128i*)(src + i) );
+        __m128i lo = _mm_srai_epi32( _mm_unpacklo_epi16( x, x ), 16 );
+        __m128i hi = _mm_srai_epi32( _mm_unpackhi_epi16( x, x ), 16 );
+        _mm_storeu_ps( dest + i, _mm_mul_ps( _mm_cvtepi32_ps( lo ), s ) );
+        _mm_storeu_ps( dest + i + 4, _mm_mul_ps( _mm_cvtepi32_ps( hi ), s ) );
+    }
+}
+
+
+static const PaUtilSimdKernels sse2Kernels_ =
+{
+    "sse2",
+    8,
+    Float32_To_Int16_Sse2,
+    Float32_To_Int32Single_Sse2,
+    Float32_To_Int32Double_Sse2,
+    Int32_To_Float32_Sse2,
+    Int16_To_Float32_Sse2,
+    Int24_To_Int32_Scalar,
+    Int32_To_Int24_Scalar
+};
+
+#endif /* PA_SIMD_X86_ */
+
+/* -------------------------------------------------------------------------- */
+
+#if defined(PA_SIMD_AVX2_)
+
+PA_SIMD_AVX2_FUNCTION_
+static void Float32_To_Int16_Avx2( PaInt16 *dest, const float *src, unsigned int count,
+        float scale, const float *dither, int clip )
+{
+    const __m256 s = _mm256_set1_ps( scale );
+    unsigned int i;
+
+    for( i = 0; i < count; i += 16 )
+    {
+        __m256 a = _mm256_mul_ps( _mm256_loadu_ps( src + i ), s );
+        __m256 b = _mm256_mul_ps( _mm256_loadu_ps( src + i + 8 ), s );
+        __m256i ia, ib;
+
+        if( dither )
+        {
+            a = _mm256_add_ps( a, _mm256_loadu_ps( dither + i ) );
+            b = _mm256_add_ps( b, _mm256_loadu_ps( dither + i + 8 ) );
+        }
+
+        ia = _mm256_cvttps_epi32( a );
+        ib = _mm256_cvttps_epi32( b );
+        if( !clip )
+        {
+            ia = _mm256_srai_epi32( _mm256_slli_epi32( ia, 16 ), 16 );
+            ib = _mm256_srai_epi32( _mm256_slli_epi32( ib, 16 ), 16 );
+        }
+
+        /* packs works within 128 bit lanes, restore the sample order */
+        _mm256_storeu_si256( (__m256i*)(dest + i),
+                _mm256_permute4x64_epi64( _mm256_packs_epi32( ia, ib ), 0xD8 ) );
+    }
+}
+
+
+PA_SIMD_AVX2_FUNCTION_
+static void Float32_To_Int32Single_Avx2( PaInt32 *dest, const float *src, unsigned int count,
+        int clip )
+{
+    const __m256 s = _mm256_set1_ps( const_float_2147483648_ );
+    unsigned int i;
+
+    for( i = 0; i < count; i += 8 )
+    {
+        __m256 scaled = _mm256_mul_ps( _mm256_loadu_ps( src + i ), s );
+        __m256i r = _mm256_cvttps_epi32( scaled );
+
+        if( clip )
+            r = _mm256_xor_si256( r, _mm256_castps_si256( _mm256_cmp_ps( scaled, s, _CMP_GE_OQ ) ) );
+
+        _mm256_storeu_si256( (__m256i*)(dest + i), r );
+    }
+}
+
+
+PA_SIMD_AVX2_FUNCTION_
+static void Float32_To_Int32Double_Avx2( PaInt32 *dest, const float *src, unsigned int count,
+        double scale, const float *dither, int clip )
+{
+    const __m256d s = _mm256_set1_pd( scale );
+    const __m256d lower = _mm256_set1_pd( -2147483648. );
+    const __m256d upper = _mm256_set1_pd( 2147483647. );
+    unsigned int i;
+
+    for( i = 0; i < count; i += 8 )
+    {
+        __m256 f = _mm256_loadu_ps( src + i );
+        __m256d lo = _mm256_mul_pd( _mm256_cvtps_pd( _mm256_castps256_ps128( f ) ), s );
+        __m256d hi = _mm256_mul_pd( _mm256_cvtps_pd( _mm256_extractf128_ps( f, 1 ) ), s );
+
+        if( dither )
+        {
+            __m256 d = _mm256_loadu_ps( dither + i );
+            lo = _mm256_add_pd( lo, _mm256_cvtps_pd( _mm256_castps256_ps128( d ) ) );
+            hi = _mm256_add_pd( hi, _mm256_cvtps_pd( _mm256_extractf128_ps( d, 1 ) ) );
+        }
+
+        if( clip )
+        {
+            lo = _mm256_min_pd( _mm256_max_pd( lo, lower ), upper );
+            hi = _mm256_min_pd( _mm256_max_pd( hi, lower ), upper );
+        }
+
+        _mm256_storeu_si256( (__m256i*)(dest + i), _mm256_insertf128_si256(
+                _mm256_castsi128_si256( _mm256_cvttpd_epi32( lo ) ), _mm256_cvttpd_epi32( hi ), 1 ) );
+    }
+}
+
+
+PA_SIMD_AVX2_FUNCTION_
+static void Int32_To_Float32_Avx2( float *dest, const PaInt32 *src, unsigned int count )
+{
+    const __m256 s = _mm256_set1_ps( const_float_1_div_2147483648_ );
+    unsigned int i;
+
+    for( i = 0; i < count; i += 8 )
+    {
+        __m256i x = _mm256_loadu_si256( (const __m256i*)(src + i) );
+        _mm256_storeu_ps( dest + i, _mm256_mul_ps( _mm256_cvtepi32_ps( x ), s ) );
+    }
+}
+
+
+PA_SIMD_AVX2_FUNCTION_
+static void Int16_To_Float32_Avx2( float *dest, const PaInt16 *src, unsigned int count )
+{
+    const __m256 s = _mm256_set1_ps( const_float_1_div_32768_ );
+    unsigned int i;
+
+    for( i = 0; i < count; i += 8 )
+    {
+        __m256i x = _mm256_cvtepi16_epi32( _mm_loadu_si128( (const __m128i*)(src + i) ) );
+        _mm256_storeu_ps( dest + i, _mm256_mul_ps( _mm256_cvtepi32_ps( x ), s ) );
+    }
+}
+
+
+PA_SIMD_AVX2_FUNCTION_
+static void Int24_To_Int32_Avx2( PaInt32 *dest, const unsigned char *src, unsigned int count )
+{
+    /* the low lane holds samples 0-3 loaded from src, the high lane samples
+        4-7 loaded from src + 8, so no byte beyond the 24 input bytes is read */
+    const __m256i shuffle = _mm256_setr_epi8(
+            -1, 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11,
+            -1, 4, 5, 6, -1, 7, 8, 9, -1, 10, 11, 12, -1, 13, 14, 15 );
+    unsigned int i;
+
+    for( i = 0; i < count; i += 8 )
+    {
+        __m256i x = _mm256_inserti128_si256( _mm256_castsi128_si256(
+                _mm_loadu_si128( (const __m128i*)src ) ),
+                _mm_loadu_si128( (const __m128i*)(src + 8) ), 1 );
+        _mm256_storeu_si256( (__m256i*)(dest + i), _mm256_shuffle_epi8( x, shuffle ) );
+        src += 24;
+    }
+}
+
+
+PA_SIMD_AVX2_FUNCTION_
+static void Int32_To_Int24_Avx2( unsigned char *dest, const PaInt32 *src, unsigned int count )
+{
+    const __m256i shuffle = _mm256_setr_epi8(
+            1, 2, 3, 5, 6, 7, 9, 10, 11, 13, 14, 15, -1, -1, -1, -1,
+            1, 2, 3, 5, 6, 7, 9, 10, 11, 13, 14, 15, -1, -1, -1, -1 );
+    unsigned int i;
+
+    for( i = 0; i < count; i += 8 )
+    {
+        __m256i x = _mm256_shuffle_epi8( _mm256_loadu_si256( (const __m256i*)(src + i) ), shuffle );
+        __m128i hi = _mm256_extracti128_si256( x, 1 );
+        int tail = _mm_cvtsi128_si32( _mm_srli_si128( hi, 8 ) );
+
+        /* write exactly 24 bytes: 12 + 4 padding, then overwrite the padding */
+        _mm_storeu_si128( (__m128i*)dest, _mm256_castsi256_si128( x ) );
+        _mm_storel_epi64( (__m128i*)(dest + 12), hi );
+        memcpy( dest + 20, &tail, 4 );
+        dest += 24;
+    }
+}
+
+
+static const PaUtilSimdKernels avx2Kernels_ =
+{
+    "avx2",
+    16,
+    Float32_To_Int16_Avx2,
+    Float32_To_Int32Single_Avx2,
+    Float32_To_Int32Double_Avx2,
+    Int32_To_Float32_Avx2,
+    Int16_To_Float32_Avx2,
+    Int24_To_Int32_Avx2,
+    Int32_To_Int24_Avx2
+};
+
+
+static int CpuHasAvx2( void )
+{
+#if defined(_MSC_VER)
+    int info[4];
+
+    __cpuid( info, 0 );
+    if( info[0] < 7 )
+        return 0;
+
+    /* OSXSAVE and AVX, and the OS saves the YMM registers */
+    __cpuid( info, 1 );
+    if( (info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0 )
+        return 0;
+    if( (_xgetbv( 0 ) & 6) != 6 )
+        return 0;
+
+    __cpuidex( info, 7, 0 );
+    return (info[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports( "avx2" );
+#endif
+}
+
+#endif /* PA_SIMD_AVX2_ */
+
+/* -------------------------------------------------------------------------- */
+
+#if defined(PA_SIMD_NEON_)
+
+/*
+    AArch64 float to integer conversions saturate, both in the vector unit and
+    for the scalar casts in pa_converters.c, so the clip variants share the
+    plain conversions here except where 16 bit results are narrowed.
+*/
+
+static void Float32_To_Int16_Neon( PaInt16 *dest, const float *src, unsigned int count,
+        float scale, const float *dither, int clip )
+{
+    unsigned int i;
+
+    for( i = 0; i < count; i += 8 )
+    {
+        float32x4_t a = vmulq_n_f32( vld1q_f32( src + i ), scale );
+        float32x4_t b = vmulq_n_f32( vld1q_f32( src + i + 4 ), scale );
+        int32x4_t ia, ib;
+
+        if( dither )
+        {
+            a = vaddq_f32( a, vld1q_f32( dither + i ) );
+            b = vaddq_f32( b, vld1q_f32( dither + i + 4 ) );
+        }
+
+        ia = vcvtq_s32_f32( a );
+        ib = vcvtq_s32_f32( b );
+        if( clip )
+            vst1q_s16( dest + i, vcombine_s16( vqmovn_s32( ia ), vqmovn_s32( ib ) ) );
+        else
+            vst1q_s16( dest + i, vcombine_s16( vmovn_s32( ia ), vmovn_s32( ib ) ) );
+    }
+}
+
+
+static void Float32_To_Int32Single_Neon( PaInt32 *dest, const float *src, unsigned int count,
+        int clip )
+{
+    unsigned int i;
+    (void) clip; /* the conversion saturates */
+
+    for( i = 0; i < count; i += 4 )
+        vst1q_s32( dest + i, vcvtq_s32_f32( vmulq_n_f32( vld1q_f32( src + i ), const_float_2147483648_ ) ) );
+}
+
+
+static void Float32_To_Int32Double_Neon( PaInt32 *dest, const float *src, unsigned int count,
+        double scale, const float *dither, int clip )
+{
+    const float64x2_t lower = vdupq_n_f64( -2147483648. );
+    const float64x2_t upper = vdupq_n_f64( 2147483647. );
+    unsigned int i;
+
+    for( i = 0; i < count; i += 4 )
+    {
+        float32x4_t f = vld1q_f32( src + i );
+        float64x2_t lo = vmulq_n_f64( vcvt_f64_f32( vget_low_f32( f ) ), scale );
+        float64x2_t hi = vmulq_n_f64( vcvt_high_f64_f32( f ), scale );
+
+        if( dither )
+        {
+            float32x4_t d = vld1q_f32( dither + i );
+            lo = vaddq_f64( lo, vcvt_f64_f32( vget_low_f32( d ) ) );
+            hi = vaddq_f64( hi, vcvt_high_f64_f32( d ) );
+        }
+
+        if( clip )
+        {
+            lo = vminq_f64( vmaxq_f64( lo, lower ), upper );
+            hi = vminq_f64( vmaxq_f64( hi, lower ), upper );
+        }
+
+        /* saturate through 64 bits, as the scalar double to 32 bit cast does */
+        vst1q_s32( dest + i, vcombine_s32( vqmovn_s64( vcvtq_s64_f64( lo ) ),
+                vqmovn_s64( vcvtq_s64_f64( hi ) ) ) );
+    }
+}
+
+
+static void Int32_To_Float32_Neon( float *dest, const PaInt32 *src, unsigned int count )
+{
+    unsigned int i;
+
+    for( i = 0; i < count; i += 4 )
+        vst1q_f32( dest + i, vmulq_n_f32( vcvtq_f32_s32( vld1q_s32( src + i ) ), const_float_1_div_2147483648_ ) );
+}
+
+
+static void Int16_To_Float32_Neon( float *dest, const PaInt16 *src, unsigned int count )
+{
+    unsigned int i;
+
+    for( i = 0; i < count; i += 8 )
+    {
+        int16x8_t x = vld1q_s16( src + i );
+        vst1q_f32( dest + i, vmulq_n_f32( vcvtq_f32_s32( vmovl_s16( vget_low_s16( x ) ) ), const_float_1_div_32768_ ) );
+        vst1q_f32( dest + i + 4, vmulq_n_f32( vcvtq_f32_s32( vmovl_s16( vget_high_s16( x ) ) ), const_float_1_div_32768_ ) );
+    }
+}
+
+
+static void Int24_To_Int32_Neon( PaInt32 *dest, const unsigned char *src, unsigned int count )
+{
+    unsigned int i;
+
+    for( i = 0; i < count; i += 8 )
+    {
+        uint8x8x3_t b = vld3_u8( src );
+        uint16x8_t low = vorrq_u16( vshll_n_u8( b.val[1], 8 ), vmovl_u8( b.val[0] ) );
+        uint16x8_t high = vmovl_u8( b.val[2] );
+
+        vst1q_s32( dest + i, vreinterpretq_s32_u32( vorrq_u32(
+                vshlq_n_u32( vmovl_u16( vget_low_u16( high ) ), 24 ),
+                vshlq_n_u32( vmovl_u16( vget_low_u16( low ) ), 8 ) ) ) );
+        vst1q_s32( dest + i + 4, vreinterpretq_s32_u32( vorrq_u32(
+                vshlq_n_u32( vmovl_u16( vget_high_u16( high ) ), 24 ),
+                vshlq_n_u32( vmovl_u16( vget_high_u16( low ) ), 8 ) ) ) );
+        src += 24;
+    }
+}
+
+
+static void Int32_To_Int24_Neon( unsigned char *dest, const PaInt32 *src, unsigned int count )
+{
+    unsigned int i;
+
+    for( i = 0; i < count; i += 8 )
+    {
+        uint32x4_t a = vreinterpretq_u32_s32( vld1q_s32( src + i ) );
+        uint32x4_t b = vreinterpretq_u32_s32( vld1q_s32( src + i + 4 ) );
+        uint16x8_t bits8 = vcombine_u16( vshrn_n_u32( a, 8 ), vshrn_n_u32( b, 8 ) );
+        uint16x8_t bits16 = vcombine_u16( vshrn_n_u32( a, 16 ), vshrn_n_u32( b, 16 ) );
+        uint8x8x3_t out;
+
+        out.val[0] = vmovn_u16( bits8 );
+        out.val[1] = vshrn_n_u16( bits8, 8 );
+        out.val[2] = vshrn_n_u16( bits16, 8 );
+        vst3_u8( dest, out );
+        dest += 24;
+    }
+}
+
+
+static const PaUtilSimdKernels neonKernels_ =
+{
+    "neon",
+    8,
+    Float32_To_Int16_Neon,
+    Float32_To_Int32Single_Neon,
+    Float32_To_Int32Double_Neon,
+    Int32_To_Float32_Neon,
+    Int16_To_Float32_Neon,
+    Int24_To_Int32_Neon,
+    Int32_To_Int24_Neon
+};
+
+#endif /* PA_SIMD_NEON_ */
+
+/* -------------------------------------------------------------------------- */
+
+/* returns the number of samples at the start of the buffer the kernels can
+    convert: 0 if either stride isn't 1, otherwise count rounded down to the
+    kernel width. */
+static unsigned int VectorCount( signed int destinationStride, signed int sourceStride,
+        unsigned int count )
+{
+    if( destinationStride != 1 || sourceStride != 1 )
+        return 0;
+
+    return count - count % kernels_->width;
+}
+
+
+/* Float32 to Int32 or packed Int24, the variants differing as described in
+    the file comment */
+typedef struct PaUtilSimdRecipe
+{
+    int doublePrecision;
+    double scale;           /* for doublePrecision only */
+    int dither;
+    int clip;
+    int packed24;
+} PaUtilSimdRecipe;
+
+
+static void Float32_To_IntN( void *destinationBuffer, signed int destinationStride,
+        void *sourceBuffer, signed int sourceStride,
+        unsigned int count, PaUtilTriangularDitherGenerator *ditherGenerator,
+        const PaUtilSimdRecipe *recipe, PaUtilConverter *fallback )
+{
+    float *src = (float*)sourceBuffer;
+    unsigned char *dest = (unsigned char*)destinationBuffer;
+    unsigned int bytesPerSample = recipe->packed24 ? 3 : 4;
+    unsigned int vectorCount = VectorCount( destinationStride, sourceStride, count );
+    PaInt32 temp[PA_SIMD_BLOCK_];
+    float dither[PA_SIMD_BLOCK_];
+
+    count -= vectorCount;
+
+    while( vectorCount > 0 )
+    {
+        unsigned int n = vectorCount;
+        PaInt32 *out = (PaInt32*)dest;
+
+        if( recipe->packed24 || recipe->dither )
+        {
+            if( n > PA_SIMD_BLOCK_ )
+                n = PA_SIMD_BLOCK_;
+            if( recipe->packed24 )
+                out = temp;
+            if( recipe->dither )
+                PaUtil_GenerateFloatTriangularDitherBlock( ditherGenerator, dither, n );
+        }
+
+        if( recipe->doublePrecision )
+            kernels_->Float32_To_Int32Double( out, src, n, recipe->scale,
+                    recipe->dither ? dither : 0, recipe->clip );
+        else
+            kernels_->Float32_To_Int32Single( out, src, n, recipe->clip );
+
+        if( recipe->packed24 )
+            kernels_->Int32_To_Int24( dest, temp, n );
+
+        src += n;
+        dest += n * bytesPerSample;
+        vectorCount -= n;
+    }
+
+    if( count > 0 )
+        fallback( dest, destinationStride, src, sourceStride, count, ditherGenerator );
+}
+
+
+#define PA_SIMD_FLOAT32_TO_INTN_( name, doublePrecision, scale, dither, clip, packed24 )\
+    static void name ## _Simd( void *destinationBuffer, signed int destinationStride,\
+            void *sourceBuffer, signed int sourceStride,\
+            unsigned int count, PaUtilTriangularDitherGenerator *ditherGenerator )\
+    {\
+        static const PaUtilSimdRecipe recipe = { doublePrecision, scale, dither, clip, packed24 };\
+        Float32_To_IntN( destinationBuffer, destinationStride, sourceBuffer, sourceStride,\
+                count, ditherGenerator, &recipe, fallbackConverters_.name );\
+    }
+
+PA_SIMD_FLOAT32_TO_INTN_( Float32_To_Int32,            0, 0.,            0, 0, 0 )
+PA_SIMD_FLOAT32_TO_INTN_( Float32_To_Int32_Clip,       0, 0.,            0, 1, 0 )
+PA_SIMD_FLOAT32_TO_INTN_( Float32_To_Int32_Dither,     1, 2147483646.0,  1, 0, 0 )
+PA_SIMD_FLOAT32_TO_INTN_( Float32_To_Int32_DitherClip, 1, 2147483646.0,  1, 1, 0 )
+PA_SIMD_FLOAT32_TO_INTN_( Float32_To_Int24,            1, 2147483647.0,  0, 0, 1 )
+PA_SIMD_FLOAT32_TO_INTN_( Float32_To_Int24_Clip,       0, 0.,            0, 1, 1 )
+PA_SIMD_FLOAT32_TO_INTN_( Float32_To_Int24_Dither,     1, 2147483646.0,  1, 0, 1 )
+PA_SIMD_FLOAT32_TO_INTN_( Float32_To_Int24_DitherClip, 1, 2147483646.0,  1, 1, 1 )
+
+
+static void Float32_To_Int16_Common( void *destinationBuffer, signed int destinationStride,
+        void *sourceBuffer, signed int sourceStride,
+        unsigned int count, PaUtilTriangularDitherGenerator *ditherGenerator,
+        int dither, int clip, PaUtilConverter *fallback )
+{
+    float *src = (float*)sourceBuffer;
+    PaInt16 *dest = (PaInt16*)destinationBuffer;
+    unsigned int vectorCount = VectorCount( destinationStride, sourceStride, count );
+    float ditherBlock[PA_SIMD_BLOCK_];
+
+    count -= vectorCount;
+
+    if( dither )
+    {
+        while( vectorCount > 0 )
+        {
+            unsigned int n = vectorCount < PA_SIMD_BLOCK_ ? vectorCount : PA_SIMD_BLOCK_;
+
+            PaUtil_GenerateFloatTriangularDitherBlock( ditherGenerator, ditherBlock, n );
+            /* use smaller scaler to prevent overflow when we add the dither */
+            kernels_->Float32_To_Int16( dest, src, n, 32766.0f, ditherBlock, clip );
+
+            src += n;
+            dest += n;
+            vectorCount -= n;
+        }
+    }
+    else if( vectorCount > 0 )
+    {
+        kernels_->Float32_To_Int16( dest, src, vectorCount, 32767.0f, 0, clip );
+        src += vectorCount;
+        dest += vectorCount;
+    }
+
+    if( count > 0 )
+        fallback( dest, destinationStride, src, sourceStride, count, ditherGenerator );
+}
+
+
+#define PA_SIMD_FLOAT32_TO_INT16_( name, dither, clip )\
+    static void name ## _Simd( void *destinationBuffer, signed int destinationStride,\
+            void *sourceBuffer, signed int sourceStride,\
+            unsigned int count, PaUtilTriangularDitherGenerator *ditherGenerator )\
+    {\
+        Float32_To_Int16_Common( destinationBuffer, destinationStride, sourceBuffer, sourceStride,\
+                count, ditherGenerator, dither, clip, fallbackConverters_.name );\
+    }
+
+PA_SIMD_FLOAT32_TO_INT16_( Float32_To_Int16,            0, 0 )
+PA_SIMD_FLOAT32_TO_INT16_( Float32_To_Int16_Clip,       0, 1 )
+PA_SIMD_FLOAT32_TO_INT16_( Float32_To_Int16_Dither,     1, 0 )
+PA_SIMD_FLOAT32_TO_INT16_( Float32_To_Int16_DitherClip, 1, 1 )
+
+
+static void Int32_To_Float32_Simd( void *destinationBuffer, signed int destinationStride,
+        void *sourceBuffer, signed int sourceStride,
+        unsigned int count, PaUtilTriangularDitherGenerator *ditherGenerator )
+{
+    unsigned int vectorCount = VectorCount( destinationStride, sourceStride, count );
+
+    kernels_->Int32_To_Float32( (float*)destinationBuffer, (PaInt32*)sourceBuffer, vectorCount );
+
+    if( count > vectorCount )
+        fallbackConverters_.Int32_To_Float32( (float*)destinationBuffer + vectorCount, destinationStride,
+                (PaInt32*)sourceBuffer + vectorCount, sourceStride, count - vectorCount, ditherGenerator );
+}
+
+
+static void Int16_To_Float32_Simd( void *destinationBuffer, signed int destinationStride,
+        void *sourceBuffer, signed int sourceStride,
+        unsigned int count, PaUtilTriangularDitherGenerator *ditherGenerator )
+{
+    unsigned int vectorCount = VectorCount( destinationStride, sourceStride, count );
+
+    kernels_->Int16_To_Float32( (float*)destinationBuffer, (PaInt16*)sourceBuffer, vectorCount );
+
+    if( count > vectorCount )
+        fallbackConverters_.Int16_To_Float32( (float*)destinationBuffer + vectorCount, destinationStride,
+                (PaInt16*)sourceBuffer + vectorCount, sourceStride, count - vectorCount, ditherGenerator );
+}
+
+
+static void Int24_To_Int32_Simd( void *destinationBuffer, signed int destinationStride,
+        void *sourceBuffer, signed int sourceStride,
+        unsigned int count, PaUtilTriangularDitherGenerator *ditherGenerator )
+{
+    unsigned int vectorCount = VectorCount( destinationStride, sourceStride, count );
+
+    kernels_->Int24_To_Int32( (PaInt32*)destinationBuffer, (unsigned char*)sourceBuffer, vectorCount );
+
+    if( count > vectorCount )
+        fallbackConverters_.Int24_To_Int32( (PaInt32*)destinationBuffer + vectorCount, destinationStride,
+                (unsigned char*)sourceBuffer + vectorCount * 3, sourceStride, count - vectorCount, ditherGenerator );
+}
+
+
+static void Int32_To_Int24_Simd( void *destinationBuffer, signed int destinationStride,
+        void *sourceBuffer, signed int sourceStride,
+        unsigned int count, PaUtilTriangularDitherGenerator *ditherGenerator )
+{
+    unsigned int vectorCount = VectorCount( destinationStride, sourceStride, count );
+
+    kernels_->Int32_To_Int24( (unsigned char*)destinationBuffer, (PaInt32*)sourceBuffer, vectorCount );
+
+    if( count > vectorCount )
+        fallbackConverters_.Int32_To_Int24( (unsigned char*)destinationBuffer + vectorCount * 3, destinationStride,
+                (PaInt32*)sourceBuffer + vectorCount, sourceStride, count - vectorCount, ditherGenerator );
+}
+
+
+static void Int24_To_Float32_Simd( void *destinationBuffer, signed int destinationStride,
+        void *sourceBuffer, signed int sourceStride,
+        unsigned int count, PaUtilTriangularDitherGenerator *ditherGenerator )
+{
+    float *dest = (float*)destinationBuffer;
+    unsigned char *src = (unsigned char*)sourceBuffer;
+    unsigned int vectorCount = VectorCount( destinationStride, sourceStride, count );
+    PaInt32 temp[PA_SIMD_BLOCK_];
+
+    count -= vectorCount;
+
+    /* the shifted 24 bit value converts exactly as the Int32 sample would */
+    while( vectorCount > 0 )
+    {
+        unsigned int n = vectorCount < PA_SIMD_BLOCK_ ? vectorCount : PA_SIMD_BLOCK_;
+
+        kernels_->Int24_To_Int32( temp, src, n );
+        kernels_->Int32_To_Float32( dest, temp, n );
+
+        src += n * 3;
+        dest += n;
+        vectorCount -= n;
+    }
+
+    if( count > 0 )
+        fallbackConverters_.Int24_To_Float32( dest, destinationStride, src, sourceStride, count, ditherGenerator );
+}
+
+
+/* -------------------------------------------------------------------------- */
+
+static const PaUtilSimdKernels *SelectKernels( void )
+{
+#if defined(PA_SIMD_AVX2_)
+    if( CpuHasAvx2() )
+        return &avx2Kernels_;
+#endif
+#if defined(PA_SIMD_X86_)
+    return &sse2Kernels_;
+#elif defined(PA_SIMD_NEON_)
+    return &neonKernels_;
+#endif
+}
+
+
+#define PA_SIMD_INSTALL_( name )\
+    if( paConverters.name )\
+        paConverters.name = name ## _Simd;
+
+void PaUtil_InitializeSimdConverters( void )
+{
+    if( kernels_ )
+        return;
+
+    kernels_ = SelectKernels();
+    fallbackConverters_ = paConverters;
+
+    PA_SIMD_INSTALL_( Float32_To_Int32 )
+    PA_SIMD_INSTALL_( Float32_To_Int32_Dither )
+    PA_SIMD_INSTALL_( Float32_To_Int32_Clip )
+    PA_SIMD_INSTALL_( Float32_To_Int32_DitherClip )
+
+    PA_SIMD_INSTALL_( Float32_To_Int24 )
+    PA_SIMD_INSTALL_( Float32_To_Int24_Dither )
+    PA_SIMD_INSTALL_( Float32_To_Int24_Clip )
+    PA_SIMD_INSTALL_( Float32_To_Int24_DitherClip )
+
+    PA_SIMD_INSTALL_( Float32_To_Int16 )
+    PA_SIMD_INSTALL_( Float32_To_Int16_Dither )
+    PA_SIMD_INSTALL_( Float32_To_Int16_Clip )
+    PA_SIMD_INSTALL_( Float32_To_Int16_DitherClip )
+
+    PA_SIMD_INSTALL_( Int32_To_Float32 )
+    PA_SIMD_INSTALL_( Int32_To_Int24 )
+
+    PA_SIMD_INSTALL_( Int24_To_Float32 )
+    PA_SIMD_INSTALL_( Int24_To_Int32 )
+
+    PA_SIMD_INSTALL_( Int16_To_Float32 )
+}
+
+
+const char *PaUtil_GetSimdConvertersName( void )
+{
+    return kernels_ ? kernels_->name : 0;
+}
+
+#else /* no vectorized converters for this target or configuration */
+
+void PaUtil_InitializeSimdConverters( void )
+{
+}
+
+
+const char *PaUtil_GetSimdConvertersName( void )
+{
+    return 0;
+}
+
+#endif
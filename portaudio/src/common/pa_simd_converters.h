@@ -0,0 +1,81 @@
+#ifndef PA_SIMD_CONVERTERS_H
+#define PA_SIMD_CONVERTERS_H
+/*
+ * $Id$
+ * Portable Audio I/O Library vectorized sample converters
+ *
+ * Based on the Open Source API proposed by Ross Bencina
+ * Copyright (c) 1999-2002 Phil Burk, Ross Bencina
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * The text above constitutes the entire PortAudio license; however,
+ * the PortAudio community also makes the following non-binding requests:
+ *
+ * Any person wishing to distribute modifications to the Software is
+ * requested to send the modifications to the original developer so that
+ * they can be incorporated into the canonical version. It is also
+ * requested that these non-binding requests be included along with the
+ * license above.
+ */
+
+/** @file
+ @ingroup common_src
+
+ @brief SSE2, AVX2 and NEON implementations of the Float32 <-> Int16/24/32
+ sample converters.
+
+ The vectorized converters produce exactly the same samples as the standard
+ converters in pa_converters.c. They only handle unit-stride buffers; strided
+ conversions are passed on to the converter which was installed before them.
+*/
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+
+/** Install the vectorized converters best suited to the host CPU into
+ paConverters. The instruction set is selected at runtime from the CPU
+ features. Called by Pa_Initialize(); calling it more than once has no
+ further effect.
+
+ Nothing is installed when PortAudio is built with PA_NO_STANDARD_CONVERTERS,
+ PA_NO_SIMD_CONVERTERS or PA_USE_C99_LRINTF, or for big endian targets.
+
+ @see paConverters
+*/
+void PaUtil_InitializeSimdConverters( void );
+
+
+/** Returns the name of the instruction set used by the installed vectorized
+ converters ("sse2", "avx2" or "neon"), or NULL if none are installed.
+*/
+const char *PaUtil_GetSimdConvertersName( void );
+
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* PA_SIMD_CONVERTERS_H */
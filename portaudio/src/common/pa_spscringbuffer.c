@@ -0,0 +1,259 @@
+/*
+ * $Id$
+ * Portable Audio I/O Library
+ * Cache friendly single-reader single-writer ring buffer.
+ *
+ * Based on the Open Source API proposed by Ross Bencina
+ * Copyright (c) 1999-2002 Phil Burk, Ross Bencina
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * The text above constitutes the entire PortAudio license; however,
+ * the PortAudio community also makes the following non-binding requests:
+ *
+ * Any person wishing to distribute modifications to the Software is
+ * requested to send the modifications to the original developer so that
+ * they can be incorporated into the canonical version. It is also
+ * requested that these non-binding requests be included along with the
+ * license above.
+ */
+
+/**
+ @file
+ @ingroup common_src
+*/
+
+#include <string.h>
+#include "pa_spscringbuffer.h"
+#include "pa_memorybarrier.h"
+
+/* The producer publishes writeIndex with a release store after filling the
+    elements, and the consumer observes it with an acquire load before reading
+    them; readIndex is handed back the same way. Each side only ever stores
+    its own index, so it can read that index without synchronization. */
+#if defined(__clang__) || ( defined(__GNUC__) && ((__GNUC__ > 4) || (__GNUC__ == 4 && __GNUC_MINOR__ >= 7)) )
+#define PA_SPSC_LOAD_ACQUIRE_( x )      __atomic_load_n( &(x), __ATOMIC_ACQUIRE )
+#define PA_SPSC_STORE_RELEASE_( x, v )  __atomic_store_n( &(x), (v), __ATOMIC_RELEASE )
+#else
+/* no acquire/release primitives, fall back to the full barriers of
+    pa_memorybarrier.h, as used by PaUtilRingBuffer */
+static ring_buffer_size_t LoadAcquire( const ring_buffer_size_t *p )
+{
+    ring_buffer_size_t result = *(const volatile ring_buffer_size_t *)p;
+    PaUtil_FullMemoryBarrier();
+    return result;
+}
+
+static void StoreRelease( ring_buffer_size_t *p, ring_buffer_size_t value )
+{
+    PaUtil_FullMemoryBarrier();
+    *(volatile ring_buffer_size_t *)p = value;
+}
+#define PA_SPSC_LOAD_ACQUIRE_( x )      LoadAcquire( &(x) )
+#define PA_SPSC_STORE_RELEASE_( x, v )  StoreRelease( &(x), (v) )
+#endif
+
+
+/***************************************************************************
+** Indices run from 0 to indexLimit-1 (twice the element count) so that a full
+** buffer can be told apart from an empty one without requiring a power of
+** two element count. */
+static ring_buffer_size_t AdvanceIndex( const PaUtilSpscRingBuffer *rbuf, ring_buffer_size_t index, ring_buffer_size_t elementCount )
+{
+    index += elementCount;
+    if( index >= rbuf->indexLimit ) index -= rbuf->indexLimit;
+    return index;
+}
+
+/* Number of elements between readIndex and writeIndex. */
+static ring_buffer_size_t IndexDistance( const PaUtilSpscRingBuffer *rbuf, ring_buffer_size_t readIndex, ring_buffer_size_t writeIndex )
+{
+    ring_buffer_size_t distance = writeIndex - readIndex;
+    if( distance < 0 ) distance += rbuf->indexLimit;
+    return distance;
+}
+
+/* Fill in the region(s) starting at index, see PaUtil_GetSpscRingBufferWriteRegions(). */
+static void GetRegions( PaUtilSpscRingBuffer *rbuf, ring_buffer_size_t index, ring_buffer_size_t elementCount,
+                        void **dataPtr1, ring_buffer_size_t *sizePtr1,
+                        void **dataPtr2, ring_buffer_size_t *sizePtr2 )
+{
+    if( index >= rbuf->bufferSize ) index -= rbuf->bufferSize;
+    if( (index + elementCount) > rbuf->bufferSize )
+    {
+        /* Data in two blocks that wrap the buffer. */
+        ring_buffer_size_t   firstHalf = rbuf->bufferSize - index;
+        *dataPtr1 = &rbuf->buffer[index*rbuf->elementSizeBytes];
+        *sizePtr1 = firstHalf;
+        *dataPtr2 = &rbuf->buffer[0];
+        *sizePtr2 = elementCount - firstHalf;
+    }
+    else
+    {
+        *dataPtr1 = &rbuf->buffer[index*rbuf->elementSizeBytes];
+        *sizePtr1 = elementCount;
+        *dataPtr2 = NULL;
+        *sizePtr2 = 0;
+    }
+}
+
+/***************************************************************************
+ * Initialize FIFO.
+ * returns -1 if elementCount is not positive or too large.
+ */
+ring_buffer_size_t PaUtil_InitializeSpscRingBuffer( PaUtilSpscRingBuffer *rbuf, ring_buffer_size_t elementSizeBytes, ring_buffer_size_t elementCount, void *dataPtr )
+{
+    /* indices must reach 2*elementCount without overflowing */
+    ring_buffer_size_t elementCountLimit = (ring_buffer_size_t)1 << (sizeof(ring_buffer_size_t) * 8 - 2);
+
+    if( elementCount <= 0 || elementCount >= elementCountLimit ) return -1;
+    rbuf->bufferSize = elementCount;
+    rbuf->indexLimit = elementCount * 2;
+    rbuf->elementSizeBytes = elementSizeBytes;
+    rbuf->buffer = (char *)dataPtr;
+    PaUtil_FlushSpscRingBuffer( rbuf );
+    return 0;
+}
+
+/***************************************************************************
+** Clear buffer. Should only be called when buffer is NOT being read or written. */
+void PaUtil_FlushSpscRingBuffer( PaUtilSpscRingBuffer *rbuf )
+{
+    rbuf->writeIndex = rbuf->cachedWriteIndex = 0;
+    rbuf->readIndex = rbuf->cachedReadIndex = 0;
+    PaUtil_FullMemoryBarrier();
+}
+
+/***************************************************************************
+** Return number of elements available for reading. */
+ring_buffer_size_t PaUtil_GetSpscRingBufferReadAvailable( const PaUtilSpscRingBuffer *rbuf )
+{
+    ring_buffer_size_t readIndex = PA_SPSC_LOAD_ACQUIRE_( rbuf->readIndex );
+    return IndexDistance( rbuf, readIndex, PA_SPSC_LOAD_ACQUIRE_( rbuf->writeIndex ) );
+}
+
+/***************************************************************************
+** Return number of elements available for writing. */
+ring_buffer_size_t PaUtil_GetSpscRingBufferWriteAvailable( const PaUtilSpscRingBuffer *rbuf )
+{
+    return rbuf->bufferSize - PaUtil_GetSpscRingBufferReadAvailable( rbuf );
+}
+
+/***************************************************************************
+** Get address of region(s) to which we can write data.
+** The consumer's read index is only reloaded when the cached copy doesn't
+** leave room for elementCount elements.
+** Returns room available to be written or elementCount, whichever is smaller.
+*/
+ring_buffer_size_t PaUtil_GetSpscRingBufferWriteRegions( PaUtilSpscRingBuffer *rbuf, ring_buffer_size_t elementCount,
+                                       void **dataPtr1, ring_buffer_size_t *sizePtr1,
+                                       void **dataPtr2, ring_buffer_size_t *sizePtr2 )
+{
+    ring_buffer_size_t   available = rbuf->bufferSize - IndexDistance( rbuf, rbuf->cachedReadIndex, rbuf->writeIndex );
+    if( elementCount > available )
+    {
+        rbuf->cachedReadIndex = PA_SPSC_LOAD_ACQUIRE_( rbuf->readIndex );
+        available = rbuf->bufferSize - IndexDistance( rbuf, rbuf->cachedReadIndex, rbuf->writeIndex );
+        if( elementCount > available ) elementCount = available;
+    }
+    GetRegions( rbuf, rbuf->writeIndex, elementCount, dataPtr1, sizePtr1, dataPtr2, sizePtr2 );
+    return elementCount;
+}
+
+/***************************************************************************
+*/
+ring_buffer_size_t PaUtil_AdvanceSpscRingBufferWriteIndex( PaUtilSpscRingBuffer *rbuf, ring_buffer_size_t elementCount )
+{
+    /* the release store makes the elements written so far visible to the
+        consumer before the new index is */
+    ring_buffer_size_t writeIndex = AdvanceIndex( rbuf, rbuf->writeIndex, elementCount );
+    PA_SPSC_STORE_RELEASE_( rbuf->writeIndex, writeIndex );
+    return writeIndex;
+}
+
+/***************************************************************************
+** Get address of region(s) from which we can read data.
+** The producer's write index is only reloaded when the cached copy doesn't
+** show elementCount elements.
+** Returns room available to be read or elementCount, whichever is smaller.
+*/
+ring_buffer_size_t PaUtil_GetSpscRingBufferReadRegions( PaUtilSpscRingBuffer *rbuf, ring_buffer_size_t elementCount,
+                                void **dataPtr1, ring_buffer_size_t *sizePtr1,
+                                void **dataPtr2, ring_buffer_size_t *sizePtr2 )
+{
+    ring_buffer_size_t   available = IndexDistance( rbuf, rbuf->readIndex, rbuf->cachedWriteIndex );
+    if( elementCount > available )
+    {
+        rbuf->cachedWriteIndex = PA_SPSC_LOAD_ACQUIRE_( rbuf->writeIndex );
+        available = IndexDistance( rbuf, rbuf->readIndex, rbuf->cachedWriteIndex );
+        if( elementCount > available ) elementCount = available;
+    }
+    GetRegions( rbuf, rbuf->readIndex, elementCount, dataPtr1, sizePtr1, dataPtr2, sizePtr2 );
+    return elementCount;
+}
+
+/***************************************************************************
+*/
+ring_buffer_size_t PaUtil_AdvanceSpscRingBufferReadIndex( PaUtilSpscRingBuffer *rbuf, ring_buffer_size_t elementCount )
+{
+    /* the release store keeps the copies out of the buffer ordered before the
+        producer can reuse the space */
+    ring_buffer_size_t readIndex = AdvanceIndex( rbuf, rbuf->readIndex, elementCount );
+    PA_SPSC_STORE_RELEASE_( rbuf->readIndex, readIndex );
+    return readIndex;
+}
+
+/***************************************************************************
+** Return elements written. */
+ring_buffer_size_t PaUtil_WriteSpscRingBuffer( PaUtilSpscRingBuffer *rbuf, const void *data, ring_buffer_size_t elementCount )
+{
+    ring_buffer_size_t size1, size2, numWritten;
+    void *data1, *data2;
+    numWritten = PaUtil_GetSpscRingBufferWriteRegions( rbuf, elementCount, &data1, &size1, &data2, &size2 );
+    memcpy( data1, data, size1*rbuf->elementSizeBytes );
+    if( size2 > 0 )
+    {
+        data = ((const char *)data) + size1*rbuf->elementSizeBytes;
+        memcpy( data2, data, size2*rbuf->elementSizeBytes );
+    }
+    if( numWritten > 0 )
+        PaUtil_AdvanceSpscRingBufferWriteIndex( rbuf, numWritten );
+    return numWritten;
+}
+
+/***************************************************************************
+** Return elements read. */
+ring_buffer_size_t PaUtil_ReadSpscRingBuffer( PaUtilSpscRingBuffer *rbuf, void *data, ring_buffer_size_t elementCount )
+{
+    ring_buffer_size_t size1, size2, numRead;
+    void *data1, *data2;
+    numRead = PaUtil_GetSpscRingBufferReadRegions( rbuf, elementCount, &data1, &size1, &data2, &size2 );
+    memcpy( data, data1, size1*rbuf->elementSizeBytes );
+    if( size2 > 0 )
+    {
+        data = ((char *)data) + size1*rbuf->elementSizeBytes;
+        memcpy( data, data2, size2*rbuf->elementSizeBytes );
+    }
+    if( numRead > 0 )
+        PaUtil_AdvanceSpscRingBufferReadIndex( rbuf, numRead );
+    return numRead;
+}
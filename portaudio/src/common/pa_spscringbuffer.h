@@ -0,0 +1,258 @@
+#ifndef PA_SPSCRINGBUFFER_H
+#define PA_SPSCRINGBUFFER_H
+/*
+ * $Id$
+ * Portable Audio I/O Library
+ * Cache friendly single-reader single-writer ring buffer.
+ *
+ * Based on the Open Source API proposed by Ross Bencina
+ * Copyright (c) 1999-2002 Phil Burk, Ross Bencina
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * The text above constitutes the entire PortAudio license; however,
+ * the PortAudio community also makes the following non-binding requests:
+ *
+ * Any person wishing to distribute modifications to the Software is
+ * requested to send the modifications to the original developer so that
+ * they can be incorporated into the canonical version. It is also
+ * requested that these non-binding requests be included along with the
+ * license above.
+ */
+
+/** @file
+ @ingroup common_src
+ @brief Single-reader single-writer lock-free ring buffer with the reader and
+ writer state on separate cache lines.
+
+ PaUtilSpscRingBuffer transports elements between one producer and one
+ consumer, like PaUtilRingBuffer, but is laid out for low cross-core traffic:
+
+ - the write index and the read index live on different cache lines, so the
+ producer and the consumer don't invalidate each other's line on every
+ advance;
+ - each side keeps a private snapshot of the other side's index and only
+ reloads it when the snapshot doesn't show enough room or data;
+ - indices are published with release stores and observed with acquire loads
+ instead of full memory barriers.
+
+ The element count may be any positive value; it does not need to be a power
+ of two.
+
+ The regions functions and PaUtil_AdvanceSpscRingBufferWriteIndex() /
+ PaUtil_AdvanceSpscRingBufferReadIndex() may only be called from the producer
+ and the consumer respectively. The available functions may be called from
+ either side.
+
+ The memory area used to store the buffer elements must be allocated by
+ the client prior to calling PaUtil_InitializeSpscRingBuffer() and must outlive
+ the use of the ring buffer.
+
+ @note Like PaUtilRingBuffer, these functions are not normally exposed in the
+ PortAudio libraries. Applications using them should add pa_ringbuffer.h,
+ pa_spscringbuffer.h and pa_spscringbuffer.c to their own sources.
+*/
+
+
+#include "pa_ringbuffer.h" /* ring_buffer_size_t */
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+
+/** Size in bytes of the padding which keeps the producer and the consumer
+ state of a PaUtilSpscRingBuffer apart. Must be at least the cache line size
+ of the target.
+*/
+#ifndef PA_SPSC_CACHE_LINE_SIZE
+#if defined(__APPLE__) && defined(__aarch64__)
+#define PA_SPSC_CACHE_LINE_SIZE 128
+#else
+#define PA_SPSC_CACHE_LINE_SIZE 64
+#endif
+#endif
+
+
+typedef struct PaUtilSpscRingBuffer
+{
+    /* set by PaUtil_InitializeSpscRingBuffer, read only afterwards */
+    ring_buffer_size_t  bufferSize; /**< Number of elements in FIFO. */
+    ring_buffer_size_t  indexLimit; /**< Indices run from 0 to 2*bufferSize-1 to distinguish full/empty. */
+    ring_buffer_size_t  elementSizeBytes; /**< Number of bytes per element. */
+    char  *buffer;    /**< Pointer to the buffer containing the actual data. */
+    char  sharedPad[PA_SPSC_CACHE_LINE_SIZE];
+
+    /* producer side */
+    ring_buffer_size_t  writeIndex; /**< Index of next writable element. Set by PaUtil_AdvanceSpscRingBufferWriteIndex. */
+    ring_buffer_size_t  cachedReadIndex; /**< Producer's last snapshot of readIndex. */
+    char  writerPad[PA_SPSC_CACHE_LINE_SIZE];
+
+    /* consumer side */
+    ring_buffer_size_t  readIndex;  /**< Index of next readable element. Set by PaUtil_AdvanceSpscRingBufferReadIndex. */
+    ring_buffer_size_t  cachedWriteIndex; /**< Consumer's last snapshot of writeIndex. */
+    char  readerPad[PA_SPSC_CACHE_LINE_SIZE];
+}PaUtilSpscRingBuffer;
+
+/** Initialize the ring buffer to empty state ready to have elements written
+ to it.
+
+ @param rbuf The ring buffer.
+
+ @param elementSizeBytes The size of a single data element in bytes.
+
+ @param elementCount The number of elements in the buffer.
+
+ @param dataPtr A pointer to a previously allocated area where the data
+ will be maintained.  It must be elementCount*elementSizeBytes long.
+
+ @return -1 if elementCount is not positive or too large, otherwise 0.
+*/
+ring_buffer_size_t PaUtil_InitializeSpscRingBuffer( PaUtilSpscRingBuffer *rbuf, ring_buffer_size_t elementSizeBytes, ring_buffer_size_t elementCount, void *dataPtr );
+
+/** Reset buffer to empty. Should only be called when buffer is NOT being read or written.
+
+ @param rbuf The ring buffer.
+*/
+void PaUtil_FlushSpscRingBuffer( PaUtilSpscRingBuffer *rbuf );
+
+/** Retrieve the number of elements available in the ring buffer for writing.
+
+ @param rbuf The ring buffer.
+
+ @return The number of elements available for writing.
+*/
+ring_buffer_size_t PaUtil_GetSpscRingBufferWriteAvailable( const PaUtilSpscRingBuffer *rbuf );
+
+/** Retrieve the number of elements available in the ring buffer for reading.
+
+ @param rbuf The ring buffer.
+
+ @return The number of elements available for reading.
+*/
+ring_buffer_size_t PaUtil_GetSpscRingBufferReadAvailable( const PaUtilSpscRingBuffer *rbuf );
+
+/** Write data to the ring buffer. Producer only.
+
+ @param rbuf The ring buffer.
+
+ @param data The address of new data to write to the buffer.
+
+ @param elementCount The number of elements to be written.
+
+ @return The number of elements written.
+*/
+ring_buffer_size_t PaUtil_WriteSpscRingBuffer( PaUtilSpscRingBuffer *rbuf, const void *data, ring_buffer_size_t elementCount );
+
+/** Read data from the ring buffer. Consumer only.
+
+ @param rbuf The ring buffer.
+
+ @param data The address where the data should be stored.
+
+ @param elementCount The number of elements to be read.
+
+ @return The number of elements read.
+*/
+ring_buffer_size_t PaUtil_ReadSpscRingBuffer( PaUtilSpscRingBuffer *rbuf, void *data, ring_buffer_size_t elementCount );
+
+/** Get address of region(s) to which we can write data. Producer only.
+ The data becomes visible to the consumer when
+ PaUtil_AdvanceSpscRingBufferWriteIndex() is called.
+
+ @param rbuf The ring buffer.
+
+ @param elementCount The number of elements desired.
+
+ @param dataPtr1 The address where the first (or only) region pointer will be
+ stored.
+
+ @param sizePtr1 The address where the first (or only) region length will be
+ stored.
+
+ @param dataPtr2 The address where the second region pointer will be stored if
+ the first region is too small to satisfy elementCount.
+
+ @param sizePtr2 The address where the second region length will be stored if
+ the first region is too small to satisfy elementCount.
+
+ @return The room available to be written or elementCount, whichever is smaller.
+*/
+ring_buffer_size_t PaUtil_GetSpscRingBufferWriteRegions( PaUtilSpscRingBuffer *rbuf, ring_buffer_size_t elementCount,
+                                       void **dataPtr1, ring_buffer_size_t *sizePtr1,
+                                       void **dataPtr2, ring_buffer_size_t *sizePtr2 );
+
+/** Advance the write index to the next location to be written. Producer only.
+
+ @param rbuf The ring buffer.
+
+ @param elementCount The number of elements to advance. Must not exceed the
+ count returned by the last call to PaUtil_GetSpscRingBufferWriteRegions().
+
+ @return The new position.
+*/
+ring_buffer_size_t PaUtil_AdvanceSpscRingBufferWriteIndex( PaUtilSpscRingBuffer *rbuf, ring_buffer_size_t elementCount );
+
+/** Get address of region(s) from which we can read data. Consumer only.
+ The space is handed back to the producer when
+ PaUtil_AdvanceSpscRingBufferReadIndex() is called.
+
+ @param rbuf The ring buffer.
+
+ @param elementCount The number of elements desired.
+
+ @param dataPtr1 The address where the first (or only) region pointer will be
+ stored.
+
+ @param sizePtr1 The address where the first (or only) region length will be
+ stored.
+
+ @param dataPtr2 The address where the second region pointer will be stored if
+ the first region is too small to satisfy elementCount.
+
+ @param sizePtr2 The address where the second region length will be stored if
+ the first region is too small to satisfy elementCount.
+
+ @return The number of elements available for reading or elementCount,
+ whichever is smaller.
+*/
+ring_buffer_size_t PaUtil_GetSpscRingBufferReadRegions( PaUtilSpscRingBuffer *rbuf, ring_buffer_size_t elementCount,
+                                      void **dataPtr1, ring_buffer_size_t *sizePtr1,
+                                      void **dataPtr2, ring_buffer_size_t *sizePtr2 );
+
+/** Advance the read index to the next location to be read. Consumer only.
+
+ @param rbuf The ring buffer.
+
+ @param elementCount The number of elements to advance. Must not exceed the
+ count returned by the last call to PaUtil_GetSpscRingBufferReadRegions().
+
+ @return The new position.
+*/
+ring_buffer_size_t PaUtil_AdvanceSpscRingBufferReadIndex( PaUtilSpscRingBuffer *rbuf, ring_buffer_size_t elementCount );
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* PA_SPSCRINGBUFFER_H */
@@ -48,6 +48,7 @@
 
 
 #include "portaudio.h"
+#include "pa_cpuload.h"
 
 #ifdef __cplusplus
 extern "C"
@@ -152,6 +153,7 @@ typedef struct PaUtilStreamRepresentation {
     PaStreamFinishedCallback *streamFinishedCallback;
     void *userData;
     PaStreamInfo streamInfo;
+    PaUtilCallbackProfile profile; /**< see PaUtil_AttachCallbackProfile */
 } PaUtilStreamRepresentation;
 
 
@@ -52,6 +52,9 @@
  This facility is only active if PA_TRACE_REALTIME_EVENTS is set to 1,
  otherwise the trace functions expand to no-ops.
 
+ For binary tracing which is cheap enough to leave enabled in production,
+ see pa_tracering.h.
+
  @fn PaUtil_ResetTraceMessages
  @brief Clear the trace buffer.
 
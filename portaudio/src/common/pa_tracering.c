@@ -0,0 +1,412 @@
+/*
+ * $Id$
+ * Portable Audio I/O Library
+ * Binary event trace for real-time threads.
+ *
+ * Based on the Open Source API proposed by Ross Bencina
+ * Copyright (c) 1999-2002 Phil Burk, Ross Bencina
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * The text above constitutes the entire PortAudio license; however,
+ * the PortAudio community also makes the following non-binding requests:
+ *
+ * Any person wishing to distribute modifications to the Software is
+ * requested to send the modifications to the original developer so that
+ * they can be incorporated into the canonical version. It is also
+ * requested that these non-binding requests be included along with the
+ * license above.
+ */
+
+/** @file
+ @ingroup common_src
+
+ @brief Binary event trace, cheap enough to leave enabled on real-time
+ threads. See pa_tracering.h.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h> /* getenv() */
+#include <string.h>
+
+#include "pa_tracering.h"
+#include "pa_spscringbuffer.h"
+#include "pa_memorybarrier.h"
+#include "pa_util.h"
+#include "pa_debugprint.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+
+/* Each thread finds its ring through thread local storage, and claims it
+    from the fixed pool with compare-and-swap and its id with fetch-and-add.
+    Without these the trace is unavailable. */
+#if defined(__GNUC__) || defined(__clang__)
+#define PA_TRACE_SUPPORTED_                     (1)
+#define PA_TRACE_THREAD_LOCAL_                  __thread
+#define PA_TRACE_CAS_( p, oldValue, newValue )  __sync_bool_compare_and_swap( (p), (oldValue), (newValue) )
+#define PA_TRACE_FETCH_INCREMENT_( p )          __sync_fetch_and_add( (p), 1 )
+#elif defined(_MSC_VER)
+#define PA_TRACE_SUPPORTED_                     (1)
+#define PA_TRACE_THREAD_LOCAL_                  __declspec(thread)
+#define PA_TRACE_CAS_( p, oldValue, newValue ) \
+    (InterlockedCompareExchange( (volatile LONG*)(p), (LONG)(newValue), (LONG)(oldValue) ) == (LONG)(oldValue))
+#define PA_TRACE_FETCH_INCREMENT_( p )          ((PaUint32)InterlockedExchangeAdd( (volatile LONG*)(p), 1 ))
+#else
+#define PA_TRACE_SUPPORTED_                     (0)
+#endif
+
+
+#define PA_TRACE_RING_FREE_         (0)
+#define PA_TRACE_RING_ACTIVE_       (1) /* owned by a thread */
+#define PA_TRACE_RING_RELEASED_     (2) /* owner gone, free once drained */
+
+typedef struct PaUtilTraceRing
+{
+    PaUtilSpscRingBuffer records;
+    volatile PaUint32 state;
+    volatile PaUint32 writing;          /* set by the owner while inside PaUtil_TraceEvent() */
+    volatile PaUint32 session;          /* traceSession_ when the ring was claimed */
+    volatile PaUint32 droppedCount;     /* written by the owner only */
+    PaUint32 threadId;
+    PaUint32 reportedDroppedCount;      /* drain thread only */
+} PaUtilTraceRing;
+
+
+/* The ring descriptors are static so that a thread racing PaUtil_StopTrace()
+    never touches freed memory; only the record storage is allocated. */
+static PaUtilTraceRing traceRings_[ PA_TRACE_MAX_THREADS ];
+static PaUtilTraceRecord *traceRecords_ = NULL;
+static FILE *traceFile_ = NULL;
+static double traceStartTime_ = 0.;
+static volatile int traceEnabled_ = 0;
+static volatile PaUint32 traceSession_ = 0;
+static volatile PaUint32 nextThreadId_ = 1;
+static volatile int drainStopRequested_ = 0;
+
+#if defined(_WIN32)
+static HANDLE drainThread_ = NULL;
+#else
+static pthread_t drainThread_;
+#endif
+
+#if PA_TRACE_SUPPORTED_
+static PA_TRACE_THREAD_LOCAL_ PaUtilTraceRing *threadRing_ = NULL;
+static PA_TRACE_THREAD_LOCAL_ PaUint32 threadSession_ = 0;
+#endif
+
+
+#if PA_TRACE_SUPPORTED_
+
+/* Wait-free: one compare-and-swap per ring at most, never retried. */
+static PaUtilTraceRing *ClaimRing( void )
+{
+    PaUint32 session = traceSession_;
+    int i;
+
+    for( i=0; i < PA_TRACE_MAX_THREADS; ++i )
+    {
+        PaUtilTraceRing *ring = &traceRings_[i];
+
+        if( ring->state == PA_TRACE_RING_FREE_
+                && PA_TRACE_CAS_( &ring->state, PA_TRACE_RING_FREE_, PA_TRACE_RING_ACTIVE_ ) )
+        {
+            ring->threadId = PA_TRACE_FETCH_INCREMENT_( &nextThreadId_ );
+            ring->session = session;
+
+            threadRing_ = ring;
+            threadSession_ = session;
+            return ring;
+        }
+    }
+
+    return NULL; /* every ring is in use, the event is lost */
+}
+
+#endif /* PA_TRACE_SUPPORTED_ */
+
+
+void PaUtil_TraceEvent( PaUint32 eventId, PaInt32 arg0, PaInt32 arg1 )
+{
+#if PA_TRACE_SUPPORTED_
+    PaUtilTraceRing *ring;
+    PaUtilTraceRecord record;
+    double nanoseconds, high;
+
+    if( !traceEnabled_ )
+        return;
+
+    ring = threadRing_;
+    if( ring == NULL || threadSession_ != traceSession_ )
+    {
+        ring = ClaimRing();
+        if( ring == NULL )
+            return;
+    }
+
+    /* PaUtil_StopTrace() clears traceEnabled_ and then waits for writing to
+        be clear on every ring, so a full barrier between setting writing and
+        checking traceEnabled_ guarantees the record storage stays valid.
+        This barrier is the main per-event cost, see pa_tracering.h. */
+    ring->writing = 1;
+    PaUtil_FullMemoryBarrier();
+
+    if( traceEnabled_ && ring->session == traceSession_ )
+    {
+        nanoseconds = (PaUtil_GetTime() - traceStartTime_) * 1e9;
+        if( nanoseconds < 0. )
+            nanoseconds = 0.;
+        high = (double)(PaUint32)(nanoseconds / 4294967296.);
+
+        record.timeHigh = (PaUint32)high;
+        record.timeLow = (PaUint32)(nanoseconds - high * 4294967296.);
+        record.eventId = eventId;
+        record.arg0 = arg0;
+        record.arg1 = arg1;
+
+        if( PaUtil_WriteSpscRingBuffer( &ring->records, &record, 1 ) == 0 )
+            ring->droppedCount = ring->droppedCount + 1;
+    }
+
+    PaUtil_WriteMemoryBarrier();
+    ring->writing = 0;
+#else
+    (void)eventId;
+    (void)arg0;
+    (void)arg1;
+#endif
+}
+
+
+void PaUtil_ReleaseTraceThread( void )
+{
+#if PA_TRACE_SUPPORTED_
+    PaUtilTraceRing *ring = threadRing_;
+
+    if( ring != NULL && threadSession_ == traceSession_ && traceEnabled_ )
+    {
+        PaUtil_WriteMemoryBarrier();
+        ring->state = PA_TRACE_RING_RELEASED_;
+    }
+
+    threadRing_ = NULL;
+#endif
+}
+
+
+/* Write whatever the rings hold to the file. Drain thread only, or
+    PaUtil_StopTrace() once the drain thread has exited. */
+static void DrainRings( void )
+{
+    int i;
+
+    for( i=0; i < PA_TRACE_MAX_THREADS; ++i )
+    {
+        PaUtilTraceRing *ring = &traceRings_[i];
+        PaUtilTraceBlockHeader header;
+        PaUint32 state = ring->state, droppedCount;
+        void *data1, *data2;
+        ring_buffer_size_t size1, size2, available;
+
+        if( state == PA_TRACE_RING_FREE_ )
+            continue;
+
+        /* when the owner has released the ring, everything it wrote is
+            visible after this barrier */
+        PaUtil_ReadMemoryBarrier();
+
+        droppedCount = ring->droppedCount;
+        available = PaUtil_GetSpscRingBufferReadRegions( &ring->records, PA_TRACE_RING_RECORDS,
+                &data1, &size1, &data2, &size2 );
+
+        if( available > 0 || droppedCount != ring->reportedDroppedCount )
+        {
+            header.threadId = ring->threadId;
+            header.recordCount = (PaUint32)available;
+            header.droppedCount = droppedCount - ring->reportedDroppedCount;
+
+            fwrite( &header, sizeof(header), 1, traceFile_ );
+            if( size1 > 0 )
+                fwrite( data1, sizeof(PaUtilTraceRecord), size1, traceFile_ );
+            if( size2 > 0 )
+                fwrite( data2, sizeof(PaUtilTraceRecord), size2, traceFile_ );
+
+            PaUtil_AdvanceSpscRingBufferReadIndex( &ring->records, available );
+            ring->reportedDroppedCount = droppedCount;
+        }
+
+        if( state == PA_TRACE_RING_RELEASED_ )
+        {
+            /* the owner is gone so the ring is now empty; recycle it */
+            PaUtil_FlushSpscRingBuffer( &ring->records );
+            ring->droppedCount = 0;
+            ring->reportedDroppedCount = 0;
+            PaUtil_WriteMemoryBarrier();
+            ring->state = PA_TRACE_RING_FREE_;
+        }
+    }
+
+    fflush( traceFile_ );
+}
+
+
+#if defined(_WIN32)
+static DWORD WINAPI DrainThreadFunc( LPVOID parameter )
+#else
+static void *DrainThreadFunc( void *parameter )
+#endif
+{
+    (void)parameter;
+
+    while( !drainStopRequested_ )
+    {
+        Pa_Sleep( PA_TRACE_DRAIN_INTERVAL_MSEC );
+        DrainRings();
+    }
+
+    return 0;
+}
+
+
+PaError PaUtil_StartTrace( const char *fileName )
+{
+#if PA_TRACE_SUPPORTED_
+    PaUtilTraceFileHeader header;
+    int i;
+
+    if( traceEnabled_ )
+        return paInternalError;
+
+    traceRecords_ = (PaUtilTraceRecord*)PaUtil_AllocateMemory(
+            PA_TRACE_MAX_THREADS * PA_TRACE_RING_RECORDS * sizeof(PaUtilTraceRecord) );
+    if( !traceRecords_ )
+        return paInsufficientMemory;
+
+    traceFile_ = fopen( fileName, "wb" );
+    if( !traceFile_ )
+    {
+        PA_DEBUG(( "PaUtil_StartTrace: could not open %s\n", fileName ));
+        PaUtil_FreeMemory( traceRecords_ );
+        traceRecords_ = NULL;
+        return paInternalError;
+    }
+
+    memset( &header, 0, sizeof(header) );
+    strcpy( header.magic, PA_TRACE_FILE_MAGIC );
+    header.version = PA_TRACE_FILE_VERSION;
+    header.byteOrderMark = PA_TRACE_BYTE_ORDER_MARK;
+    header.recordSize = sizeof(PaUtilTraceRecord);
+    fwrite( &header, sizeof(header), 1, traceFile_ );
+
+    for( i=0; i < PA_TRACE_MAX_THREADS; ++i )
+    {
+        PaUtilTraceRing *ring = &traceRings_[i];
+
+        PaUtil_InitializeSpscRingBuffer( &ring->records, sizeof(PaUtilTraceRecord),
+                PA_TRACE_RING_RECORDS, &traceRecords_[ i * PA_TRACE_RING_RECORDS ] );
+        ring->state = PA_TRACE_RING_FREE_;
+        ring->writing = 0;
+        ring->droppedCount = 0;
+        ring->reportedDroppedCount = 0;
+    }
+
+    nextThreadId_ = 1;
+    traceStartTime_ = PaUtil_GetTime();
+    traceSession_ = traceSession_ + 1;
+    drainStopRequested_ = 0;
+
+#if defined(_WIN32)
+    drainThread_ = CreateThread( NULL, 0, DrainThreadFunc, NULL, 0, NULL );
+    if( drainThread_ == NULL )
+#else
+    if( pthread_create( &drainThread_, NULL, DrainThreadFunc, NULL ) != 0 )
+#endif
+    {
+        fclose( traceFile_ );
+        traceFile_ = NULL;
+        PaUtil_FreeMemory( traceRecords_ );
+        traceRecords_ = NULL;
+        return paInternalError;
+    }
+
+    PaUtil_WriteMemoryBarrier();
+    traceEnabled_ = 1;
+
+    return paNoError;
+#else
+    (void)fileName;
+    return paInternalError;
+#endif
+}
+
+
+void PaUtil_StopTrace( void )
+{
+    int i;
+
+    if( !traceEnabled_ )
+        return;
+
+    traceEnabled_ = 0;
+    PaUtil_FullMemoryBarrier();
+
+    for( i=0; i < PA_TRACE_MAX_THREADS; ++i )
+    {
+        while( traceRings_[i].writing )
+            Pa_Sleep( 1 );
+    }
+
+    drainStopRequested_ = 1;
+#if defined(_WIN32)
+    WaitForSingleObject( drainThread_, INFINITE );
+    CloseHandle( drainThread_ );
+    drainThread_ = NULL;
+#else
+    pthread_join( drainThread_, NULL );
+#endif
+
+    DrainRings();
+
+    for( i=0; i < PA_TRACE_MAX_THREADS; ++i )
+        traceRings_[i].state = PA_TRACE_RING_FREE_;
+
+    fclose( traceFile_ );
+    traceFile_ = NULL;
+    PaUtil_FreeMemory( traceRecords_ );
+    traceRecords_ = NULL;
+}
+
+
+void PaUtil_InitializeTrace( void )
+{
+    const char *fileName = getenv( "PA_TRACE_FILE" );
+
+    if( fileName && *fileName && PaUtil_StartTrace( fileName ) != paNoError )
+    {
+        PA_DEBUG(( "PaUtil_InitializeTrace: tracing to %s failed\n", fileName ));
+    }
+}
@@ -0,0 +1,189 @@
+#ifndef PA_TRACERING_H
+#define PA_TRACERING_H
+/*
+ * $Id$
+ * Portable Audio I/O Library
+ * Binary event trace for real-time threads.
+ *
+ * Based on the Open Source API proposed by Ross Bencina
+ * Copyright (c) 1999-2002 Phil Burk, Ross Bencina
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * The text above constitutes the entire PortAudio license; however,
+ * the PortAudio community also makes the following non-binding requests:
+ *
+ * Any person wishing to distribute modifications to the Software is
+ * requested to send the modifications to the original developer so that
+ * they can be incorporated into the canonical version. It is also
+ * requested that these non-binding requests be included along with the
+ * license above.
+ */
+
+/** @file
+ @ingroup common_src
+
+ @brief Binary event trace, cheap enough to leave enabled on real-time
+ threads.
+
+ Each thread which records an event is given its own ring of fixed size
+ PaUtilTraceRecord entries the first time it does so. PaUtil_TraceEvent()
+ is wait-free: it never blocks, never retries, never allocates and never
+ formats text. When a thread's ring is full the event is dropped and
+ counted.
+
+ Besides reading the clock, each event costs one full memory barrier, which
+ lets PaUtil_StopTrace() free the record storage without a lock; on current
+ x86 and ARM cores that is some tens of cycles.
+
+ A drain thread started by PaUtil_StartTrace() empties the rings into a
+ compact binary file every PA_TRACE_DRAIN_INTERVAL_MSEC. The file is
+ decoded offline by test/pa_trace_decode.c, which emits Chrome trace JSON
+ (chrome://tracing, Perfetto).
+
+ PortAudio itself records callback boundaries (PaUtil_BeginCpuLoadMeasurement
+ and PaUtil_EndCpuLoadMeasurement), xruns (PaUtil_BeginBufferProcessing) and,
+ where the host API polls, poll wakeups. Setting the PA_TRACE_FILE
+ environment variable starts a trace in Pa_Initialize(); the trace is
+ stopped by Pa_Terminate().
+
+ File layout, in host byte order:
+
+ - PaUtilTraceFileHeader
+ - any number of blocks, each a PaUtilTraceBlockHeader followed by
+   recordCount PaUtilTraceRecord entries from one thread
+
+ @see pa_trace.h for the older text based trace facility.
+*/
+
+
+#include "portaudio.h"
+#include "pa_types.h"
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+
+#ifndef PA_TRACE_MAX_THREADS
+#define PA_TRACE_MAX_THREADS            (16)   /**< Maximum number of threads tracing at once */
+#endif
+
+#ifndef PA_TRACE_RING_RECORDS
+#define PA_TRACE_RING_RECORDS           (4096) /**< Records buffered per thread between drains */
+#endif
+
+#ifndef PA_TRACE_DRAIN_INTERVAL_MSEC
+#define PA_TRACE_DRAIN_INTERVAL_MSEC    (20)
+#endif
+
+
+/** Event identifiers recorded by PortAudio. Values from paUtilTraceUser
+ upwards are free for client code.
+*/
+typedef enum PaUtilTraceEventId
+{
+    paUtilTraceCallbackBegin = 1,   /**< no arguments */
+    paUtilTraceCallbackEnd = 2,     /**< arg0: frames processed */
+    paUtilTraceXrun = 3,            /**< arg0: PaStreamCallbackFlags */
+    paUtilTracePollWakeup = 4,      /**< arg0: poll() result, arg1: poll timeout in msec */
+
+    paUtilTraceUser = 0x1000
+} PaUtilTraceEventId;
+
+
+/** A trace record. Timestamps are in nanoseconds since PaUtil_StartTrace(). */
+typedef struct PaUtilTraceRecord
+{
+    PaUint32 timeLow;
+    PaUint32 timeHigh;
+    PaUint32 eventId;
+    PaInt32 arg0;
+    PaInt32 arg1;
+} PaUtilTraceRecord;
+
+
+#define PA_TRACE_FILE_MAGIC     "PATRACE"
+#define PA_TRACE_FILE_VERSION   (1)
+#define PA_TRACE_BYTE_ORDER_MARK (0x01020304)
+
+typedef struct PaUtilTraceFileHeader
+{
+    char magic[8];              /**< PA_TRACE_FILE_MAGIC, NUL terminated */
+    PaUint32 version;           /**< PA_TRACE_FILE_VERSION */
+    PaUint32 byteOrderMark;     /**< PA_TRACE_BYTE_ORDER_MARK as written by the tracing host */
+    PaUint32 recordSize;        /**< sizeof(PaUtilTraceRecord) */
+    PaUint32 reserved;
+} PaUtilTraceFileHeader;
+
+typedef struct PaUtilTraceBlockHeader
+{
+    PaUint32 threadId;          /**< unique per traced thread within a file, starting at 1 */
+    PaUint32 recordCount;
+    PaUint32 droppedCount;      /**< events lost to a full ring since the previous block of this thread */
+} PaUtilTraceBlockHeader;
+
+
+/** Start tracing to a file. Not real-time safe.
+
+ @param fileName The file to write. It is created or truncated.
+
+ @return paNoError on success, paInsufficientMemory if the rings could not
+ be allocated, or paInternalError if a trace is already running, if the file
+ or the drain thread could not be created, or if the platform lacks the
+ thread local storage and atomic operations the trace needs.
+*/
+PaError PaUtil_StartTrace( const char *fileName );
+
+
+/** Stop tracing: waits for threads inside PaUtil_TraceEvent(), drains every
+ ring and closes the file. Does nothing if no trace is running. Not real-time
+ safe.
+*/
+void PaUtil_StopTrace( void );
+
+
+/** Record an event from the calling thread. Wait-free; returns immediately
+ when no trace is running.
+*/
+void PaUtil_TraceEvent( PaUint32 eventId, PaInt32 arg0, PaInt32 arg1 );
+
+
+/** Hand the calling thread's ring back for reuse by other threads once it
+ has been drained. Call before a thread which may have traced exits. Threads
+ which exit without calling it keep their ring until the trace stops.
+*/
+void PaUtil_ReleaseTraceThread( void );
+
+
+/** Start a trace if the PA_TRACE_FILE environment variable names a file.
+ Called by Pa_Initialize().
+*/
+void PaUtil_InitializeTrace( void );
+
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+#endif /* PA_TRACERING_H */
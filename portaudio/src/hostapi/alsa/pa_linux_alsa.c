@@ -61,6 +61,10 @@
 #include <signal.h>
 #include <time.h>
 #include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
 #include <signal.h> /* For sig_atomic_t */
 #ifdef PA_ALSA_DYNAMIC
     #include <dlfcn.h> /* For dlXXX functions */
@@ -76,6 +80,7 @@
 #include "pa_process.h"
 #include "pa_endianness.h"
 #include "pa_debugprint.h"
+#include "pa_tracering.h"
 
 #include "pa_linux_alsa.h"
 
@@ -204,6 +209,10 @@ _PA_DEFINE_FUNC(snd_ctl_card_info_free);
 _PA_DEFINE_FUNC(snd_ctl_card_info);
 _PA_DEFINE_FUNC(snd_ctl_card_info_sizeof);
 _PA_DEFINE_FUNC(snd_ctl_card_info_get_name);
+_PA_DEFINE_FUNC(snd_ctl_card_info_get_id);
+_PA_DEFINE_FUNC(snd_ctl_card_info_get_driver);
+_PA_DEFINE_FUNC(snd_ctl_card_info_get_longname);
+_PA_DEFINE_FUNC(snd_ctl_card_info_get_components);
 #define alsa_snd_ctl_card_info_alloca(ptr) __alsa_snd_alloca(ptr, snd_ctl_card_info)
 
 _PA_DEFINE_FUNC(snd_config);
@@ -484,6 +493,10 @@ static int PaAlsa_LoadLibrary()
     _PA_LOAD_FUNC(snd_ctl_card_info);
     _PA_LOAD_FUNC(snd_ctl_card_info_sizeof);
     _PA_LOAD_FUNC(snd_ctl_card_info_get_name);
+    _PA_LOAD_FUNC(snd_ctl_card_info_get_id);
+    _PA_LOAD_FUNC(snd_ctl_card_info_get_driver);
+    _PA_LOAD_FUNC(snd_ctl_card_info_get_longname);
+    _PA_LOAD_FUNC(snd_ctl_card_info_get_components);
 
     _PA_LOAD_FUNC(snd_config);
     _PA_LOAD_FUNC(snd_config_update);
@@ -672,6 +685,9 @@ typedef struct PaAlsaHostApiRepresentation
 
     PaHostApiIndex hostApiIndex;
     PaUint32 alsaLibVersion; /* Retrieved from the library at run-time */
+    int openBlocking;        /* mode BuildDeviceList() opened PCMs in */
+    int deferProbe;          /* paInitializeDeferProbe was given */
+    PaUnixMutex probeMtx;    /* serializes ProbeDeferredDevice() between callers of Pa_GetDeviceInfo() */
 }
 PaAlsaHostApiRepresentation;
 
@@ -682,6 +698,7 @@ typedef struct PaAlsaDeviceInfo
     int isPlug;
     int minInputChannels;
     int minOutputChannels;
+    int probePending;   /* only the channel range is known yet, see ProbeDeferredDevice */
 }
 PaAlsaDeviceInfo;
 
@@ -710,6 +727,7 @@ static PaError IsStreamActive( PaStream *stream );
 static PaTime GetStreamTime( PaStream *stream );
 static double GetStreamCpuLoad( PaStream* stream );
 static PaError BuildDeviceList( PaAlsaHostApiRepresentation *hostApi );
+static void ProbeDeferredDevice( struct PaUtilHostApiRepresentation *hostApi, int device );
 static int SetApproximateSampleRate( snd_pcm_t *pcm, snd_pcm_hw_params_t *hwParams, double sampleRate );
 static int GetExactSampleRate( snd_pcm_hw_params_t *hwParams, double *sampleRate );
 static PaUint32 PaAlsaVersionNum(void);
@@ -740,6 +758,7 @@ PaError PaAlsa_Initialize( PaUtilHostApiRepresentation **hostApi, PaHostApiIndex
 {
     PaError result = paNoError;
     PaAlsaHostApiRepresentation *alsaHostApi = NULL;
+    int probeMtxInitialized = 0;
 
     /* Try loading Alsa library. */
     if (!PaAlsa_LoadLibrary())
@@ -750,6 +769,9 @@ PaError PaAlsa_Initialize( PaUtilHostApiRepresentation **hostApi, PaHostApiIndex
     PA_UNLESS( alsaHostApi->allocations = PaUtil_CreateAllocationGroup(), paInsufficientMemory );
     alsaHostApi->hostApiIndex = hostApiIndex;
     alsaHostApi->alsaLibVersion = PaAlsaVersionNum();
+    alsaHostApi->deferProbe = (PaUtil_GetInitializeFlags() & paInitializeDeferProbe) != 0;
+    PA_ENSURE( PaUnixMutex_Initialize( &alsaHostApi->probeMtx ) );
+    probeMtxInitialized = 1;
 
     *hostApi = (PaUtilHostApiRepresentation*)alsaHostApi;
     (*hostApi)->info.structVersion = 1;
@@ -767,6 +789,15 @@ PaError PaAlsa_Initialize( PaUtilHostApiRepresentation **hostApi, PaHostApiIndex
 
     PA_ENSURE( BuildDeviceList( alsaHostApi ) );
 
+    if( alsaHostApi->deferProbe &&
+        PaUtil_SetDeviceProbeFunction( *hostApi, ProbeDeferredDevice ) != paNoError )
+    {
+        /* nobody would finish the probes, so do it now */
+        int i;
+        for( i = 0; i < (*hostApi)->info.deviceCount; ++i )
+            ProbeDeferredDevice( *hostApi, i );
+    }
+
     PaUtil_InitializeStreamInterface( &alsaHostApi->callbackStreamInterface,
                                       CloseStream, StartStream,
                                       StopStream, AbortStream,
@@ -797,6 +828,8 @@ error:
             PaUtil_FreeAllAllocations( alsaHostApi->allocations );
             PaUtil_DestroyAllocationGroup( alsaHostApi->allocations );
         }
+        if( probeMtxInitialized )
+            PaUnixMutex_Terminate( &alsaHostApi->probeMtx );
 
         PaUtil_FreeMemory( alsaHostApi );
     }
@@ -819,6 +852,7 @@ static void Terminate( struct PaUtilHostApiRepresentation *hostApi )
         PaUtil_FreeAllAllocations( alsaHostApi->allocations );
         PaUtil_DestroyAllocationGroup( alsaHostApi->allocations );
     }
+    PaUnixMutex_Terminate( &alsaHostApi->probeMtx );
 
     PaUtil_FreeMemory( alsaHostApi );
     alsa_snd_config_update_free_global();
@@ -946,6 +980,44 @@ error:
     goto end;
 }
 
+/* The cheap part of GropeDevice(): only the channel range, which is all that is needed to list the device. Used
+ * with paInitializeDeferProbe; ProbeDeferredDevice() fills in the rest. */
+static PaError GropeChannels( snd_pcm_t* pcm, int isPlug, StreamDirection mode, PaAlsaDeviceInfo* devInfo )
+{
+    PaError result = paNoError;
+    snd_pcm_hw_params_t *hwParams;
+    unsigned int minChans, maxChans;
+
+    assert( pcm );
+
+    alsa_snd_pcm_hw_params_alloca( &hwParams );
+    ENSURE_( alsa_snd_pcm_hw_params_any( pcm, hwParams ), paUnanticipatedHostError );
+    ENSURE_( alsa_snd_pcm_hw_params_get_channels_min( hwParams, &minChans ), paUnanticipatedHostError );
+    ENSURE_( alsa_snd_pcm_hw_params_get_channels_max( hwParams, &maxChans ), paUnanticipatedHostError );
+    assert( maxChans <= INT_MAX );
+
+    if( isPlug && maxChans > 128 )
+        maxChans = 128;
+
+    if( StreamDirection_In == mode )
+    {
+        devInfo->minInputChannels = (int)minChans;
+        devInfo->baseDeviceInfo.maxInputChannels = (int)maxChans;
+    }
+    else
+    {
+        devInfo->minOutputChannels = (int)minChans;
+        devInfo->baseDeviceInfo.maxOutputChannels = (int)maxChans;
+    }
+
+end:
+    alsa_snd_pcm_close( pcm );
+    return result;
+
+error:
+    goto end;
+}
+
 /* Initialize device info with invalid values (maxInputChannels and maxOutputChannels are set to zero since these indicate
  * whether input/output is available) */
 static void InitializeDeviceInfo( PaDeviceInfo *deviceInfo )
@@ -988,9 +1060,285 @@ typedef struct
     int isPlug;
     int hasPlayback;
     int hasCapture;
+    uint64_t cacheKey;  /* identifies a hardware PCM across runs, 0 for plugins */
 } HwDevInfo;
 
 
+/* Device capability cache
+ *
+ * Probing a PCM means opening it, which is slow and fails while another process holds the device. If PA_ALSA_CACHE
+ * is set (to a file name, or to 1 for $XDG_CACHE_HOME/portaudio/alsa-devices) what the probe finds for hardware PCMs
+ * is kept on disk. The file is mapped read-only and only trusted while /proc/asound/cards and /proc/asound/pcm read
+ * the same as when it was written. Each entry is also keyed by its card's id, driver, components and long name, so a
+ * different card at the same index is probed afresh. Plugin PCMs depend on configuration, not hardware, and are
+ * always probed.
+ */
+
+#define PA_ALSA_CACHE_MAGIC     0x43416150  /* "PaAC" */
+#define PA_ALSA_CACHE_VERSION   1
+
+typedef struct
+{
+    PaUint32 magic;
+    PaUint32 version;
+    uint64_t procHash;
+    PaUint32 count;
+    PaUint32 entrySize;
+}
+PaAlsaCacheHeader;
+
+typedef struct
+{
+    uint64_t key;
+    double defaultSampleRate;
+    double defaultLowInputLatency;
+    double defaultHighInputLatency;
+    double defaultLowOutputLatency;
+    double defaultHighOutputLatency;
+    int32_t minInputChannels;
+    int32_t maxInputChannels;
+    int32_t minOutputChannels;
+    int32_t maxOutputChannels;
+}
+PaAlsaCacheEntry;
+
+typedef struct
+{
+    char *path;                         /* NULL when the cache is off */
+    uint64_t procHash;
+    void *mapped;                       /* the file, if it was valid */
+    size_t mappedSize;
+    const PaAlsaCacheEntry *entries;    /* in mapped */
+    size_t count;
+    PaAlsaCacheEntry *found;            /* this run's results, to write back */
+    size_t foundCount, foundCapacity;
+    int dirty;
+}
+PaAlsaCache;
+
+/* FNV-1a */
+static uint64_t PaAlsa_Hash( const void *data, size_t size, uint64_t h )
+{
+    const unsigned char *p = (const unsigned char *)data;
+    size_t i;
+
+    for( i = 0; i < size; ++i )
+    {
+        h ^= p[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static uint64_t PaAlsa_HashString( const char *s, uint64_t h )
+{
+    /* include the terminator so that "ab","c" and "a","bc" differ */
+    return s ? PaAlsa_Hash( s, strlen( s ) + 1, h ) : PaAlsa_Hash( "", 1, h );
+}
+
+static int PaAlsa_HashFile( const char *path, uint64_t *h )
+{
+    char buf[4096];
+    size_t n;
+    FILE *f = fopen( path, "r" );
+
+    if( !f )
+        return 0;
+    while( (n = fread( buf, 1, sizeof (buf), f )) > 0 )
+        *h = PaAlsa_Hash( buf, n, *h );
+    fclose( f );
+    return 1;
+}
+
+static void PaAlsaCache_Open( PaAlsaCache *cache, PaAlsaHostApiRepresentation *alsaApi )
+{
+    const char *env = getenv( "PA_ALSA_CACHE" );
+    const PaAlsaCacheHeader *header;
+    struct stat st;
+    void *map;
+    int fd;
+
+    memset( cache, 0, sizeof (*cache) );
+    if( !env || !*env || !strcmp( env, "0" ) )
+        return;
+
+    cache->procHash = PaAlsa_Hash( &alsaApi->alsaLibVersion, sizeof (alsaApi->alsaLibVersion), 0xcbf29ce484222325ULL );
+    if( !PaAlsa_HashFile( "/proc/asound/cards", &cache->procHash ) ||
+        !PaAlsa_HashFile( "/proc/asound/pcm", &cache->procHash ) )
+    {
+        PA_DEBUG(( "%s: /proc/asound is unreadable, not caching\n", __FUNCTION__ ));
+        return;
+    }
+
+    if( strcmp( env, "1" ) )
+    {
+        if( (cache->path = (char *)PaUtil_AllocateMemory( strlen( env ) + 1 )) )
+            strcpy( cache->path, env );
+    }
+    else
+    {
+        const char *dir = getenv( "XDG_CACHE_HOME" ), *sub = "/portaudio/alsa-devices";
+        const char *home = getenv( "HOME" );
+        size_t len;
+
+        if( !dir || !*dir )
+        {
+            if( !home || !*home )
+                return;
+            dir = home;
+            sub = "/.cache/portaudio/alsa-devices";
+        }
+        len = strlen( dir ) + strlen( sub ) + 1;
+        if( (cache->path = (char *)PaUtil_AllocateMemory( len )) )
+            snprintf( cache->path, len, "%s%s", dir, sub );
+    }
+    if( !cache->path )
+        return;
+    cache->dirty = 1;   /* until a valid file shows otherwise */
+
+    if( (fd = open( cache->path, O_RDONLY | O_CLOEXEC )) < 0 )
+        return;
+    if( fstat( fd, &st ) == 0 && (size_t)st.st_size >= sizeof (PaAlsaCacheHeader) &&
+        (map = mmap( NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 )) != MAP_FAILED )
+    {
+        header = (const PaAlsaCacheHeader *)map;
+        if( header->magic == PA_ALSA_CACHE_MAGIC && header->version == PA_ALSA_CACHE_VERSION &&
+            header->entrySize == sizeof (PaAlsaCacheEntry) && header->procHash == cache->procHash &&
+            (size_t)st.st_size == sizeof (PaAlsaCacheHeader) + (size_t)header->count * sizeof (PaAlsaCacheEntry) )
+        {
+            cache->mapped = map;
+            cache->mappedSize = (size_t)st.st_size;
+            cache->entries = (const PaAlsaCacheEntry *)(header + 1);
+            cache->count = header->count;
+            cache->dirty = 0;
+            PA_DEBUG(( "%s: %s holds %u devices\n", __FUNCTION__, cache->path, (unsigned)header->count ));
+        }
+        else
+        {
+            PA_DEBUG(( "%s: %s is stale, probing\n", __FUNCTION__, cache->path ));
+            munmap( map, (size_t)st.st_size );
+        }
+    }
+    close( fd );
+}
+
+static const PaAlsaCacheEntry *PaAlsaCache_Find( const PaAlsaCache *cache, uint64_t key )
+{
+    size_t i;
+
+    if( !key )
+        return NULL;
+    for( i = 0; i < cache->count; ++i )
+    {
+        if( cache->entries[i].key == key )
+            return &cache->entries[i];
+    }
+    return NULL;
+}
+
+static void PaAlsaCache_Apply( const PaAlsaCacheEntry *entry, PaAlsaDeviceInfo *devInfo )
+{
+    PaDeviceInfo *base = &devInfo->baseDeviceInfo;
+
+    base->defaultSampleRate = entry->defaultSampleRate;
+    base->defaultLowInputLatency = entry->defaultLowInputLatency;
+    base->defaultHighInputLatency = entry->defaultHighInputLatency;
+    base->defaultLowOutputLatency = entry->defaultLowOutputLatency;
+    base->defaultHighOutputLatency = entry->defaultHighOutputLatency;
+    devInfo->minInputChannels = entry->minInputChannels;
+    base->maxInputChannels = entry->maxInputChannels;
+    devInfo->minOutputChannels = entry->minOutputChannels;
+    base->maxOutputChannels = entry->maxOutputChannels;
+}
+
+/* Remember a device for the file that PaAlsaCache_Close() writes */
+static void PaAlsaCache_Record( PaAlsaCache *cache, uint64_t key, const PaAlsaDeviceInfo *devInfo,
+        const PaAlsaCacheEntry *previous )
+{
+    const PaDeviceInfo *base = &devInfo->baseDeviceInfo;
+    PaAlsaCacheEntry *entry;
+
+    if( !cache->path || !key )
+        return;
+    if( cache->foundCount == cache->foundCapacity )
+    {
+        size_t capacity = cache->foundCapacity ? cache->foundCapacity * 2 : 16;
+        PaAlsaCacheEntry *grown = (PaAlsaCacheEntry *)PaUtil_AllocateMemory( capacity * sizeof (PaAlsaCacheEntry) );
+        if( !grown )
+            return;
+        if( cache->foundCount )
+            memcpy( grown, cache->found, cache->foundCount * sizeof (PaAlsaCacheEntry) );
+        PaUtil_FreeMemory( cache->found );
+        cache->found = grown;
+        cache->foundCapacity = capacity;
+    }
+    entry = &cache->found[cache->foundCount++];
+    memset( entry, 0, sizeof (*entry) );
+    entry->key = key;
+    entry->defaultSampleRate = base->defaultSampleRate;
+    entry->defaultLowInputLatency = base->defaultLowInputLatency;
+    entry->defaultHighInputLatency = base->defaultHighInputLatency;
+    entry->defaultLowOutputLatency = base->defaultLowOutputLatency;
+    entry->defaultHighOutputLatency = base->defaultHighOutputLatency;
+    entry->minInputChannels = devInfo->minInputChannels;
+    entry->maxInputChannels = base->maxInputChannels;
+    entry->minOutputChannels = devInfo->minOutputChannels;
+    entry->maxOutputChannels = base->maxOutputChannels;
+
+    if( !previous )
+        cache->dirty = 1;
+}
+
+/* Writes the file if anything changed (via a temporary and rename(), so a concurrent reader sees the old file or the
+ * new one), and releases the cache */
+static void PaAlsaCache_Close( PaAlsaCache *cache, int write )
+{
+    if( write && cache->path && (cache->dirty || cache->foundCount != cache->count) )
+    {
+        PaAlsaCacheHeader header;
+        size_t len = strlen( cache->path ) + 32;
+        char *tmp = (char *)PaUtil_AllocateMemory( len ), *slash;
+        FILE *f = NULL;
+        int ok = 0;
+
+        if( tmp )
+        {
+            /* create the directory, one level, as with the default $HOME/.cache/portaudio */
+            snprintf( tmp, len, "%s", cache->path );
+            if( (slash = strrchr( tmp, '/' )) && slash != tmp )
+            {
+                *slash = '\0';
+                mkdir( tmp, 0755 );
+            }
+            snprintf( tmp, len, "%s.%d.tmp", cache->path, (int)getpid() );
+            f = fopen( tmp, "wb" );
+        }
+        if( f )
+        {
+            header.magic = PA_ALSA_CACHE_MAGIC;
+            header.version = PA_ALSA_CACHE_VERSION;
+            header.procHash = cache->procHash;
+            header.count = (PaUint32)cache->foundCount;
+            header.entrySize = sizeof (PaAlsaCacheEntry);
+            ok = fwrite( &header, sizeof (header), 1, f ) == 1 &&
+                 fwrite( cache->found, sizeof (PaAlsaCacheEntry), cache->foundCount, f ) == cache->foundCount;
+            ok = (fclose( f ) == 0) && ok;
+            if( ok && rename( tmp, cache->path ) == 0 )
+                PA_DEBUG(( "%s: wrote %u devices to %s\n", __FUNCTION__, (unsigned)cache->foundCount, cache->path ));
+            else
+                remove( tmp );
+        }
+        PaUtil_FreeMemory( tmp );
+    }
+
+    if( cache->mapped )
+        munmap( cache->mapped, cache->mappedSize );
+    PaUtil_FreeMemory( cache->found );
+    PaUtil_FreeMemory( cache->path );
+    memset( cache, 0, sizeof (*cache) );
+}
+
+
 HwDevInfo predefinedNames[] = {
     { "center_lfe", NULL, 0, 1, 0 },
 /* { "default", NULL, 0, 1, 1 }, */
@@ -1152,26 +1500,42 @@ static int OpenPcm( snd_pcm_t **pcmp, const char *name, snd_pcm_stream_t stream,
 }
 
 static PaError FillInDevInfo( PaAlsaHostApiRepresentation *alsaApi, HwDevInfo* deviceHwInfo, int blocking,
-        PaAlsaDeviceInfo* devInfo, int* devIdx )
+        PaAlsaDeviceInfo* devInfo, int* devIdx, PaAlsaCache *cache )
 {
     PaError result = 0;
     PaDeviceInfo *baseDeviceInfo = &devInfo->baseDeviceInfo;
     snd_pcm_t *pcm = NULL;
     PaUtilHostApiRepresentation *baseApi = &alsaApi->baseHostApiRep;
+    const PaAlsaCacheEntry *cached = PaAlsaCache_Find( cache, deviceHwInfo->cacheKey );
 
     PA_DEBUG(( "%s: Filling device info for: %s\n", __FUNCTION__, deviceHwInfo->name ));
 
     /* Zero fields */
     InitializeDeviceInfo( baseDeviceInfo );
+    /* with the cache on, a miss is probed fully now so that it can be stored */
+    devInfo->probePending = alsaApi->deferProbe && !cache->path;
+    if( cached )
+    {
+        PA_DEBUG(( "%s: Using cached capabilities for: %s\n", __FUNCTION__, deviceHwInfo->name ));
+        PaAlsaCache_Apply( cached, devInfo );
+    }
 
     /* To determine device capabilities, we must open the device and query the
      * hardware parameter configuration space */
 
     /* Query capture */
-    if( deviceHwInfo->hasCapture &&
+    if( !cached && deviceHwInfo->hasCapture &&
         OpenPcm( &pcm, deviceHwInfo->alsaName, SND_PCM_STREAM_CAPTURE, blocking, 0 ) >= 0 )
     {
-        if( GropeDevice( pcm, deviceHwInfo->isPlug, StreamDirection_In, blocking, devInfo ) != paNoError )
+        if( devInfo->probePending )
+        {
+            if( GropeChannels( pcm, deviceHwInfo->isPlug, StreamDirection_In, devInfo ) != paNoError )
+            {
+                PA_DEBUG(( "%s: Failed groping %s for capture channels\n", __FUNCTION__, deviceHwInfo->alsaName ));
+                goto end;
+            }
+        }
+        else if( GropeDevice( pcm, deviceHwInfo->isPlug, StreamDirection_In, blocking, devInfo ) != paNoError )
         {
             /* Error */
             PA_DEBUG(( "%s: Failed groping %s for capture\n", __FUNCTION__, deviceHwInfo->alsaName ));
@@ -1180,10 +1544,18 @@ static PaError FillInDevInfo( PaAlsaHostApiRepresentation *alsaApi, HwDevInfo* d
     }
 
     /* Query playback */
-    if( deviceHwInfo->hasPlayback &&
+    if( !cached && deviceHwInfo->hasPlayback &&
         OpenPcm( &pcm, deviceHwInfo->alsaName, SND_PCM_STREAM_PLAYBACK, blocking, 0 ) >= 0 )
     {
-        if( GropeDevice( pcm, deviceHwInfo->isPlug, StreamDirection_Out, blocking, devInfo ) != paNoError )
+        if( devInfo->probePending )
+        {
+            if( GropeChannels( pcm, deviceHwInfo->isPlug, StreamDirection_Out, devInfo ) != paNoError )
+            {
+                PA_DEBUG(( "%s: Failed groping %s for playback channels\n", __FUNCTION__, deviceHwInfo->alsaName ));
+                goto end;
+            }
+        }
+        else if( GropeDevice( pcm, deviceHwInfo->isPlug, StreamDirection_Out, blocking, devInfo ) != paNoError )
         {
             /* Error */
             PA_DEBUG(( "%s: Failed groping %s for playback\n", __FUNCTION__, deviceHwInfo->alsaName ));
@@ -1218,6 +1590,12 @@ static PaError FillInDevInfo( PaAlsaHostApiRepresentation *alsaApi, HwDevInfo* d
         PA_DEBUG(( "%s: Adding device %s: %d\n", __FUNCTION__, deviceHwInfo->name, *devIdx ));
         baseApi->deviceInfos[*devIdx] = (PaDeviceInfo *) devInfo;
         (*devIdx) += 1;
+        /* Only cache what was fully probed: a direction that was busy or came back without channels is left out, so
+         * that the next Pa_Initialize() probes the device again instead of hiding that direction for good. */
+        if( !devInfo->probePending && ( cached ||
+                ( ( !deviceHwInfo->hasCapture || baseDeviceInfo->maxInputChannels > 0 ) &&
+                  ( !deviceHwInfo->hasPlayback || baseDeviceInfo->maxOutputChannels > 0 ) ) ) )
+            PaAlsaCache_Record( cache, deviceHwInfo->cacheKey, devInfo, cached );
     }
     else
     {
@@ -1245,12 +1623,16 @@ static PaError BuildDeviceList( PaAlsaHostApiRepresentation *alsaApi )
     int usePlughw = 0;
     char *hwPrefix = "";
     char alsaCardName[50];
+    PaAlsaCache cache;
 #ifdef PA_ENABLE_DEBUG_OUTPUT
     PaTime startTime = PaUtil_GetTime();
 #endif
 
+    PaAlsaCache_Open( &cache, alsaApi );
+
     if( getenv( "PA_ALSA_INITIALIZE_BLOCK" ) && atoi( getenv( "PA_ALSA_INITIALIZE_BLOCK" ) ) )
         blocking = 0;
+    alsaApi->openBlocking = blocking;
 
     /* If PA_ALSA_PLUGHW is 1 (non-zero), use the plughw: pcm throughout instead of hw: */
     if( getenv( "PA_ALSA_PLUGHW" ) && atoi( getenv( "PA_ALSA_PLUGHW" ) ) )
@@ -1281,6 +1663,7 @@ static PaError BuildDeviceList( PaAlsaHostApiRepresentation *alsaApi )
         int devIdx = -1;
         snd_ctl_t *ctl;
         char buf[50];
+        uint64_t cardHash;
 
         snprintf( alsaCardName, sizeof (alsaCardName), "hw:%d", cardIdx );
 
@@ -1295,6 +1678,12 @@ static PaError BuildDeviceList( PaAlsaHostApiRepresentation *alsaApi )
 
         PA_ENSURE( PaAlsa_StrDup( alsaApi, &cardName, alsa_snd_ctl_card_info_get_name( cardInfo )) );
 
+        /* what the capability cache knows this card by */
+        cardHash = PaAlsa_HashString( alsa_snd_ctl_card_info_get_id( cardInfo ), 0xcbf29ce484222325ULL );
+        cardHash = PaAlsa_HashString( alsa_snd_ctl_card_info_get_driver( cardInfo ), cardHash );
+        cardHash = PaAlsa_HashString( alsa_snd_ctl_card_info_get_components( cardInfo ), cardHash );
+        cardHash = PaAlsa_HashString( alsa_snd_ctl_card_info_get_longname( cardInfo ), cardHash );
+
         while( alsa_snd_ctl_pcm_next_device( ctl, &devIdx ) == 0 && devIdx >= 0 )
         {
             char *alsaDeviceName, *deviceName, *infoName;
@@ -1349,6 +1738,9 @@ static PaError BuildDeviceList( PaAlsaHostApiRepresentation *alsaApi )
             hwDevInfos[ numDeviceNames - 1 ].isPlug = usePlughw;
             hwDevInfos[ numDeviceNames - 1 ].hasPlayback = hasPlayback;
             hwDevInfos[ numDeviceNames - 1 ].hasCapture = hasCapture;
+            hwDevInfos[ numDeviceNames - 1 ].cacheKey =
+                PaAlsa_Hash( &hasCapture, sizeof (hasCapture),
+                PaAlsa_Hash( &hasPlayback, sizeof (hasPlayback), PaAlsa_HashString( buf, cardHash ) ) ) | 1;
         }
         alsa_snd_ctl_close( ctl );
     }
@@ -1413,6 +1805,7 @@ static PaError BuildDeviceList( PaAlsaHostApiRepresentation *alsaApi )
             hwDevInfos[numDeviceNames - 1].alsaName = alsaDeviceName;
             hwDevInfos[numDeviceNames - 1].name     = deviceName;
             hwDevInfos[numDeviceNames - 1].isPlug   = 1;
+            hwDevInfos[numDeviceNames - 1].cacheKey = 0;
 
             if( predefined )
             {
@@ -1455,7 +1848,7 @@ static PaError BuildDeviceList( PaAlsaHostApiRepresentation *alsaApi )
             continue;
         }
 
-        PA_ENSURE( FillInDevInfo( alsaApi, hwInfo, blocking, devInfo, &devIdx ) );
+        PA_ENSURE( FillInDevInfo( alsaApi, hwInfo, blocking, devInfo, &devIdx, &cache ) );
     }
     assert( devIdx <= numDeviceNames );
     /* Now inspect 'dmix' and 'default' plugins */
@@ -1468,7 +1861,7 @@ static PaError BuildDeviceList( PaAlsaHostApiRepresentation *alsaApi )
             continue;
         }
 
-        PA_ENSURE( FillInDevInfo( alsaApi, hwInfo, blocking, devInfo, &devIdx ) );
+        PA_ENSURE( FillInDevInfo( alsaApi, hwInfo, blocking, devInfo, &devIdx, &cache ) );
     }
     free( hwDevInfos );
 
@@ -1479,6 +1872,7 @@ static PaError BuildDeviceList( PaAlsaHostApiRepresentation *alsaApi )
 #endif
 
 end:
+    PaAlsaCache_Close( &cache, result == paNoError );
     return result;
 
 error:
@@ -1486,6 +1880,43 @@ error:
     goto end;
 }
 
+/* Finish the probe FillInDevInfo() deferred: default sample rate and latencies. Called by pa_front whenever the
+ * device's info is requested. A device that fails now keeps its channel range and -1 for the rest.
+ *
+ * Pa_GetDeviceInfo() may be called from several threads at once, so the whole probe runs under probeMtx: a second
+ * caller waits for the first to finish filling in devInfo instead of opening the PCM again or returning half-written
+ * fields. probePending is only cleared once devInfo is complete. */
+static void ProbeDeferredDevice( struct PaUtilHostApiRepresentation *hostApi, int device )
+{
+    PaAlsaHostApiRepresentation *alsaApi = (PaAlsaHostApiRepresentation*)hostApi;
+    PaAlsaDeviceInfo *devInfo = (PaAlsaDeviceInfo*)hostApi->deviceInfos[device];
+    snd_pcm_t *pcm = NULL;
+
+    ASSERT_CALL_( PaUnixMutex_Lock( &alsaApi->probeMtx ), paNoError );
+    if( !devInfo->probePending )
+    {
+        ASSERT_CALL_( PaUnixMutex_Unlock( &alsaApi->probeMtx ), paNoError );
+        return;
+    }
+
+    if( devInfo->baseDeviceInfo.maxInputChannels > 0 &&
+        OpenPcm( &pcm, devInfo->alsaName, SND_PCM_STREAM_CAPTURE, alsaApi->openBlocking, 0 ) >= 0 )
+    {
+        if( GropeDevice( pcm, devInfo->isPlug, StreamDirection_In, alsaApi->openBlocking, devInfo ) != paNoError )
+            PA_DEBUG(( "%s: Failed groping %s for capture\n", __FUNCTION__, devInfo->alsaName ));
+    }
+
+    if( devInfo->baseDeviceInfo.maxOutputChannels > 0 &&
+        OpenPcm( &pcm, devInfo->alsaName, SND_PCM_STREAM_PLAYBACK, alsaApi->openBlocking, 0 ) >= 0 )
+    {
+        if( GropeDevice( pcm, devInfo->isPlug, StreamDirection_Out, alsaApi->openBlocking, devInfo ) != paNoError )
+            PA_DEBUG(( "%s: Failed groping %s for playback\n", __FUNCTION__, devInfo->alsaName ));
+    }
+
+    devInfo->probePending = 0;
+    ASSERT_CALL_( PaUnixMutex_Unlock( &alsaApi->probeMtx ), paNoError );
+}
+
 /* Check against known device capabilities */
 static PaError ValidateParameters( const PaStreamParameters *parameters, PaUtilHostApiRepresentation *hostApi, StreamDirection mode )
 {
@@ -2852,6 +3283,8 @@ static PaError OpenStream( struct PaUtilHostApiRepresentation *hostApi,
                     numOutputChannels, outputSampleFormat, hostOutputSampleFormat,
                     sampleRate, streamFlags, framesPerBuffer, stream->maxFramesPerHostBuffer,
                     hostBufferSizeMode, callback, userData ) );
+    PaUtil_AttachCallbackProfile( &stream->bufferProcessor, &stream->cpuLoadMeasurer,
+            &stream->streamRepresentation.profile );
 
     /* Ok, buffer processor is initialized, now we can deduce it's latency */
     if( numInputChannels > 0 )
@@ -3404,6 +3837,8 @@ static void OnExit( void *data )
         stream->streamRepresentation.streamFinishedCallback( stream->streamRepresentation.userData );
     }
     stream->isActive = 0;
+
+    PaUtil_ReleaseTraceThread();
 }
 
 static void CalculateTimeInfo( PaAlsaStream *stream, PaStreamCallbackTimeInfo *timeInfo )
@@ -3842,6 +4277,8 @@ static PaError PaAlsaStream_WaitForFrames( PaAlsaStream *self, unsigned long *fr
         }
 #endif
 
+        PaUtil_TraceEvent( paUtilTracePollWakeup, pollResults, pollTimeout );
+
         if( pollResults < 0 )
         {
             /*  XXX: Depend on preprocessor condition? */
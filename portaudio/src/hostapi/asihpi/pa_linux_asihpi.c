@@ -1804,6 +1804,8 @@ static PaError OpenStream( struct PaUtilHostApiRepresentation *hostApi,
                 sampleRate, streamFlags,
                 framesPerBuffer, framesPerHostBuffer, paUtilFixedHostBufferSize,
                 streamCallback, userData ) );
+    PaUtil_AttachCallbackProfile( &stream->bufferProcessor, &stream->cpuLoadMeasurer,
+            &stream->baseStreamRep.profile );
 
     stream->baseStreamRep.streamInfo.structVersion = 1;
     stream->baseStreamRep.streamInfo.sampleRate = sampleRate;
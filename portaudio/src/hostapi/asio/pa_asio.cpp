@@ -2720,6 +2720,8 @@ static PaError OpenStream( struct PaUtilHostApiRepresentation *hostApi,
             goto error;
         }
         callbackBufferProcessorInited = TRUE;
+        PaUtil_AttachCallbackProfile( &stream->bufferProcessor, &stream->cpuLoadMeasurer,
+                            &stream->streamRepresentation.profile );
 
         stream->streamRepresentation.streamInfo.inputLatency =
                 (double)( PaUtil_GetBufferProcessorInputLatencyFrames(&stream->bufferProcessor)
@@ -2036,6 +2036,8 @@ static PaError OpenStream( struct PaUtilHostApiRepresentation *hostApi,
            goto error;
     }
     stream->bufferProcessorIsInitialized = TRUE;
+    PaUtil_AttachCallbackProfile( &stream->bufferProcessor, &stream->cpuLoadMeasurer,
+            &stream->streamRepresentation.profile );
 
     // Calculate actual latency from the sum of individual latencies.
     if( inputParameters ) 
@@ -2073,6 +2073,8 @@ static PaError OpenStream( struct PaUtilHostApiRepresentation *hostApi,
         goto error;
 
     bufferProcessorIsInitialized = 1;
+    PaUtil_AttachCallbackProfile( &stream->bufferProcessor, &stream->cpuLoadMeasurer,
+            &stream->streamRepresentation.profile );
 
    
 /* DirectSound specific initialization */ 
@@ -68,7 +68,7 @@
 #include "pa_process.h"
 #include "pa_allocation.h"
 #include "pa_cpuload.h"
-#include "pa_ringbuffer.h"
+#include "pa_spscringbuffer.h"
 #include "pa_debugprint.h"
 
 #include "pa_jack.h"
@@ -223,8 +223,8 @@ typedef struct PaJackStream
     /* These are useful for the blocking API */
 
     int                     isBlockingStream;
-    PaUtilRingBuffer        inFIFO;
-    PaUtilRingBuffer        outFIFO;
+    PaUtilSpscRingBuffer    inFIFO;
+    PaUtilSpscRingBuffer    outFIFO;
     volatile sig_atomic_t   data_available;
     sem_t                   data_semaphore;
     int                     bytesPerFrame;
@@ -257,17 +257,22 @@ static int JackCallback( jack_nframes_t frames, void *userData );
 /* ---- blocking emulation layer ---- */
 
 /* Allocate buffer. */
-static PaError BlockingInitFIFO( PaUtilRingBuffer *rbuf, long numFrames, long bytesPerFrame )
+static PaError BlockingInitFIFO( PaUtilSpscRingBuffer *rbuf, long numFrames, long bytesPerFrame )
 {
     long numBytes = numFrames * bytesPerFrame;
     char *buffer = (char *) malloc( numBytes );
     if( buffer == NULL ) return paInsufficientMemory;
     memset( buffer, 0, numBytes );
-    return (PaError) PaUtil_InitializeRingBuffer( rbuf, 1, numBytes, buffer );
+    if( PaUtil_InitializeSpscRingBuffer( rbuf, 1, numBytes, buffer ) != 0 )
+    {
+        free( buffer );
+        return paInternalError;
+    }
+    return paNoError;
 }
 
 /* Free buffer. */
-static PaError BlockingTermFIFO( PaUtilRingBuffer *rbuf )
+static PaError BlockingTermFIFO( PaUtilSpscRingBuffer *rbuf )
 {
     if( rbuf->buffer ) free( rbuf->buffer );
     rbuf->buffer = NULL;
@@ -288,11 +293,11 @@ BlockingCallback( const void                      *inputBuffer,
     /* This may get called with NULL inputBuffer during initial setup. */
     if( inputBuffer != NULL )
     {
-        PaUtil_WriteRingBuffer( &stream->inFIFO, inputBuffer, numBytes );
+        PaUtil_WriteSpscRingBuffer( &stream->inFIFO, inputBuffer, numBytes );
     }
     if( outputBuffer != NULL )
     {
-        int numRead = PaUtil_ReadRingBuffer( &stream->outFIFO, outputBuffer, numBytes );
+        int numRead = PaUtil_ReadSpscRingBuffer( &stream->outFIFO, outputBuffer, numBytes );
         /* Zero out remainder of buffer if we run out of data. */
         memset( (char *)outputBuffer + numRead, 0, numBytes - numRead );
     }
@@ -319,9 +324,11 @@ BlockingBegin( PaJackStream *stream, int minimum_buffer_size )
     stream->samplesPerFrame = 2;
     stream->bytesPerFrame = sizeof(float) * stream->samplesPerFrame;
     /* </FIXME> */
+    /* the FIFOs don't need a power of two size, so hold exactly the
+       requested latency */
     numFrames = 32;
-    while (numFrames < minimum_buffer_size)
-        numFrames *= 2;
+    if (numFrames < minimum_buffer_size)
+        numFrames = minimum_buffer_size;
 
     if( doRead )
     {
@@ -334,8 +341,8 @@ BlockingBegin( PaJackStream *stream, int minimum_buffer_size )
         ENSURE_PA( BlockingInitFIFO( &stream->outFIFO, numFrames, stream->bytesPerFrame ) );
 
         /* Make Write FIFO appear full initially. */
-        numBytes = PaUtil_GetRingBufferWriteAvailable( &stream->outFIFO );
-        PaUtil_AdvanceRingBufferWriteIndex( &stream->outFIFO, numBytes );
+        numBytes = PaUtil_GetSpscRingBufferWriteAvailable( &stream->outFIFO );
+        PaUtil_AdvanceSpscRingBufferWriteIndex( &stream->outFIFO, numBytes );
     }
 
     stream->data_available = 0;
@@ -364,7 +371,7 @@ static PaError BlockingReadStream( PaStream* s, void *data, unsigned long numFra
     long numBytes = stream->bytesPerFrame * numFrames;
     while( numBytes > 0 )
     {
-        bytesRead = PaUtil_ReadRingBuffer( &stream->inFIFO, p, numBytes );
+        bytesRead = PaUtil_ReadSpscRingBuffer( &stream->inFIFO, p, numBytes );
         numBytes -= bytesRead;
         p += bytesRead;
         if( numBytes > 0 )
@@ -389,7 +396,7 @@ static PaError BlockingWriteStream( PaStream* s, const void *data, unsigned long
     long numBytes = stream->bytesPerFrame * numFrames;
     while( numBytes > 0 )
     {
-        bytesWritten = PaUtil_WriteRingBuffer( &stream->outFIFO, p, numBytes );
+        bytesWritten = PaUtil_WriteSpscRingBuffer( &stream->outFIFO, p, numBytes );
         numBytes -= bytesWritten;
         p += bytesWritten;
         if( numBytes > 0 )
@@ -423,7 +430,7 @@ BlockingGetStreamReadAvailable( PaStream* s )
 {
     PaJackStream *stream = (PaJackStream *)s;
 
-    int bytesFull = PaUtil_GetRingBufferReadAvailable( &stream->inFIFO );
+    int bytesFull = PaUtil_GetSpscRingBufferReadAvailable( &stream->inFIFO );
     return bytesFull / stream->bytesPerFrame;
 }
 
@@ -432,7 +439,7 @@ BlockingGetStreamWriteAvailable( PaStream* s )
 {
     PaJackStream *stream = (PaJackStream *)s;
 
-    int bytesEmpty = PaUtil_GetRingBufferWriteAvailable( &stream->outFIFO );
+    int bytesEmpty = PaUtil_GetSpscRingBufferWriteAvailable( &stream->outFIFO );
     return bytesEmpty / stream->bytesPerFrame;
 }
 
@@ -441,7 +448,7 @@ BlockingWaitEmpty( PaStream *s )
 {
     PaJackStream *stream = (PaJackStream *)s;
 
-    while( PaUtil_GetRingBufferReadAvailable( &stream->outFIFO ) > 0 )
+    while( PaUtil_GetSpscRingBufferReadAvailable( &stream->outFIFO ) > 0 )
     {
         stream->data_available = 0;
         sem_wait( &stream->data_semaphore );
@@ -1298,6 +1305,8 @@ static PaError OpenStream( struct PaUtilHostApiRepresentation *hostApi,
                   streamCallback,
                   userData ) );
     bpInitialized = 1;
+    PaUtil_AttachCallbackProfile( &stream->bufferProcessor, &stream->cpuLoadMeasurer,
+            &stream->streamRepresentation.profile );
 
     if( stream->num_incoming_connections > 0 )
         stream->streamRepresentation.streamInfo.inputLatency = (jack_port_get_latency( stream->remote_output_ports[0] )
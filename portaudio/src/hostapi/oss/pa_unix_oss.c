@@ -89,6 +89,7 @@
 #include "pa_process.h"
 #include "pa_unix_util.h"
 #include "pa_debugprint.h"
+#include "pa_tracering.h"
 
 static int sysErr_;
 static pthread_t mainThread_;
@@ -1274,6 +1275,8 @@ static PaError OpenStream( struct PaUtilHostApiRepresentation *hostApi,
               outputHostFormat, sampleRate, streamFlags, framesPerBuffer, stream->framesPerHostBuffer,
               paUtilFixedHostBufferSize, streamCallback, userData ) );
     bpInitialized = 1;
+    PaUtil_AttachCallbackProfile( &stream->bufferProcessor, &stream->cpuLoadMeasurer,
+            &stream->streamRepresentation.profile );
 
     *s = (PaStream*)stream;
 
@@ -1569,6 +1572,8 @@ static void OnExit( void *data )
 
     stream->callbackAbort = 0;      /* Clear state */
     stream->isActive = 0;
+
+    PaUtil_ReleaseTraceThread();
 }
 
 static PaError SetUpBuffers( PaOssStream *stream, unsigned long framesAvail )
@@ -0,0 +1,1900 @@
+/*
+ * $Id$
+ * Portable Audio I/O Library virtual host API implementation
+ * devices backed by files or memory rather than audio hardware
+ *
+ * Based on the Open Source API proposed by Ross Bencina
+ * Copyright (c) 1999-2002 Ross Bencina, Phil Burk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * The text above constitutes the entire PortAudio license; however, 
+ * the PortAudio community also makes the following non-binding requests:
+ *
+ * Any person wishing to distribute modifications to the Software is
+ * requested to send the modifications to the original developer so that
+ * they can be incorporated into the canonical version. It is also 
+ * requested that these non-binding requests be included along with the 
+ * license above.
+ */
+
+/** @file
+ @ingroup common_src
+
+ @brief Virtual host API: devices which are not backed by audio hardware.
+
+ A virtual stream reads its input from, and writes its output to, a raw
+ sample file, a WAV file or a memory buffer, or uses silence and discards its
+ output (see pa_virtual.h). Host buffers are always interleaved, in the
+ endpoint's sample format; the buffer processor converts to and from the
+ client's format.
+
+ Callback streams are run by a thread of their own. Blocking streams do their
+ work in Pa_ReadStream() and Pa_WriteStream().
+
+ A stream is either paced or free running. A paced stream follows a simulated
+ device clock, PaUtil_GetTime() scaled by the stream's speed: host buffer n
+ is processed when the clock reaches n periods, and a stream which falls more
+ than its buffer behind the clock reports an underflow or overflow and is
+ resynchronized. Data is never dropped, so the content of output files does
+ not depend on timing. A free running stream processes its next host buffer as
+ soon as the previous one is done.
+
+ Stream time is the simulated device clock: frames processed divided by the
+ sample rate. It starts at 0 when the stream is opened and pauses while the
+ stream is stopped.
+*/
+
+
+#include <stdio.h>
+#include <stdlib.h> /* getenv(), strtol(), strtod() */
+#include <string.h>
+#include <errno.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h> /* sched_yield() */
+#include <time.h> /* nanosleep() */
+#endif
+
+#include "pa_virtual.h"
+#include "pa_util.h"
+#include "pa_allocation.h"
+#include "pa_hostapi.h"
+#include "pa_stream.h"
+#include "pa_cpuload.h"
+#include "pa_process.h"
+#include "pa_converters.h"
+#include "pa_endianness.h"
+#include "pa_tracering.h"
+#include "pa_debugprint.h"
+
+
+/* prototypes for functions declared in this file */
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif /* __cplusplus */
+
+PaError PaVirtual_Initialize( PaUtilHostApiRepresentation **hostApi, PaHostApiIndex index );
+
+#ifdef __cplusplus
+}
+#endif /* __cplusplus */
+
+
+static void Terminate( struct PaUtilHostApiRepresentation *hostApi );
+static PaError IsFormatSupported( struct PaUtilHostApiRepresentation *hostApi,
+                                  const PaStreamParameters *inputParameters,
+                                  const PaStreamParameters *outputParameters,
+                                  double sampleRate );
+static PaError OpenStream( struct PaUtilHostApiRepresentation *hostApi,
+                           PaStream** s,
+                           const PaStreamParameters *inputParameters,
+                           const PaStreamParameters *outputParameters,
+                           double sampleRate,
+                           unsigned long framesPerBuffer,
+                           PaStreamFlags streamFlags,
+                           PaStreamCallback *streamCallback,
+                           void *userData );
+static PaError CloseStream( PaStream* stream );
+static PaError StartStream( PaStream *stream );
+static PaError StopStream( PaStream *stream );
+static PaError AbortStream( PaStream *stream );
+static PaError IsStreamStopped( PaStream *s );
+static PaError IsStreamActive( PaStream *stream );
+static PaTime GetStreamTime( PaStream *stream );
+static double GetStreamCpuLoad( PaStream* stream );
+static PaError ReadStream( PaStream* stream, void *buffer, unsigned long frames );
+static PaError WriteStream( PaStream* stream, const void *buffer, unsigned long frames );
+static signed long GetStreamReadAvailable( PaStream* stream );
+static signed long GetStreamWriteAvailable( PaStream* stream );
+
+
+#define PA_VIRTUAL_SET_LAST_HOST_ERROR( errorCode, errorText ) \
+    PaUtil_SetLastHostErrorInfo( paVirtual, errorCode, errorText )
+
+#define PA_VIRTUAL_STANDARD_FORMATS \
+    (paFloat32 | paInt32 | paInt24 | paInt16 | paInt8 | paUInt8)
+
+#define PA_VIRTUAL_DEFAULT_SAMPLE_RATE          (48000.)
+#define PA_VIRTUAL_DEFAULT_FRAMES_PER_BUFFER    (256)
+#define PA_VIRTUAL_MAX_NAME_LENGTH              (64)
+
+/* the longest a paced stream sleeps before checking whether it should stop */
+#define PA_VIRTUAL_MAX_SLEEP_SECONDS            (.01)
+
+/* timers overshoot, so the last stretch before a deadline is waited for by
+    yielding rather than sleeping */
+#define PA_VIRTUAL_SPIN_SECONDS                 (.0005)
+
+/* how late a paced stream may run, on top of its buffering, before it counts
+    as an xrun: the scheduler's latency, not the simulated device's */
+#define PA_VIRTUAL_TIMER_SLACK_SECONDS          (.002)
+
+#define PA_VIRTUAL_WAVE_HEADER_SIZE             (44)
+#define PA_VIRTUAL_WAVE_FORMAT_PCM              (1)
+#define PA_VIRTUAL_WAVE_FORMAT_IEEE_FLOAT       (3)
+#define PA_VIRTUAL_WAVE_FORMAT_EXTENSIBLE       (0xFFFE)
+#define PA_VIRTUAL_WAVE_UNKNOWN_SIZE            (0xFFFFFFFFUL)
+
+
+/* device configuration -----------------------------------------------------*/
+
+typedef struct PaVirtualDeviceConfig
+{
+    PaVirtualDeviceInfo info;   /* info.name points to name */
+    char name[ PA_VIRTUAL_MAX_NAME_LENGTH ];
+}
+PaVirtualDeviceConfig;
+
+/* devices added with PaVirtual_AddDevice(), read by PaVirtual_Initialize() */
+static PaVirtualDeviceConfig deviceConfigs_[ PA_VIRTUAL_MAX_DEVICES ];
+static int deviceConfigCount_ = 0;
+
+
+void PaVirtual_InitializeDeviceInfo( PaVirtualDeviceInfo *info )
+{
+    info->name = NULL;
+    info->maxInputChannels = 2;
+    info->maxOutputChannels = 2;
+    info->defaultSampleRate = PA_VIRTUAL_DEFAULT_SAMPLE_RATE;
+    info->minSampleRate = 0.;
+    info->maxSampleRate = 0.;
+    info->sampleFormats = 0;
+    info->framesPerHostBuffer = 0;
+    info->speed = 1.;
+}
+
+
+static int IsSampleRateInRange( const PaVirtualDeviceInfo *info, double sampleRate )
+{
+    return sampleRate > 0.
+            && (info->minSampleRate <= 0. || sampleRate >= info->minSampleRate)
+            && (info->maxSampleRate <= 0. || sampleRate <= info->maxSampleRate);
+}
+
+
+/* validate info and copy it to config, filling in defaults */
+static PaError SetDeviceConfig( PaVirtualDeviceConfig *config, const PaVirtualDeviceInfo *info )
+{
+    if( info->maxInputChannels < 0 || info->maxOutputChannels < 0
+            || info->maxInputChannels + info->maxOutputChannels == 0 )
+        return paInvalidChannelCount;
+
+    if( info->defaultSampleRate < 0. || info->minSampleRate < 0. || info->maxSampleRate < 0.
+            || (info->maxSampleRate > 0. && info->minSampleRate > info->maxSampleRate) )
+        return paInvalidSampleRate;
+
+    if( info->sampleFormats != 0 && (info->sampleFormats & PA_VIRTUAL_STANDARD_FORMATS) == 0 )
+        return paSampleFormatNotSupported;
+
+    config->info = *info;
+
+    strncpy( config->name, info->name ? info->name : "Virtual Device", PA_VIRTUAL_MAX_NAME_LENGTH - 1 );
+    config->name[ PA_VIRTUAL_MAX_NAME_LENGTH - 1 ] = '\0';
+    config->info.name = config->name;
+
+    if( config->info.defaultSampleRate == 0. )
+    {
+        config->info.defaultSampleRate = PA_VIRTUAL_DEFAULT_SAMPLE_RATE;
+        if( config->info.maxSampleRate > 0. && config->info.defaultSampleRate > config->info.maxSampleRate )
+            config->info.defaultSampleRate = config->info.maxSampleRate;
+        if( config->info.defaultSampleRate < config->info.minSampleRate )
+            config->info.defaultSampleRate = config->info.minSampleRate;
+    }
+    else if( !IsSampleRateInRange( &config->info, config->info.defaultSampleRate ) )
+    {
+        return paInvalidSampleRate;
+    }
+
+    config->info.sampleFormats = info->sampleFormats != 0
+            ? (info->sampleFormats & PA_VIRTUAL_STANDARD_FORMATS) : PA_VIRTUAL_STANDARD_FORMATS;
+
+    if( config->info.speed == 0. )
+        config->info.speed = 1.;
+    else if( config->info.speed < 0. )
+        config->info.speed = paVirtualFreeRunning;
+
+    return paNoError;
+}
+
+
+PaError PaVirtual_AddDevice( const PaVirtualDeviceInfo *info )
+{
+    PaError result;
+
+    if( deviceConfigCount_ == PA_VIRTUAL_MAX_DEVICES )
+        return paInsufficientMemory;
+
+    result = SetDeviceConfig( &deviceConfigs_[ deviceConfigCount_ ], info );
+    if( result == paNoError )
+        ++deviceConfigCount_;
+
+    return result;
+}
+
+
+void PaVirtual_RemoveAllDevices( void )
+{
+    deviceConfigCount_ = 0;
+}
+
+
+/* Parse the PA_VIRTUAL_DEVICES environment variable into configs. Each entry
+    is name:inputChannels:outputChannels[:sampleRate[:speed]]; entries are
+    separated by semicolons. Malformed entries are skipped. Returns the number
+    of devices parsed. */
+static int ParseEnvironmentDevices( PaVirtualDeviceConfig *configs )
+{
+    const char *entry = getenv( "PA_VIRTUAL_DEVICES" );
+    const char *entryEnd, *field, *fieldEnd;
+    char text[ PA_VIRTUAL_MAX_NAME_LENGTH ];
+    PaVirtualDeviceInfo info;
+    int count = 0, fieldIndex;
+    size_t length;
+
+    while( entry && *entry && count < PA_VIRTUAL_MAX_DEVICES )
+    {
+        entryEnd = strchr( entry, ';' );
+        if( !entryEnd )
+            entryEnd = entry + strlen( entry );
+
+        PaVirtual_InitializeDeviceInfo( &info );
+        info.name = NULL;
+
+        fieldIndex = 0;
+        for( field = entry; field < entryEnd; field = fieldEnd + 1, ++fieldIndex )
+        {
+            fieldEnd = strchr( field, ':' );
+            if( !fieldEnd || fieldEnd > entryEnd )
+                fieldEnd = entryEnd;
+
+            length = (size_t)(fieldEnd - field);
+            if( length >= PA_VIRTUAL_MAX_NAME_LENGTH )
+                length = PA_VIRTUAL_MAX_NAME_LENGTH - 1;
+            memcpy( text, field, length );
+            text[ length ] = '\0';
+
+            switch( fieldIndex )
+            {
+                case 0: /* the name is copied by SetDeviceConfig() */
+                    strcpy( configs[count].name, text );
+                    break;
+                case 1: info.maxInputChannels = (int)strtol( text, NULL, 10 ); break;
+                case 2: info.maxOutputChannels = (int)strtol( text, NULL, 10 ); break;
+                case 3: info.defaultSampleRate = strtod( text, NULL ); break;
+                case 4: info.speed = strtod( text, NULL ); break;
+                default: break;
+            }
+
+            if( fieldEnd == entryEnd )
+                break;
+        }
+
+        if( fieldIndex >= 2 )
+        {
+            strcpy( text, configs[count].name );
+            info.name = text;
+            if( SetDeviceConfig( &configs[count], &info ) == paNoError )
+                ++count;
+            else
+            {
+                PA_DEBUG(( "%s: ignoring invalid PA_VIRTUAL_DEVICES entry %s\n", __FUNCTION__, text ));
+            }
+        }
+
+        entry = *entryEnd ? entryEnd + 1 : entryEnd;
+    }
+
+    return count;
+}
+
+
+/* host API -----------------------------------------------------------------*/
+
+typedef struct
+{
+    PaUtilHostApiRepresentation inheritedHostApiRep;
+    PaUtilStreamInterface callbackStreamInterface;
+    PaUtilStreamInterface blockingStreamInterface;
+
+    PaUtilAllocationGroup *allocations;
+
+    /* one per device, parallel to inheritedHostApiRep.deviceInfos */
+    PaVirtualDeviceConfig *devices;
+}
+PaVirtualHostApiRepresentation;
+
+
+PaError PaVirtual_Initialize( PaUtilHostApiRepresentation **hostApi, PaHostApiIndex hostApiIndex )
+{
+    PaError result = paNoError;
+    int i, deviceCount;
+    PaVirtualHostApiRepresentation *virtualHostApi = NULL;
+    PaDeviceInfo *deviceInfoArray;
+    PaVirtualDeviceConfig environmentConfigs[ PA_VIRTUAL_MAX_DEVICES ];
+    const PaVirtualDeviceConfig *configs;
+    PaVirtualDeviceConfig *device;
+    double period;
+
+    if( deviceConfigCount_ > 0 )
+    {
+        configs = deviceConfigs_;
+        deviceCount = deviceConfigCount_;
+    }
+    else
+    {
+        configs = environmentConfigs;
+        deviceCount = ParseEnvironmentDevices( environmentConfigs );
+    }
+
+    /* without devices, the host API doesn't appear at all */
+    if( deviceCount == 0 )
+        return paNoError;
+
+    virtualHostApi = (PaVirtualHostApiRepresentation*)PaUtil_AllocateMemory( sizeof(PaVirtualHostApiRepresentation) );
+    if( !virtualHostApi )
+    {
+        result = paInsufficientMemory;
+        goto error;
+    }
+
+    virtualHostApi->allocations = PaUtil_CreateAllocationGroup();
+    if( !virtualHostApi->allocations )
+    {
+        result = paInsufficientMemory;
+        goto error;
+    }
+
+    *hostApi = &virtualHostApi->inheritedHostApiRep;
+    (*hostApi)->info.structVersion = 1;
+    (*hostApi)->info.type = paVirtual;
+    (*hostApi)->info.name = "Virtual";
+
+    (*hostApi)->info.defaultInputDevice = paNoDevice;
+    (*hostApi)->info.defaultOutputDevice = paNoDevice;
+
+    (*hostApi)->info.deviceCount = 0;
+
+    virtualHostApi->devices = (PaVirtualDeviceConfig*)PaUtil_GroupAllocateMemory(
+            virtualHostApi->allocations, sizeof(PaVirtualDeviceConfig) * deviceCount );
+    (*hostApi)->deviceInfos = (PaDeviceInfo**)PaUtil_GroupAllocateMemory(
+            virtualHostApi->allocations, sizeof(PaDeviceInfo*) * deviceCount );
+    /* allocate all device info structs in a contiguous block */
+    deviceInfoArray = (PaDeviceInfo*)PaUtil_GroupAllocateMemory(
+            virtualHostApi->allocations, sizeof(PaDeviceInfo) * deviceCount );
+    if( !virtualHostApi->devices || !(*hostApi)->deviceInfos || !deviceInfoArray )
+    {
+        result = paInsufficientMemory;
+        goto error;
+    }
+
+    for( i=0; i < deviceCount; ++i )
+    {
+        PaDeviceInfo *deviceInfo = &deviceInfoArray[i];
+
+        device = &virtualHostApi->devices[i];
+        *device = configs[i];
+        device->info.name = device->name;
+
+        deviceInfo->structVersion = 2;
+        deviceInfo->hostApi = hostApiIndex;
+        deviceInfo->name = device->name;
+
+        deviceInfo->maxInputChannels = device->info.maxInputChannels;
+        deviceInfo->maxOutputChannels = device->info.maxOutputChannels;
+
+        deviceInfo->defaultSampleRate = device->info.defaultSampleRate;
+
+        /* two periods of buffering for low latency, eight for high */
+        period = (double)(device->info.framesPerHostBuffer != 0
+                ? device->info.framesPerHostBuffer : PA_VIRTUAL_DEFAULT_FRAMES_PER_BUFFER)
+                / device->info.defaultSampleRate;
+        deviceInfo->defaultLowInputLatency = deviceInfo->maxInputChannels > 0 ? 2. * period : 0.;
+        deviceInfo->defaultLowOutputLatency = deviceInfo->maxOutputChannels > 0 ? 2. * period : 0.;
+        deviceInfo->defaultHighInputLatency = deviceInfo->maxInputChannels > 0 ? 8. * period : 0.;
+        deviceInfo->defaultHighOutputLatency = deviceInfo->maxOutputChannels > 0 ? 8. * period : 0.;
+
+        if( (*hostApi)->info.defaultInputDevice == paNoDevice && deviceInfo->maxInputChannels > 0 )
+            (*hostApi)->info.defaultInputDevice = i;
+        if( (*hostApi)->info.defaultOutputDevice == paNoDevice && deviceInfo->maxOutputChannels > 0 )
+            (*hostApi)->info.defaultOutputDevice = i;
+
+        (*hostApi)->deviceInfos[i] = deviceInfo;
+        ++(*hostApi)->info.deviceCount;
+    }
+
+    (*hostApi)->Terminate = Terminate;
+    (*hostApi)->OpenStream = OpenStream;
+    (*hostApi)->IsFormatSupported = IsFormatSupported;
+
+    PaUtil_InitializeStreamInterface( &virtualHostApi->callbackStreamInterface, CloseStream, StartStream,
+                                      StopStream, AbortStream, IsStreamStopped, IsStreamActive,
+                                      GetStreamTime, GetStreamCpuLoad,
+                                      PaUtil_DummyRead, PaUtil_DummyWrite,
+                                      PaUtil_DummyGetReadAvailable, PaUtil_DummyGetWriteAvailable );
+
+    PaUtil_InitializeStreamInterface( &virtualHostApi->blockingStreamInterface, CloseStream, StartStream,
+                                      StopStream, AbortStream, IsStreamStopped, IsStreamActive,
+                                      GetStreamTime, PaUtil_DummyGetCpuLoad,
+                                      ReadStream, WriteStream, GetStreamReadAvailable, GetStreamWriteAvailable );
+
+    return result;
+
+error:
+    if( virtualHostApi )
+    {
+        if( virtualHostApi->allocations )
+        {
+            PaUtil_FreeAllAllocations( virtualHostApi->allocations );
+            PaUtil_DestroyAllocationGroup( virtualHostApi->allocations );
+        }
+
+        PaUtil_FreeMemory( virtualHostApi );
+    }
+    *hostApi = NULL;
+    return result;
+}
+
+
+static void Terminate( struct PaUtilHostApiRepresentation *hostApi )
+{
+    PaVirtualHostApiRepresentation *virtualHostApi = (PaVirtualHostApiRepresentation*)hostApi;
+
+    if( virtualHostApi->allocations )
+    {
+        PaUtil_FreeAllAllocations( virtualHostApi->allocations );
+        PaUtil_DestroyAllocationGroup( virtualHostApi->allocations );
+    }
+
+    PaUtil_FreeMemory( virtualHostApi );
+}
+
+
+/* Validate a direction's parameters against its device and its stream info.
+    Shared by IsFormatSupported() and OpenStream(). */
+static PaError ValidateParameters( PaVirtualHostApiRepresentation *virtualHostApi,
+        const PaStreamParameters *parameters, int isInput, double sampleRate )
+{
+    const PaVirtualDeviceConfig *device;
+    const PaVirtualStreamInfo *streamInfo;
+
+    /* all standard sample formats are supported by the buffer adapter,
+        this implementation doesn't support any custom sample formats */
+    if( parameters->sampleFormat & paCustomFormat )
+        return paSampleFormatNotSupported;
+
+    /* alternate device specification is not supported */
+    if( parameters->device == paUseHostApiSpecificDeviceSpecification )
+        return paInvalidDevice;
+
+    device = &virtualHostApi->devices[ parameters->device ];
+
+    if( parameters->channelCount > (isInput ? device->info.maxInputChannels : device->info.maxOutputChannels) )
+        return paInvalidChannelCount;
+
+    if( !IsSampleRateInRange( &device->info, sampleRate ) )
+        return paInvalidSampleRate;
+
+    streamInfo = (const PaVirtualStreamInfo*)parameters->hostApiSpecificStreamInfo;
+    if( streamInfo )
+    {
+        if( streamInfo->size != sizeof(PaVirtualStreamInfo) || streamInfo->version != 1 )
+            return paIncompatibleHostApiSpecificStreamInfo;
+
+        switch( streamInfo->endpointType )
+        {
+            case paVirtualNull:
+                break;
+            case paVirtualRawFile:
+            case paVirtualWaveFile:
+                if( !streamInfo->fileName )
+                    return paIncompatibleHostApiSpecificStreamInfo;
+                break;
+            case paVirtualMemory:
+                if( !streamInfo->buffer )
+                    return paIncompatibleHostApiSpecificStreamInfo;
+                break;
+            default:
+                return paIncompatibleHostApiSpecificStreamInfo;
+        }
+
+        if( streamInfo->sampleFormat != 0 && (streamInfo->sampleFormat & device->info.sampleFormats) == 0 )
+            return paSampleFormatNotSupported;
+    }
+
+    return paNoError;
+}
+
+
+/* The speed of a stream, from its stream infos or its devices. Returns 0 for
+    a free running stream, and a negative value if the stream infos disagree. */
+static double SelectSpeed( PaVirtualHostApiRepresentation *virtualHostApi,
+        const PaStreamParameters *inputParameters, const PaStreamParameters *outputParameters )
+{
+    const PaVirtualStreamInfo *inputInfo = inputParameters
+            ? (const PaVirtualStreamInfo*)inputParameters->hostApiSpecificStreamInfo : NULL;
+    const PaVirtualStreamInfo *outputInfo = outputParameters
+            ? (const PaVirtualStreamInfo*)outputParameters->hostApiSpecificStreamInfo : NULL;
+    double inputSpeed = (inputInfo && inputInfo->speed != 0.) ? inputInfo->speed : 0.;
+    double outputSpeed = (outputInfo && outputInfo->speed != 0.) ? outputInfo->speed : 0.;
+    double speed;
+
+    if( inputSpeed != 0. && outputSpeed != 0. && inputSpeed != outputSpeed )
+        return -1.;
+
+    if( outputSpeed != 0. )
+        speed = outputSpeed;
+    else if( inputSpeed != 0. )
+        speed = inputSpeed;
+    else if( outputParameters ) /* the output device's speed takes precedence */
+        speed = virtualHostApi->devices[ outputParameters->device ].info.speed;
+    else
+        speed = virtualHostApi->devices[ inputParameters->device ].info.speed;
+
+    return speed > 0. ? speed : 0.;
+}
+
+
+static PaError IsFormatSupported( struct PaUtilHostApiRepresentation *hostApi,
+                                  const PaStreamParameters *inputParameters,
+                                  const PaStreamParameters *outputParameters,
+                                  double sampleRate )
+{
+    PaVirtualHostApiRepresentation *virtualHostApi = (PaVirtualHostApiRepresentation*)hostApi;
+    PaError result;
+
+    if( inputParameters )
+    {
+        result = ValidateParameters( virtualHostApi, inputParameters, 1, sampleRate );
+        if( result != paNoError )
+            return result;
+    }
+
+    if( outputParameters )
+    {
+        result = ValidateParameters( virtualHostApi, outputParameters, 0, sampleRate );
+        if( result != paNoError )
+            return result;
+    }
+
+    if( SelectSpeed( virtualHostApi, inputParameters, outputParameters ) < 0. )
+        return paIncompatibleHostApiSpecificStreamInfo;
+
+    return paFormatIsSupported;
+}
+
+
+/* endpoints ----------------------------------------------------------------*/
+
+/* PaVirtualEndpoint - the source of a stream's input or the sink of its output */
+
+typedef struct PaVirtualEndpoint
+{
+    PaVirtualEndpointType type;
+    unsigned long flags;
+    int isOutput;
+    PaSampleFormat sampleFormat;    /* the host sample format */
+    int channelCount;
+    unsigned int bytesPerFrame;
+    PaUtilZeroer *zeroer;
+
+    FILE *file;
+    long dataOffset;                /* where the samples of a file start */
+    unsigned long dataBytes;        /* WAV input: size of the data chunk; output: bytes written */
+    unsigned long dataPosition;     /* WAV input: bytes read from the data chunk */
+    unsigned long waveSampleRate;
+
+    unsigned char *buffer;
+    unsigned long bufferFrames;
+    unsigned long bufferPosition;   /* in frames */
+
+    unsigned long frames;           /* frames transferred */
+    int ended;                      /* input ran out, or output has no more room */
+}
+PaVirtualEndpoint;
+
+
+static unsigned long ReadUInt16LE( const unsigned char *p )
+{
+    return (unsigned long)p[0] | ((unsigned long)p[1] << 8);
+}
+
+static unsigned long ReadUInt32LE( const unsigned char *p )
+{
+    return (unsigned long)p[0] | ((unsigned long)p[1] << 8)
+            | ((unsigned long)p[2] << 16) | ((unsigned long)p[3] << 24);
+}
+
+static void WriteUInt16LE( unsigned char *p, unsigned long value )
+{
+    p[0] = (unsigned char)(value & 0xFF);
+    p[1] = (unsigned char)((value >> 8) & 0xFF);
+}
+
+static void WriteUInt32LE( unsigned char *p, unsigned long value )
+{
+    WriteUInt16LE( p, value & 0xFFFF );
+    WriteUInt16LE( p + 2, (value >> 16) & 0xFFFF );
+}
+
+
+/* WAV sample data is little endian */
+static void SwapWaveSamples( PaVirtualEndpoint *endpoint, void *buffer, unsigned long frames )
+{
+#ifdef PA_BIG_ENDIAN
+    unsigned char *p = (unsigned char*)buffer, t;
+    unsigned long count = frames * endpoint->channelCount;
+    int sampleSize = Pa_GetSampleSize( endpoint->sampleFormat );
+
+    if( endpoint->type != paVirtualWaveFile || sampleSize == 1 )
+        return;
+
+    for( ; count > 0; --count, p += sampleSize )
+    {
+        t = p[0]; p[0] = p[sampleSize - 1]; p[sampleSize - 1] = t;
+        if( sampleSize == 4 )
+        {
+            t = p[1]; p[1] = p[2]; p[2] = t;
+        }
+    }
+#else
+    (void) endpoint;
+    (void) buffer;
+    (void) frames;
+#endif
+}
+
+
+static PaError FileError( const char *fileName )
+{
+    (void) fileName; /* only used in debug output */
+    PA_DEBUG(( "%s: %s: %s\n", __FUNCTION__, fileName, strerror( errno ) ));
+    PA_VIRTUAL_SET_LAST_HOST_ERROR( errno, strerror( errno ) );
+    return paUnanticipatedHostError;
+}
+
+
+static PaError WaveFileError( const char *text )
+{
+    PA_VIRTUAL_SET_LAST_HOST_ERROR( 0, text );
+    return paUnanticipatedHostError;
+}
+
+
+/* Read the header of a WAV file up to the start of its data chunk. Fills in
+    endpoint's sampleFormat, dataOffset and dataBytes. */
+static PaError ReadWaveHeader( PaVirtualEndpoint *endpoint, int *channelCount, double *sampleRate )
+{
+    unsigned char chunk[8], format[40];
+    unsigned long chunkSize, formatTag = 0, bitsPerSample = 0, blockAlign = 0;
+    int haveFormat = 0;
+
+    if( fread( chunk, 1, 8, endpoint->file ) != 8 || memcmp( chunk, "RIFF", 4 ) != 0
+            || fread( chunk, 1, 4, endpoint->file ) != 4 || memcmp( chunk, "WAVE", 4 ) != 0 )
+        return WaveFileError( "not a WAV file" );
+
+    for( ;; )
+    {
+        if( fread( chunk, 1, 8, endpoint->file ) != 8 )
+            return WaveFileError( "WAV file has no data chunk" );
+        chunkSize = ReadUInt32LE( chunk + 4 );
+
+        if( memcmp( chunk, "fmt ", 4 ) == 0 )
+        {
+            if( chunkSize < 16 || chunkSize > sizeof(format)
+                    || fread( format, 1, chunkSize, endpoint->file ) != chunkSize )
+                return WaveFileError( "unsupported WAV format chunk" );
+            if( chunkSize & 1 )
+                fseek( endpoint->file, 1, SEEK_CUR );
+
+            formatTag = ReadUInt16LE( format );
+            *channelCount = (int)ReadUInt16LE( format + 2 );
+            *sampleRate = (double)ReadUInt32LE( format + 4 );
+            blockAlign = ReadUInt16LE( format + 12 );
+            bitsPerSample = ReadUInt16LE( format + 14 );
+            /* the first two bytes of the sub format GUID are the format tag */
+            if( formatTag == PA_VIRTUAL_WAVE_FORMAT_EXTENSIBLE && chunkSize >= 40 )
+                formatTag = ReadUInt16LE( format + 24 );
+            haveFormat = 1;
+        }
+        else if( memcmp( chunk, "data", 4 ) == 0 )
+        {
+            if( !haveFormat )
+                return WaveFileError( "WAV file has no format chunk" );
+            endpoint->dataOffset = ftell( endpoint->file );
+            /* a size of 0 or 0xFFFFFFFF is left by writers which couldn't
+                finish the file: read to the end */
+            endpoint->dataBytes = chunkSize != 0 ? chunkSize : PA_VIRTUAL_WAVE_UNKNOWN_SIZE;
+            break;
+        }
+        else if( fseek( endpoint->file, (long)(chunkSize + (chunkSize & 1)), SEEK_CUR ) != 0 )
+        {
+            return WaveFileError( "WAV file has no data chunk" );
+        }
+    }
+
+    if( formatTag == PA_VIRTUAL_WAVE_FORMAT_PCM )
+    {
+        switch( bitsPerSample )
+        {
+            case 8: endpoint->sampleFormat = paUInt8; break;
+            case 16: endpoint->sampleFormat = paInt16; break;
+            case 24: endpoint->sampleFormat = paInt24; break;
+            case 32: endpoint->sampleFormat = paInt32; break;
+            default: return paSampleFormatNotSupported;
+        }
+    }
+    else if( formatTag == PA_VIRTUAL_WAVE_FORMAT_IEEE_FLOAT && bitsPerSample == 32 )
+    {
+        endpoint->sampleFormat = paFloat32;
+    }
+    else
+    {
+        return paSampleFormatNotSupported;
+    }
+
+    /* samples must be packed, not padded to a larger container */
+    if( blockAlign != (unsigned long)*channelCount * (bitsPerSample / 8) )
+        return paSampleFormatNotSupported;
+
+    return paNoError;
+}
+
+
+/* Write the 44 byte header of a WAV file holding endpoint->dataBytes bytes
+    of samples, at the current position. */
+static int WriteWaveHeader( PaVirtualEndpoint *endpoint )
+{
+    unsigned char header[ PA_VIRTUAL_WAVE_HEADER_SIZE ];
+    unsigned long sampleSize = Pa_GetSampleSize( endpoint->sampleFormat );
+
+    memcpy( header, "RIFF", 4 );
+    WriteUInt32LE( header + 4, PA_VIRTUAL_WAVE_HEADER_SIZE - 8 + endpoint->dataBytes );
+    memcpy( header + 8, "WAVEfmt ", 8 );
+    WriteUInt32LE( header + 16, 16 );
+    WriteUInt16LE( header + 20, endpoint->sampleFormat == paFloat32
+            ? PA_VIRTUAL_WAVE_FORMAT_IEEE_FLOAT : PA_VIRTUAL_WAVE_FORMAT_PCM );
+    WriteUInt16LE( header + 22, (unsigned long)endpoint->channelCount );
+    WriteUInt32LE( header + 24, endpoint->waveSampleRate );
+    WriteUInt32LE( header + 28, endpoint->waveSampleRate * endpoint->bytesPerFrame );
+    WriteUInt16LE( header + 32, endpoint->bytesPerFrame );
+    WriteUInt16LE( header + 34, sampleSize * 8 );
+    memcpy( header + 36, "data", 4 );
+    WriteUInt32LE( header + 40, endpoint->dataBytes );
+
+    return fwrite( header, 1, sizeof(header), endpoint->file ) == sizeof(header);
+}
+
+
+/* Bring the sizes in an output WAV file's header up to date, so that the file
+    is complete whenever the stream is stopped. */
+static void FinishWaveFile( PaVirtualEndpoint *endpoint )
+{
+    if( endpoint->type != paVirtualWaveFile || !endpoint->isOutput || !endpoint->file )
+        return;
+
+    if( fseek( endpoint->file, 0, SEEK_SET ) != 0 || !WriteWaveHeader( endpoint ) )
+    {
+        PA_DEBUG(( "%s: couldn't update the WAV header\n", __FUNCTION__ ));
+    }
+    fseek( endpoint->file, 0, SEEK_END );
+    fflush( endpoint->file );
+}
+
+
+static void CloseEndpoint( PaVirtualEndpoint *endpoint )
+{
+    if( endpoint->file )
+    {
+        FinishWaveFile( endpoint );
+        fclose( endpoint->file );
+        endpoint->file = NULL;
+    }
+}
+
+
+static PaError OpenEndpoint( PaVirtualEndpoint *endpoint, const PaStreamParameters *parameters,
+        const PaVirtualDeviceConfig *device, int isOutput, double sampleRate )
+{
+    const PaVirtualStreamInfo *streamInfo = (const PaVirtualStreamInfo*)parameters->hostApiSpecificStreamInfo;
+    PaSampleFormat userFormat = parameters->sampleFormat & ~paNonInterleaved;
+    PaError result = paNoError;
+    int fileChannelCount = 0;
+    double fileSampleRate = 0.;
+
+    memset( endpoint, 0, sizeof(PaVirtualEndpoint) );
+    endpoint->type = streamInfo ? streamInfo->endpointType : paVirtualNull;
+    endpoint->flags = streamInfo ? streamInfo->flags : 0;
+    endpoint->isOutput = isOutput;
+    endpoint->channelCount = parameters->channelCount;
+
+    if( endpoint->type == paVirtualWaveFile && !isOutput )
+    {
+        /* an input file's header decides its sample format */
+        endpoint->file = fopen( streamInfo->fileName, "rb" );
+        if( !endpoint->file )
+            return FileError( streamInfo->fileName );
+
+        result = ReadWaveHeader( endpoint, &fileChannelCount, &fileSampleRate );
+        if( result != paNoError )
+            goto error;
+
+        if( fileChannelCount != endpoint->channelCount )
+        {
+            result = paInvalidChannelCount;
+            goto error;
+        }
+
+        if( fileSampleRate != sampleRate )
+        {
+            result = paInvalidSampleRate;
+            goto error;
+        }
+
+        if( (endpoint->sampleFormat & device->info.sampleFormats) == 0 )
+        {
+            result = paSampleFormatNotSupported;
+            goto error;
+        }
+    }
+    else
+    {
+        if( streamInfo && streamInfo->sampleFormat != 0 )
+            endpoint->sampleFormat = streamInfo->sampleFormat;
+        else
+            endpoint->sampleFormat = PaUtil_SelectClosestAvailableFormat( device->info.sampleFormats, userFormat );
+
+        /* 8 bit WAV data is unsigned */
+        if( endpoint->type == paVirtualWaveFile && endpoint->sampleFormat == paInt8 )
+            endpoint->sampleFormat = paUInt8;
+    }
+
+    endpoint->bytesPerFrame = Pa_GetSampleSize( endpoint->sampleFormat ) * endpoint->channelCount;
+    endpoint->zeroer = PaUtil_SelectZeroer( endpoint->sampleFormat );
+
+    switch( endpoint->type )
+    {
+        case paVirtualRawFile:
+            endpoint->file = fopen( streamInfo->fileName, isOutput ? "wb" : "rb" );
+            if( !endpoint->file )
+                return FileError( streamInfo->fileName );
+            break;
+
+        case paVirtualWaveFile:
+            if( isOutput )
+            {
+                endpoint->file = fopen( streamInfo->fileName, "wb" );
+                if( !endpoint->file )
+                    return FileError( streamInfo->fileName );
+
+                endpoint->waveSampleRate = (unsigned long)(sampleRate + .5);
+                if( !WriteWaveHeader( endpoint ) )
+                {
+                    result = FileError( streamInfo->fileName );
+                    goto error;
+                }
+            }
+            break;
+
+        case paVirtualMemory:
+            endpoint->buffer = (unsigned char*)streamInfo->buffer;
+            endpoint->bufferFrames = streamInfo->bufferFrames;
+            break;
+
+        default:
+            break;
+    }
+
+    return result;
+
+error:
+    CloseEndpoint( endpoint );
+    return result;
+}
+
+
+/* Restart an input endpoint from the beginning of its file or buffer. */
+static void RewindEndpoint( PaVirtualEndpoint *endpoint )
+{
+    if( endpoint->file )
+    {
+        clearerr( endpoint->file );
+        fseek( endpoint->file, endpoint->dataOffset, SEEK_SET );
+    }
+    endpoint->dataPosition = 0;
+    endpoint->bufferPosition = 0;
+}
+
+
+/* Read up to frames frames from an input endpoint's file or buffer, without
+    looping. Returns the number of frames read. */
+static unsigned long ReadEndpointFrames( PaVirtualEndpoint *endpoint, unsigned char *buffer,
+        unsigned long frames )
+{
+    unsigned long remaining;
+
+    switch( endpoint->type )
+    {
+        case paVirtualWaveFile:
+            if( endpoint->dataBytes != PA_VIRTUAL_WAVE_UNKNOWN_SIZE )
+            {
+                remaining = (endpoint->dataBytes - endpoint->dataPosition) / endpoint->bytesPerFrame;
+                if( frames > remaining )
+                    frames = remaining;
+            }
+            frames = (unsigned long)fread( buffer, endpoint->bytesPerFrame, frames, endpoint->file );
+            endpoint->dataPosition += frames * endpoint->bytesPerFrame;
+            return frames;
+
+        case paVirtualRawFile:
+            return (unsigned long)fread( buffer, endpoint->bytesPerFrame, frames, endpoint->file );
+
+        case paVirtualMemory:
+            remaining = endpoint->bufferFrames - endpoint->bufferPosition;
+            if( frames > remaining )
+                frames = remaining;
+            memcpy( buffer, endpoint->buffer + endpoint->bufferPosition * endpoint->bytesPerFrame,
+                    frames * endpoint->bytesPerFrame );
+            endpoint->bufferPosition += frames;
+            return frames;
+
+        default:
+            return 0;
+    }
+}
+
+
+/* Fill buffer with frames frames of input. Once the endpoint's data has run
+    out, it is either restarted (paVirtualLoop) or the rest is silence. */
+static void ReadEndpoint( PaVirtualEndpoint *endpoint, void *buffer, unsigned long frames )
+{
+    unsigned char *p = (unsigned char*)buffer;
+    unsigned long framesRead = 0, n;
+    int rewound = 0;
+
+    if( endpoint->type == paVirtualNull )
+    {
+        endpoint->zeroer( buffer, 1, frames * endpoint->channelCount );
+        endpoint->frames += frames;
+        return;
+    }
+
+    while( framesRead < frames && !endpoint->ended )
+    {
+        n = ReadEndpointFrames( endpoint, p + framesRead * endpoint->bytesPerFrame, frames - framesRead );
+        framesRead += n;
+
+        if( n == 0 )
+        {
+            /* rewinding twice without reading anything means there is nothing to read */
+            if( (endpoint->flags & paVirtualLoop) && !rewound )
+            {
+                RewindEndpoint( endpoint );
+                rewound = 1;
+            }
+            else
+            {
+                endpoint->ended = 1;
+            }
+        }
+        else
+        {
+            rewound = 0;
+        }
+    }
+
+    /* notice the end of a memory buffer or WAV file as soon as it is reached,
+        rather than on the next read */
+    if( !(endpoint->flags & paVirtualLoop)
+            && ((endpoint->type == paVirtualMemory && endpoint->bufferPosition == endpoint->bufferFrames)
+                || (endpoint->type == paVirtualWaveFile && endpoint->dataBytes != PA_VIRTUAL_WAVE_UNKNOWN_SIZE
+                    && endpoint->dataBytes - endpoint->dataPosition < endpoint->bytesPerFrame)) )
+        endpoint->ended = 1;
+
+    SwapWaveSamples( endpoint, buffer, framesRead );
+
+    if( framesRead < frames )
+    {
+        endpoint->zeroer( p + framesRead * endpoint->bytesPerFrame, 1,
+                (frames - framesRead) * endpoint->channelCount );
+    }
+
+    endpoint->frames += framesRead;
+}
+
+
+/* Write frames frames of output to an endpoint. Frames which don't fit are
+    discarded. */
+static void WriteEndpoint( PaVirtualEndpoint *endpoint, void *buffer, unsigned long frames )
+{
+    unsigned long framesWritten = frames, room;
+
+    switch( endpoint->type )
+    {
+        case paVirtualWaveFile:
+            /* a WAV file can't hold more than 4GB */
+            room = (PA_VIRTUAL_WAVE_UNKNOWN_SIZE - PA_VIRTUAL_WAVE_HEADER_SIZE - endpoint->dataBytes)
+                    / endpoint->bytesPerFrame;
+            if( framesWritten > room )
+                framesWritten = room;
+            SwapWaveSamples( endpoint, buffer, framesWritten );
+            framesWritten = (unsigned long)fwrite( buffer, endpoint->bytesPerFrame, framesWritten, endpoint->file );
+            endpoint->dataBytes += framesWritten * endpoint->bytesPerFrame;
+            break;
+
+        case paVirtualRawFile:
+            framesWritten = (unsigned long)fwrite( buffer, endpoint->bytesPerFrame, frames, endpoint->file );
+            break;
+
+        case paVirtualMemory:
+            room = endpoint->bufferFrames - endpoint->bufferPosition;
+            if( framesWritten > room )
+                framesWritten = room;
+            memcpy( endpoint->buffer + endpoint->bufferPosition * endpoint->bytesPerFrame, buffer,
+                    framesWritten * endpoint->bytesPerFrame );
+            endpoint->bufferPosition += framesWritten;
+            break;
+
+        default:
+            break;
+    }
+
+    if( endpoint->type == paVirtualMemory && endpoint->bufferPosition == endpoint->bufferFrames )
+        endpoint->ended = 1;
+
+    if( framesWritten < frames )
+    {
+        if( endpoint->type != paVirtualMemory && !endpoint->ended )
+        {
+            PA_DEBUG(( "%s: output file is full\n", __FUNCTION__ ));
+        }
+        endpoint->ended = 1;
+    }
+
+    endpoint->frames += framesWritten;
+}
+
+
+/* streams ------------------------------------------------------------------*/
+
+/* PaVirtualStream - a stream data structure specifically for this implementation */
+
+typedef struct PaVirtualStream
+{
+    PaUtilStreamRepresentation streamRepresentation;
+    PaUtilCpuLoadMeasurer cpuLoadMeasurer;
+    PaUtilBufferProcessor bufferProcessor;
+
+    PaVirtualEndpoint input;
+    PaVirtualEndpoint output;
+    int hasInput, hasOutput;
+    void *hostInputBuffer;
+    void *hostOutputBuffer;
+
+    /* copies of the user's buffer pointers for non-interleaved blocking i/o */
+    void **userInputPointers;
+    void **userOutputPointers;
+
+    double sampleRate;
+    double speed;                       /* 0 when free running */
+    unsigned long framesPerHostBuffer;
+    unsigned long bufferFrames;         /* the simulated device buffer */
+
+    /* The simulated device clock. While the stream runs, input frame p is
+        due at startTime + (p - inputStart) / (sampleRate * speed), and
+        likewise for output. inputStart and outputStart move on an xrun. */
+    double startTime;
+    double startStreamTime;
+    double inputStart, outputStart;
+    double inputPosition, outputPosition;
+    double stopStreamTime;
+
+    volatile int isStopped;
+    volatile int isActive;
+    volatile int stopRequested;
+    int threadStarted;
+#if defined(_WIN32)
+    HANDLE thread;
+#else
+    pthread_t thread;
+#endif
+}
+PaVirtualStream;
+
+
+/* see pa_hostapi.h for a list of validity guarantees made about OpenStream parameters */
+
+static PaError OpenStream( struct PaUtilHostApiRepresentation *hostApi,
+                           PaStream** s,
+                           const PaStreamParameters *inputParameters,
+                           const PaStreamParameters *outputParameters,
+                           double sampleRate,
+                           unsigned long framesPerBuffer,
+                           PaStreamFlags streamFlags,
+                           PaStreamCallback *streamCallback,
+                           void *userData )
+{
+    PaError result = paNoError;
+    PaVirtualHostApiRepresentation *virtualHostApi = (PaVirtualHostApiRepresentation*)hostApi;
+    PaVirtualStream *stream = 0;
+    const PaVirtualDeviceConfig *inputDevice = NULL, *outputDevice = NULL;
+    unsigned long framesPerHostBuffer, hostBufferCount, count;
+    int inputChannelCount, outputChannelCount;
+    PaSampleFormat inputSampleFormat, outputSampleFormat;
+    PaSampleFormat hostInputSampleFormat, hostOutputSampleFormat;
+    double speed;
+
+    if( inputParameters )
+    {
+        result = ValidateParameters( virtualHostApi, inputParameters, 1, sampleRate );
+        if( result != paNoError )
+            return result;
+
+        inputDevice = &virtualHostApi->devices[ inputParameters->device ];
+        inputChannelCount = inputParameters->channelCount;
+        inputSampleFormat = inputParameters->sampleFormat;
+    }
+    else
+    {
+        inputChannelCount = 0;
+        inputSampleFormat = paInt16; /* Suppress 'uninitialised var' warnings. */
+    }
+
+    if( outputParameters )
+    {
+        result = ValidateParameters( virtualHostApi, outputParameters, 0, sampleRate );
+        if( result != paNoError )
+            return result;
+
+        outputDevice = &virtualHostApi->devices[ outputParameters->device ];
+        outputChannelCount = outputParameters->channelCount;
+        outputSampleFormat = outputParameters->sampleFormat;
+    }
+    else
+    {
+        outputChannelCount = 0;
+        outputSampleFormat = paInt16; /* Suppress 'uninitialized var' warnings. */
+    }
+
+    speed = SelectSpeed( virtualHostApi, inputParameters, outputParameters );
+    if( speed < 0. )
+        return paIncompatibleHostApiSpecificStreamInfo;
+
+    /* validate platform specific flags */
+    if( (streamFlags & paPlatformSpecificFlags) != 0 )
+        return paInvalidFlag; /* unexpected platform specific flag */
+
+    /* the device's period if it has one, otherwise the client's buffer size */
+    if( outputDevice && outputDevice->info.framesPerHostBuffer != 0 )
+        framesPerHostBuffer = outputDevice->info.framesPerHostBuffer;
+    else if( inputDevice && inputDevice->info.framesPerHostBuffer != 0 )
+        framesPerHostBuffer = inputDevice->info.framesPerHostBuffer;
+    else if( framesPerBuffer != paFramesPerBufferUnspecified )
+        framesPerHostBuffer = framesPerBuffer;
+    else
+        framesPerHostBuffer = PA_VIRTUAL_DEFAULT_FRAMES_PER_BUFFER;
+
+    /* enough periods to cover the suggested latency, and at least two */
+    hostBufferCount = 2;
+    if( inputParameters )
+    {
+        count = (unsigned long)(inputParameters->suggestedLatency * sampleRate / framesPerHostBuffer + .999);
+        if( count > hostBufferCount )
+            hostBufferCount = count;
+    }
+    if( outputParameters )
+    {
+        count = (unsigned long)(outputParameters->suggestedLatency * sampleRate / framesPerHostBuffer + .999);
+        if( count > hostBufferCount )
+            hostBufferCount = count;
+    }
+
+
+    stream = (PaVirtualStream*)PaUtil_AllocateMemory( sizeof(PaVirtualStream) );
+    if( !stream )
+    {
+        result = paInsufficientMemory;
+        goto error;
+    }
+    memset( stream, 0, sizeof(PaVirtualStream) );
+
+    if( inputParameters )
+    {
+        result = OpenEndpoint( &stream->input, inputParameters, inputDevice, 0, sampleRate );
+        if( result != paNoError )
+            goto error;
+        stream->hasInput = 1;
+    }
+
+    if( outputParameters )
+    {
+        result = OpenEndpoint( &stream->output, outputParameters, outputDevice, 1, sampleRate );
+        if( result != paNoError )
+            goto error;
+        stream->hasOutput = 1;
+    }
+
+    hostInputSampleFormat = stream->hasInput ? stream->input.sampleFormat : paInt16;
+    hostOutputSampleFormat = stream->hasOutput ? stream->output.sampleFormat : paInt16;
+
+    if( stream->hasInput )
+    {
+        stream->hostInputBuffer = PaUtil_AllocateMemory( framesPerHostBuffer * stream->input.bytesPerFrame );
+        stream->userInputPointers = (void**)PaUtil_AllocateMemory( sizeof(void*) * inputChannelCount );
+        if( !stream->hostInputBuffer || !stream->userInputPointers )
+        {
+            result = paInsufficientMemory;
+            goto error;
+        }
+    }
+
+    if( stream->hasOutput )
+    {
+        stream->hostOutputBuffer = PaUtil_AllocateMemory( framesPerHostBuffer * stream->output.bytesPerFrame );
+        stream->userOutputPointers = (void**)PaUtil_AllocateMemory( sizeof(void*) * outputChannelCount );
+        if( !stream->hostOutputBuffer || !stream->userOutputPointers )
+        {
+            result = paInsufficientMemory;
+            goto error;
+        }
+    }
+
+    if( streamCallback )
+    {
+        PaUtil_InitializeStreamRepresentation( &stream->streamRepresentation,
+                                               &virtualHostApi->callbackStreamInterface, streamCallback, userData );
+    }
+    else
+    {
+        PaUtil_InitializeStreamRepresentation( &stream->streamRepresentation,
+                                               &virtualHostApi->blockingStreamInterface, streamCallback, userData );
+    }
+
+    /* a paced stream's CPU load is relative to the time it has for each buffer */
+    PaUtil_InitializeCpuLoadMeasurer( &stream->cpuLoadMeasurer, speed > 0. ? sampleRate * speed : sampleRate );
+
+    /* callback streams always process whole host buffers, blocking streams
+        transfer at most a host buffer at a time */
+    result =  PaUtil_InitializeBufferProcessor( &stream->bufferProcessor,
+              inputChannelCount, inputSampleFormat, hostInputSampleFormat,
+              outputChannelCount, outputSampleFormat, hostOutputSampleFormat,
+              sampleRate, streamFlags, framesPerBuffer,
+              framesPerHostBuffer, streamCallback ? paUtilFixedHostBufferSize : paUtilBoundedHostBufferSize,
+              streamCallback, userData );
+    if( result != paNoError )
+        goto error;
+
+    PaUtil_AttachCallbackProfile( &stream->bufferProcessor, &stream->cpuLoadMeasurer,
+            &stream->streamRepresentation.profile );
+
+    stream->sampleRate = sampleRate;
+    stream->speed = speed;
+    stream->framesPerHostBuffer = framesPerHostBuffer;
+    stream->bufferFrames = framesPerHostBuffer * hostBufferCount;
+    stream->isStopped = 1;
+
+    /* a blocking stream may run its whole buffer ahead of the clock */
+    stream->streamRepresentation.streamInfo.inputLatency = stream->hasInput
+            ? (PaTime)(PaUtil_GetBufferProcessorInputLatencyFrames( &stream->bufferProcessor )
+                    + (streamCallback ? framesPerHostBuffer : stream->bufferFrames)) / sampleRate
+            : 0.;
+    stream->streamRepresentation.streamInfo.outputLatency = stream->hasOutput
+            ? (PaTime)(PaUtil_GetBufferProcessorOutputLatencyFrames( &stream->bufferProcessor )
+                    + (streamCallback ? framesPerHostBuffer : stream->bufferFrames)) / sampleRate
+            : 0.;
+    stream->streamRepresentation.streamInfo.sampleRate = sampleRate;
+
+    *s = (PaStream*)stream;
+
+    return result;
+
+error:
+    if( stream )
+    {
+        CloseEndpoint( &stream->input );
+        CloseEndpoint( &stream->output );
+        if( stream->hostInputBuffer )
+            PaUtil_FreeMemory( stream->hostInputBuffer );
+        if( stream->hostOutputBuffer )
+            PaUtil_FreeMemory( stream->hostOutputBuffer );
+        if( stream->userInputPointers )
+            PaUtil_FreeMemory( stream->userInputPointers );
+        if( stream->userOutputPointers )
+            PaUtil_FreeMemory( stream->userOutputPointers );
+        PaUtil_FreeMemory( stream );
+    }
+
+    return result;
+}
+
+
+/*
+    When CloseStream() is called, the multi-api layer ensures that
+    the stream has already been stopped or aborted.
+*/
+static PaError CloseStream( PaStream* s )
+{
+    PaError result = paNoError;
+    PaVirtualStream *stream = (PaVirtualStream*)s;
+
+    CloseEndpoint( &stream->input );
+    CloseEndpoint( &stream->output );
+
+    PaUtil_TerminateBufferProcessor( &stream->bufferProcessor );
+    PaUtil_TerminateStreamRepresentation( &stream->streamRepresentation );
+
+    if( stream->hostInputBuffer )
+        PaUtil_FreeMemory( stream->hostInputBuffer );
+    if( stream->hostOutputBuffer )
+        PaUtil_FreeMemory( stream->hostOutputBuffer );
+    if( stream->userInputPointers )
+        PaUtil_FreeMemory( stream->userInputPointers );
+    if( stream->userOutputPointers )
+        PaUtil_FreeMemory( stream->userOutputPointers );
+    PaUtil_FreeMemory( stream );
+
+    return result;
+}
+
+
+/* timing -------------------------------------------------------------------*/
+
+static void SleepSeconds( double seconds )
+{
+#if defined(_WIN32)
+    Sleep( (DWORD)(seconds * 1000.) );
+#else
+    struct timespec request;
+    request.tv_sec = (time_t)seconds;
+    request.tv_nsec = (long)((seconds - (double)request.tv_sec) * 1.e9);
+    nanosleep( &request, NULL );
+#endif
+}
+
+
+static void YieldThread( void )
+{
+#if defined(_WIN32)
+    SwitchToThread();
+#else
+    sched_yield();
+#endif
+}
+
+
+/* Wait until PaUtil_GetTime() reaches deadline: sleep while it is far off,
+    then yield until it arrives. Returns non-zero, early, if the stream is
+    asked to stop. */
+static int WaitUntil( PaVirtualStream *stream, double deadline )
+{
+    double remaining;
+
+    for( ;; )
+    {
+        if( stream->stopRequested )
+            return 1;
+
+        remaining = deadline - PaUtil_GetTime();
+        if( remaining <= 0. )
+            return 0;
+
+        if( remaining <= PA_VIRTUAL_SPIN_SECONDS )
+            YieldThread();
+        else if( remaining - PA_VIRTUAL_SPIN_SECONDS < PA_VIRTUAL_MAX_SLEEP_SECONDS )
+            SleepSeconds( remaining - PA_VIRTUAL_SPIN_SECONDS );
+        else
+            SleepSeconds( PA_VIRTUAL_MAX_SLEEP_SECONDS );
+    }
+}
+
+
+/* the wall clock time at which frame position of a paced stream is due */
+static double DueTime( PaVirtualStream *stream, double position, double start )
+{
+    return stream->startTime + (position - start) / (stream->sampleRate * stream->speed);
+}
+
+
+/* PA_VIRTUAL_TIMER_SLACK_SECONDS of wall clock time, in frames of the
+    simulated device clock */
+static double TimerSlackFrames( PaVirtualStream *stream )
+{
+    return PA_VIRTUAL_TIMER_SLACK_SECONDS * stream->sampleRate * stream->speed;
+}
+
+
+/* frames of the simulated device clock elapsed since startTime */
+static double ElapsedFrames( PaVirtualStream *stream )
+{
+    return (PaUtil_GetTime() - stream->startTime) * stream->sampleRate * stream->speed;
+}
+
+
+/* the stream time of frame position */
+static PaTime FrameTime( PaVirtualStream *stream, double position, double start )
+{
+    return stream->startStreamTime + (position - start) / stream->sampleRate;
+}
+
+
+static PaTime CurrentStreamTime( PaVirtualStream *stream )
+{
+    if( !stream->isActive )
+        return stream->stopStreamTime;
+
+    if( stream->speed > 0. )
+        return stream->startStreamTime + (PaUtil_GetTime() - stream->startTime) * stream->speed;
+
+    if( stream->hasOutput )
+        return FrameTime( stream, stream->outputPosition, stream->outputStart );
+    return FrameTime( stream, stream->inputPosition, stream->inputStart );
+}
+
+
+/* callback streams ---------------------------------------------------------*/
+
+/* Process the host buffer at outputPosition: read input, run the buffer
+    processor and write output. */
+static void ProcessHostBuffer( PaVirtualStream *stream, PaStreamCallbackFlags statusFlags, int *callbackResult )
+{
+    PaStreamCallbackTimeInfo timeInfo;
+    double hostBufferTime = stream->framesPerHostBuffer / stream->sampleRate;
+    unsigned long framesProcessed;
+
+    timeInfo.currentTime = FrameTime( stream, stream->outputPosition, stream->outputStart );
+    timeInfo.inputBufferAdcTime = timeInfo.currentTime - hostBufferTime;
+    timeInfo.outputBufferDacTime = timeInfo.currentTime + hostBufferTime;
+
+    if( stream->hasInput )
+        ReadEndpoint( &stream->input, stream->hostInputBuffer, stream->framesPerHostBuffer );
+
+    PaUtil_BeginCpuLoadMeasurement( &stream->cpuLoadMeasurer );
+
+    PaUtil_BeginBufferProcessing( &stream->bufferProcessor, &timeInfo, statusFlags );
+
+    if( stream->hasInput )
+    {
+        PaUtil_SetInputFrameCount( &stream->bufferProcessor, 0 /* default to host buffer size */ );
+        PaUtil_SetInterleavedInputChannels( &stream->bufferProcessor, 0, stream->hostInputBuffer, 0 );
+    }
+
+    if( stream->hasOutput )
+    {
+        PaUtil_SetOutputFrameCount( &stream->bufferProcessor, 0 /* default to host buffer size */ );
+        PaUtil_SetInterleavedOutputChannels( &stream->bufferProcessor, 0, stream->hostOutputBuffer, 0 );
+    }
+
+    framesProcessed = PaUtil_EndBufferProcessing( &stream->bufferProcessor, callbackResult );
+
+    PaUtil_EndCpuLoadMeasurement( &stream->cpuLoadMeasurer, framesProcessed );
+
+    if( stream->hasOutput )
+        WriteEndpoint( &stream->output, stream->hostOutputBuffer, stream->framesPerHostBuffer );
+
+    stream->inputPosition += stream->framesPerHostBuffer;
+    stream->outputPosition += stream->framesPerHostBuffer;
+}
+
+
+#if defined(_WIN32)
+static DWORD WINAPI ProcessingThreadFunc( LPVOID userData )
+#else
+static void *ProcessingThreadFunc( void *userData )
+#endif
+{
+    PaVirtualStream *stream = (PaVirtualStream*)userData;
+    PaStreamCallbackFlags statusFlags = 0;
+    int callbackResult = paContinue;
+    double lateness, allowedLateness;
+
+    /* a buffer may be late by what the device buffers beyond it, and by at
+        least one host buffer, before the simulated device runs dry */
+    allowedLateness = (double)(stream->bufferFrames - stream->framesPerHostBuffer);
+    if( allowedLateness < (double)stream->framesPerHostBuffer )
+        allowedLateness = (double)stream->framesPerHostBuffer;
+
+    while( !stream->stopRequested )
+    {
+        if( stream->speed > 0. )
+        {
+            if( WaitUntil( stream, DueTime( stream, stream->outputPosition, stream->outputStart ) ) )
+                break;
+
+            /* more than the device buffer behind the clock: the simulated
+                device ran dry, report it and catch up */
+            lateness = ElapsedFrames( stream ) - (stream->outputPosition - stream->outputStart);
+            if( lateness > allowedLateness + TimerSlackFrames( stream ) )
+            {
+                if( stream->hasInput )
+                    statusFlags |= paInputOverflow;
+                if( stream->hasOutput )
+                    statusFlags |= paOutputUnderflow;
+                stream->inputStart -= lateness;
+                stream->outputStart -= lateness;
+            }
+        }
+
+        ProcessHostBuffer( stream, statusFlags, &callbackResult );
+        statusFlags = 0;
+
+        if( callbackResult == paContinue
+                && (((stream->input.flags & paVirtualCompleteAtEnd) && stream->input.ended)
+                    || ((stream->output.flags & paVirtualCompleteAtEnd) && stream->output.ended)) )
+        {
+            callbackResult = paComplete;
+        }
+
+        if( callbackResult == paAbort )
+            break;
+
+        /* after paComplete, keep going until the buffer processor has
+            delivered all the output the callback produced */
+        if( callbackResult != paContinue
+                && (!stream->hasOutput || stream->output.ended
+                    || PaUtil_IsBufferProcessorOutputEmpty( &stream->bufferProcessor )) )
+            break;
+    }
+
+    stream->stopStreamTime = FrameTime( stream, stream->outputPosition, stream->outputStart );
+    FinishWaveFile( &stream->output );
+    stream->isActive = 0;
+
+    if( stream->streamRepresentation.streamFinishedCallback != 0 )
+        stream->streamRepresentation.streamFinishedCallback( stream->streamRepresentation.userData );
+
+    PaUtil_ReleaseTraceThread();
+
+    return 0;
+}
+
+
+static PaError StartStream( PaStream *s )
+{
+    PaError result = paNoError;
+    PaVirtualStream *stream = (PaVirtualStream*)s;
+
+    PaUtil_ResetBufferProcessor( &stream->bufferProcessor );
+
+    /* the clock carries on from where it was stopped */
+    stream->startStreamTime = stream->stopStreamTime;
+    stream->startTime = PaUtil_GetTime();
+    stream->inputStart = stream->inputPosition;
+    stream->outputStart = stream->outputPosition;
+
+    stream->stopRequested = 0;
+    stream->isStopped = 0;
+    stream->isActive = 1;
+
+    if( stream->bufferProcessor.streamCallback )
+    {
+#if defined(_WIN32)
+        stream->thread = CreateThread( NULL, 0, ProcessingThreadFunc, stream, 0, NULL );
+        if( stream->thread == NULL )
+#else
+        if( pthread_create( &stream->thread, NULL, ProcessingThreadFunc, stream ) != 0 )
+#endif
+        {
+            stream->isActive = 0;
+            stream->isStopped = 1;
+            PA_VIRTUAL_SET_LAST_HOST_ERROR( 0, "couldn't create the processing thread" );
+            return paUnanticipatedHostError;
+        }
+        stream->threadStarted = 1;
+    }
+
+    return result;
+}
+
+
+static PaError StopStream( PaStream *s )
+{
+    PaError result = paNoError;
+    PaVirtualStream *stream = (PaVirtualStream*)s;
+
+    if( stream->threadStarted )
+    {
+        /* the thread finishes the file and calls the finished callback */
+        stream->stopRequested = 1;
+#if defined(_WIN32)
+        WaitForSingleObject( stream->thread, INFINITE );
+        CloseHandle( stream->thread );
+#else
+        pthread_join( stream->thread, NULL );
+#endif
+        stream->threadStarted = 0;
+    }
+    else if( stream->isActive )
+    {
+        stream->stopStreamTime = CurrentStreamTime( stream );
+        FinishWaveFile( &stream->output );
+        stream->isActive = 0;
+
+        if( stream->streamRepresentation.streamFinishedCallback != 0 )
+            stream->streamRepresentation.streamFinishedCallback( stream->streamRepresentation.userData );
+    }
+
+    stream->isStopped = 1;
+
+    return result;
+}
+
+
+static PaError AbortStream( PaStream *s )
+{
+    /* nothing is queued beyond the current host buffer, so stopping is as
+        quick as aborting */
+    return StopStream( s );
+}
+
+
+static PaError IsStreamStopped( PaStream *s )
+{
+    PaVirtualStream *stream = (PaVirtualStream*)s;
+
+    return stream->isStopped;
+}
+
+
+static PaError IsStreamActive( PaStream *s )
+{
+    PaVirtualStream *stream = (PaVirtualStream*)s;
+
+    return stream->isActive;
+}
+
+
+static PaTime GetStreamTime( PaStream *s )
+{
+    PaVirtualStream *stream = (PaVirtualStream*)s;
+
+    return CurrentStreamTime( stream );
+}
+
+
+static double GetStreamCpuLoad( PaStream* s )
+{
+    PaVirtualStream *stream = (PaVirtualStream*)s;
+
+    return PaUtil_GetCpuLoad( &stream->cpuLoadMeasurer );
+}
+
+
+/* blocking streams ---------------------------------------------------------*/
+
+/*
+    As separate stream interfaces are used for blocking and callback
+    streams, the following functions can be guaranteed to only be called
+    for blocking streams.
+*/
+
+static PaError ReadStream( PaStream* s,
+                           void *buffer,
+                           unsigned long frames )
+{
+    PaError result = paNoError;
+    PaVirtualStream *stream = (PaVirtualStream*)s;
+    void *userBuffer;
+    unsigned long n;
+    double available;
+
+    if( stream->bufferProcessor.userInputIsInterleaved )
+    {
+        userBuffer = buffer;
+    }
+    else
+    {
+        /* the buffer processor advances the pointers, so use a copy */
+        userBuffer = stream->userInputPointers;
+        memcpy( userBuffer, buffer, sizeof(void*) * stream->input.channelCount );
+    }
+
+    while( frames > 0 )
+    {
+        n = frames < stream->framesPerHostBuffer ? frames : stream->framesPerHostBuffer;
+
+        if( stream->speed > 0. && stream->isActive )
+        {
+            /* the simulated device buffer filled up: report it, and keep a
+                full buffer from now on */
+            available = ElapsedFrames( stream ) - (stream->inputPosition - stream->inputStart);
+            if( available > (double)stream->bufferFrames + TimerSlackFrames( stream ) )
+            {
+                result = paInputOverflowed;
+                stream->inputStart -= available - stream->bufferFrames;
+            }
+
+            WaitUntil( stream, DueTime( stream, stream->inputPosition + n, stream->inputStart ) );
+        }
+
+        ReadEndpoint( &stream->input, stream->hostInputBuffer, n );
+
+        PaUtil_SetInputFrameCount( &stream->bufferProcessor, n );
+        PaUtil_SetInterleavedInputChannels( &stream->bufferProcessor, 0, stream->hostInputBuffer, 0 );
+        PaUtil_CopyInput( &stream->bufferProcessor, &userBuffer, n );
+
+        stream->inputPosition += n;
+        frames -= n;
+    }
+
+    return result;
+}
+
+
+static PaError WriteStream( PaStream* s,
+                            const void *buffer,
+                            unsigned long frames )
+{
+    PaError result = paNoError;
+    PaVirtualStream *stream = (PaVirtualStream*)s;
+    const void *userBuffer;
+    unsigned long n;
+    double queued;
+
+    if( stream->bufferProcessor.userOutputIsInterleaved )
+    {
+        userBuffer = buffer;
+    }
+    else
+    {
+        /* the buffer processor advances the pointers, so use a copy */
+        memcpy( stream->userOutputPointers, buffer, sizeof(void*) * stream->output.channelCount );
+        userBuffer = stream->userOutputPointers;
+    }
+
+    while( frames > 0 )
+    {
+        n = frames < stream->framesPerHostBuffer ? frames : stream->framesPerHostBuffer;
+
+        if( stream->speed > 0. && stream->isActive )
+        {
+            /* the simulated device played everything it was given: report
+                it, and start again from an empty buffer */
+            queued = (stream->outputPosition - stream->outputStart) - ElapsedFrames( stream );
+            if( queued < -TimerSlackFrames( stream ) )
+            {
+                result = paOutputUnderflowed;
+                stream->outputStart += queued;
+            }
+
+            /* wait for room in the device buffer */
+            WaitUntil( stream, DueTime( stream, stream->outputPosition + n - stream->bufferFrames,
+                    stream->outputStart ) );
+        }
+
+        PaUtil_SetOutputFrameCount( &stream->bufferProcessor, n );
+        PaUtil_SetInterleavedOutputChannels( &stream->bufferProcessor, 0, stream->hostOutputBuffer, 0 );
+        PaUtil_CopyOutput( &stream->bufferProcessor, &userBuffer, n );
+
+        WriteEndpoint( &stream->output, stream->hostOutputBuffer, n );
+
+        stream->outputPosition += n;
+        frames -= n;
+    }
+
+    return result;
+}
+
+
+static signed long GetStreamReadAvailable( PaStream* s )
+{
+    PaVirtualStream *stream = (PaVirtualStream*)s;
+    double available;
+
+    /* a free running stream never waits */
+    if( stream->speed == 0. || !stream->isActive )
+        return (signed long)stream->bufferFrames;
+
+    available = ElapsedFrames( stream ) - (stream->inputPosition - stream->inputStart);
+    if( available < 0. )
+        return 0;
+    if( available > (double)stream->bufferFrames )
+        return (signed long)stream->bufferFrames;
+    return (signed long)available;
+}
+
+
+static signed long GetStreamWriteAvailable( PaStream* s )
+{
+    PaVirtualStream *stream = (PaVirtualStream*)s;
+    double queued;
+
+    if( stream->speed == 0. || !stream->isActive )
+        return (signed long)stream->bufferFrames;
+
+    queued = (stream->outputPosition - stream->outputStart) - ElapsedFrames( stream );
+    if( queued < 0. )
+        return (signed long)stream->bufferFrames;
+    if( queued > (double)stream->bufferFrames )
+        return 0;
+    return (signed long)(stream->bufferFrames - queued);
+}
+
+
+/* extensions ---------------------------------------------------------------*/
+
+void PaVirtual_InitializeStreamInfo( PaVirtualStreamInfo *info )
+{
+    info->size = sizeof (PaVirtualStreamInfo);
+    info->hostApiType = paVirtual;
+    info->version = 1;
+    info->flags = 0;
+    info->speed = 0.;
+    info->endpointType = paVirtualNull;
+    info->fileName = NULL;
+    info->buffer = NULL;
+    info->bufferFrames = 0;
+    info->sampleFormat = 0;
+}
+
+
+PaError PaVirtual_GetStreamFrames( PaStream *s, unsigned long *inputFrames, unsigned long *outputFrames )
+{
+    PaError result;
+    PaUtilHostApiRepresentation *hostApi;
+    PaVirtualHostApiRepresentation *virtualHostApi;
+    PaVirtualStream *stream = (PaVirtualStream*)s;
+
+    result = PaUtil_ValidateStreamPointer( s );
+    if( result != paNoError )
+        return result;
+
+    result = PaUtil_GetHostApiRepresentation( &hostApi, paVirtual );
+    if( result != paNoError )
+        return result;
+    virtualHostApi = (PaVirtualHostApiRepresentation*)hostApi;
+
+    if( PA_STREAM_REP( s )->streamInterface != &virtualHostApi->callbackStreamInterface
+            && PA_STREAM_REP( s )->streamInterface != &virtualHostApi->blockingStreamInterface )
+        return paIncompatibleStreamHostApi;
+
+    if( inputFrames )
+        *inputFrames = stream->input.frames;
+    if( outputFrames )
+        *outputFrames = stream->output.frames;
+
+    return paNoError;
+}
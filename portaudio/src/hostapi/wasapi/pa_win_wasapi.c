@@ -4116,6 +4116,8 @@ static PaError OpenStream( struct PaUtilHostApiRepresentation *hostApi,
             LogPaError(result);
             goto error;
         }
+        PaUtil_AttachCallbackProfile(&stream->bufferProcessor, &stream->cpuLoadMeasurer,
+            &stream->streamRepresentation.profile);
     }
 
     // Set Input latency
@@ -4809,6 +4809,8 @@ static PaError OpenStream( struct PaUtilHostApiRepresentation *hostApi,
             max(stream->capture.framesPerBuffer, stream->render.framesPerBuffer));
         goto error;
     }
+    PaUtil_AttachCallbackProfile( &stream->bufferProcessor, &stream->cpuLoadMeasurer,
+            &stream->streamRepresentation.profile );
 
     /* Allocate/get all the buffers for host I/O */
     if (stream->userInputChannels > 0)
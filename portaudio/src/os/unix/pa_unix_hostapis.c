@@ -50,6 +50,7 @@ PaError PaSGI_Initialize( PaUtilHostApiRepresentation **hostApi, PaHostApiIndex
 /* Linux AudioScience HPI */
 PaError PaAsiHpi_Initialize( PaUtilHostApiRepresentation **hostApi, PaHostApiIndex index );
 PaError PaMacCore_Initialize( PaUtilHostApiRepresentation **hostApi, PaHostApiIndex index );
+PaError PaVirtual_Initialize( PaUtilHostApiRepresentation **hostApi, PaHostApiIndex index );
 PaError PaSkeleton_Initialize( PaUtilHostApiRepresentation **hostApi, PaHostApiIndex index );
 
 /** Note that on Linux, ALSA is placed before OSS so that the former is preferred over the latter.
@@ -95,6 +96,10 @@ PaUtilHostApiInitializer *paHostApiInitializers[] =
         PaMacCore_Initialize,
 #endif
 
+#if PA_USE_VIRTUAL
+        PaVirtual_Initialize, /* after the hardware host APIs so it isn't the default */
+#endif
+
 #if PA_USE_SKELETON
         PaSkeleton_Initialize,
 #endif
@@ -57,6 +57,7 @@ extern "C"
 {
 #endif /* __cplusplus */
 
+PaError PaVirtual_Initialize( PaUtilHostApiRepresentation **hostApi, PaHostApiIndex index );
 PaError PaSkeleton_Initialize( PaUtilHostApiRepresentation **hostApi, PaHostApiIndex index );
 PaError PaWinMme_Initialize( PaUtilHostApiRepresentation **hostApi, PaHostApiIndex index );
 PaError PaWinDs_Initialize( PaUtilHostApiRepresentation **hostApi, PaHostApiIndex index );
@@ -92,6 +93,10 @@ PaUtilHostApiInitializer *paHostApiInitializers[] =
         PaWinWdm_Initialize,
 #endif
 
+#if PA_USE_VIRTUAL
+        PaVirtual_Initialize, /* after the hardware host APIs so it isn't the default */
+#endif
+
 #if PA_USE_SKELETON
         PaSkeleton_Initialize, /* just for testing. last in list so it isn't marked as default. */
 #endif
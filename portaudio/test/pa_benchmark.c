@@ -0,0 +1,585 @@
+/** @file pa_benchmark.c
+	@ingroup test_src
+	@brief Measure the throughput of the sample converters, zeroers, dither
+	generators and buffer processor, in memory, without an audio device.
+
+	Usage: pa_benchmark [--json] [--no-simd] [--time seconds]
+
+	Every converter returned by PaUtil_SelectConverter() for each pair of
+	standard sample formats and each combination of clip and dither flags
+	is timed, as is every zeroer, the dither generators and
+	PaUtil_EndBufferProcessing() in each host buffer size mode and
+	direction. Each case is run over several buffer sizes and channel
+	counts.
+
+	One result is printed per line, as CSV with a header line by default or
+	as JSON objects with --json, so that runs can be compared by a script
+	for regression tracking. ns_per_frame is the time per frame of all
+	channels; gb_per_s counts the bytes read plus the bytes written.
+
+	--no-simd times the standard converters alone, without installing the
+	vectorized ones (see pa_simd_converters.h). --time sets the minimum
+	measurement time per case (default 0.02 seconds); the best of three
+	measurements is reported.
+*/
+/*
+ * $Id$
+ *
+ * This program uses the PortAudio Portable Audio Library.
+ * For more information see: http://www.portaudio.com
+ * Copyright (c) 1999-2000 Ross Bencina and Phil Burk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * The text above constitutes the entire PortAudio license; however, 
+ * the PortAudio community also makes the following non-binding requests:
+ *
+ * Any person wishing to distribute modifications to the Software is
+ * requested to send the modifications to the original developer so that
+ * they can be incorporated into the canonical version. It is also 
+ * requested that these non-binding requests be included along with the 
+ * license above.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "portaudio.h"
+#include "pa_converters.h"
+#include "pa_dither.h"
+#include "pa_process.h"
+#include "pa_simd_converters.h"
+#include "pa_types.h"
+#include "pa_util.h"
+
+
+#define MAX_FRAME_COUNT         (1024)
+#define MAX_CHANNEL_COUNT       (8)
+#define MAX_SAMPLE_SIZE         (4)
+#define MEASUREMENT_COUNT       (3)
+
+
+#define SAMPLE_FORMAT_COUNT (6)
+
+static PaSampleFormat sampleFormats_[ SAMPLE_FORMAT_COUNT ] =
+    { paFloat32, paInt32, paInt24, paInt16, paInt8, paUInt8 };
+
+static const char* sampleFormatNames_[ SAMPLE_FORMAT_COUNT ] =
+    { "float32", "int32", "int24", "int16", "int8", "uint8" };
+
+
+#define FLAG_SET_COUNT (5)
+
+static PaStreamFlags flagSets_[ FLAG_SET_COUNT ] =
+    { paNoFlag, paClipOff, paDitherOff, paClipOff | paDitherOff, paDitherNoiseShapedFirstOrder };
+
+static const char* flagSetNames_[ FLAG_SET_COUNT ] =
+    { "clip_dither", "dither", "clip", "plain", "noise_shaped" };
+
+
+static const unsigned long frameCounts_[] = { 64, 256, 1024 };
+#define FRAME_COUNT_COUNT (sizeof(frameCounts_) / sizeof(frameCounts_[0]))
+
+static const int channelCounts_[] = { 1, 2, 8 };
+#define CHANNEL_COUNT_COUNT (sizeof(channelCounts_) / sizeof(channelCounts_[0]))
+
+
+static int json_ = 0;
+static double minimumSeconds_ = 0.02;
+static const char *isaName_ = "scalar";
+
+/* source and destination buffers, large enough for any case */
+static unsigned char source_[ MAX_FRAME_COUNT * MAX_CHANNEL_COUNT * MAX_SAMPLE_SIZE ];
+static unsigned char destination_[ MAX_FRAME_COUNT * MAX_CHANNEL_COUNT * MAX_SAMPLE_SIZE ];
+static PaUtilTriangularDitherGenerator ditherGenerators_[ MAX_CHANNEL_COUNT ];
+
+
+/* A case is run by calling its function iterationCount times. */
+typedef void BenchmarkFunction( void *context );
+
+static double BestSecondsPerIteration( BenchmarkFunction *function, void *context )
+{
+    double best = 0., start, elapsed;
+    long iterations = 1, i;
+    int measurement;
+
+    /* find an iteration count which runs for minimumSeconds_ */
+    for( ;; )
+    {
+        start = PaUtil_GetTime();
+        for( i=0; i < iterations; ++i )
+            function( context );
+        elapsed = PaUtil_GetTime() - start;
+
+        if( elapsed >= minimumSeconds_ || iterations >= (1L << 28) )
+            break;
+        if( elapsed > minimumSeconds_ * .01 )
+            iterations = (long)(iterations * 1.1 * minimumSeconds_ / elapsed) + 1;
+        else
+            iterations *= 10;
+    }
+    best = elapsed / iterations;
+
+    for( measurement=1; measurement < MEASUREMENT_COUNT; ++measurement )
+    {
+        start = PaUtil_GetTime();
+        for( i=0; i < iterations; ++i )
+            function( context );
+        elapsed = (PaUtil_GetTime() - start) / iterations;
+        if( elapsed < best )
+            best = elapsed;
+    }
+
+    return best;
+}
+
+
+static void PrintHeader( void )
+{
+    if( !json_ )
+        printf( "group,name,layout,frames,channels,isa,ns_per_frame,gb_per_s\n" );
+}
+
+
+static void PrintResult( const char *group, const char *name, const char *layout,
+        unsigned long frames, int channels, double secondsPerIteration, double bytesPerIteration )
+{
+    double nsPerFrame = secondsPerIteration * 1e9 / frames;
+    double gbPerSecond = bytesPerIteration / secondsPerIteration * 1e-9;
+
+    if( json_ )
+    {
+        printf( "{\"group\":\"%s\",\"name\":\"%s\",\"layout\":\"%s\",\"frames\":%lu,\"channels\":%d,"
+                "\"isa\":\"%s\",\"ns_per_frame\":%.4f,\"gb_per_s\":%.4f}\n",
+                group, name, layout, frames, channels, isaName_, nsPerFrame, gbPerSecond );
+    }
+    else
+    {
+        printf( "%s,%s,%s,%lu,%d,%s,%.4f,%.4f\n",
+                group, name, layout, frames, channels, isaName_, nsPerFrame, gbPerSecond );
+    }
+    fflush( stdout );
+}
+
+
+/* Fill source_ with samples in the given format. Float samples range a
+    little beyond [-1, 1] so that the clipping paths are taken; integer
+    samples are pseudo random. */
+static void FillSource( PaSampleFormat format )
+{
+    PaUint32 state = 0x12345678;
+    unsigned long i;
+
+    if( format == paFloat32 )
+    {
+        float *samples = (float*)source_;
+        for( i=0; i < sizeof(source_) / sizeof(float); ++i )
+        {
+            state = state * 1664525 + 1013904223;
+            samples[i] = ((float)(state >> 8) / (float)(1 << 24)) * 2.2f - 1.1f;
+        }
+    }
+    else
+    {
+        for( i=0; i < sizeof(source_); ++i )
+        {
+            state = state * 1664525 + 1013904223;
+            source_[i] = (unsigned char)(state >> 24);
+        }
+    }
+}
+
+
+static void ResetDitherGenerators( PaStreamFlags flags )
+{
+    int i;
+
+    for( i=0; i < MAX_CHANNEL_COUNT; ++i )
+    {
+        PaUtil_SeedTriangularDitherState( &ditherGenerators_[i], (PaUint32)i );
+        PaUtil_SetDitherNoiseShaping( &ditherGenerators_[i],
+                (flags & paDitherNoiseShapedFirstOrder) ? paUtilDitherNoiseShapedFirstOrder : paUtilDitherTriangular );
+    }
+}
+
+
+/* converters ---------------------------------------------------------------*/
+
+typedef struct
+{
+    PaUtilConverter *converter;
+    int sourceSampleSize;
+    int destinationSampleSize;
+    unsigned long frames;
+    int channels;
+    int run;    /* convert all channels as one unit-stride run */
+} ConverterCase;
+
+static void RunConverter( void *context )
+{
+    ConverterCase *c = (ConverterCase*)context;
+    int i;
+
+    if( c->run )
+    {
+        c->converter( destination_, 1, source_, 1,
+                (unsigned int)(c->frames * c->channels), &ditherGenerators_[0] );
+    }
+    else
+    {
+        for( i=0; i < c->channels; ++i )
+        {
+            c->converter( destination_ + i * c->destinationSampleSize, c->channels,
+                    source_ + i * c->sourceSampleSize, c->channels,
+                    (unsigned int)c->frames, &ditherGenerators_[i] );
+        }
+    }
+}
+
+static void BenchmarkConverters( void )
+{
+    PaUtilConverter *timed[ FLAG_SET_COUNT ];
+    ConverterCase c;
+    char name[64];
+    int source, destination, flagSet, timedCount, i, layout;
+    unsigned int frameIndex, channelIndex;
+
+    for( source=0; source < SAMPLE_FORMAT_COUNT; ++source )
+    {
+        FillSource( sampleFormats_[source] );
+
+        for( destination=0; destination < SAMPLE_FORMAT_COUNT; ++destination )
+        {
+            timedCount = 0;
+            for( flagSet=0; flagSet < FLAG_SET_COUNT; ++flagSet )
+            {
+                c.converter = PaUtil_SelectConverter( sampleFormats_[source],
+                        sampleFormats_[destination], flagSets_[flagSet] );
+                if( !c.converter )
+                    continue;
+
+                /* flags which don't apply to a pair select the same converter */
+                for( i=0; i < timedCount; ++i )
+                    if( timed[i] == c.converter )
+                        break;
+                if( i < timedCount )
+                    continue;
+                timed[ timedCount++ ] = c.converter;
+
+                sprintf( name, "%s_to_%s_%s", sampleFormatNames_[source],
+                        sampleFormatNames_[destination], flagSetNames_[flagSet] );
+                c.sourceSampleSize = Pa_GetSampleSize( sampleFormats_[source] );
+                c.destinationSampleSize = Pa_GetSampleSize( sampleFormats_[destination] );
+                ResetDitherGenerators( flagSets_[flagSet] );
+
+                for( frameIndex=0; frameIndex < FRAME_COUNT_COUNT; ++frameIndex )
+                {
+                    for( channelIndex=0; channelIndex < CHANNEL_COUNT_COUNT; ++channelIndex )
+                    {
+                        c.frames = frameCounts_[frameIndex];
+                        c.channels = channelCounts_[channelIndex];
+
+                        /* strided per channel conversion, and for interleaved
+                            buffers the single run used by the buffer processor */
+                        for( layout=0; layout < (c.channels > 1 ? 2 : 1); ++layout )
+                        {
+                            c.run = layout;
+                            PrintResult( "converter", name, layout ? "run" : "strided", c.frames, c.channels,
+                                    BestSecondsPerIteration( RunConverter, &c ),
+                                    (double)c.frames * c.channels * (c.sourceSampleSize + c.destinationSampleSize) );
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+
+/* zeroers ------------------------------------------------------------------*/
+
+typedef struct
+{
+    PaUtilZeroer *zeroer;
+    int sampleSize;
+    unsigned long frames;
+    int channels;
+} ZeroerCase;
+
+static void RunZeroer( void *context )
+{
+    ZeroerCase *c = (ZeroerCase*)context;
+    int i;
+
+    for( i=0; i < c->channels; ++i )
+        c->zeroer( destination_ + i * c->sampleSize, c->channels, (unsigned int)c->frames );
+}
+
+static void BenchmarkZeroers( void )
+{
+    ZeroerCase c;
+    int format;
+    unsigned int frameIndex, channelIndex;
+
+    for( format=0; format < SAMPLE_FORMAT_COUNT; ++format )
+    {
+        c.zeroer = PaUtil_SelectZeroer( sampleFormats_[format] );
+        if( !c.zeroer )
+            continue;
+        c.sampleSize = Pa_GetSampleSize( sampleFormats_[format] );
+
+        for( frameIndex=0; frameIndex < FRAME_COUNT_COUNT; ++frameIndex )
+        {
+            for( channelIndex=0; channelIndex < CHANNEL_COUNT_COUNT; ++channelIndex )
+            {
+                c.frames = frameCounts_[frameIndex];
+                c.channels = channelCounts_[channelIndex];
+                PrintResult( "zeroer", sampleFormatNames_[format], "strided", c.frames, c.channels,
+                        BestSecondsPerIteration( RunZeroer, &c ),
+                        (double)c.frames * c.channels * c.sampleSize );
+            }
+        }
+    }
+}
+
+
+/* dither -------------------------------------------------------------------*/
+
+typedef struct
+{
+    unsigned long frames;
+    int channels;
+} DitherCase;
+
+static void RunDither16( void *context )
+{
+    DitherCase *c = (DitherCase*)context;
+    PaInt32 *dither = (PaInt32*)destination_;
+    unsigned long i;
+    int channel;
+
+    for( channel=0; channel < c->channels; ++channel )
+        for( i=0; i < c->frames; ++i )
+            dither[i] = PaUtil_Generate16BitTriangularDither( &ditherGenerators_[channel] );
+}
+
+static void RunDitherFloat( void *context )
+{
+    DitherCase *c = (DitherCase*)context;
+    float *dither = (float*)destination_;
+    unsigned long i;
+    int channel;
+
+    for( channel=0; channel < c->channels; ++channel )
+        for( i=0; i < c->frames; ++i )
+            dither[i] = PaUtil_GenerateFloatTriangularDither( &ditherGenerators_[channel] );
+}
+
+static void RunDither16Block( void *context )
+{
+    DitherCase *c = (DitherCase*)context;
+    int channel;
+
+    for( channel=0; channel < c->channels; ++channel )
+        PaUtil_Generate16BitTriangularDitherBlock( &ditherGenerators_[channel],
+                (PaInt32*)destination_, (unsigned int)c->frames );
+}
+
+static void RunDitherFloatBlock( void *context )
+{
+    DitherCase *c = (DitherCase*)context;
+    int channel;
+
+    for( channel=0; channel < c->channels; ++channel )
+        PaUtil_GenerateFloatTriangularDitherBlock( &ditherGenerators_[channel],
+                (float*)destination_, (unsigned int)c->frames );
+}
+
+static void BenchmarkDither( void )
+{
+    static BenchmarkFunction *functions[] =
+        { RunDither16, RunDitherFloat, RunDither16Block, RunDitherFloatBlock };
+    static const char *names[] =
+        { "int16_per_sample", "float_per_sample", "int16_block", "float_block" };
+    DitherCase c;
+    unsigned int function, frameIndex, channelIndex;
+
+    ResetDitherGenerators( paNoFlag );
+
+    for( function=0; function < sizeof(functions) / sizeof(functions[0]); ++function )
+    {
+        for( frameIndex=0; frameIndex < FRAME_COUNT_COUNT; ++frameIndex )
+        {
+            for( channelIndex=0; channelIndex < CHANNEL_COUNT_COUNT; ++channelIndex )
+            {
+                c.frames = frameCounts_[frameIndex];
+                c.channels = channelCounts_[channelIndex];
+                PrintResult( "dither", names[function], "block", c.frames, c.channels,
+                        BestSecondsPerIteration( functions[function], &c ),
+                        (double)c.frames * c.channels * 4 );
+            }
+        }
+    }
+}
+
+
+/* buffer processor ---------------------------------------------------------*/
+
+#define HOST_MODE_COUNT (5)
+
+static PaUtilHostBufferSizeMode hostModes_[ HOST_MODE_COUNT ] =
+    { paUtilFixedHostBufferSize, paUtilFixedHostBufferSize, paUtilBoundedHostBufferSize,
+      paUtilUnknownHostBufferSize, paUtilVariableHostBufferSizePartialUsageAllowed };
+
+/* frames per user buffer for each mode: 64 divides every host buffer size,
+    so the first case doesn't need to adapt; 60 never does, so the second does */
+static unsigned long userFrames_[ HOST_MODE_COUNT ] = { 64, 60, 64, 64, 64 };
+
+static const char *hostModeNames_[ HOST_MODE_COUNT ] =
+    { "fixed", "fixed_mismatched", "bounded", "unknown", "variable_partial" };
+
+static const char *directionNames_[] = { "input", "output", "duplex" };
+
+typedef struct
+{
+    PaUtilBufferProcessor bufferProcessor;
+    PaStreamCallbackTimeInfo timeInfo;
+    unsigned long frames;
+    int channels;
+    int input, output;
+} BufferProcessorCase;
+
+static int NullCallback( const void *input, void *output, unsigned long frameCount,
+        const PaStreamCallbackTimeInfo* timeInfo, PaStreamCallbackFlags statusFlags, void *userData )
+{
+    (void)input; (void)output; (void)frameCount; (void)timeInfo; (void)statusFlags; (void)userData;
+    return paContinue;
+}
+
+/* Process one host buffer the way a host API implementation does: Int16
+    interleaved on the host side, Float32 interleaved for the callback. */
+static void RunBufferProcessor( void *context )
+{
+    BufferProcessorCase *c = (BufferProcessorCase*)context;
+    int callbackResult = paContinue;
+
+    PaUtil_BeginBufferProcessing( &c->bufferProcessor, &c->timeInfo, 0 );
+    if( c->input )
+    {
+        PaUtil_SetInputFrameCount( &c->bufferProcessor, c->frames );
+        PaUtil_SetInterleavedInputChannels( &c->bufferProcessor, 0, source_, 0 );
+    }
+    if( c->output )
+    {
+        PaUtil_SetOutputFrameCount( &c->bufferProcessor, c->frames );
+        PaUtil_SetInterleavedOutputChannels( &c->bufferProcessor, 0, destination_, 0 );
+    }
+    PaUtil_EndBufferProcessing( &c->bufferProcessor, &callbackResult );
+}
+
+static void BenchmarkBufferProcessor( void )
+{
+    BufferProcessorCase c;
+    char name[64];
+    int mode, direction;
+    unsigned int frameIndex, channelIndex;
+    PaError result;
+
+    FillSource( paInt16 );
+    memset( &c.timeInfo, 0, sizeof(c.timeInfo) );
+
+    for( mode=0; mode < HOST_MODE_COUNT; ++mode )
+    {
+        for( direction=0; direction < 3; ++direction )
+        {
+            c.input = (direction != 1);
+            c.output = (direction != 0);
+
+            for( frameIndex=0; frameIndex < FRAME_COUNT_COUNT; ++frameIndex )
+            {
+                for( channelIndex=0; channelIndex < CHANNEL_COUNT_COUNT; ++channelIndex )
+                {
+                    c.frames = frameCounts_[frameIndex];
+                    c.channels = channelCounts_[channelIndex];
+
+                    result = PaUtil_InitializeBufferProcessor( &c.bufferProcessor,
+                            c.input ? c.channels : 0, paFloat32, paInt16,
+                            c.output ? c.channels : 0, paFloat32, paInt16,
+                            48000., paNoFlag, userFrames_[mode], c.frames, hostModes_[mode],
+                            NullCallback, NULL );
+                    if( result != paNoError )
+                    {
+                        fprintf( stderr, "PaUtil_InitializeBufferProcessor failed: %s\n", Pa_GetErrorText( result ) );
+                        continue;
+                    }
+                    PaUtil_ResetBufferProcessor( &c.bufferProcessor );
+
+                    sprintf( name, "%s_%s_%s", directionNames_[direction], hostModeNames_[mode],
+                            c.bufferProcessor.useNonAdaptingProcess ? "nonadapting" : "adapting" );
+                    PrintResult( "buffer_processor", name, "interleaved", c.frames, c.channels,
+                            BestSecondsPerIteration( RunBufferProcessor, &c ),
+                            (double)c.frames * c.channels * (c.input + c.output) * (2 + 4) );
+
+                    PaUtil_TerminateBufferProcessor( &c.bufferProcessor );
+                }
+            }
+        }
+    }
+}
+
+
+int main( int argc, char **argv )
+{
+    int useSimd = 1, i;
+
+    for( i=1; i < argc; ++i )
+    {
+        if( strcmp( argv[i], "--json" ) == 0 )
+            json_ = 1;
+        else if( strcmp( argv[i], "--no-simd" ) == 0 )
+            useSimd = 0;
+        else if( strcmp( argv[i], "--time" ) == 0 && i + 1 < argc )
+            minimumSeconds_ = atof( argv[++i] );
+        else
+        {
+            fprintf( stderr, "usage: %s [--json] [--no-simd] [--time seconds]\n", argv[0] );
+            return 1;
+        }
+    }
+
+    PaUtil_InitializeClock();
+    if( useSimd )
+    {
+        PaUtil_InitializeSimdConverters();
+        if( PaUtil_GetSimdConvertersName() )
+            isaName_ = PaUtil_GetSimdConvertersName();
+    }
+
+    PrintHeader();
+    BenchmarkConverters();
+    BenchmarkZeroers();
+    BenchmarkDither();
+    BenchmarkBufferProcessor();
+
+    return 0;
+}
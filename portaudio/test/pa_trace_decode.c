@@ -0,0 +1,222 @@
+/** @file pa_trace_decode.c
+	@ingroup test_src
+	@brief Convert a binary trace written by PaUtil_StartTrace() into
+	Chrome trace JSON, for viewing in chrome://tracing or Perfetto.
+
+	Usage: pa_trace_decode trace.bin [trace.json]
+
+	The JSON is written to stdout when no output file is given. Callbacks
+	become duration events; xruns, poll wakeups, dropped records and client
+	events become instant events on the thread which recorded them.
+*/
+/*
+ * $Id$
+ *
+ * This program uses the PortAudio Portable Audio Library.
+ * For more information see: http://www.portaudio.com
+ * Copyright (c) 1999-2000 Ross Bencina and Phil Burk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files
+ * (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be
+ * included in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF
+ * CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION
+ * WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * The text above constitutes the entire PortAudio license; however, 
+ * the PortAudio community also makes the following non-binding requests:
+ *
+ * Any person wishing to distribute modifications to the Software is
+ * requested to send the modifications to the original developer so that
+ * they can be incorporated into the canonical version. It is also 
+ * requested that these non-binding requests be included along with the 
+ * license above.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "portaudio.h"
+#include "pa_tracering.h"
+
+#define RECORDS_PER_READ    (256)
+
+
+static PaUint32 Swap32( PaUint32 x )
+{
+    return (x >> 24) | ((x >> 8) & 0xFF00) | ((x << 8) & 0xFF0000) | (x << 24);
+}
+
+
+/* Timestamps are printed in microseconds, as Chrome expects. */
+static double ToMicroseconds( const PaUtilTraceRecord *record )
+{
+    return (record->timeHigh * 4294967296. + record->timeLow) * 1e-3;
+}
+
+
+static void PrintXrunCauses( FILE *out, PaInt32 flags )
+{
+    const char *separator = "";
+
+    fprintf( out, "\"" );
+    if( flags & paInputUnderflow ) { fprintf( out, "%sinput underflow", separator ); separator = ", "; }
+    if( flags & paInputOverflow ) { fprintf( out, "%sinput overflow", separator ); separator = ", "; }
+    if( flags & paOutputUnderflow ) { fprintf( out, "%soutput underflow", separator ); separator = ", "; }
+    if( flags & paOutputOverflow ) { fprintf( out, "%soutput overflow", separator ); separator = ", "; }
+    fprintf( out, "\"" );
+}
+
+
+static void PrintRecord( FILE *out, const PaUtilTraceRecord *record, PaUint32 threadId, int *first )
+{
+    double ts = ToMicroseconds( record );
+
+    fprintf( out, "%s\n{\"pid\":1,\"tid\":%u,\"ts\":%.3f,", *first ? "" : ",", (unsigned)threadId, ts );
+    *first = 0;
+
+    switch( record->eventId )
+    {
+    case paUtilTraceCallbackBegin:
+        fprintf( out, "\"name\":\"callback\",\"ph\":\"B\"}" );
+        break;
+    case paUtilTraceCallbackEnd:
+        fprintf( out, "\"name\":\"callback\",\"ph\":\"E\",\"args\":{\"frames\":%d}}", (int)record->arg0 );
+        break;
+    case paUtilTraceXrun:
+        fprintf( out, "\"name\":\"xrun\",\"ph\":\"i\",\"s\":\"t\",\"args\":{\"flags\":%d,\"causes\":", (int)record->arg0 );
+        PrintXrunCauses( out, record->arg0 );
+        fprintf( out, "}}" );
+        break;
+    case paUtilTracePollWakeup:
+        fprintf( out, "\"name\":\"poll wakeup\",\"ph\":\"i\",\"s\":\"t\",\"args\":{\"result\":%d,\"timeout_ms\":%d}}",
+                (int)record->arg0, (int)record->arg1 );
+        break;
+    default:
+        fprintf( out, "\"name\":\"event 0x%x\",\"ph\":\"i\",\"s\":\"t\",\"args\":{\"arg0\":%d,\"arg1\":%d}}",
+                (unsigned)record->eventId, (int)record->arg0, (int)record->arg1 );
+        break;
+    }
+}
+
+
+int main( int argc, char **argv )
+{
+    PaUtilTraceFileHeader header;
+    PaUtilTraceBlockHeader block;
+    PaUtilTraceRecord records[ RECORDS_PER_READ ];
+    PaUtilTraceRecord lastRecord;
+    FILE *in, *out = stdout;
+    PaUint32 remaining, count, i;
+    int swapped, first = 1;
+
+    if( argc < 2 || argc > 3 )
+    {
+        fprintf( stderr, "usage: %s trace.bin [trace.json]\n", argv[0] );
+        return 1;
+    }
+
+    in = fopen( argv[1], "rb" );
+    if( !in )
+    {
+        fprintf( stderr, "%s: cannot open %s\n", argv[0], argv[1] );
+        return 1;
+    }
+
+    if( fread( &header, sizeof(header), 1, in ) != 1
+            || memcmp( header.magic, PA_TRACE_FILE_MAGIC, sizeof(PA_TRACE_FILE_MAGIC) ) != 0 )
+    {
+        fprintf( stderr, "%s: %s is not a PortAudio trace\n", argv[0], argv[1] );
+        return 1;
+    }
+
+    swapped = (header.byteOrderMark != PA_TRACE_BYTE_ORDER_MARK);
+    if( swapped )
+    {
+        header.version = Swap32( header.version );
+        header.recordSize = Swap32( header.recordSize );
+    }
+    if( header.version != PA_TRACE_FILE_VERSION || header.recordSize != sizeof(PaUtilTraceRecord) )
+    {
+        fprintf( stderr, "%s: unsupported trace version %u\n", argv[0], (unsigned)header.version );
+        return 1;
+    }
+
+    if( argc == 3 )
+    {
+        out = fopen( argv[2], "w" );
+        if( !out )
+        {
+            fprintf( stderr, "%s: cannot create %s\n", argv[0], argv[2] );
+            return 1;
+        }
+    }
+
+    fprintf( out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[" );
+
+    memset( &lastRecord, 0, sizeof(lastRecord) );
+    while( fread( &block, sizeof(block), 1, in ) == 1 )
+    {
+        if( swapped )
+        {
+            block.threadId = Swap32( block.threadId );
+            block.recordCount = Swap32( block.recordCount );
+            block.droppedCount = Swap32( block.droppedCount );
+        }
+
+        for( remaining = block.recordCount; remaining > 0; remaining -= count )
+        {
+            count = remaining < RECORDS_PER_READ ? remaining : RECORDS_PER_READ;
+            if( fread( records, sizeof(PaUtilTraceRecord), count, in ) != count )
+            {
+                fprintf( stderr, "%s: trace is truncated\n", argv[0] );
+                break;
+            }
+
+            for( i=0; i < count; ++i )
+            {
+                if( swapped )
+                {
+                    records[i].timeLow = Swap32( records[i].timeLow );
+                    records[i].timeHigh = Swap32( records[i].timeHigh );
+                    records[i].eventId = Swap32( records[i].eventId );
+                    records[i].arg0 = (PaInt32)Swap32( (PaUint32)records[i].arg0 );
+                    records[i].arg1 = (PaInt32)Swap32( (PaUint32)records[i].arg1 );
+                }
+                PrintRecord( out, &records[i], block.threadId, &first );
+            }
+            lastRecord = records[count - 1];
+        }
+
+        /* the records were lost after the last one written for this
+            thread; mark them at the latest time known */
+        if( block.droppedCount > 0 )
+        {
+            fprintf( out, "%s\n{\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"name\":\"dropped records\",\"ph\":\"i\",\"s\":\"t\",\"args\":{\"count\":%u}}",
+                    first ? "" : ",", (unsigned)block.threadId, ToMicroseconds( &lastRecord ),
+                    (unsigned)block.droppedCount );
+            first = 0;
+        }
+    }
+
+    fprintf( out, "\n]}\n" );
+
+    fclose( in );
+    if( out != stdout )
+        fclose( out );
+
+    return 0;
+}
@@ -1,4 +1,5 @@
 #include "portaudioplusplus.h"
+#include <thread>
 
 void test_setup_teardown()
 {
@@ -160,6 +161,975 @@ void test_dual_play(int num_seconds = 5)
     return;
 }
 
+// AudioBlock is a pure view, so this needs no device.
+void test_audio_block()
+{
+    namespace pa = portaudio;
+    std::array<float, 8> in = {0, 1, 2, 3, 4, 5, 6, 7};
+    std::array<float, 8> out = {};
+    pa::AudioBlock<float, 2> blk;
+    blk.input = in.data();
+    blk.output = out.data();
+    blk.frameCount = 4;
+
+    auto typed_cb = [](pa::AudioBlock<float, 2> &) {
+        return pa::CallbackResult::Continue;
+    };
+    auto untyped_cb = [](pa::CallbackInfo) {
+        return pa::CallbackResult::Continue;
+    };
+    static_assert(
+        pa::detail::is_block_callback_v<decltype(typed_cb), float, 2>);
+    static_assert(
+        !pa::detail::is_block_callback_v<decltype(untyped_cb), float, 2>);
+    assert(blk.samples() == 8);
+    assert(blk.in(2, 1) == 5);
+    assert(blk.inFrame(3)[0] == 6);
+    for (size_t f = 0; f < blk.frames(); ++f)
+    {
+        for (size_t ch = 0; ch < blk.channels; ++ch)
+        {
+            blk.out(f, ch) = -blk.in(f, ch);
+        }
+    }
+    assert(out[7] == -7);
+    assert(blk.outFrame(1)[1] == -3);
+}
+
+void test_sample_formats()
+{
+    namespace pa = portaudio;
+    static_assert(pa::sample_traits<float>::format == paFloat32);
+    static_assert(pa::sample_traits<int32_t>::format == paInt32);
+    static_assert(pa::sample_traits<pa::Int24>::format == paInt24);
+    static_assert(pa::sample_traits<int16_t>::format == paInt16);
+    static_assert(pa::sample_traits<int8_t>::format == paInt8);
+    static_assert(pa::sample_traits<uint8_t>::format == paUInt8);
+
+    for (int32_t v : {0, 1, -1, 8388607, -8388608, 123456, -654321})
+    {
+        pa::Int24 packed(v);
+        assert((int32_t)packed == v);
+    }
+
+    // half gain on int16 is a native Q15 shift, not a float round trip
+    using t16 = pa::sample_traits<int16_t>;
+    assert(t16::apply_gain(32767, t16::make_gain(0.5f)) == 16383);
+    assert(t16::apply_gain(-32768, t16::make_gain(1.0f)) == -32768);
+    assert(t16::from_float(2.0f) == 32767);
+
+    using tu8 = pa::sample_traits<uint8_t>;
+    assert(tu8::apply_gain(255, tu8::make_gain(0.0f)) == 128);
+
+    // a fader ramping up from silence on an Int24 buffer
+    pa::dsp::fader<pa::Int24> f;
+    f.arm(1.0f, 1000.0f, 0.004f);
+    std::array<pa::Int24, 8> buf;
+    buf.fill(pa::Int24(1000000));
+    f.processSamples(4, buf.data(), 2);
+    assert((int32_t)buf[0] == 0);
+    assert((int32_t)buf[7] > 0 && (int32_t)buf[7] < 1000000);
+    assert(!f.active());
+}
+
+void test_planar()
+{
+    namespace pa = portaudio;
+    constexpr unsigned long frames = 64;
+    std::array<float, frames> left = {}, right = {};
+    float *chans[2] = {left.data(), right.data()};
+
+    pa::AudioBlock<float, 2, pa::Layout::Planar> blk;
+    blk.output = chans;
+    blk.frameCount = frames;
+    blk.samplerate = 48000;
+    unsigned int n = 0;
+    pa::dsp::fill_buffer_sine(n, blk, 1000);
+    assert(n == frames);
+    assert(left[10] != 0 && left == right);
+    assert(&blk.out(3, 1) == &right[3]);
+
+    // the follower must see each channel separately, not one pointer
+    right.fill(0);
+    const float *cchans[2] = {left.data(), right.data()};
+    pa::dsp::EnvelopeFollower<2, float> env;
+    env.Setup(48000, 1, 10);
+    env.Process(frames, cchans);
+    assert(env[0] > 0.1f && env[1] == 0);
+
+    // a 1ms fade in at 48kHz is a 48 frame linear ramp from 0, one step per
+    // frame: both layouts give every channel of frame f a gain of f / 48,
+    // even when the ramp is split across two planar blocks
+    std::array<float, frames * 2> inter;
+    inter.fill(1.0f);
+    left.fill(1.0f);
+    right.fill(1.0f);
+    pa::dsp::fader<float> fi, fp;
+    fi.arm(1.0f, 48000, 0.001f);
+    fp.arm(1.0f, 48000, 0.001f);
+    fi.processSamples(frames, inter.data(), 2);
+    fp.processPlanar(frames / 2, chans, 2);
+    float *chans2[2] = {left.data() + frames / 2, right.data() + frames / 2};
+    fp.processPlanar(frames / 2, chans2, 2);
+    for (unsigned long f = 0; f < frames; ++f)
+    {
+        const float expected = f < 48 ? (float)f / 48.0f : 1.0f;
+        assert(std::abs(inter[f * 2] - expected) < 1e-5f);
+        assert(std::abs(inter[f * 2 + 1] - expected) < 1e-5f);
+        assert(std::abs(left[f] - expected) < 1e-5f);
+        assert(std::abs(right[f] - expected) < 1e-5f);
+    }
+    assert(!fi.active() && !fp.active());
+}
+
+// every SIMD kernel this CPU supports must match the scalar reference.
+void test_fader_kernels()
+{
+    namespace simd = portaudio::dsp::simd;
+    const auto ref = simd::kernels_for(simd::Isa::Scalar);
+    for (auto isa : {simd::Isa::SSE2, simd::Isa::AVX2, simd::Isa::NEON})
+    {
+        if (!simd::isa_supported(isa)) continue;
+        const auto k = simd::kernels_for(isa);
+        assert(k.isa == isa);
+        for (size_t nch : {1, 2, 3, 4, 6, 8, 11})
+        {
+            const size_t frames = 37;
+            std::vector<float> a(frames * nch), b;
+            for (size_t i = 0; i < a.size(); ++i)
+                a[i] = (float)((i * 7919) % 101) / 50.0f - 1.0f;
+            b = a;
+            float ga = ref.ramp_linear(a.data(), frames, nch, 0.1f, 0.02f);
+            float gb = k.ramp_linear(b.data(), frames, nch, 0.1f, 0.02f);
+            assert(std::abs(ga - gb) < 1e-4f);
+            ga = ref.ramp_exp(a.data(), frames, nch, 0.01f, 1.1f);
+            gb = k.ramp_exp(b.data(), frames, nch, 0.01f, 1.1f);
+            assert(std::abs(ga - gb) < 1e-4f * ga);
+            ref.gain(a.data(), a.size(), 0.3f);
+            k.gain(b.data(), b.size(), 0.3f);
+            for (size_t i = 0; i < a.size(); ++i)
+                assert(std::abs(a[i] - b[i]) < 1e-5f);
+        }
+    }
+
+    // an exponential fade lands exactly on its destination
+    portaudio::dsp::fader<float> f;
+    f.arm(1.0f, 48000, 0.01f, portaudio::dsp::FadeShape::Exponential);
+    std::vector<float> buf(480 * 2, 1.0f);
+    f.processSamples(480, buf.data(), 2);
+    assert(!f.active() && f.volume() == 1.0f && !f.needed());
+    assert(buf[0] < 0.001f && buf[1] == buf[0] && buf[959] > 0.98f);
+}
+
+void test_meters()
+{
+    namespace dsp = portaudio::dsp;
+    constexpr int nch = 6;
+    constexpr size_t frames = 480;
+    std::vector<float> buf(frames * nch, 0.0f);
+    for (size_t f = 0; f < frames; ++f)
+    {
+        for (int ch = 0; ch < nch; ++ch)
+            buf[f * nch + ch] = (f % 2 ? 1.0f : -1.0f) * (ch + 1) / nch;
+    }
+
+    dsp::EnvelopeFollower<nch, float> env;
+    env.Setup(48000, 1, 100);
+    assert(env.snapshot().buffers == 0);
+    env.ProcessInterleaved(frames, buf.data());
+    auto snap = env.snapshot();
+    assert(snap.buffers == 1);
+    for (int ch = 0; ch < nch; ++ch)
+    {
+        const float level = (float)(ch + 1) / nch;
+        assert(std::abs(snap.peak[ch] - level) < 1e-6f);
+        assert(snap.envelope[ch] > 0.9f * level);
+        assert(snap.rms[ch] > 0 && snap.rms[ch] <= level);
+        assert(env[ch] == snap.envelope[ch]);
+    }
+
+    // silence: envelope releases, peak holds
+    std::fill(buf.begin(), buf.end(), 0.0f);
+    env.ProcessInterleaved(frames, buf.data());
+    snap = env.snapshot();
+    assert(snap.envelope[5] < 0.9f && snap.peak[5] == 1.0f);
+
+    // a reader hammering snapshots never sees a torn update
+    env.Setup(48000, 1, 100, 0, 300, 1e6); // no hold, instant fall
+    env.ProcessInterleaved(frames, buf.data());
+    std::atomic<bool> done{false};
+    std::thread reader([&] {
+        while (!done)
+        {
+            const auto s = env.snapshot();
+            for (int ch = 1; ch < nch; ++ch)
+                assert(s.peak[ch] == s.peak[0]);
+        }
+    });
+    for (int i = 0; i < 2000; ++i)
+    {
+        std::fill(buf.begin(), buf.end(), (float)(i % 7) / 7.0f);
+        env.ProcessInterleaved(frames, buf.data());
+    }
+    done = true;
+    reader.join();
+}
+
+// drive the clock with synthetic callback times, no device needed.
+struct TestClock : portaudio::detail::StreamClock
+{
+    using StreamClock::advance;
+    using StreamClock::reset;
+};
+
+void test_stream_clock()
+{
+    TestClock clk;
+    clk.reset(44100);
+    // 44100 / 1000 truncates to 44: the old millisecond counter ran fast.
+    for (int i = 0; i < 1000; ++i)
+        clk.advance(441, nullptr, 0);
+    assert(clk.nframes() == 441000);
+    assert(clk.elapsedMillis() == 10000);
+    assert(clk.elapsedSeconds() == 10.0);
+
+    // a device running 100ppm fast, with +-0.5ms of callback jitter
+    const double nominal = 48000, actual = nominal * (1 + 100e-6);
+    const unsigned long period = 256;
+    clk.reset((unsigned int)nominal);
+    const double start = 1000.0;
+    for (int i = 0; i < 20000; ++i)
+    {
+        const double jitter = ((i * 7919) % 11 - 5) * 1e-4;
+        clk.advance(period, nullptr, start + i * period / actual + jitter);
+    }
+    const auto snap = clk.clockSnapshot();
+    assert(snap.frames == 19999ull * period);
+    assert(std::abs(snap.driftPpm() - 100) < 10);
+    assert(std::abs(snap.actualSamplerate() - actual) < 0.5);
+    // and it predicts where the stream will be one second from now
+    const double t = start + snap.frames / actual + 1.0;
+    const auto predicted = (double)snap.frameAt(t);
+    assert(std::abs(predicted - (snap.frames + actual)) < 48);
+}
+
+void test_audio_events()
+{
+    using namespace std::chrono;
+    portaudio::detail::AudioEvents ev;
+
+    // nothing raised: times out, and not before it should
+    auto t0 = steady_clock::now();
+    assert(!ev.wait_any(1, 0.02));
+    assert(steady_clock::now() - t0 >= milliseconds(19));
+
+    // a waiter on another thread is woken as soon as the bit is raised
+    std::atomic<bool> woke{false};
+    std::thread waiter([&] { woke = ev.wait_any(2 | 4, 5.0); });
+    std::this_thread::sleep_for(milliseconds(20));
+    assert(!woke);
+    t0 = steady_clock::now();
+    ev.raise(1); // not what it is waiting for
+    ev.raise(4);
+    waiter.join();
+    assert(woke);
+    assert(steady_clock::now() - t0 < milliseconds(500));
+
+    // raised bits stay raised until cleared
+    assert(ev.wait_any(4, 0));
+    ev.clear(4);
+    assert(ev.raised() == 1);
+    assert(!ev.wait_any(4, 0));
+}
+
+void test_device_table()
+{
+    portaudio::Portaudio audio("table");
+    auto &en = audio.enumerator();
+    const auto &devs = en.devices();
+    assert((int)devs.size() == Pa_GetDeviceCount());
+
+    size_t listed = 0;
+    for (const auto &api : en.apis())
+    {
+        listed += api.allDevices().size();
+        for (size_t i = 0; i < api.allDevices().size(); ++i)
+        {
+            // the per-api lists are views onto the table, not copies
+            const auto &d = api.allDevices()[i];
+            assert(&d == &devs[d.global_device_index]);
+            assert(d.api_device_index == (int)i);
+            assert(d.info->hostApi == api.api_index);
+        }
+        for (const auto &d : api.inputDevices())
+            assert(&api.inputDevices()[d.input_api_device_index] == &d);
+        for (const auto &d : api.outputDevices())
+            assert(en.findDevice(api, d.output_api_device_index) == &d);
+        for (const auto &d : api.duplexDevices())
+            assert(d.deviceType.is_duplex());
+    }
+    assert(listed == devs.size());
+
+    for (const auto &d : devs)
+    {
+        const auto *byName = en.findDeviceByName(d.info->name, d.info->hostApi);
+        assert(byName && std::string_view(byName->info->name) == d.info->name);
+    }
+    assert(en.findDeviceByName("no such device, surely") == nullptr);
+
+    // nothing changed underneath us: a refresh keeps every row
+    const auto changes = en.refresh();
+    assert(changes.empty());
+    assert((int)en.devices().size() == Pa_GetDeviceCount());
+}
+
+void test_parallel_init()
+{
+    // same host apis and devices, in the same order, however we start up
+    std::vector<std::string> serial;
+    {
+        portaudio::Portaudio audio("serial");
+        for (const auto &d : audio.enumerator().devices())
+            serial.push_back(d.info->name);
+    }
+    portaudio::Portaudio audio("parallel",
+                               paInitializeParallel | paInitializeDeferProbe);
+    const auto &devs = audio.enumerator().devices();
+    assert(devs.size() == serial.size());
+    for (size_t i = 0; i < devs.size(); ++i)
+    {
+        assert(serial[i] == devs[i].info->name);
+        assert(devs[i].info->hostApi < Pa_GetHostApiCount());
+    }
+}
+
+void test_dither_mode()
+{
+    using portaudio::DitherMode;
+    using portaudio::withDitherMode;
+    const PaStreamFlags base = paClipOff | paPrimeOutputBuffersUsingStreamCallback;
+
+    assert(withDitherMode(base, DitherMode::Triangular) == base);
+    assert(withDitherMode(base, DitherMode::Off) == (base | paDitherOff));
+    assert(withDitherMode(base | paDitherOff,
+                          DitherMode::NoiseShapedFirstOrder) ==
+           (base | paDitherNoiseShapedFirstOrder));
+    // selecting one order replaces the other
+    assert(withDitherMode(base | paDitherNoiseShapedFirstOrder,
+                          DitherMode::NoiseShapedSecondOrder) ==
+           (base | paDitherNoiseShapedSecondOrder));
+
+    portaudio::StreamSetupInfo info;
+    assert(!info.dither);
+}
+
+void test_audio_fifo()
+{
+    using Fifo = portaudio::SpscAudioFifo<int16_t, 2>;
+    Fifo fifo(5); // not a power of two
+    int16_t in[16], out[16];
+    for (int i = 0; i < 16; ++i)
+        in[i] = (int16_t)i;
+
+    // fill, overrun, then drain across the wrap
+    assert(fifo.write(in, 3) == 3 && fifo.size() == 3);
+    assert(fifo.read(out, 2) == 2 && out[3] == 3);
+    assert(fifo.write(in, 6) == 4 && fifo.overruns() == 2);
+    assert(fifo.size() == 5 && fifo.space() == 0);
+    const auto reg = fifo.readRegions(5);
+    assert(reg.first.frames == 3 && reg.second.frames == 2);
+    assert(reg.first.data[0] == 4 && reg.second.data[3] == 7);
+    fifo.commitRead(reg.frames());
+    assert(fifo.size() == 0);
+
+    // a short pop pads the block with silence and counts the underrun
+    portaudio::AudioBlock<int16_t, 2> blk;
+    blk.input = in;
+    blk.output = out;
+    blk.frameCount = 4;
+    assert(fifo.push(blk) == 4);
+    fifo.read(out, 1);
+    assert(fifo.pop(blk) == 3 && fifo.underruns() == 1);
+    assert(out[0] == 2 && out[5] == 7 && out[6] == 0 && out[7] == 0);
+
+    // a producer and a consumer on two threads see every frame in order
+    portaudio::SpscAudioFifo<uint32_t, 3> big(97);
+    constexpr uint32_t total = 200000;
+    std::thread producer([&] {
+        uint32_t f = 0, chunk[3 * 40];
+        while (f < total)
+        {
+            const uint32_t n = (std::min)(total - f, 1 + f % 40);
+            for (uint32_t i = 0; i < n * 3; ++i)
+                chunk[i] = f * 3 + i;
+            f += (uint32_t)big.write(chunk, n);
+        }
+    });
+    uint32_t next = 0, chunk[3 * 64];
+    while (next < total * 3)
+    {
+        const size_t n = big.read(chunk, 1 + next % 64);
+        for (size_t i = 0; i < n * 3; ++i)
+            assert(chunk[i] == next++);
+        if (!n) std::this_thread::yield();
+    }
+    producer.join();
+}
+
+void test_command_queue()
+{
+    struct Cmd
+    {
+        int thread = -1;
+        int seq = 0;
+    };
+    portaudio::MpscCommandQueue<Cmd> q(6);
+    assert(q.capacity() == 8);
+    for (int i = 0; i < 8; ++i)
+        assert(q.push(Cmd{0, i}));
+    assert(!q.push(Cmd{0, 8}) && q.overruns() == 1);
+    Cmd c;
+    assert(q.pop(c) && c.seq == 0 && q.size() == 7);
+    assert(q.drain([](Cmd &) {}) == 7 && !q.pop(c));
+
+    // several producers: each one's commands arrive once, in order
+    constexpr int nthreads = 4, per = 20000;
+    std::vector<std::thread> producers;
+    for (int t = 0; t < nthreads; ++t)
+        producers.emplace_back([&q, t] {
+            for (int i = 0; i < per;)
+                if (q.push(Cmd{t, i}))
+                    ++i;
+                else
+                    std::this_thread::yield();
+        });
+    int expect[nthreads] = {};
+    int got = 0;
+    while (got < nthreads * per)
+    {
+        const size_t n = q.drain([&](Cmd &cmd) {
+            assert(cmd.seq == expect[cmd.thread]);
+            ++expect[cmd.thread];
+        });
+        got += (int)n;
+        if (!n) std::this_thread::yield();
+    }
+    for (auto &p : producers)
+        p.join();
+}
+
+void test_mixer()
+{
+    namespace simd = portaudio::dsp::simd;
+    const auto ref = simd::kernels_for(simd::Isa::Scalar);
+    const float gains[11] = {0.5f, -1, 0.25f, 2, 1, 0, 0.1f, 3, 0.7f, 1, 0.3f};
+    for (auto isa : {simd::Isa::SSE2, simd::Isa::AVX2, simd::Isa::NEON})
+    {
+        if (!simd::isa_supported(isa)) continue;
+        for (size_t nch : {1, 2, 3, 4, 6, 8, 11})
+        {
+            const size_t frames = 37;
+            std::vector<float> src(frames * nch), a(frames * nch, 0.5f), b;
+            for (size_t i = 0; i < src.size(); ++i)
+                src[i] = (float)((i * 7919) % 101) / 50.0f - 1.0f;
+            b = a;
+            ref.mix(a.data(), src.data(), frames, nch, gains);
+            simd::kernels_for(isa).mix(b.data(), src.data(), frames, nch,
+                                       gains);
+            for (size_t i = 0; i < a.size(); ++i)
+                assert(std::abs(a[i] - b[i]) < 1e-6f);
+        }
+    }
+
+    using Bus = portaudio::MixBus<2>;
+    Bus bus(2, 16);
+    auto constant = [](float v) {
+        return [v](float *out, size_t frames) {
+            std::fill(out, out + frames * 2, v);
+        };
+    };
+    const auto a = bus.add(constant(1.0f), 0.5f);
+    const auto b = bus.add(constant(0.25f), 1.0f, 0.5f);
+    assert(a != Bus::InvalidSource && b != Bus::InvalidSource);
+    assert(bus.add(constant(1)) == Bus::InvalidSource && bus.size() == 2);
+
+    // first buffer fades in, later ones are steady, longer buffers are
+    // mixed in pieces of at most 16 frames
+    std::vector<float> out(40 * 2);
+    bus.render(out.data(), 8);
+    assert(out[0] < out[14] && std::abs(out[14] - 0.625f) < 1e-6f);
+    bus.render(out.data(), 40);
+    for (size_t f = 0; f < 40; ++f)
+    {
+        assert(std::abs(out[2 * f] - (0.5f + 0.125f)) < 1e-6f);
+        assert(std::abs(out[2 * f + 1] - (0.5f + 0.25f)) < 1e-6f);
+    }
+    assert(bus.setMute(a, true));
+    bus.render(out.data(), 8); // ramps out
+    bus.render(out.data(), 8);
+    assert(std::abs(out[0] - 0.125f) < 1e-6f);
+
+    // a removed source's id stays dead after its slot is reused
+    assert(bus.remove(a) && !bus.remove(a) && !bus.setGain(a, 1));
+    const auto c = bus.add(constant(1.0f));
+    assert(c != a && bus.setGain(c, 0.5f) && bus.size() == 2);
+
+    // sources come and go while another thread renders; none is called
+    // once remove() has returned
+    Bus live(8, 64);
+    std::atomic<bool> done{false};
+    std::thread audio([&] {
+        std::vector<float> buf(256 * 2);
+        while (!done)
+            live.render(buf.data(), 256);
+    });
+    for (int i = 0; i < 500; ++i)
+    {
+        auto removed = std::make_shared<std::atomic<bool>>(false);
+        const auto id = live.add([removed](float *o, size_t n) {
+            assert(!*removed);
+            std::fill(o, o + n * 2, 0.1f);
+        });
+        assert(id != Bus::InvalidSource);
+        if (i % 7 == 0) std::this_thread::yield();
+        assert(live.remove(id));
+        *removed = true;
+    }
+    done = true;
+    audio.join();
+    assert(live.size() == 0);
+}
+
+void test_resampler()
+{
+    namespace dsp = portaudio::dsp;
+    namespace simd = dsp::simd;
+    const auto ref = simd::kernels_for(simd::Isa::Scalar);
+    std::vector<float> x(67), y(67);
+    for (size_t i = 0; i < x.size(); ++i)
+    {
+        x[i] = (float)((i * 7919) % 101) / 50.0f - 1.0f;
+        y[i] = (float)((i * 104729) % 89) / 44.0f - 1.0f;
+    }
+    for (auto isa : {simd::Isa::SSE2, simd::Isa::AVX2, simd::Isa::NEON})
+    {
+        if (!simd::isa_supported(isa)) continue;
+        for (size_t n : {0, 1, 3, 4, 8, 15, 16, 17, 67})
+            assert(std::abs(ref.dot(x.data(), y.data(), n) -
+                            simd::kernels_for(isa).dot(x.data(), y.data(),
+                                                       n)) < 1e-4f);
+    }
+
+    // a sine comes through at the new rate, at every quality; output frame
+    // j is input time j * 48000 / 44100
+    const double pi2 = 2 * M_PI;
+    const size_t inFrames = 48000 / 4;
+    std::vector<float> in(inFrames * 2);
+    for (size_t f = 0; f < inFrames; ++f)
+    {
+        in[2 * f] = (float)sin(pi2 * 1000.0 * f / 48000.0);
+        in[2 * f + 1] = (float)cos(pi2 * 5000.0 * f / 48000.0) * 0.5f;
+    }
+    const float limits[] = {3e-3f, 3e-4f, 5e-5f};
+    for (auto q : {dsp::ResamplerQuality::Fast, dsp::ResamplerQuality::Medium,
+                   dsp::ResamplerQuality::High})
+    {
+        dsp::Resampler<2> rs(48000, 44100, inFrames, q);
+        assert(rs.push(in.data(), inFrames) == inFrames);
+        std::vector<float> out(inFrames * 2);
+        const size_t n = rs.pull(out.data(), inFrames);
+        assert(rs.available() == 0);
+        // the last output needs taps/2 frames of lookahead
+        const double expect = (inFrames - rs.taps() / 2) * 44100.0 / 48000.0;
+        assert(std::abs((double)n - expect) < 2);
+        float worst = 0;
+        for (size_t j = rs.taps(); j < n; ++j)
+        {
+            const double t = j * 48000.0 / 44100.0 / 48000.0;
+            worst = (std::max)(
+                worst, std::abs(out[2 * j] - (float)sin(pi2 * 1000.0 * t)));
+            worst = (std::max)(worst,
+                               std::abs(out[2 * j + 1] -
+                                        (float)cos(pi2 * 5000.0 * t) * 0.5f));
+        }
+        assert(worst < limits[(unsigned)q]);
+    }
+
+    // the output does not depend on how the input is cut up, and
+    // inputNeeded() is exact
+    dsp::Resampler<2> whole(44100, 48000, 4096), parts(44100, 48000, 4096);
+    std::vector<float> a(8192 * 2), b(8192 * 2);
+    whole.push(in.data(), 4000);
+    const size_t na = whole.pull(a.data(), 8192);
+    size_t nb = 0, used = 0;
+    unsigned seed = 1;
+    while (nb < na)
+    {
+        seed = seed * 1103515245 + 12345;
+        const size_t want = (std::min)((size_t)(seed >> 16) % 300, na - nb);
+        const size_t need = parts.inputNeeded(want);
+        assert(parts.push(in.data() + used * 2, need) == need);
+        used += need;
+        assert(parts.available() >= want);
+        assert(parts.pull(b.data() + nb * 2, want) == want);
+        nb += want;
+    }
+    assert(memcmp(a.data(), b.data(), na * 2 * sizeof(float)) == 0);
+
+    // drift correction changes how fast input is used up
+    dsp::Resampler<1> slow(48000, 48000, 1000), fast(48000, 48000, 1000);
+    fast.setDrift(1000);
+    std::vector<float> mono(1000), sink(1000);
+    size_t outSlow = 0, outFast = 0;
+    for (int i = 0; i < 20; ++i)
+    {
+        slow.push(mono.data(), 1000);
+        fast.push(mono.data(), 1000);
+        outSlow += slow.pull(sink.data(), 1000);
+        outFast += fast.pull(sink.data(), 1000);
+    }
+    assert(outFast + 15 < outSlow && outSlow - outFast < 25);
+}
+
+void test_drift_bridge()
+{
+    // The input device's clock runs 150 ppm fast against the output's.
+    // Played out in simulated time, 40 seconds of it: the bridge settles on
+    // the drift and holds its fill without a single drop or repeat.
+    const double drift = 150e-6;
+    const size_t inBlock = 128, outBlock = 256, target = 1024;
+    portaudio::DriftBridge<1> bridge(48000, 48000, outBlock, target,
+                                     portaudio::dsp::ResamplerQuality::Fast);
+    std::vector<float> in(inBlock), out(outBlock);
+    unsigned int phase = 0;
+    size_t nIn = 0, nOut = 0;
+    float fillLo = 1e9f, fillHi = 0;
+    while (nOut * outBlock < 48000 * 40)
+    {
+        const double tIn = nIn * inBlock / (48000 * (1 + drift));
+        const double tOut = nOut * outBlock / 48000.0;
+        if (tIn <= tOut)
+        {
+            for (auto &s : in)
+                s = portaudio::dsp::next_sine_sample(phase, 48000, 1000);
+            bridge.capture(in.data(), inBlock, tIn);
+            ++nIn;
+        }
+        else
+        {
+            bridge.render(out.data(), outBlock, tOut);
+            ++nOut;
+            if (tOut > 30)
+            {
+                fillLo = (std::min)(fillLo, bridge.averageFill());
+                fillHi = (std::max)(fillHi, bridge.averageFill());
+            }
+        }
+    }
+    assert(bridge.overruns() == 0 && bridge.underruns() == 0);
+    assert(std::abs(bridge.driftPpm() - 150.0f) < 3.0f);
+    assert(fillLo > target - 4.0f && fillHi < target + 4.0f);
+    // the output is still a clean sine: no sample-to-sample jump bigger
+    // than a 1 kHz sine ever makes
+    const float maxStep = (float)(2 * M_PI * 1000 / 48000) * 1.05f;
+    for (size_t f = 1; f < outBlock; ++f)
+        assert(std::abs(out[f] - out[f - 1]) < maxStep);
+}
+
+void test_automation_queue()
+{
+    using Kind = portaudio::AutomationEvent::Kind;
+    portaudio::AutomationQueue q(8);
+    auto ev = [](uint64_t frame, float value) {
+        return portaudio::AutomationEvent{frame, Kind::Param, 0, value};
+    };
+    // posted out of order, handed over by frame; ties in posting order
+    assert(q.post(ev(300, 1)) && q.post(ev(100, 2)) && q.post(ev(300, 3)));
+    assert(q.post(ev(0, 4)));
+    q.collect();
+    assert(q.pending() == 4);
+    portaudio::AutomationEvent e;
+    assert(q.popDue(50, e) && e.value == 4 && !q.popDue(50, e));
+    assert(q.framesUntilNext(50, 512) == 50);
+    assert(q.framesUntilNext(50, 20) == 20);
+    assert(q.popDue(100, e) && e.value == 2);
+    assert(q.framesUntilNext(100, 512) == 200);
+    assert(q.popDue(400, e) && e.value == 1);
+    assert(q.popDue(400, e) && e.value == 3);
+    assert(!q.popDue(~0ull, e) && q.framesUntilNext(400, 512) == 512);
+
+    // a full queue refuses, and counts it
+    for (int i = 0; i < 8; ++i)
+        assert(q.post(ev(i, (float)i)));
+    assert(!q.post(ev(9, 9)) && q.overruns() == 1);
+    q.clear();
+    q.collect();
+    assert(q.pending() == 0);
+
+    // more than MaxPending posted: the rest wait for a later collect()
+    portaudio::AutomationQueue big(256);
+    const size_t n = portaudio::AutomationQueue::MaxPending + 10;
+    for (size_t i = 0; i < n; ++i)
+        assert(big.post(ev(n - i, (float)i)));
+    big.collect();
+    assert(big.pending() == portaudio::AutomationQueue::MaxPending);
+    size_t got = 0;
+    while (big.popDue(~0ull, e))
+        ++got;
+    big.collect();
+    while (big.popDue(~0ull, e))
+        ++got;
+    assert(got == n);
+
+    // control threads post while the consumer runs buffers of 64 frames;
+    // every event is seen exactly once, none ahead of its frame
+    portaudio::AutomationQueue live(64);
+    const int nthreads = 3, per = 2000;
+    std::atomic<int> seen{0};
+    std::atomic<bool> done{false};
+    std::thread consumer([&] {
+        uint64_t pos = 0;
+        while (!done || seen < nthreads * per)
+        {
+            live.collect();
+            size_t f = 0;
+            while (f < 64)
+            {
+                portaudio::AutomationEvent x;
+                while (live.popDue(pos + f, x))
+                {
+                    assert(x.frame <= pos + f);
+                    ++seen;
+                }
+                f += live.framesUntilNext(pos + f, 64 - f);
+            }
+            pos += 64;
+            std::this_thread::yield();
+        }
+    });
+    std::vector<std::thread> producers;
+    for (int t = 0; t < nthreads; ++t)
+        producers.emplace_back([&, t] {
+            for (int i = 0; i < per; ++i)
+                while (!live.post(ev((uint64_t)(i * 7 + t), 0)))
+                    std::this_thread::yield();
+        });
+    for (auto &p : producers)
+        p.join();
+    done = true;
+    consumer.join();
+    assert(seen == nthreads * per);
+}
+
+// a virtual device needs no hardware: render offline, then pace at 100x
+void test_virtual_render()
+{
+    namespace pa = portaudio;
+    PaVirtualDeviceInfo vdev;
+    PaVirtual_InitializeDeviceInfo(&vdev);
+    vdev.name = "Virtual Render";
+    vdev.speed = paVirtualFreeRunning;
+    PaVirtual_RemoveAllDevices();
+    assert(PaVirtual_AddDevice(&vdev) == paNoError);
+    vdev.maxInputChannels = vdev.maxOutputChannels = 0;
+    assert(PaVirtual_AddDevice(&vdev) == paInvalidChannelCount);
+    {
+        pa::Portaudio audio("test virtual render");
+        pa::PaDeviceInfoEx device;
+        for (const auto &d : audio.enumerator().devices())
+            if (d.hostApiInfo->type == paVirtual) device = d;
+        assert(device.info && std::string(device.info->name) == vdev.name);
+
+        const unsigned int sr = 48000;
+        std::vector<float> rendered(sr * 2, -1.0f);
+        PaVirtualStreamInfo vout;
+        PaVirtual_InitializeStreamInfo(&vout);
+        vout.endpointType = paVirtualMemory;
+        vout.buffer = rendered.data();
+        vout.bufferFrames = sr;
+        vout.flags = paVirtualCompleteAtEnd;
+        // duplex, with the input side left at the default silent endpoint
+        device.streamSetupInfo.inParams = pa::makeStreamParams(audio, &device);
+        device.streamSetupInfo.outParams = device.streamSetupInfo.inParams;
+        device.streamSetupInfo.outParams.hostApiSpecificStreamInfo = &vout;
+        device.streamSetupInfo.samplerate = sr;
+        device.streamSetupInfo.framesPerBuffer = 256;
+
+        // the memory buffer filling up completes the stream
+        size_t frames = 0;
+        auto stream = audio.openStream<float, 2>(
+            device, [&](pa::AudioBlock<float, 2> &b) {
+                for (size_t f = 0; f < b.frames(); ++f, ++frames)
+                    b.out(f, 0) = b.out(f, 1) = 0.5f;
+                return pa::CallbackResult::Continue;
+            });
+        stream.Start(0);
+        assert(stream.waitUntilFinished(10.0));
+        stream.Stop(0);
+        assert(frames >= sr);
+        assert(rendered[2 * (sr / 2)] == 0.5f);
+        assert(rendered[2 * sr - 1] == 0.5f);
+
+        // the same second of audio paced at 100x real time; how long that
+        // takes depends on the machine, so only the amount of audio is
+        // checked exactly
+        vout.flags = paVirtualCompleteAtEnd;
+        vout.speed = 100;
+        frames = 0;
+        size_t callbacks = 0;
+        const auto t0 = std::chrono::steady_clock::now();
+        auto paced = audio.openStream<float, 2>(
+            device, [&](pa::AudioBlock<float, 2> &b) {
+                frames += b.frames();
+                ++callbacks;
+                return pa::CallbackResult::Continue;
+            });
+        paced.Start(0);
+        assert(paced.waitUntilFinished(10.0));
+        const std::chrono::duration<double> took =
+            std::chrono::steady_clock::now() - t0;
+        unsigned long inFrames = 0, outFrames = 0;
+        assert(PaVirtual_GetStreamFrames(paced.actualStreamInfo().stream,
+                                         &inFrames, &outFrames) == paNoError);
+        paced.Stop(0);
+        assert(outFrames == sr);
+        assert(callbacks == (sr + 255) / 256);
+        assert(frames == callbacks * 256);
+        assert(took.count() < 1.0);
+    }
+    PaVirtual_RemoveAllDevices();
+}
+
+// a stream always has the channel count of its callback's block, whatever
+// the setup asked for
+void test_stream_channels()
+{
+    namespace pa = portaudio;
+    PaVirtualDeviceInfo vdev;
+    PaVirtual_InitializeDeviceInfo(&vdev);
+    vdev.name = "Virtual Quad";
+    vdev.maxOutputChannels = 4;
+    vdev.speed = paVirtualFreeRunning;
+    PaVirtual_RemoveAllDevices();
+    assert(PaVirtual_AddDevice(&vdev) == paNoError);
+    {
+        pa::Portaudio audio("test stream channels");
+        pa::PaDeviceInfoEx device;
+        for (const auto &d : audio.enumerator().devices())
+            if (d.hostApiInfo->type == paVirtual) device = d;
+        assert(device.info);
+
+        const size_t frames = 1024;
+        std::vector<float> rendered(frames * 2, -1.0f);
+        PaVirtualStreamInfo vout;
+        PaVirtual_InitializeStreamInfo(&vout);
+        vout.endpointType = paVirtualMemory;
+        vout.buffer = rendered.data();
+        vout.bufferFrames = frames;
+        vout.flags = paVirtualCompleteAtEnd;
+        device.streamSetupInfo.inParams = pa::makeStreamParams(audio, &device);
+        device.streamSetupInfo.inParams.channelCount = 1;
+        device.streamSetupInfo.outParams = device.streamSetupInfo.inParams;
+        device.streamSetupInfo.outParams.channelCount = 1;
+        device.streamSetupInfo.outParams.hostApiSpecificStreamInfo = &vout;
+        device.streamSetupInfo.samplerate = 48000;
+        device.streamSetupInfo.framesPerBuffer = 256;
+
+        auto stream = audio.openStream<float, 2>(
+            device, [](pa::AudioBlock<float, 2> &b) {
+                for (size_t f = 0; f < b.frames(); ++f)
+                {
+                    b.out(f, 0) = 0.25f;
+                    b.out(f, 1) = -0.25f;
+                }
+                return pa::CallbackResult::Continue;
+            });
+        assert(device.streamSetupInfo.inParams.channelCount == 2);
+        assert(device.streamSetupInfo.outParams.channelCount == 2);
+        stream.Start(0);
+        assert(stream.waitUntilFinished(10.0));
+        stream.Stop(0);
+        for (size_t f = 0; f < frames; ++f)
+            assert(rendered[2 * f] == 0.25f && rendered[2 * f + 1] == -0.25f);
+
+        // a planar callback reads one pointer per channel
+        device.streamSetupInfo.inParams.channelCount = 1;
+        device.streamSetupInfo.outParams.channelCount = 1;
+        std::fill(rendered.begin(), rendered.end(), -1.0f);
+        auto planar = audio.openStream<float, 2, pa::Layout::Planar>(
+            device, [](pa::AudioBlock<float, 2, pa::Layout::Planar> &b) {
+                for (size_t f = 0; f < b.frames(); ++f)
+                {
+                    b.out(f, 0) = 0.5f;
+                    b.out(f, 1) = -0.5f;
+                }
+                return pa::CallbackResult::Continue;
+            });
+        assert(device.streamSetupInfo.outParams.channelCount == 2);
+        planar.Start(0);
+        assert(planar.waitUntilFinished(10.0));
+        planar.Stop(0);
+        for (size_t f = 0; f < frames; ++f)
+            assert(rendered[2 * f] == 0.5f && rendered[2 * f + 1] == -0.5f);
+
+        // a mixer's bus is NCH wide too
+        device.streamSetupInfo.outParams.channelCount = 1;
+        std::fill(rendered.begin(), rendered.end(), -1.0f);
+        auto mixer = audio.openMixer<2>(device);
+        assert(mixer.stream().actualStreamInfo().outParams.channelCount == 2);
+        mixer.add([](float *out, size_t n) {
+            std::fill(out, out + 2 * n, 0.125f);
+        });
+        mixer.Start(0);
+        assert(mixer.stream().waitUntilFinished(10.0));
+        mixer.Stop(0);
+        // after the source's fade in over the first buffer
+        for (size_t f = 256; f < frames; ++f)
+            assert(rendered[2 * f] == 0.125f && rendered[2 * f + 1] == 0.125f);
+    }
+    PaVirtual_RemoveAllDevices();
+}
+
+// a device that moves keeps its setup, pointing at where it went
+void test_device_hotplug()
+{
+    PaVirtualDeviceInfo vdev;
+    PaVirtual_InitializeDeviceInfo(&vdev);
+    PaVirtual_RemoveAllDevices();
+    vdev.name = "Virtual Unplugged";
+    assert(PaVirtual_AddDevice(&vdev) == paNoError);
+    vdev.name = "Virtual Kept";
+    assert(PaVirtual_AddDevice(&vdev) == paNoError);
+    {
+        portaudio::Portaudio audio("hotplug");
+        auto &en = audio.enumerator();
+        const auto *kept = en.findDeviceByName("Virtual Kept");
+        assert(kept && en.findDeviceByName("Virtual Unplugged"));
+        const int before = kept->global_device_index;
+
+        // the table's rows are where a setup is kept across a refresh
+        auto &setup = en.findDeviceByGlobalIndex(before)->streamSetupInfo;
+        setup.inParams.device = setup.outParams.device = before;
+        setup.stream = (PaStream *)&setup; // anything not null
+
+        // unplug the first: the second moves down a place
+        Pa_Terminate();
+        PaVirtual_RemoveAllDevices();
+        assert(PaVirtual_AddDevice(&vdev) == paNoError);
+        assert(Pa_Initialize() == paNoError);
+        const auto changes = en.refresh();
+        assert(changes.added.empty() && changes.removed.size() == 1);
+
+        kept = en.findDeviceByName("Virtual Kept");
+        assert(kept && kept->global_device_index == before - 1);
+        assert(kept->streamSetupInfo.inParams.device == before - 1);
+        assert(kept->streamSetupInfo.outParams.device == before - 1);
+        assert(kept->streamSetupInfo.stream == nullptr);
+        assert(en.findDeviceByName("Virtual Unplugged") == nullptr);
+    }
+    PaVirtual_RemoveAllDevices();
+}
+
 void test_my_exceptions()
 {
     namespace pa = portaudio;
@@ -291,14 +1261,228 @@ void test_callback_stream()
     }
 }
 
+void test_blocking_stream(int num_seconds = 1)
+{
+    namespace pa = portaudio;
+    using Blocking = pa::BlockingStream<float, 2>;
+    pa::Portaudio audio("test blocking playback");
+    auto device = audio.enumerator().defaultDevice();
+    auto params = pa::makeStreamParams(audio, &device);
+    device.streamSetupInfo.outParams = params;
+    device.streamSetupInfo.samplerate =
+        (unsigned int)device.info->defaultSampleRate;
+
+    // the same tone through the native blocking API and through the FIFOs
+    for (auto mode : {Blocking::Mode::Native, Blocking::Mode::Fifo})
+    {
+        auto stream = audio.openBlockingStream<float, 2>(device, mode);
+        assert(stream.isNative() == (mode == Blocking::Mode::Native));
+        const size_t chunk = stream.samplerate() / 10; // large batches
+        stream.watermarks(chunk, chunk);
+        std::vector<float> buf(chunk * 2);
+        unsigned int n = 0;
+        stream.Start();
+        for (unsigned int i = 0; i < 10u * num_seconds; ++i)
+        {
+            for (size_t f = 0; f < chunk; ++f)
+                buf[2 * f] = buf[2 * f + 1] = pa::dsp::next_sine_sample(
+                    n, stream.samplerate(), 440);
+            assert(stream.write({buf.data(), chunk}) == chunk);
+        }
+        assert(stream.waitWritable(2.0));
+        assert(stream.writeAvailable() >= chunk);
+        stream.Stop();
+    }
+}
+
+// test_dual_play's two tones, through one stream
+void test_mixer_play(int num_seconds = 1)
+{
+    namespace pa = portaudio;
+    pa::Portaudio audio("test mixer playback");
+    auto device = audio.enumerator().defaultDevice();
+    device.streamSetupInfo.outParams = pa::makeStreamParams(audio, &device);
+    device.streamSetupInfo.samplerate =
+        (unsigned int)device.info->defaultSampleRate;
+    auto mixer = audio.openMixer<2>(device);
+    const unsigned int sr = device.streamSetupInfo.samplerate;
+
+    auto tone = [sr](unsigned int freq) {
+        return [sr, freq, n = 0u](float *out, size_t frames) mutable {
+            for (size_t f = 0; f < frames; ++f)
+                out[2 * f] = out[2 * f + 1] =
+                    pa::dsp::next_sine_sample(n, sr, freq) * 0.5f;
+        };
+    };
+    const auto left = mixer.add(tone(440), 1.0f, -1.0f);
+    const auto right = mixer.add(tone(1000), 1.0f, 1.0f);
+    mixer.Start();
+    while (mixer.stream().elapsedSeconds() < num_seconds / 2.0)
+        pa::sleep_ms(50);
+    mixer.remove(left);
+    puts("Left source removed, now the right only ...");
+    while (mixer.stream().elapsedSeconds() < num_seconds)
+        pa::sleep_ms(50);
+    mixer.remove(right);
+    mixer.Stop();
+}
+
+// The callback runs at 32 kHz; the device at its own rate.
+void test_resampled_play(int num_seconds = 1)
+{
+    namespace pa = portaudio;
+    pa::Portaudio audio("test resampled playback");
+    auto device = audio.enumerator().defaultDevice();
+    device.streamSetupInfo.outParams = pa::makeStreamParams(audio, &device);
+    device.streamSetupInfo.samplerate = 32000;
+    device.streamSetupInfo.deviceSamplerate =
+        (unsigned int)device.info->defaultSampleRate;
+    device.streamSetupInfo.resamplerQuality = pa::dsp::ResamplerQuality::High;
+    auto mixer = audio.openMixer<2>(device);
+    assert(mixer.stream().isResampling() ||
+           device.streamSetupInfo.deviceSamplerate == 32000);
+
+    mixer.add([n = 0u](float *out, size_t frames) mutable {
+        for (size_t f = 0; f < frames; ++f)
+            out[2 * f] = out[2 * f + 1] =
+                pa::dsp::next_sine_sample(n, 32000, 440) * 0.5f;
+    });
+    mixer.Start();
+    while (mixer.stream().elapsedSeconds() < num_seconds)
+        pa::sleep_ms(50);
+    mixer.Stop();
+}
+
+// Input from the default input device, played on the default output device
+// through a DeviceBridge. Headphones on: this is a live monitor.
+void test_bridge_play(int num_seconds = 1)
+{
+    namespace pa = portaudio;
+    pa::Portaudio audio("test device bridge");
+    auto in = audio.enumerator().defaultDevice();
+    auto out = in;
+    in.streamSetupInfo.inParams.device = Pa_GetDefaultInputDevice();
+    in.streamSetupInfo.inParams.suggestedLatency =
+        Pa_GetDeviceInfo(in.streamSetupInfo.inParams.device)
+            ->defaultLowInputLatency;
+    in.streamSetupInfo.samplerate = (unsigned int)Pa_GetDeviceInfo(
+                                        in.streamSetupInfo.inParams.device)
+                                        ->defaultSampleRate;
+    out.streamSetupInfo.outParams = pa::makeStreamParams(audio, &out);
+    out.streamSetupInfo.samplerate =
+        (unsigned int)out.info->defaultSampleRate;
+    auto bridge = audio.openBridge<2>(in, out);
+    bridge.Start();
+    while (bridge.outputStream().elapsedSeconds() < num_seconds)
+        pa::sleep_ms(50);
+    bridge.Stop();
+    printf("bridge: drift %.1f ppm, fill %.0f of %zu frames, %llu underruns, "
+           "%llu overruns\n",
+           bridge.driftPpm(), bridge.averageFill(), bridge.targetFrames(),
+           (unsigned long long)bridge.underruns(),
+           (unsigned long long)bridge.overruns());
+}
+
+// Gain, mute and a user parameter, each scheduled for an exact frame.
+void test_automation_play(int num_seconds = 2)
+{
+    namespace pa = portaudio;
+    pa::Portaudio audio("test automation");
+    auto device = audio.enumerator().defaultDevice();
+    device.streamSetupInfo.outParams = pa::makeStreamParams(audio, &device);
+    const unsigned int sr = (unsigned int)device.info->defaultSampleRate;
+    device.streamSetupInfo.samplerate = sr;
+    std::atomic<uint64_t> pitchChangedAt{0};
+    unsigned int n = 0;
+    uint64_t frame = 0;
+    auto stream = audio.openStream<float, 2>(
+        device, [&](pa::AudioBlock<float, 2> &b) {
+            // param 0 is the pitch; each run of frames sees one value
+            const auto freq = (unsigned int)b.param(0);
+            if (freq == 880 && !pitchChangedAt) pitchChangedAt = frame;
+            for (size_t f = 0; f < b.frames(); ++f)
+                b.out(f, 0) = b.out(f, 1) =
+                    pa::dsp::next_sine_sample(n, sr, freq ? freq : 440) *
+                    0.5f;
+            frame += b.frames();
+            return pa::CallbackResult::Continue;
+        });
+    stream.Start();
+    stream.setParam(0, 440);
+    const uint64_t at = sr / 2 + 17; // deliberately mid-buffer
+    stream.setParam(0, 880, at);
+    stream.setGain(0.25f, 0.2f, sr);
+    stream.setMute(true, 0.005f, sr * 3 / 2);
+    stream.setMute(false, 0.005f, sr * 7 / 4);
+    while (stream.elapsedSeconds() < num_seconds)
+        pa::sleep_ms(50);
+    stream.Stop();
+    assert(pitchChangedAt == at);
+}
+
+void test_profile_play(int num_seconds = 1)
+{
+    namespace pa = portaudio;
+    pa::Portaudio audio("test profile");
+    auto device = audio.enumerator().defaultDevice();
+    device.streamSetupInfo.outParams = pa::makeStreamParams(audio, &device);
+    const unsigned int sr = (unsigned int)device.info->defaultSampleRate;
+    device.streamSetupInfo.samplerate = sr;
+    unsigned int n = 0;
+    auto stream = audio.openStream<float, 2>(
+        device, [&](pa::AudioBlock<float, 2> &b) {
+            for (size_t f = 0; f < b.frames(); ++f)
+                b.out(f, 0) = b.out(f, 1) =
+                    pa::dsp::next_sine_sample(n, sr, 440) * 0.5f;
+            return pa::CallbackResult::Continue;
+        });
+    stream.Start();
+    while (stream.elapsedSeconds() < num_seconds)
+        pa::sleep_ms(50);
+    auto p = stream.profile();
+    assert(p.callbackCount > 0);
+    assert(p.callbackTimeP50 <= p.callbackTimeP99);
+    assert(p.callbackTimeP99 <= p.callbackTimeP999);
+    assert(p.callbackTimeP999 <= p.callbackTimeMax);
+    assert(p.jitterP50 <= p.jitterMax);
+    assert(p.outputUnderflowCount <= p.callbackCount);
+    stream.Stop();
+    stream.resetProfile();
+    assert(stream.profile().callbackCount == 0);
+}
+
 int main(int, char **)
 {
 
     test_enumerator();
     test_my_exceptions();
+    test_audio_block();
+    test_sample_formats();
+    test_planar();
+    test_fader_kernels();
+    test_meters();
+    test_stream_clock();
+    test_audio_events();
+    test_device_table();
+    test_parallel_init();
+    test_dither_mode();
+    test_audio_fifo();
+    test_command_queue();
+    test_mixer();
+    test_resampler();
+    test_drift_bridge();
+    test_automation_queue();
+    test_virtual_render();
+    test_stream_channels();
+    test_device_hotplug();
     test_setup_teardown();
 
     test_dual_play(1);
+    test_mixer_play(1);
+    test_resampled_play(1);
+    test_bridge_play(1);
+    test_automation_play(2);
+    test_profile_play(1);
 
     {
         portaudio::Portaudio paObj;
@@ -306,5 +1490,6 @@ int main(int, char **)
     }
 
     test_simple_play(1);
+    test_blocking_stream(1);
     test_callback_stream();
 }
@@ -6,25 +6,61 @@
 #include <algorithm> // std::max()
 #include <atomic>
 #include <cassert>
+#include <chrono>
 #define _USE_MATH_DEFINES
 #include <array>
 #include <cmath>   // std::abs
 #include <cstdint> // uint_64
 #include <cstring>
+#include <functional>
 #include <iostream>
+#include <iterator>
 #include <limits> // numeric_limits
 #include <math.h>
 #include <memory> // unique_ptr
 #include <mutex>
+#include <optional>
 #include <sstream>
 #include <stdexcept>
 #include <string>
 #include <string_view>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
 #include <vector>
 
+#if defined(__linux__)
+#include <climits>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "Synchronization.lib")
+#endif
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) ||           \
+    defined(_M_IX86)
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
 //#ifdef _MSC_VER
 #include "../../../portaudio/include/pa_win_wasapi.h"
 //#endif
+#include "../../../portaudio/include/pa_virtual.h"
+
+#ifdef _MSC_VER
+#define PA_FORCE_INLINE __forceinline
+#else
+#define PA_FORCE_INLINE __attribute__((always_inline))
+#endif
 
 namespace portaudio
 {
@@ -35,6 +71,137 @@ static inline bool is_almost_equal(const Float f1, const Float f2)
     return std::abs(f1 - f2) < std::numeric_limits<Float>::epsilon();
 }
 
+// Packed, native-endian 24-bit sample, as PortAudio's paInt24 expects it.
+struct Int24
+{
+    uint8_t bytes[3];
+
+    Int24() = default;
+    Int24(int32_t v) noexcept
+    {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        bytes[0] = (uint8_t)(v >> 16);
+        bytes[1] = (uint8_t)(v >> 8);
+        bytes[2] = (uint8_t)v;
+#else
+        bytes[0] = (uint8_t)v;
+        bytes[1] = (uint8_t)(v >> 8);
+        bytes[2] = (uint8_t)(v >> 16);
+#endif
+    }
+    operator int32_t() const noexcept
+    {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        const uint32_t u = ((uint32_t)bytes[0] << 24) |
+                           ((uint32_t)bytes[1] << 16) |
+                           ((uint32_t)bytes[2] << 8);
+#else
+        const uint32_t u = ((uint32_t)bytes[2] << 24) |
+                           ((uint32_t)bytes[1] << 16) |
+                           ((uint32_t)bytes[0] << 8);
+#endif
+        return (int32_t)u >> 8; // sign-extend
+    }
+};
+static_assert(sizeof(Int24) == 3, "Int24 must be packed");
+
+// Maps a C++ sample type to its PortAudio format, and supplies the
+// per-format kernels the wrapper DSP uses. Integer formats apply gain in
+// Q15 fixed point so they never round-trip through float.
+// Gains are expected to be in [0, 1].
+template <typename SAMPLE> struct sample_traits;
+
+template <> struct sample_traits<float>
+{
+    static constexpr PaSampleFormat format = paFloat32;
+    static constexpr bool is_integer = false;
+    using gain_type = float;
+    static gain_type make_gain(float g) noexcept { return g; }
+    static PA_FORCE_INLINE float apply_gain(float s, gain_type g) noexcept
+    {
+        return s * g;
+    }
+    static float to_float(float s) noexcept { return s; }
+    static float from_float(float f) noexcept { return f; }
+};
+
+namespace detail
+{
+// Shared by all the signed integer formats: FULL is 2^(bits-1).
+template <typename SAMPLE, typename ACCUM, int64_t FULL>
+struct int_sample_traits
+{
+    static constexpr bool is_integer = true;
+    using gain_type = int32_t; // Q15
+    static gain_type make_gain(float g) noexcept
+    {
+        return (int32_t)(g * 32768.0f + 0.5f);
+    }
+    static PA_FORCE_INLINE SAMPLE apply_gain(SAMPLE s,
+                                             gain_type g) noexcept
+    {
+        return (SAMPLE)(((ACCUM)(int32_t)s * g) >> 15);
+    }
+    static float to_float(SAMPLE s) noexcept
+    {
+        return (float)((double)(int32_t)s / (double)FULL);
+    }
+    static SAMPLE from_float(float f) noexcept
+    {
+        const double v = (double)f * (double)FULL;
+        const double hi = (double)(FULL - 1);
+        return (SAMPLE)(int32_t)(v > hi ? hi : (v < -hi - 1 ? -hi - 1 : v));
+    }
+};
+} // namespace detail
+
+template <>
+struct sample_traits<int32_t>
+    : detail::int_sample_traits<int32_t, int64_t, 2147483648LL>
+{
+    static constexpr PaSampleFormat format = paInt32;
+};
+template <>
+struct sample_traits<Int24> : detail::int_sample_traits<Int24, int64_t, 8388608>
+{
+    static constexpr PaSampleFormat format = paInt24;
+};
+template <>
+struct sample_traits<int16_t> : detail::int_sample_traits<int16_t, int32_t, 32768>
+{
+    static constexpr PaSampleFormat format = paInt16;
+};
+template <>
+struct sample_traits<int8_t> : detail::int_sample_traits<int8_t, int32_t, 128>
+{
+    static constexpr PaSampleFormat format = paInt8;
+};
+
+// paUInt8 is offset binary: 128 is silence.
+template <> struct sample_traits<uint8_t>
+{
+    static constexpr PaSampleFormat format = paUInt8;
+    static constexpr bool is_integer = true;
+    using gain_type = int32_t; // Q15
+    static gain_type make_gain(float g) noexcept
+    {
+        return (int32_t)(g * 32768.0f + 0.5f);
+    }
+    static PA_FORCE_INLINE uint8_t apply_gain(uint8_t s, gain_type g) noexcept
+    {
+        return (uint8_t)((((int32_t)s - 128) * g >> 15) + 128);
+    }
+    static float to_float(uint8_t s) noexcept
+    {
+        return ((int32_t)s - 128) / 128.0f;
+    }
+    static uint8_t from_float(float f) noexcept
+    {
+        const float v = f * 128.0f;
+        return (uint8_t)((int32_t)(v > 127 ? 127 : (v < -128 ? -128 : v)) + 128);
+    }
+};
+
 namespace strings
 {
 template <typename... Args>
@@ -46,11 +213,6 @@ void make_string(std::ostringstream &stream, Args &&... args) noexcept
 
 namespace dsp
 {
-#ifdef _MSC_VER
-#define PA_FORCE_INLINE __forceinline
-#else
-#define PA_FORCE_INLINE __attribute__((always_inline))
-#endif
 static inline float next_sine_sample(unsigned int &sample_num,
                                      unsigned int samplerate,
                                      unsigned int freq = 440)
@@ -60,248 +222,1246 @@ static inline float next_sine_sample(unsigned int &sample_num,
     return (float)sin(freq * 2 * M_PI * sample_num++ / samplerate);
 }
 
-template <typename T> class fader
+namespace simd
 {
-    T m_destValue;
-    float m_secToDest;
-    std::atomic<int> m_steps;
-    float m_samplerate;
-    float m_startValue = 0;
-    float m_step = 0;
-    float m_vol = 0;
-    int m_nch = 2;
-    void calc()
-    {
-        if (m_secToDest <= 0 || m_samplerate <= 0) return;
-        const float fsteps = (m_secToDest * m_samplerate) * m_nch;
-        m_steps = (int)(fsteps + 0.5f);
-        m_step = (m_destValue - m_startValue) / m_steps;
-        m_vol = m_startValue;
-    }
+// Which instruction set the float kernels below were built for.
+enum class Isa : unsigned int
+{
+    Scalar = 0,
+    SSE2,
+    AVX2,
+    NEON
+};
 
-  public:
-    fader() : m_destValue(0), m_secToDest(0), m_steps(0), m_samplerate(0) {}
-    fader(T destValue, float secToDest, float samplerate, int nch = 2)
-        : m_destValue(destValue), m_secToDest(secToDest), m_steps(0),
-          m_samplerate(samplerate), m_nch(nch), m_vol(0)
+// Linear ramps add `d` to the gain every frame, exponential ones multiply
+// by it. Both return the gain for the frame after the last one processed.
+template <bool EXP> static inline float ramp_step(float g, float d) noexcept
+{
+    if constexpr (EXP)
+        return g * d;
+    else
+        return g + d;
+}
+
+// Plain C++ reference kernels. These also serve every integer format, via
+// the native sample_traits gain.
+template <typename T>
+static inline void gain_scalar(T *s, size_t n, float g) noexcept
+{
+    using traits = sample_traits<T>;
+    const auto q = traits::make_gain(g);
+    for (size_t i = 0; i < n; ++i)
+        s[i] = traits::apply_gain(s[i], q);
+}
+
+template <bool EXP, typename T>
+static inline float ramp_scalar(T *s, size_t frames, size_t nch, float g,
+                                float d) noexcept
+{
+    using traits = sample_traits<T>;
+    for (size_t f = 0; f < frames; ++f)
     {
-        calc();
+        const auto q = traits::make_gain(g);
+        for (size_t ch = 0; ch < nch; ++ch, ++s)
+            *s = traits::apply_gain(*s, q);
+        g = ramp_step<EXP>(g, d);
     }
+    return g;
+}
+
+// dst += src * gains[channel], over `frames` interleaved frames of nch
+// channels. The mixer's accumulate step.
+static inline void mix_scalar(float *dst, const float *src, size_t frames,
+                              size_t nch, const float *gains) noexcept
+{
+    for (size_t f = 0; f < frames; ++f)
+        for (size_t ch = 0; ch < nch; ++ch, ++dst, ++src)
+            *dst += *src * gains[ch];
+}
 
-    T volume() const noexcept { return m_vol; }
-    void arm(T destval, float samplerate, float secToDest)
+// sum of a[i] * b[i]. The resampler's inner loop; four partial sums so the
+// scalar build does not serialize on one accumulator.
+static inline float dot_scalar(const float *a, const float *b,
+                               size_t n) noexcept
+{
+    float s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
     {
-        m_startValue = m_vol;
-        m_destValue = destval;
-        m_samplerate = samplerate;
-        m_secToDest = secToDest;
-        calc();
+        s0 += a[i] * b[i];
+        s1 += a[i + 1] * b[i + 1];
+        s2 += a[i + 2] * b[i + 2];
+        s3 += a[i + 3] * b[i + 3];
     }
+    for (; i < n; ++i)
+        s0 += a[i] * b[i];
+    return (s0 + s1) + (s2 + s3);
+}
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) ||           \
+    defined(_M_IX86)
+#define PA_SIMD_X86 1
+#if defined(_MSC_VER) && !defined(__clang__)
+#define PA_TARGET_SSE2
+#define PA_TARGET_AVX2
+#else
+#define PA_TARGET_SSE2 __attribute__((target("sse2")))
+#define PA_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
 
-    PA_FORCE_INLINE void processSample(T &sample)
+PA_TARGET_SSE2 static inline void gain_sse2(float *s, size_t n, float g)
+{
+    const __m128 vg = _mm_set1_ps(g);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+        _mm_storeu_ps(s + i, _mm_mul_ps(_mm_loadu_ps(s + i), vg));
+    for (; i < n; ++i)
+        s[i] *= g;
+}
+
+template <bool EXP>
+PA_TARGET_SSE2 static inline float ramp_sse2(float *s, size_t frames,
+                                             size_t nch, float g, float d)
+{
+    size_t f = 0;
+    if (4 % nch == 0)
     {
-        if (m_steps > 0)
+        // each vector spans 4 / nch whole frames
+        const size_t fpv = 4 / nch;
+        alignas(16) float lanes[4];
+        float gi = g;
+        for (size_t j = 0; j < fpv; ++j, gi = ramp_step<EXP>(gi, d))
+            for (size_t ch = 0; ch < nch; ++ch)
+                lanes[j * nch + ch] = gi;
+        float inc = EXP ? 1.0f : 0.0f;
+        for (size_t j = 0; j < fpv; ++j)
+            inc = EXP ? inc * d : inc + d;
+        __m128 vg = _mm_load_ps(lanes);
+        const __m128 vinc = _mm_set1_ps(inc);
+        for (; f + fpv <= frames; f += fpv)
         {
-            sample *= m_vol;
-            m_vol += m_step;
-            if (m_vol < 0) m_vol = 0;
-            --m_steps;
-            if (m_steps <= 0)
-            {
-                m_vol = this->m_destValue;
-                return;
-            }
+            float *p = s + f * nch;
+            _mm_storeu_ps(p, _mm_mul_ps(_mm_loadu_ps(p), vg));
+            vg = EXP ? _mm_mul_ps(vg, vinc) : _mm_add_ps(vg, vinc);
         }
+        g = _mm_cvtss_f32(vg);
     }
-
-    void processSamples(int nFrames, T *samples, const int nch)
+    else
     {
-        while (nFrames > 0)
+        // awkward channel counts: one broadcast gain per frame
+        for (; f < frames; ++f, g = ramp_step<EXP>(g, d))
         {
-            if (active())
-            {
-                for (auto ch = 0; ch < nch; ++ch)
-                {
-                    T &val = *samples++;
-                    processSample(val);
-                }
-                nFrames--;
-            }
-            else
-            {
-                if (!is_almost_equal(1.0f, m_destValue))
-                {
-                    for (auto ch = 0; ch < nch; ++ch)
-                    {
-                        *samples = *samples * m_vol;
-                        ++samples;
-                    }
-                    nFrames--;
-                }
-                else
-                {
-                    return; // nothing to do here: just multiply by one.
-                }
-            }
-        };
+            float *p = s + f * nch;
+            const __m128 vg = _mm_set1_ps(g);
+            size_t ch = 0;
+            for (; ch + 4 <= nch; ch += 4)
+                _mm_storeu_ps(p + ch, _mm_mul_ps(_mm_loadu_ps(p + ch), vg));
+            for (; ch < nch; ++ch)
+                p[ch] *= g;
+        }
     }
+    return ramp_scalar<EXP>(s + f * nch, frames - f, nch, g, d);
+}
 
-    bool active() const noexcept { return m_steps > 0; }
-};
-
-template <typename T> struct Atomic
+PA_TARGET_SSE2 static inline void mix_sse2(float *dst, const float *src,
+                                           size_t frames, size_t nch,
+                                           const float *gains)
 {
-    std::atomic<T> atomic;
-
-    Atomic() : atomic(T()) {}
-
-    explicit Atomic(T const &v) : atomic(v) {}
-    explicit Atomic(std::atomic<T> const &a) : atomic(a.load()) {}
-
-    Atomic(Atomic const &other) : atomic(other.atomic.load()) {}
-
-    Atomic &operator=(Atomic const &other)
+    const size_t n = frames * nch;
+    size_t i = 0;
+    if (4 % nch == 0)
     {
-        atomic.store(other.atomic.load());
-        return *this;
+        // the gains repeat every nch lanes
+        alignas(16) float lanes[4];
+        for (size_t j = 0; j < 4; ++j)
+            lanes[j] = gains[j % nch];
+        const __m128 vg = _mm_load_ps(lanes);
+        for (; i + 4 <= n; i += 4)
+            _mm_storeu_ps(dst + i,
+                          _mm_add_ps(_mm_loadu_ps(dst + i),
+                                     _mm_mul_ps(_mm_loadu_ps(src + i), vg)));
     }
-    Atomic &operator=(const T value)
+    else if (nch % 4 == 0)
     {
-        atomic = value;
-        return *this;
+        for (; i < n; i += nch)
+            for (size_t ch = 0; ch < nch; ch += 4)
+                _mm_storeu_ps(dst + i + ch,
+                              _mm_add_ps(_mm_loadu_ps(dst + i + ch),
+                                         _mm_mul_ps(_mm_loadu_ps(src + i + ch),
+                                                    _mm_loadu_ps(gains + ch))));
     }
+    mix_scalar(dst + i, src + i, (n - i) / nch, nch, gains);
+}
 
-    operator T() { return atomic; }
-};
-
-typedef Atomic<double> AtomicDouble;
-
-template <int Channels = 2, typename Value = float> class EnvelopeFollower
+PA_TARGET_SSE2 static inline float dot_sse2(const float *a, const float *b,
+                                            size_t n)
 {
-    std::array<AtomicDouble, 2> m_env;
-
-  public:
-    EnvelopeFollower()
+    __m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
     {
-        assert(m_env[0].atomic.is_lock_free());
-
-        for (int i = 0; i < Channels; i++)
-            m_env[i] = 0;
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i),
+                                           _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4),
+                                           _mm_loadu_ps(b + i + 4)));
     }
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, _mm_add_ps(acc0, acc1));
+    return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]) +
+           dot_scalar(a + i, b + i, n - i);
+}
 
-    Value operator[](unsigned int channel) const { return m_env[channel]; }
+PA_TARGET_AVX2 static inline void gain_avx2(float *s, size_t n, float g)
+{
+    const __m256 vg = _mm256_set1_ps(g);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+        _mm256_storeu_ps(s + i, _mm256_mul_ps(_mm256_loadu_ps(s + i), vg));
+    for (; i < n; ++i)
+        s[i] *= g;
+}
 
-    void Setup(int sampleRate, double attackMs, double releaseMs)
+template <bool EXP>
+PA_TARGET_AVX2 static inline float ramp_avx2(float *s, size_t frames,
+                                             size_t nch, float g, float d)
+{
+    size_t f = 0;
+    if (8 % nch == 0)
     {
-        m_a = pow(0.01, 1.0 / (attackMs * sampleRate * 0.001));
-        m_r = pow(0.01, 1.0 / (releaseMs * sampleRate * 0.001));
+        const size_t fpv = 8 / nch;
+        alignas(32) float lanes[8];
+        float gi = g;
+        for (size_t j = 0; j < fpv; ++j, gi = ramp_step<EXP>(gi, d))
+            for (size_t ch = 0; ch < nch; ++ch)
+                lanes[j * nch + ch] = gi;
+        float inc = EXP ? 1.0f : 0.0f;
+        for (size_t j = 0; j < fpv; ++j)
+            inc = EXP ? inc * d : inc + d;
+        __m256 vg = _mm256_load_ps(lanes);
+        const __m256 vinc = _mm256_set1_ps(inc);
+        for (; f + fpv <= frames; f += fpv)
+        {
+            float *p = s + f * nch;
+            _mm256_storeu_ps(p, _mm256_mul_ps(_mm256_loadu_ps(p), vg));
+            vg = EXP ? _mm256_mul_ps(vg, vinc) : _mm256_add_ps(vg, vinc);
+        }
+        g = _mm256_cvtss_f32(vg);
     }
-
-    void Process(size_t samples, const Value **src)
+    else
     {
-
-        for (int i = 0; i < Channels; i++)
+        for (; f < frames; ++f, g = ramp_step<EXP>(g, d))
         {
-            const Value *cur = src[i];
-
-            double e = m_env[i];
-            for (int n = samples; n; n--)
-            {
-                double v = std::abs(*cur++);
-                if (v > e)
-                    e = m_a * (e - v) + v;
-                else
-                    e = m_r * (e - v) + v;
-            }
-            m_env[i] = e;
+            float *p = s + f * nch;
+            const __m256 vg = _mm256_set1_ps(g);
+            size_t ch = 0;
+            for (; ch + 8 <= nch; ch += 8)
+                _mm256_storeu_ps(p + ch,
+                                 _mm256_mul_ps(_mm256_loadu_ps(p + ch), vg));
+            for (; ch < nch; ++ch)
+                p[ch] *= g;
         }
     }
+    return ramp_scalar<EXP>(s + f * nch, frames - f, nch, g, d);
+}
 
-  protected:
-    double m_a = 0;
-    double m_r = 0;
-};
-} // namespace dsp
+PA_TARGET_AVX2 static inline void mix_avx2(float *dst, const float *src,
+                                           size_t frames, size_t nch,
+                                           const float *gains)
+{
+    const size_t n = frames * nch;
+    size_t i = 0;
+    if (8 % nch == 0)
+    {
+        alignas(32) float lanes[8];
+        for (size_t j = 0; j < 8; ++j)
+            lanes[j] = gains[j % nch];
+        const __m256 vg = _mm256_load_ps(lanes);
+        for (; i + 8 <= n; i += 8)
+            _mm256_storeu_ps(
+                dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i),
+                                       _mm256_mul_ps(_mm256_loadu_ps(src + i),
+                                                     vg)));
+    }
+    else if (nch % 8 == 0)
+    {
+        for (; i < n; i += nch)
+            for (size_t ch = 0; ch < nch; ch += 8)
+                _mm256_storeu_ps(
+                    dst + i + ch,
+                    _mm256_add_ps(_mm256_loadu_ps(dst + i + ch),
+                                  _mm256_mul_ps(_mm256_loadu_ps(src + i + ch),
+                                                _mm256_loadu_ps(gains + ch))));
+    }
+    else
+    {
+        // 3, 5, 6, 7 channels...: the 128 bit kernel handles multiples of 4
+        mix_sse2(dst, src, frames, nch, gains);
+        return;
+    }
+    mix_scalar(dst + i, src + i, (n - i) / nch, nch, gains);
+}
 
-[[maybe_unused]] static inline void sleep_ms(const long ms) noexcept
+PA_TARGET_AVX2 static inline float dot_avx2(const float *a, const float *b,
+                                            size_t n)
 {
-    Pa_Sleep(ms);
+    __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        acc0 = _mm256_add_ps(acc0, _mm256_mul_ps(_mm256_loadu_ps(a + i),
+                                                 _mm256_loadu_ps(b + i)));
+        acc1 = _mm256_add_ps(acc1, _mm256_mul_ps(_mm256_loadu_ps(a + i + 8),
+                                                 _mm256_loadu_ps(b + i + 8)));
+    }
+    alignas(32) float lanes[8];
+    _mm256_store_ps(lanes, _mm256_add_ps(acc0, acc1));
+    return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) +
+           ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7])) +
+           dot_sse2(a + i, b + i, n - i);
 }
-[[maybe_unused]] static inline void SleepmS(const long ms) noexcept
+
+static inline bool cpu_has_avx2() noexcept
 {
-    Pa_Sleep(ms);
+#if defined(_MSC_VER) && !defined(__clang__)
+    int r[4];
+    __cpuid(r, 1);
+    const bool osxsave_avx = (r[2] & (1 << 27)) && (r[2] & (1 << 28));
+    if (!osxsave_avx || (_xgetbv(0) & 6) != 6) return false;
+    __cpuidex(r, 7, 0);
+    return (r[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
 }
+#endif // x86
 
-class Exception : public std::runtime_error
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define PA_SIMD_NEON 1
+static inline void gain_neon(float *s, size_t n, float g)
 {
-    std::ostringstream m_stream;
-    std::string m_str;
-    PaError m_errcode;
+    const float32x4_t vg = vdupq_n_f32(g);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4)
+        vst1q_f32(s + i, vmulq_f32(vld1q_f32(s + i), vg));
+    for (; i < n; ++i)
+        s[i] *= g;
+}
 
-  public:
-    static inline auto error_string(PaError errCode) noexcept
-    {
-        return Pa_GetErrorText(errCode);
-    }
-    template <typename... Args>
-    auto error_string_ex(PaError errCode, Args &&... args) noexcept
+template <bool EXP>
+static inline float ramp_neon(float *s, size_t frames, size_t nch, float g,
+                              float d)
+{
+    size_t f = 0;
+    if (4 % nch == 0)
     {
-        m_stream.str().clear();
-        if (errCode == -1)
+        const size_t fpv = 4 / nch;
+        float lanes[4];
+        float gi = g;
+        for (size_t j = 0; j < fpv; ++j, gi = ramp_step<EXP>(gi, d))
+            for (size_t ch = 0; ch < nch; ++ch)
+                lanes[j * nch + ch] = gi;
+        float inc = EXP ? 1.0f : 0.0f;
+        for (size_t j = 0; j < fpv; ++j)
+            inc = EXP ? inc * d : inc + d;
+        float32x4_t vg = vld1q_f32(lanes);
+        const float32x4_t vinc = vdupq_n_f32(inc);
+        for (; f + fpv <= frames; f += fpv)
         {
-            m_stream << "Generic error\n";
+            float *p = s + f * nch;
+            vst1q_f32(p, vmulq_f32(vld1q_f32(p), vg));
+            vg = EXP ? vmulq_f32(vg, vinc) : vaddq_f32(vg, vinc);
         }
-        else
+        g = vgetq_lane_f32(vg, 0);
+    }
+    else
+    {
+        for (; f < frames; ++f, g = ramp_step<EXP>(g, d))
         {
-            std::string pe = error_string(errCode);
-            m_stream << "PortAudio error code: " << errCode << " (" << pe
-                     << ")\n";
+            float *p = s + f * nch;
+            const float32x4_t vg = vdupq_n_f32(g);
+            size_t ch = 0;
+            for (; ch + 4 <= nch; ch += 4)
+                vst1q_f32(p + ch, vmulq_f32(vld1q_f32(p + ch), vg));
+            for (; ch < nch; ++ch)
+                p[ch] *= g;
         }
-
-        strings::make_string(m_stream, args...);
-        std::string annoying_temp = m_stream.str();
-        return annoying_temp;
     }
+    return ramp_scalar<EXP>(s + f * nch, frames - f, nch, g, d);
+}
 
-    Exception(const PaError errCode) noexcept
-        : std::runtime_error(""), m_str(error_string(errCode)),
-          m_errcode(errCode)
+static inline void mix_neon(float *dst, const float *src, size_t frames,
+                            size_t nch, const float *gains)
+{
+    const size_t n = frames * nch;
+    size_t i = 0;
+    if (4 % nch == 0)
+    {
+        float lanes[4];
+        for (size_t j = 0; j < 4; ++j)
+            lanes[j] = gains[j % nch];
+        const float32x4_t vg = vld1q_f32(lanes);
+        for (; i + 4 <= n; i += 4)
+            vst1q_f32(dst + i, vaddq_f32(vld1q_f32(dst + i),
+                                         vmulq_f32(vld1q_f32(src + i), vg)));
+    }
+    else if (nch % 4 == 0)
     {
+        for (; i < n; i += nch)
+            for (size_t ch = 0; ch < nch; ch += 4)
+                vst1q_f32(dst + i + ch,
+                          vaddq_f32(vld1q_f32(dst + i + ch),
+                                    vmulq_f32(vld1q_f32(src + i + ch),
+                                              vld1q_f32(gains + ch))));
     }
+    mix_scalar(dst + i, src + i, (n - i) / nch, nch, gains);
+}
 
-    template <typename... ARGS>
-    Exception(const PaError errCode, ARGS &&... args) noexcept
-        : std::runtime_error(""),
-          m_str(error_string_ex(errCode, std::forward<ARGS>(args)...)),
-          m_errcode(errCode)
+static inline float dot_neon(const float *a, const float *b, size_t n)
+{
+    float32x4_t acc0 = vdupq_n_f32(0), acc1 = vdupq_n_f32(0);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
     {
+        acc0 = vmlaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+        acc1 = vmlaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
     }
+    const float32x4_t acc = vaddq_f32(acc0, acc1);
+    return (vgetq_lane_f32(acc, 0) + vgetq_lane_f32(acc, 1)) +
+           (vgetq_lane_f32(acc, 2) + vgetq_lane_f32(acc, 3)) +
+           dot_scalar(a + i, b + i, n - i);
+}
+#endif // neon
 
-    virtual const char *what() const noexcept
+// One table per instruction set; the fader and the mixer call through it
+// once per block, never per sample. The resampler's dot product is the
+// exception: it is called once per output frame and channel, over a whole
+// filter phase.
+struct float_kernels
+{
+    Isa isa;
+    void (*gain)(float *s, size_t n, float g);
+    float (*ramp_linear)(float *s, size_t frames, size_t nch, float g,
+                         float d);
+    float (*ramp_exp)(float *s, size_t frames, size_t nch, float g, float d);
+    void (*mix)(float *dst, const float *src, size_t frames, size_t nch,
+                const float *gains);
+    float (*dot)(const float *a, const float *b, size_t n);
+};
+
+static inline bool isa_supported(Isa isa) noexcept
+{
+    switch (isa)
     {
+    case Isa::Scalar: return true;
+#ifdef PA_SIMD_X86
+    case Isa::SSE2: return true;
+    case Isa::AVX2: return cpu_has_avx2();
+#endif
+#ifdef PA_SIMD_NEON
+    case Isa::NEON: return true;
+#endif
+    default: return false;
+    }
+}
 
-        const char *ps = m_str.c_str();
-        return ps;
+// The kernels for a given instruction set. Asking for one the CPU does
+// not support gets you the scalar ones.
+static inline float_kernels kernels_for(Isa isa) noexcept
+{
+    if (!isa_supported(isa)) isa = Isa::Scalar;
+    switch (isa)
+    {
+#ifdef PA_SIMD_X86
+    case Isa::SSE2:
+        return {isa, gain_sse2, ramp_sse2<false>, ramp_sse2<true>, mix_sse2,
+                dot_sse2};
+    case Isa::AVX2:
+        return {isa, gain_avx2, ramp_avx2<false>, ramp_avx2<true>, mix_avx2,
+                dot_avx2};
+#endif
+#ifdef PA_SIMD_NEON
+    case Isa::NEON:
+        return {isa, gain_neon, ramp_neon<false>, ramp_neon<true>, mix_neon,
+                dot_neon};
+#endif
+    default:
+        return {Isa::Scalar, gain_scalar<float>, ramp_scalar<false, float>,
+                ramp_scalar<true, float>, mix_scalar, dot_scalar};
     }
+}
 
-    PaError errorCode() const noexcept { return m_errcode; }
-};
+// The best kernels for this CPU, detected once on first use.
+static inline const float_kernels &best_kernels() noexcept
+{
+    static const float_kernels k = [] {
+        for (Isa isa : {Isa::AVX2, Isa::SSE2, Isa::NEON})
+            if (isa_supported(isa)) return kernels_for(isa);
+        return kernels_for(Isa::Scalar);
+    }();
+    return k;
+}
+} // namespace simd
 
-struct SampleFormat
+enum class FadeShape : unsigned int
 {
-    static inline PaSampleFormat Float32 = paFloat32;
-    static inline PaSampleFormat Int32 = paInt32;
-    static inline PaSampleFormat Int24 = paInt24;
-    static inline PaSampleFormat Int16 = paInt16;
-    static inline PaSampleFormat Int8 = paInt8;
-    static inline PaSampleFormat UInt8 = paUInt8;
-    static inline PaSampleFormat CustomFormat = paCustomFormat;
-    static inline PaSampleFormat NonInterleaved = paNonInterleaved;
+    Linear = 0,
+    Exponential = 1 // constant dB per second
 };
 
-struct StreamSetupInfo
+// Gain ramp applied to the stream output. T is the stream's sample type; the
+// gain itself is always a float in [0, 1].
+// Work is done a block at a time: the remaining length of the ramp is read
+// and written once per call, and the samples themselves go through the
+// simd kernels (float) or the native sample_traits kernels (integers).
+// Every channel of a frame gets the same gain.
+template <typename T> class fader
 {
-    // PaStreamCallback *streamCallback = {nullptr};
+    using traits = sample_traits<T>;
+    // exponential ramps cannot start or end at true silence; they run to
+    // -80dB and then snap to the destination.
+    static constexpr float kExpFloor = 1e-4f;
+
+    std::atomic<int> m_framesLeft{0};
+    float m_destValue = 0;
+    float m_vol = 0;
+    float m_delta = 0; // per frame: added (linear) or multiplied (exp)
+    FadeShape m_shape = FadeShape::Linear;
+
+    float ramp(T *s, size_t frames, size_t nch, float g) noexcept
+    {
+        if constexpr (std::is_same_v<T, float>)
+        {
+            const auto &k = simd::best_kernels();
+            return m_shape == FadeShape::Exponential
+                       ? k.ramp_exp(s, frames, nch, g, m_delta)
+                       : k.ramp_linear(s, frames, nch, g, m_delta);
+        }
+        else
+        {
+            return m_shape == FadeShape::Exponential
+                       ? simd::ramp_scalar<true>(s, frames, nch, g, m_delta)
+                       : simd::ramp_scalar<false>(s, frames, nch, g, m_delta);
+        }
+    }
+    void gain(T *s, size_t n, float g) noexcept
+    {
+        if constexpr (std::is_same_v<T, float>)
+            simd::best_kernels().gain(s, n, g);
+        else
+            simd::gain_scalar(s, n, g);
+    }
+    // ramp `rampFrames` of a block that had `left` frames of fade to go.
+    void advance(int left, size_t rampFrames, float g) noexcept
+    {
+        const int remaining = left - (int)rampFrames;
+        m_vol = remaining <= 0 ? m_destValue : (std::max)(0.0f, g);
+        m_framesLeft.store((std::max)(remaining, 0),
+                           std::memory_order_release);
+    }
+
+  public:
+    fader() = default;
+    fader(float destValue, float secToDest, float samplerate,
+          FadeShape shape = FadeShape::Linear)
+    {
+        arm(destValue, samplerate, secToDest, shape);
+    }
+
+    float volume() const noexcept { return m_vol; }
+    void arm(float destval, float samplerate, float secToDest,
+             FadeShape shape = FadeShape::Linear)
+    {
+        m_destValue = destval;
+        m_shape = shape;
+        if (secToDest <= 0 || samplerate <= 0)
+        {
+            m_vol = destval; // no ramp: jump straight there
+            m_framesLeft.store(0, std::memory_order_release);
+            return;
+        }
+        const int frames = (std::max)(1, (int)(secToDest * samplerate + 0.5f));
+        if (shape == FadeShape::Exponential)
+        {
+            m_vol = (std::max)(m_vol, kExpFloor);
+            const float to = (std::max)(destval, kExpFloor);
+            m_delta = (float)std::pow((double)to / m_vol, 1.0 / frames);
+        }
+        else
+        {
+            m_delta = (destval - m_vol) / frames;
+        }
+        m_framesLeft.store(frames, std::memory_order_release);
+    }
+
+    // Interleaved buffer of nFrames * nch samples.
+    void processSamples(int nFrames, T *samples, const int nch)
+    {
+        const int left = m_framesLeft.load(std::memory_order_acquire);
+        const size_t rampFrames = (size_t)(std::min)(nFrames, left);
+        if (rampFrames)
+        {
+            advance(left, rampFrames,
+                    ramp(samples, rampFrames, (size_t)nch, m_vol));
+        }
+        if ((int)rampFrames < nFrames && !is_almost_equal(1.0f, m_vol))
+        {
+            gain(samples + rampFrames * nch, (nFrames - rampFrames) * nch,
+                 m_vol);
+        }
+    }
+
+    // Planar buffers: one contiguous run of nFrames per channel.
+    void processPlanar(int nFrames, T *const *channels, const int nch)
+    {
+        const int left = m_framesLeft.load(std::memory_order_acquire);
+        const size_t rampFrames = (size_t)(std::min)(nFrames, left);
+        if (rampFrames)
+        {
+            float g = m_vol;
+            for (int ch = 0; ch < nch; ++ch)
+                g = ramp(channels[ch], rampFrames, 1, m_vol);
+            advance(left, rampFrames, g);
+        }
+        if ((int)rampFrames < nFrames && !is_almost_equal(1.0f, m_vol))
+        {
+            for (int ch = 0; ch < nch; ++ch)
+                gain(channels[ch] + rampFrames, nFrames - rampFrames, m_vol);
+        }
+    }
+
+    bool active() const noexcept
+    {
+        return m_framesLeft.load(std::memory_order_acquire) > 0;
+    }
+    // true while the fader still changes the signal: ramping, or parked at
+    // anything but unity gain.
+    bool needed() const noexcept
+    {
+        return active() || !is_almost_equal(1.0f, m_vol);
+    }
+};
+
+template <typename T> struct Atomic
+{
+    std::atomic<T> atomic;
+
+    Atomic() : atomic(T()) {}
+
+    explicit Atomic(T const &v) : atomic(v) {}
+    explicit Atomic(std::atomic<T> const &a) : atomic(a.load()) {}
+
+    Atomic(Atomic const &other) : atomic(other.atomic.load()) {}
+
+    Atomic &operator=(Atomic const &other)
+    {
+        atomic.store(other.atomic.load());
+        return *this;
+    }
+    Atomic &operator=(const T value)
+    {
+        atomic = value;
+        return *this;
+    }
+
+    operator T() const { return atomic; }
+};
+
+typedef Atomic<double> AtomicDouble;
+
+// A consistent copy of every channel's meters, taken at one buffer boundary.
+// All values are normalized to [0, 1] whatever the sample format.
+template <int Channels> struct MeterSnapshot
+{
+    std::array<float, Channels> envelope{};
+    std::array<float, Channels> peak{}; // held, then falling
+    std::array<float, Channels> rms{};
+    uint64_t buffers = 0; // how many buffers had been metered
+};
+
+namespace simd
+{
+// One frame of meter update for n channels, as lanes: attack/release
+// envelope, running mean square and block maximum. The attack/release
+// choice is a compare-and-select, so there is no data-dependent branch.
+static inline void follow_lanes(float *env, float *ms, float *mx,
+                                const float *x, size_t n, float a, float r,
+                                float k) noexcept
+{
+    size_t ch = 0;
+#if defined(PA_SIMD_X86)
+    const __m128 va = _mm_set1_ps(a), vr = _mm_set1_ps(r), vk = _mm_set1_ps(k);
+    for (; ch + 4 <= n; ch += 4)
+    {
+        const __m128 v = _mm_loadu_ps(x + ch);
+        __m128 e = _mm_loadu_ps(env + ch);
+        const __m128 up = _mm_cmpgt_ps(v, e);
+        const __m128 c = _mm_or_ps(_mm_and_ps(up, va), _mm_andnot_ps(up, vr));
+        e = _mm_add_ps(_mm_mul_ps(c, _mm_sub_ps(e, v)), v);
+        _mm_storeu_ps(env + ch, e);
+        __m128 m = _mm_loadu_ps(ms + ch);
+        m = _mm_add_ps(m, _mm_mul_ps(vk, _mm_sub_ps(_mm_mul_ps(v, v), m)));
+        _mm_storeu_ps(ms + ch, m);
+        _mm_storeu_ps(mx + ch, _mm_max_ps(_mm_loadu_ps(mx + ch), v));
+    }
+#elif defined(PA_SIMD_NEON)
+    const float32x4_t va = vdupq_n_f32(a), vr = vdupq_n_f32(r),
+                      vk = vdupq_n_f32(k);
+    for (; ch + 4 <= n; ch += 4)
+    {
+        const float32x4_t v = vld1q_f32(x + ch);
+        float32x4_t e = vld1q_f32(env + ch);
+        const float32x4_t c = vbslq_f32(vcgtq_f32(v, e), va, vr);
+        e = vaddq_f32(vmulq_f32(c, vsubq_f32(e, v)), v);
+        vst1q_f32(env + ch, e);
+        float32x4_t m = vld1q_f32(ms + ch);
+        m = vaddq_f32(m, vmulq_f32(vk, vsubq_f32(vmulq_f32(v, v), m)));
+        vst1q_f32(ms + ch, m);
+        vst1q_f32(mx + ch, vmaxq_f32(vld1q_f32(mx + ch), v));
+    }
+#endif
+    for (; ch < n; ++ch)
+    {
+        const float v = x[ch];
+        const float c = v > env[ch] ? a : r;
+        env[ch] = c * (env[ch] - v) + v;
+        ms[ch] += k * (v * v - ms[ch]);
+        mx[ch] = (std::max)(mx[ch], v);
+    }
+}
+} // namespace simd
+
+// Per-channel meters (envelope, held peak, RMS) for up to 64 channels.
+// Process*() runs on the audio thread and keeps its working state in plain
+// floats; at the end of each buffer it publishes all channels together
+// under a sequence counter, so readers on other threads get a consistent
+// snapshot without ever blocking the writer.
+template <int Channels = 2, typename Value = float> class EnvelopeFollower
+{
+    static_assert(Channels > 0 && Channels <= 64,
+                  "EnvelopeFollower supports 1 to 64 channels");
+    using traits = sample_traits<Value>;
+
+    // audio thread only
+    alignas(64) std::array<float, Channels> m_env{};
+    std::array<float, Channels> m_ms{};
+    std::array<float, Channels> m_mx{};
+    std::array<float, Channels> m_peak{};
+    std::array<int, Channels> m_holdLeft{};
+    float m_a = 0;
+    float m_r = 0;
+    float m_k = 0;       // mean-square smoothing
+    float m_fall = 1;    // per-frame peak fall, after the hold
+    int m_holdFrames = 0;
+
+    // published
+    alignas(64) std::atomic<uint64_t> m_seq{0};
+    std::array<std::atomic<float>, Channels> m_pubEnv{};
+    std::array<std::atomic<float>, Channels> m_pubPeak{};
+    std::array<std::atomic<float>, Channels> m_pubRms{};
+
+  public:
+    EnvelopeFollower() { assert(m_pubEnv[0].is_lock_free()); }
+
+    static constexpr int channels() noexcept { return Channels; }
+
+    // the latest published envelope for one channel
+    float operator[](unsigned int channel) const
+    {
+        assert(channel < (unsigned int)Channels);
+        return m_pubEnv[channel].load(std::memory_order_relaxed);
+    }
+
+    void Setup(int sampleRate, double attackMs, double releaseMs,
+               double holdMs = 1000, double rmsMs = 300,
+               double peakFallDbPerSec = 20)
+    {
+        const double sr = sampleRate;
+        m_a = (float)pow(0.01, 1.0 / (attackMs * sr * 0.001));
+        m_r = (float)pow(0.01, 1.0 / (releaseMs * sr * 0.001));
+        m_k = (float)(1.0 - exp(-1.0 / (rmsMs * sr * 0.001)));
+        m_fall = (float)pow(10.0, -peakFallDbPerSec / 20.0 / sr);
+        m_holdFrames = (int)(holdMs * sr * 0.001);
+        for (auto &h : m_holdLeft)
+            h = (std::min)(h, m_holdFrames);
+    }
+
+    // Planar input: src holds one pointer per channel.
+    void Process(size_t frames, const Value *const *src)
+    {
+        float x[Channels];
+        for (size_t f = 0; f < frames; ++f)
+        {
+            for (int ch = 0; ch < Channels; ++ch)
+                x[ch] = std::abs(traits::to_float(src[ch][f]));
+            step(x);
+        }
+        finishBlock(frames);
+    }
+
+    // Interleaved input: one buffer, Channels samples per frame.
+    void ProcessInterleaved(size_t frames, const Value *src)
+    {
+        float x[Channels];
+        for (size_t f = 0; f < frames; ++f, src += Channels)
+        {
+            for (int ch = 0; ch < Channels; ++ch)
+                x[ch] = std::abs(traits::to_float(src[ch]));
+            step(x);
+        }
+        finishBlock(frames);
+    }
+
+    // Safe from any thread. Retries only if it raced a publish.
+    MeterSnapshot<Channels> snapshot() const noexcept
+    {
+        MeterSnapshot<Channels> s;
+        uint64_t before, after;
+        do
+        {
+            before = m_seq.load(std::memory_order_acquire);
+            for (int ch = 0; ch < Channels; ++ch)
+            {
+                s.envelope[ch] = m_pubEnv[ch].load(std::memory_order_relaxed);
+                s.peak[ch] = m_pubPeak[ch].load(std::memory_order_relaxed);
+                s.rms[ch] = m_pubRms[ch].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = m_seq.load(std::memory_order_relaxed);
+        } while ((before & 1) || before != after);
+        s.buffers = before / 2;
+        return s;
+    }
+
+  private:
+    PA_FORCE_INLINE void step(const float *x) noexcept
+    {
+        simd::follow_lanes(m_env.data(), m_ms.data(), m_mx.data(), x,
+                           Channels, m_a, m_r, m_k);
+    }
+
+    // Peak hold is tracked per buffer rather than per frame, which keeps
+    // the hold/fall logic out of the sample loop entirely.
+    void finishBlock(size_t frames) noexcept
+    {
+        const float fall = (float)pow((double)m_fall, (double)frames);
+        for (int ch = 0; ch < Channels; ++ch)
+        {
+            if (m_mx[ch] >= m_peak[ch])
+            {
+                m_peak[ch] = m_mx[ch];
+                m_holdLeft[ch] = m_holdFrames;
+            }
+            else if (m_holdLeft[ch] > 0)
+            {
+                m_holdLeft[ch] -= (int)frames;
+            }
+            else
+            {
+                m_peak[ch] = (std::max)(m_mx[ch], m_peak[ch] * fall);
+            }
+            m_mx[ch] = 0;
+        }
+        publish();
+    }
+
+    void publish() noexcept
+    {
+        const uint64_t seq = m_seq.load(std::memory_order_relaxed);
+        m_seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (int ch = 0; ch < Channels; ++ch)
+        {
+            m_pubEnv[ch].store(m_env[ch], std::memory_order_relaxed);
+            m_pubPeak[ch].store(m_peak[ch], std::memory_order_relaxed);
+            m_pubRms[ch].store(std::sqrt(m_ms[ch]), std::memory_order_relaxed);
+        }
+        m_seq.store(seq + 2, std::memory_order_release);
+    }
+};
+
+enum class ResamplerQuality : unsigned int
+{
+    Fast = 0,   // 16 taps, 32 phases: about 60 dB of stopband
+    Medium = 1, // 32 taps, 128 phases: about 85 dB
+    High = 2    // 64 taps, 512 phases: about 105 dB
+};
+
+// Streaming polyphase windowed-sinc resampler for NCH interleaved float
+// channels. setup() designs the filter and sizes every buffer; after it,
+// push(), pull() and the queries never allocate and are fine on the audio
+// thread. Audio goes in with push() and comes out with pull(), in whatever
+// block sizes suit the caller: the output does not depend on how the input
+// was cut up.
+// The ratio is arbitrary. The Kaiser-windowed sinc is tabulated at a fixed
+// number of phases per input frame and interpolated linearly between
+// neighbouring phases, and the read position is a 32.32 fixed point count
+// of input frames, so the ratio is held exactly over any length of stream.
+// Downsampling scales the cutoff, and the taps, by the ratio.
+template <size_t NCH = 2> class Resampler
+{
+    static_assert(NCH > 0, "Resampler needs at least one channel");
+
+    // constant after setup()
+    size_t m_taps = 0;   // per phase, even
+    size_t m_phases = 0; // power of two
+    unsigned m_phaseShift = 0;
+    size_t m_capacity = 0; // frames of history per channel
+    uint64_t m_nominalStep = 0;
+    std::vector<float> m_table; // per phase: taps, then the step to the next
+    std::vector<float> m_history; // planar, m_capacity frames per channel
+    std::vector<float> m_coef;
+    const simd::float_kernels *m_k = &simd::best_kernels();
+
+    // the caller's thread: the one calling push() and pull()
+    uint64_t m_pos = 0; // 32.32, relative to m_history
+    uint64_t m_step = 0;
+    size_t m_frames = 0; // frames in m_history
+
+    // any thread
+    std::atomic<uint64_t> m_pendingStep{0};
+
+    static constexpr unsigned FracBits = 32;
+
+    static double bessel_i0(double x) noexcept
+    {
+        double sum = 1, term = 1;
+        for (int k = 1; k < 64 && term > 1e-12 * sum; ++k)
+        {
+            const double t = x / (2.0 * k);
+            term *= t * t;
+            sum += term;
+        }
+        return sum;
+    }
+
+    // the window, at x input frames from the centre of the filter
+    double kernel(double x, double cutoff, double beta) const noexcept
+    {
+        const double u = 2.0 * x / (double)m_taps;
+        if (u <= -1.0 || u >= 1.0) return 0.0;
+        const double t = M_PI * cutoff * x;
+        const double sinc = t == 0.0 ? 1.0 : sin(t) / t;
+        return cutoff * sinc * bessel_i0(beta * sqrt(1.0 - u * u)) /
+               bessel_i0(beta);
+    }
+
+    void design(double cutoff, double beta)
+    {
+        const size_t L = m_taps;
+        std::vector<double> rows((m_phases + 1) * L);
+        for (size_t p = 0; p <= m_phases; ++p)
+        {
+            // the output lands between history frames L/2-1 and L/2 of
+            // the window, p/phases of the way along
+            double *h = &rows[p * L];
+            double sum = 0;
+            for (size_t k = 0; k < L; ++k)
+            {
+                const double x = (double)p / (double)m_phases +
+                                 (double)(L / 2 - 1) - (double)k;
+                h[k] = kernel(x, cutoff, beta);
+                sum += h[k];
+            }
+            // unity gain at DC for every phase
+            for (size_t k = 0; k < L; ++k)
+                h[k] /= sum;
+        }
+        m_table.assign(m_phases * 2 * L, 0.0f);
+        for (size_t p = 0; p < m_phases; ++p)
+        {
+            float *t = &m_table[p * 2 * L];
+            for (size_t k = 0; k < L; ++k)
+            {
+                t[k] = (float)rows[p * L + k];
+                t[L + k] = (float)(rows[(p + 1) * L + k] - rows[p * L + k]);
+            }
+        }
+    }
+
+    // history frames the output at position `pos` reads up to
+    static size_t end_of(uint64_t pos, size_t taps) noexcept
+    {
+        return (size_t)(pos >> FracBits) + taps;
+    }
+
+  public:
+    static constexpr size_t channels = NCH;
+
+    Resampler() = default;
+    Resampler(double inRate, double outRate, size_t maxFrames,
+              ResamplerQuality quality = ResamplerQuality::Medium)
+    {
+        setup(inRate, outRate, maxFrames, quality);
+    }
+    Resampler(const Resampler &) = delete;
+    Resampler &operator=(const Resampler &) = delete;
+
+    // maxFrames is the most frames handed to push(), or asked of pull(),
+    // in one call. Allocates: call it before the stream starts.
+    void setup(double inRate, double outRate, size_t maxFrames,
+               ResamplerQuality quality = ResamplerQuality::Medium)
+    {
+        if (!(inRate > 0) || !(outRate > 0) || maxFrames == 0)
+            throw std::invalid_argument(
+                "Resampler: rates and maxFrames must be > 0");
+        static constexpr struct
+        {
+            size_t taps;
+            unsigned phaseShift;
+            double beta;
+            double rolloff;
+        } presets[] = {{16, 5, 6.0, 0.80},
+                       {32, 7, 8.5, 0.88},
+                       {64, 9, 10.5, 0.92}};
+        const auto &q = presets[(unsigned)quality > 2 ? 1 : (unsigned)quality];
+        const double ratio = outRate / inRate;
+        const double scale = (std::min)(1.0, ratio);
+        m_taps = (std::min)((size_t)1024,
+                            ((size_t)ceil((double)q.taps / scale) + 1) & ~(size_t)1);
+        m_phaseShift = q.phaseShift;
+        m_phases = (size_t)1 << m_phaseShift;
+        design(q.rolloff * scale, q.beta);
+
+        m_nominalStep = (uint64_t)llround(inRate / outRate * 4294967296.0);
+        m_pendingStep.store(m_nominalStep, std::memory_order_relaxed);
+        m_step = m_nominalStep;
+        // enough for a whole pull() at the fastest drift, plus a push()
+        const double most = (double)maxFrames * (std::max)(1.0, 1.0 / ratio);
+        m_capacity = (size_t)ceil(most * 1.02) + 2 * m_taps + 8;
+        m_history.assign(m_capacity * NCH, 0.0f);
+        m_coef.assign(m_taps, 0.0f);
+        reset();
+    }
+
+    // Forget the stream. The history is refilled with silence, so the first
+    // output frame lines up with the first frame pushed; `extraDelay` more
+    // frames of silence put that much slack in front of it.
+    void reset(size_t extraDelay = 0) noexcept
+    {
+        m_frames = (std::min)(m_taps / 2 - 1 + extraDelay, m_capacity);
+        std::fill(m_history.begin(), m_history.end(), 0.0f);
+        m_pos = 0;
+        m_step = m_pendingStep.load(std::memory_order_relaxed);
+    }
+
+    // Trims the ratio by `ppm` parts per million, within +/-1%: positive
+    // values consume input faster. Safe from any thread; it takes effect
+    // at the end of the next pull().
+    void setDrift(double ppm) noexcept
+    {
+        ppm = (std::max)(-10000.0, (std::min)(10000.0, ppm));
+        m_pendingStep.store(
+            (uint64_t)llround((double)m_nominalStep * (1.0 + ppm * 1e-6)),
+            std::memory_order_relaxed);
+    }
+
+    size_t taps() const noexcept { return m_taps; }
+    size_t phases() const noexcept { return m_phases; }
+    // input frames consumed per output frame, drift included
+    double step() const noexcept
+    {
+        return (double)m_step / 4294967296.0;
+    }
+    // how far the output lags the input, in input frames
+    double delay() const noexcept { return (double)(m_taps / 2); }
+
+    // frames push() can take right now
+    size_t space() const noexcept { return m_capacity - m_frames; }
+
+    // output frames pull() can produce right now
+    size_t available() const noexcept
+    {
+        if (m_frames < end_of(m_pos, m_taps)) return 0;
+        const uint64_t room =
+            ((uint64_t)(m_frames - m_taps + 1) << FracBits) - 1 - m_pos;
+        return (size_t)(room / m_step) + 1;
+    }
+
+    // input frames to push() before pull() can produce `outFrames`
+    size_t inputNeeded(size_t outFrames) const noexcept
+    {
+        if (outFrames == 0) return 0;
+        const size_t end =
+            end_of(m_pos + (uint64_t)(outFrames - 1) * m_step, m_taps);
+        return end > m_frames ? end - m_frames : 0;
+    }
+
+    // Appends interleaved frames; returns how many fitted.
+    size_t push(const float *in, size_t frames) noexcept
+    {
+        frames = (std::min)(frames, space());
+        for (size_t ch = 0; ch < NCH; ++ch)
+        {
+            float *h = &m_history[ch * m_capacity + m_frames];
+            const float *s = in + ch;
+            for (size_t f = 0; f < frames; ++f, s += NCH)
+                h[f] = *s;
+        }
+        m_frames += frames;
+        return frames;
+    }
+
+    // Writes up to `frames` interleaved output frames; returns how many.
+    size_t pull(float *out, size_t frames) noexcept
+    {
+        const size_t L = m_taps;
+        const uint64_t fracMask = ((uint64_t)1 << FracBits) - 1;
+        const unsigned interpShift = FracBits - m_phaseShift;
+        const float interpScale = 1.0f / (float)((uint64_t)1 << interpShift);
+        size_t n = 0;
+        for (; n < frames && end_of(m_pos, L) <= m_frames; ++n)
+        {
+            const size_t at = (size_t)(m_pos >> FracBits);
+            const uint64_t frac = m_pos & fracMask;
+            const float *row = &m_table[(frac >> interpShift) * 2 * L];
+            const float a =
+                (float)(frac & (((uint64_t)1 << interpShift) - 1)) *
+                interpScale;
+            // this frame's filter, shared by every channel
+            memcpy(m_coef.data(), row, L * sizeof(float));
+            m_k->mix(m_coef.data(), row + L, L, 1, &a);
+            for (size_t ch = 0; ch < NCH; ++ch)
+                out[n * NCH + ch] = m_k->dot(
+                    &m_history[ch * m_capacity + at], m_coef.data(), L);
+            m_pos += m_step;
+        }
+        // drop the frames no output will read again
+        const size_t used = (std::min)((size_t)(m_pos >> FracBits), m_frames);
+        if (used)
+        {
+            for (size_t ch = 0; ch < NCH; ++ch)
+            {
+                float *h = &m_history[ch * m_capacity];
+                memmove(h, h + used, (m_frames - used) * sizeof(float));
+            }
+            m_frames -= used;
+            m_pos -= (uint64_t)used << FracBits;
+        }
+        m_step = m_pendingStep.load(std::memory_order_relaxed);
+        return n;
+    }
+
+    // For testing the kernels against one another.
+    void useKernels(const simd::float_kernels &k) noexcept { m_k = &k; }
+};
+} // namespace dsp
+
+[[maybe_unused]] static inline void sleep_ms(const long ms) noexcept
+{
+    Pa_Sleep(ms);
+}
+[[maybe_unused]] static inline void SleepmS(const long ms) noexcept
+{
+    Pa_Sleep(ms);
+}
+
+class Exception : public std::runtime_error
+{
+    std::ostringstream m_stream;
+    std::string m_str;
+    PaError m_errcode;
+
+  public:
+    static inline auto error_string(PaError errCode) noexcept
+    {
+        return Pa_GetErrorText(errCode);
+    }
+    template <typename... Args>
+    auto error_string_ex(PaError errCode, Args &&... args) noexcept
+    {
+        m_stream.str().clear();
+        if (errCode == -1)
+        {
+            m_stream << "Generic error\n";
+        }
+        else
+        {
+            std::string pe = error_string(errCode);
+            m_stream << "PortAudio error code: " << errCode << " (" << pe
+                     << ")\n";
+        }
+
+        strings::make_string(m_stream, args...);
+        std::string annoying_temp = m_stream.str();
+        return annoying_temp;
+    }
+
+    Exception(const PaError errCode) noexcept
+        : std::runtime_error(""), m_str(error_string(errCode)),
+          m_errcode(errCode)
+    {
+    }
+
+    template <typename... ARGS>
+    Exception(const PaError errCode, ARGS &&... args) noexcept
+        : std::runtime_error(""),
+          m_str(error_string_ex(errCode, std::forward<ARGS>(args)...)),
+          m_errcode(errCode)
+    {
+    }
+
+    virtual const char *what() const noexcept
+    {
+
+        const char *ps = m_str.c_str();
+        return ps;
+    }
+
+    PaError errorCode() const noexcept { return m_errcode; }
+};
+
+struct SampleFormat
+{
+    static inline PaSampleFormat Float32 = paFloat32;
+    static inline PaSampleFormat Int32 = paInt32;
+    static inline PaSampleFormat Int24 = paInt24;
+    static inline PaSampleFormat Int16 = paInt16;
+    static inline PaSampleFormat Int8 = paInt8;
+    static inline PaSampleFormat UInt8 = paUInt8;
+    static inline PaSampleFormat CustomFormat = paCustomFormat;
+    static inline PaSampleFormat NonInterleaved = paNonInterleaved;
+};
+
+// How channels are laid out in the host buffers. Planar is PortAudio's
+// paNonInterleaved: one contiguous buffer per channel.
+enum class Layout : unsigned int
+{
+    Interleaved = 0,
+    Planar = 1
+};
+
+// Dither PortAudio applies when it converts samples to a narrower host
+// format. The noise shaped modes only shape Float32 -> Int16 output, other
+// conversions fall back to triangular dither.
+enum class DitherMode : unsigned int
+{
+    Off,
+    Triangular,
+    NoiseShapedFirstOrder,
+    NoiseShapedSecondOrder
+};
+
+// Replaces the dither bits of flags with those selecting mode.
+inline PaStreamFlags withDitherMode(PaStreamFlags flags,
+                                    DitherMode mode) noexcept
+{
+    flags &= ~(paDitherOff | paDitherNoiseShapedFirstOrder |
+               paDitherNoiseShapedSecondOrder);
+    switch (mode)
+    {
+    case DitherMode::Off: return flags | paDitherOff;
+    case DitherMode::NoiseShapedFirstOrder:
+        return flags | paDitherNoiseShapedFirstOrder;
+    case DitherMode::NoiseShapedSecondOrder:
+        return flags | paDitherNoiseShapedSecondOrder;
+    default: return flags;
+    }
+}
+
+struct StreamSetupInfo
+{
+    // PaStreamCallback *streamCallback = {nullptr};
     PaStream *stream = {nullptr};
     int inputChannelCount = 2;
     int outputChannelCount = 2;
@@ -312,6 +1472,13 @@ struct StreamSetupInfo
     PaStreamParameters inParams = {paNoDevice, -1, 0, -1, nullptr};
     PaStreamParameters outParams = {paNoDevice, -1, 0, -1, nullptr};
     PaStreamFlags flags = {0};
+    // when set, overrides the dither bits of flags
+    std::optional<DitherMode> dither = {};
+    // when set and different from samplerate, the device is opened at this
+    // rate and the stream resamples between it and samplerate, which is
+    // what the callback sees. Float, interleaved streams only.
+    unsigned int deviceSamplerate = 0;
+    dsp::ResamplerQuality resamplerQuality = dsp::ResamplerQuality::Medium;
     PaTime inputLatency = {0};
     PaTime outputLatency = {0};
 };
@@ -338,6 +1505,113 @@ struct CallbackInfo
     int samplerate;
 };
 
+// User parameters a stream carries for its callback, see Stream::setParam().
+static constexpr size_t MaxAutomationParams = 32;
+
+// A typed, non-owning view over the host buffers for one callback.
+// Sample type and channel count are fixed at compile time, so the callback
+// can index frames directly instead of casting the raw void pointers.
+// The Stream owns one of these and refills it in place every callback; it is
+// handed to the callback by reference, so nothing is copied or allocated.
+// NCH applies to whichever direction(s) the stream has open.
+template <typename SAMPLE = float, size_t NCH = 2,
+          Layout LAYOUT = Layout::Interleaved>
+struct AudioBlock
+{
+    using sample_type = SAMPLE;
+    static constexpr size_t channels = NCH;
+    static constexpr Layout layout = LAYOUT;
+
+    const SAMPLE *input = nullptr;
+    SAMPLE *output = nullptr;
+    unsigned long frameCount = 0;
+    const PaStreamCallbackTimeInfo *timeInfo = nullptr;
+    PaStreamCallbackFlags statusFlags = 0;
+    PaTime elapsed_time = 0;
+    int samplerate = 0;
+    // the stream's automation parameters, see Stream::setParam()
+    const float *params = nullptr;
+
+    bool hasInput() const noexcept { return input != nullptr; }
+    float param(size_t id) const noexcept
+    {
+        assert(params && id < MaxAutomationParams);
+        return params[id];
+    }
+    bool hasOutput() const noexcept { return output != nullptr; }
+    size_t frames() const noexcept { return frameCount; }
+    size_t samples() const noexcept { return frameCount * NCH; }
+
+    const SAMPLE *inFrame(size_t frame) const noexcept
+    {
+        return input + frame * NCH;
+    }
+    SAMPLE *outFrame(size_t frame) const noexcept
+    {
+        return output + frame * NCH;
+    }
+    const SAMPLE &in(size_t frame, size_t ch) const noexcept
+    {
+        assert(input && ch < NCH && frame < frameCount);
+        return input[frame * NCH + ch];
+    }
+    SAMPLE &out(size_t frame, size_t ch) const noexcept
+    {
+        assert(output && ch < NCH && frame < frameCount);
+        return output[frame * NCH + ch];
+    }
+};
+
+// Planar view: PortAudio hands us one pointer per channel, and so does this.
+// Each channel is a contiguous run of frameCount samples.
+template <typename SAMPLE, size_t NCH> struct AudioBlock<SAMPLE, NCH, Layout::Planar>
+{
+    using sample_type = SAMPLE;
+    static constexpr size_t channels = NCH;
+    static constexpr Layout layout = Layout::Planar;
+
+    const SAMPLE *const *input = nullptr;
+    SAMPLE *const *output = nullptr;
+    unsigned long frameCount = 0;
+    const PaStreamCallbackTimeInfo *timeInfo = nullptr;
+    PaStreamCallbackFlags statusFlags = 0;
+    PaTime elapsed_time = 0;
+    int samplerate = 0;
+    // the stream's automation parameters, see Stream::setParam()
+    const float *params = nullptr;
+
+    bool hasInput() const noexcept { return input != nullptr; }
+    float param(size_t id) const noexcept
+    {
+        assert(params && id < MaxAutomationParams);
+        return params[id];
+    }
+    bool hasOutput() const noexcept { return output != nullptr; }
+    size_t frames() const noexcept { return frameCount; }
+    size_t samples() const noexcept { return frameCount * NCH; }
+
+    const SAMPLE *inChannel(size_t ch) const noexcept
+    {
+        assert(input && ch < NCH);
+        return input[ch];
+    }
+    SAMPLE *outChannel(size_t ch) const noexcept
+    {
+        assert(output && ch < NCH);
+        return output[ch];
+    }
+    const SAMPLE &in(size_t frame, size_t ch) const noexcept
+    {
+        assert(frame < frameCount);
+        return inChannel(ch)[frame];
+    }
+    SAMPLE &out(size_t frame, size_t ch) const noexcept
+    {
+        assert(frame < frameCount);
+        return outChannel(ch)[frame];
+    }
+};
+
 enum class CallbackResult : unsigned int
 {
     Continue = 0, /**< Signal that the stream should continue invoking the
@@ -348,6 +1622,430 @@ enum class CallbackResult : unsigned int
                  finish as soon as possible. */
 };
 
+// A contiguous run of interleaved frames inside a FIFO's storage.
+template <typename SAMPLE> struct FrameSpan
+{
+    SAMPLE *data = nullptr;
+    size_t frames = 0;
+};
+
+// Up to two spans, because a transfer may wrap around the end of the ring.
+// `second` is empty unless it does.
+template <typename SAMPLE> struct FrameRegions
+{
+    FrameSpan<SAMPLE> first;
+    FrameSpan<SAMPLE> second;
+    size_t frames() const noexcept { return first.frames + second.frames; }
+};
+
+// Wait-free single producer, single consumer FIFO of NCH-channel interleaved
+// frames, for moving audio between the callback and another thread.
+// Either side may be the audio thread. The write and read positions live on
+// their own cache lines, and each side keeps a private copy of the other's
+// position, refreshed only when that copy shows too little room or data.
+// The capacity is any number of frames; storage is allocated once, up front.
+// Overruns and underruns are counted in frames, and are readable from any
+// thread along with the fill level.
+template <typename SAMPLE = float, size_t NCH = 2> class SpscAudioFifo
+{
+    static_assert(NCH > 0, "SpscAudioFifo needs at least one channel");
+    static_assert(std::is_trivially_copyable_v<SAMPLE>,
+                  "SpscAudioFifo samples are moved with memcpy");
+
+    // producer
+    alignas(64) std::atomic<size_t> m_write{0};
+    size_t m_readCache = 0;
+    std::atomic<uint64_t> m_overruns{0};
+
+    // consumer
+    alignas(64) std::atomic<size_t> m_read{0};
+    size_t m_writeCache = 0;
+    std::atomic<uint64_t> m_underruns{0};
+
+    // shared, constant after construction
+    alignas(64) size_t m_capacity;
+    std::vector<SAMPLE> m_buf;
+
+    // positions count frames since construction and are reduced to an
+    // offset only here, so any capacity works and full != empty.
+    FrameRegions<SAMPLE> regions(size_t pos, size_t frames) noexcept
+    {
+        const size_t at = pos % m_capacity;
+        const size_t first = (std::min)(frames, m_capacity - at);
+        FrameRegions<SAMPLE> r;
+        r.first = {m_buf.data() + at * NCH, first};
+        if (frames > first) r.second = {m_buf.data(), frames - first};
+        return r;
+    }
+
+  public:
+    using sample_type = SAMPLE;
+    static constexpr size_t channels = NCH;
+
+    explicit SpscAudioFifo(size_t capacityFrames)
+        : m_capacity(capacityFrames), m_buf(capacityFrames * NCH)
+    {
+        if (capacityFrames == 0)
+            throw std::invalid_argument("SpscAudioFifo capacity must be > 0");
+    }
+    SpscAudioFifo(const SpscAudioFifo &) = delete;
+    SpscAudioFifo &operator=(const SpscAudioFifo &) = delete;
+
+    size_t capacity() const noexcept { return m_capacity; }
+    // frames ready to read. Exact on either side, a snapshot elsewhere.
+    size_t size() const noexcept
+    {
+        return m_write.load(std::memory_order_acquire) -
+               m_read.load(std::memory_order_acquire);
+    }
+    size_t space() const noexcept { return m_capacity - size(); }
+    uint64_t overruns() const noexcept
+    {
+        return m_overruns.load(std::memory_order_relaxed);
+    }
+    uint64_t underruns() const noexcept
+    {
+        return m_underruns.load(std::memory_order_relaxed);
+    }
+
+    // Producer only. Where the next `frames` frames (or as many as fit) go.
+    // Nothing is visible to the consumer until commitWrite().
+    FrameRegions<SAMPLE> writeRegions(size_t frames) noexcept
+    {
+        const size_t w = m_write.load(std::memory_order_relaxed);
+        if (m_capacity - (w - m_readCache) < frames)
+            m_readCache = m_read.load(std::memory_order_acquire);
+        return regions(w, (std::min)(frames, m_capacity - (w - m_readCache)));
+    }
+    void commitWrite(size_t frames) noexcept
+    {
+        m_write.store(m_write.load(std::memory_order_relaxed) + frames,
+                      std::memory_order_release);
+    }
+
+    // Consumer only. The next `frames` frames (or as many as are ready).
+    // The space is handed back to the producer by commitRead().
+    FrameRegions<const SAMPLE> readRegions(size_t frames) noexcept
+    {
+        const size_t r = m_read.load(std::memory_order_relaxed);
+        if (m_writeCache - r < frames)
+            m_writeCache = m_write.load(std::memory_order_acquire);
+        const auto reg = regions(r, (std::min)(frames, m_writeCache - r));
+        return {{reg.first.data, reg.first.frames},
+                {reg.second.data, reg.second.frames}};
+    }
+    void commitRead(size_t frames) noexcept
+    {
+        m_read.store(m_read.load(std::memory_order_relaxed) + frames,
+                     std::memory_order_release);
+    }
+
+    // Producer only. Copies in as many frames as fit and returns how many;
+    // the rest are dropped and counted as overruns.
+    size_t write(const SAMPLE *interleaved, size_t frames) noexcept
+    {
+        const auto reg = writeRegions(frames);
+        copy_in(reg.first, interleaved);
+        copy_in(reg.second, interleaved + reg.first.frames * NCH);
+        commitWrite(reg.frames());
+        note_overrun(frames - reg.frames());
+        return reg.frames();
+    }
+
+    // Consumer only. Copies out up to `frames` frames and returns how many.
+    size_t read(SAMPLE *interleaved, size_t frames) noexcept
+    {
+        const auto reg = readRegions(frames);
+        copy_out(interleaved, reg.first);
+        copy_out(interleaved + reg.first.frames * NCH, reg.second);
+        commitRead(reg.frames());
+        return reg.frames();
+    }
+
+    // Stream callback helpers: push() queues the block's input, pop() fills
+    // its output, padding with silence and counting the missing frames as
+    // underruns.
+    template <Layout LAYOUT>
+    size_t push(const AudioBlock<SAMPLE, NCH, LAYOUT> &b) noexcept
+    {
+        if (!b.hasInput()) return 0;
+        if constexpr (LAYOUT == Layout::Interleaved)
+            return write(b.input, b.frames());
+        else
+        {
+            const auto reg = writeRegions(b.frames());
+            size_t f = 0;
+            for (const auto &span : {reg.first, reg.second})
+            {
+                for (size_t i = 0; i < span.frames; ++i, ++f)
+                    for (size_t ch = 0; ch < NCH; ++ch)
+                        span.data[i * NCH + ch] = b.input[ch][f];
+            }
+            commitWrite(reg.frames());
+            note_overrun(b.frames() - reg.frames());
+            return reg.frames();
+        }
+    }
+
+    template <Layout LAYOUT>
+    size_t pop(const AudioBlock<SAMPLE, NCH, LAYOUT> &b) noexcept
+    {
+        if (!b.hasOutput()) return 0;
+        const SAMPLE silence = sample_traits<SAMPLE>::from_float(0.0f);
+        const auto reg = readRegions(b.frames());
+        size_t f = 0;
+        if constexpr (LAYOUT == Layout::Interleaved)
+        {
+            copy_out(b.output, reg.first);
+            copy_out(b.output + reg.first.frames * NCH, reg.second);
+            f = reg.frames();
+            std::fill(b.output + f * NCH, b.output + b.frames() * NCH, silence);
+        }
+        else
+        {
+            for (const auto &span : {reg.first, reg.second})
+            {
+                for (size_t i = 0; i < span.frames; ++i, ++f)
+                    for (size_t ch = 0; ch < NCH; ++ch)
+                        b.output[ch][f] = span.data[i * NCH + ch];
+            }
+            for (size_t ch = 0; ch < NCH; ++ch)
+                std::fill(b.output[ch] + f, b.output[ch] + b.frames(), silence);
+        }
+        commitRead(reg.frames());
+        if (reg.frames() < b.frames())
+            m_underruns.fetch_add(b.frames() - reg.frames(),
+                                  std::memory_order_relaxed);
+        return reg.frames();
+    }
+
+  private:
+    static void copy_in(const FrameSpan<SAMPLE> &to,
+                        const SAMPLE *from) noexcept
+    {
+        if (to.frames)
+            std::memcpy(to.data, from, to.frames * NCH * sizeof(SAMPLE));
+    }
+    static void copy_out(SAMPLE *to,
+                         const FrameSpan<const SAMPLE> &from) noexcept
+    {
+        if (from.frames)
+            std::memcpy(to, from.data, from.frames * NCH * sizeof(SAMPLE));
+    }
+    void note_overrun(size_t dropped) noexcept
+    {
+        if (dropped) m_overruns.fetch_add(dropped, std::memory_order_relaxed);
+    }
+};
+
+// Bounded queue of commands from any number of control threads to one
+// consumer, normally the audio callback. pop() never retries and never
+// waits on a producer, but commands come out strictly in claim order: a
+// producer preempted between claiming a slot and publishing it leaves that
+// slot unready, and pop() returns false for it and for every later command
+// until that producer resumes. push() is lock-free. The capacity is
+// rounded up to a power of two. A push onto a full queue fails and is
+// counted as an overrun.
+template <typename T> class MpscCommandQueue
+{
+    static_assert(std::is_nothrow_move_assignable_v<T> &&
+                      std::is_default_constructible_v<T>,
+                  "commands must be default constructible and nothrow "
+                  "move assignable");
+
+    // seq == position: free for the producer claiming that position.
+    // seq == position + 1: holds that position's command.
+    struct Cell
+    {
+        std::atomic<size_t> seq{0};
+        T value{};
+    };
+
+    alignas(64) std::atomic<size_t> m_tail{0}; // producers
+    std::atomic<uint64_t> m_overruns{0};
+    alignas(64) std::atomic<size_t> m_head{0}; // consumer
+    alignas(64) size_t m_mask;
+    std::unique_ptr<Cell[]> m_cells;
+
+    static size_t round_up(size_t n)
+    {
+        size_t p = 1;
+        while (p < n) p <<= 1;
+        return p;
+    }
+
+  public:
+    using value_type = T;
+
+    explicit MpscCommandQueue(size_t capacity)
+        : m_mask(round_up(capacity) - 1),
+          m_cells(std::make_unique<Cell[]>(m_mask + 1))
+    {
+        if (capacity == 0)
+            throw std::invalid_argument(
+                "MpscCommandQueue capacity must be > 0");
+        for (size_t i = 0; i <= m_mask; ++i)
+            m_cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+    MpscCommandQueue(const MpscCommandQueue &) = delete;
+    MpscCommandQueue &operator=(const MpscCommandQueue &) = delete;
+
+    size_t capacity() const noexcept { return m_mask + 1; }
+    // commands claimed by producers and not yet popped; a snapshot.
+    size_t size() const noexcept
+    {
+        return m_tail.load(std::memory_order_acquire) -
+               m_head.load(std::memory_order_acquire);
+    }
+    uint64_t overruns() const noexcept
+    {
+        return m_overruns.load(std::memory_order_relaxed);
+    }
+
+    // Any thread. False if the queue is full.
+    template <typename U> bool push(U &&command)
+    {
+        size_t pos = m_tail.load(std::memory_order_relaxed);
+        Cell *cell;
+        for (;;)
+        {
+            cell = &m_cells[pos & m_mask];
+            const size_t seq = cell->seq.load(std::memory_order_acquire);
+            const auto diff = (std::ptrdiff_t)(seq - pos);
+            if (diff == 0)
+            {
+                if (m_tail.compare_exchange_weak(pos, pos + 1,
+                                                 std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                m_overruns.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            else
+                pos = m_tail.load(std::memory_order_relaxed);
+        }
+        cell->value = std::forward<U>(command);
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only. False if there is no complete command at the head.
+    bool pop(T &out) noexcept
+    {
+        const size_t pos = m_head.load(std::memory_order_relaxed);
+        Cell &cell = m_cells[pos & m_mask];
+        if (cell.seq.load(std::memory_order_acquire) != pos + 1) return false;
+        out = std::move(cell.value);
+        cell.seq.store(pos + m_mask + 1, std::memory_order_release);
+        m_head.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only. Pops up to `max` commands into f(T&), returns how many.
+    template <typename F>
+    size_t drain(F &&f, size_t max = (std::numeric_limits<size_t>::max)())
+    {
+        size_t n = 0;
+        T cmd;
+        while (n < max && pop(cmd))
+        {
+            f(cmd);
+            ++n;
+        }
+        return n;
+    }
+};
+
+// One scheduled change to a stream, see Stream::schedule(). `frame` is a
+// position on the stream's clock (StreamClock::nframes()).
+struct AutomationEvent
+{
+    enum class Kind : uint32_t
+    {
+        Gain,      // ramp the output gain to `value` over `seconds`
+        Mute,      // mute (value != 0) or unmute, ramped over `seconds`
+        Param,     // set user parameter `param` to `value`
+        Transport  // Start() and Stop()'s fades: `value` is 1 or 0
+    };
+    uint64_t frame = 0;
+    Kind kind = Kind::Gain;
+    uint32_t param = 0;
+    float value = 0;
+    float seconds = 0;
+    dsp::FadeShape shape = dsp::FadeShape::Linear;
+};
+
+// Time-stamped events from any number of control threads to the audio
+// callback. post() is lock-free. Once per buffer the callback collect()s
+// what has arrived into a short list ordered by frame, then works through
+// the buffer a piece at a time: popDue() hands over the events due at the
+// start of a piece, and framesUntilNext() says how long it may run before
+// the next one. Events posted for the same frame are handed over in the
+// order they were posted.
+class AutomationQueue
+{
+  public:
+    static constexpr size_t MaxPending = 64;
+
+    explicit AutomationQueue(size_t capacity = 256) : m_queue(capacity) {}
+    AutomationQueue(const AutomationQueue &) = delete;
+    AutomationQueue &operator=(const AutomationQueue &) = delete;
+
+    // Any thread. False, and counted as an overrun, if the queue is full.
+    bool post(const AutomationEvent &e) noexcept { return m_queue.push(e); }
+    uint64_t overruns() const noexcept { return m_queue.overruns(); }
+
+    // Consumer only. Anything beyond MaxPending waits in the queue for a
+    // later buffer.
+    void collect() noexcept
+    {
+        m_queue.drain([this](AutomationEvent &e) { insert(e); },
+                      MaxPending - m_count);
+    }
+    size_t pending() const noexcept { return m_count; }
+
+    // Consumer only. The earliest event due at or before `pos`, if any.
+    bool popDue(uint64_t pos, AutomationEvent &out) noexcept
+    {
+        if (!m_count || m_pending[m_count - 1].frame > pos) return false;
+        out = m_pending[--m_count];
+        return true;
+    }
+
+    // Consumer only. Frames from `pos` to the next pending event, at most
+    // `limit`.
+    size_t framesUntilNext(uint64_t pos, size_t limit) const noexcept
+    {
+        if (!m_count) return limit;
+        const uint64_t next = m_pending[m_count - 1].frame;
+        if (next <= pos) return 0;
+        return (size_t)(std::min)((uint64_t)limit, next - pos);
+    }
+
+    // Consumer only, or any thread while the consumer is stopped.
+    void clear() noexcept
+    {
+        m_queue.drain([](AutomationEvent &) {});
+        m_count = 0;
+    }
+
+  private:
+    // latest frame first, so the next due is popped off the end
+    void insert(const AutomationEvent &e) noexcept
+    {
+        size_t i = m_count++;
+        for (; i > 0 && m_pending[i - 1].frame <= e.frame; --i)
+            m_pending[i] = m_pending[i - 1];
+        m_pending[i] = e;
+    }
+
+    MpscCommandQueue<AutomationEvent> m_queue;
+    std::array<AutomationEvent, MaxPending> m_pending{};
+    size_t m_count = 0;
+};
+
 // Inherit from me to grab the audio callback.
 struct AudioCallback
 {
@@ -427,6 +2125,81 @@ using inputDeviceList = deviceList;
 using outputDeviceList = deviceList;
 using apiDeviceList = deviceList;
 
+// A read-only view of some of the enumerator's devices. It holds global
+// device indices into the enumerator's table, so building one never
+// copies a device, and element i is found in O(1).
+class DeviceRange
+{
+  public:
+    class const_iterator
+    {
+      public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = PaDeviceInfoEx;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const PaDeviceInfoEx *;
+        using reference = const PaDeviceInfoEx &;
+
+        const_iterator(const deviceList *rows,
+                       std::vector<int>::const_iterator it)
+            : m_rows(rows), m_it(it)
+        {
+        }
+        reference operator*() const noexcept { return (*m_rows)[*m_it]; }
+        pointer operator->() const noexcept { return &(*m_rows)[*m_it]; }
+        const_iterator &operator++() noexcept
+        {
+            ++m_it;
+            return *this;
+        }
+        const_iterator operator++(int) noexcept
+        {
+            auto tmp = *this;
+            ++m_it;
+            return tmp;
+        }
+        bool operator==(const const_iterator &rhs) const noexcept
+        {
+            return m_it == rhs.m_it;
+        }
+        bool operator!=(const const_iterator &rhs) const noexcept
+        {
+            return m_it != rhs.m_it;
+        }
+
+      private:
+        const deviceList *m_rows;
+        std::vector<int>::const_iterator m_it;
+    };
+
+    DeviceRange() = default;
+    size_t size() const noexcept { return m_index.size(); }
+    bool empty() const noexcept { return m_index.empty(); }
+    const PaDeviceInfoEx &operator[](size_t i) const noexcept
+    {
+        return (*m_rows)[m_index[i]];
+    }
+    const PaDeviceInfoEx &at(size_t i) const
+    {
+        return m_rows->at(m_index.at(i));
+    }
+    int globalIndex(size_t i) const { return m_index.at(i); }
+    const_iterator begin() const noexcept
+    {
+        return const_iterator(m_rows, m_index.begin());
+    }
+    const_iterator end() const noexcept
+    {
+        return const_iterator(m_rows, m_index.end());
+    }
+
+  private:
+    friend struct enumerator_t;
+    friend struct PaHostApiInfoEx;
+    const deviceList *m_rows = nullptr;
+    std::vector<int> m_index;
+};
+
 struct enumerator_t;
 struct PaHostApiInfoEx
 {
@@ -435,22 +2208,30 @@ struct PaHostApiInfoEx
     int api_index = -1;
     int defaultInputDeviceGlobalApiIndex = INVALID_PA_DEVICE_INDEX;
     int defaultOutputDeviceGlobalApiIndex = INVALID_PA_DEVICE_INDEX;
-    const deviceList &inputDevices() const noexcept { return m_inputDevices; }
-    const deviceList &outputDevices() const noexcept { return m_outputDevices; }
-    const deviceList &allDevices() const noexcept { return m_allDevices; }
-    const deviceList &duplexDevices() const noexcept { return m_duplexDevices; }
+    const DeviceRange &inputDevices() const noexcept { return m_inputDevices; }
+    const DeviceRange &outputDevices() const noexcept
+    {
+        return m_outputDevices;
+    }
+    const DeviceRange &allDevices() const noexcept { return m_allDevices; }
+    const DeviceRange &duplexDevices() const noexcept
+    {
+        return m_duplexDevices;
+    }
+    // nullptr if this api has no default input device.
     const PaDeviceInfoEx *defaultInputDevice() const noexcept
     {
-        return &m_DefaultInputDevice;
+        return device(defaultInputDeviceGlobalApiIndex);
     }
+    // nullptr if this api has no default output device.
     const PaDeviceInfoEx *defaultOutputDevice() const noexcept
     {
-        return &m_DefaultOutputDevice;
+        return device(defaultOutputDeviceGlobalApiIndex);
     }
     const PaDeviceInfoEx *defaultDuplexDevice() const noexcept
     {
         if (m_duplexDevices.empty()) return nullptr;
-        return &m_duplexDevices.at(0);
+        return &m_duplexDevices[0];
     }
     PaHostApiInfoEx(const PaHostApiInfo *info, int api_index)
         : info(*info), api_index(api_index)
@@ -460,12 +2241,18 @@ struct PaHostApiInfoEx
     }
 
   private:
-    deviceList m_inputDevices;
-    deviceList m_outputDevices;
-    deviceList m_allDevices;
-    deviceList m_duplexDevices;
-    PaDeviceInfoEx m_DefaultInputDevice;
-    PaDeviceInfoEx m_DefaultOutputDevice;
+    DeviceRange m_inputDevices;
+    DeviceRange m_outputDevices;
+    DeviceRange m_allDevices;
+    DeviceRange m_duplexDevices;
+
+    const PaDeviceInfoEx *device(int globalIndex) const noexcept
+    {
+        const deviceList *rows = m_allDevices.m_rows;
+        if (!rows || globalIndex < 0 || (size_t)globalIndex >= rows->size())
+            return nullptr;
+        return &(*rows)[globalIndex];
+    }
 };
 
 using hostApiList = std::vector<PaHostApiInfoEx>;
@@ -484,6 +2271,7 @@ static inline hostApiList enum_apis()
 {
     hostApiList list;
     const int cnt = Pa_GetHostApiCount();
+    list.reserve(cnt > 0 ? cnt : 0);
     for (int i = 0; i < cnt; ++i)
     {
         auto inf = Pa_GetHostApiInfo(i);
@@ -510,113 +2298,64 @@ static inline deviceList enum_devices()
     return list;
 }
 
+// FNV-1a. Stable across runs, so hashes may be stored.
+static inline uint64_t hash_name(std::string_view s,
+                                 uint64_t h = 0xcbf29ce484222325ull) noexcept
+{
+    for (unsigned char c : s)
+    {
+        h ^= c;
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+static inline uint64_t hash_mix(uint64_t h, uint64_t v) noexcept
+{
+    h ^= v + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+    return h;
+}
+
 } // namespace detail
 
+// What a refresh() changed. `added` are global indices in the new table,
+// `removed` are global indices the devices had in the old one.
+struct DeviceChanges
+{
+    std::vector<int> added;
+    std::vector<int> removed;
+    bool empty() const noexcept { return added.empty() && removed.empty(); }
+};
+
 struct enumerator_t : detail::no_copy<enumerator_t>
 {
-    void populate() { m_apiDeviceList = devicesByApi(true); }
+    void populate() { rebuild(); }
+
+    // Re-reads PortAudio's device list into the table. PortAudio only scans
+    // for hardware in Pa_Initialize(), so call this after re-initializing.
+    // Devices still present keep their rows (including any streamSetupInfo
+    // set on them, with its device indices renumbered and its stream
+    // cleared); only what appeared or went away is built or dropped.
+    DeviceChanges refresh() { return rebuild(); }
+
     const hostApiList &apis(bool force_refresh = false) const
     {
-        if (m_apis.empty() || force_refresh)
-        {
-            m_apis = detail::enum_apis();
-        }
+        if (m_apis.empty() || force_refresh) rebuild();
         return m_apis;
     }
 
+    // The device table: element i is global device i.
     const deviceList &devices(bool force_refresh = false) const
     {
-        if (m_devices.empty() || force_refresh)
-        {
-            m_devices = detail::enum_devices();
-        }
+        if (m_devices.empty() || force_refresh) rebuild();
         return m_devices;
     }
 
-    const apiDeviceList devicesByApi(bool force_refresh = false) const
+    // PortAudio numbers devices api by api, so the table is already
+    // grouped by api; use PaHostApiInfoEx::allDevices() for one api.
+    const apiDeviceList &devicesByApi(bool force_refresh = false) const
     {
-        if (!force_refresh && !apis().empty() && !this->devices().empty() &&
-            !this->m_apiDeviceList.empty())
-        {
-            return m_apiDeviceList;
-        }
-        this->apis(force_refresh);
-        this->devices(force_refresh);
-        apiDeviceList retval;
-
-        for (auto &api : m_apis)
-        {
-            auto &api_indevs = api.m_inputDevices;
-            auto &api_outdevs = api.m_outputDevices;
-            auto &api_alldevs = api.m_allDevices;
-            auto &api_duplexdevs = api.m_duplexDevices;
-            api_indevs.clear();
-            api_outdevs.clear();
-            api_alldevs.clear();
-            api_duplexdevs.clear();
-
-            for (int i = 0; i < api.info.deviceCount; ++i)
-            {
-
-                const auto global_device_index =
-                    Pa_HostApiDeviceIndexToDeviceIndex(api.api_index, i);
-                auto &dev_ref = m_devices.at(global_device_index); // NOT a copy
-                assert(dev_ref.hostApiInfo != nullptr);
-                auto dev = m_devices.at(global_device_index); // it *is* a copy.
-                assert(dev_ref.hostApiInfo != nullptr);
-                assert(dev.global_device_index == global_device_index);
-                dev.api_device_index = i;
-
-                api_alldevs.push_back(dev);
-                if (dev.deviceType.is_input_only())
-                {
-                    dev.input_api_device_index = api_indevs.size();
-                    dev_ref.input_api_device_index = dev.input_api_device_index;
-                    api_indevs.push_back(dev);
-                }
-                else if (dev.deviceType.is_output_only())
-                {
-                    dev.output_api_device_index = api_outdevs.size();
-                    dev_ref.output_api_device_index =
-                        dev.output_api_device_index;
-                    api_outdevs.push_back(dev);
-                }
-                else if (dev.deviceType.is_duplex())
-                {
-                    dev.input_api_device_index = api_indevs.size();
-                    dev.output_api_device_index = api_outdevs.size();
-                    dev.duplex_api_device_index = api_duplexdevs.size();
-                    dev_ref.output_api_device_index =
-                        dev.output_api_device_index;
-                    dev_ref.input_api_device_index = dev.input_api_device_index;
-                    dev_ref.duplex_api_device_index =
-                        dev.duplex_api_device_index;
-                    api_indevs.push_back(dev);
-                    api_outdevs.push_back(dev);
-                    api_duplexdevs.push_back(dev);
-                }
-                auto definput = findDevice(
-                    this->m_devices, api.defaultInputDeviceGlobalApiIndex);
-                auto defoutput = findDevice(
-                    m_devices, api.defaultOutputDeviceGlobalApiIndex);
-                assert(definput && defoutput);
-                api.m_DefaultInputDevice = *definput;
-                api.m_DefaultOutputDevice = *defoutput;
-            };
-        };
-
-        for (const auto &a : m_apis)
-        {
-            assert(a.defaultInputDevice()->api_device_index !=
-                   INVALID_PA_DEVICE_INDEX);
-            assert(a.defaultOutputDevice()->api_device_index !=
-                   INVALID_PA_DEVICE_INDEX);
-            assert(a.defaultInputDevice()->global_device_index !=
-                   INVALID_PA_DEVICE_INDEX);
-            assert(a.defaultOutputDevice()->global_device_index !=
-                   INVALID_PA_DEVICE_INDEX);
-        }
-        return retval;
+        return devices(force_refresh);
     }
 
     // returns an *instance* (a copy) of an input device where you might want to
@@ -627,7 +2366,7 @@ struct enumerator_t : detail::no_copy<enumerator_t>
         const auto idx = Pa_GetDefaultInputDevice();
         const auto &devs = devices();
         assert((size_t)idx < devs.size());
-        return m_devices.at(idx);
+        return devs.at(idx);
     }
     // returns an *instance* (a copy) of an output device where you might want
     // to adjust its properties perhaps before calling openStream() etc on it.
@@ -637,7 +2376,7 @@ struct enumerator_t : detail::no_copy<enumerator_t>
         const auto idx = Pa_GetDefaultOutputDevice();
         const auto &devs = devices();
         assert((size_t)idx < devs.size());
-        return m_devices.at(idx);
+        return devs.at(idx);
     }
     const PaHostApiInfoEx &defaultHostApi() const noexcept
     {
@@ -675,11 +2414,27 @@ struct enumerator_t : detail::no_copy<enumerator_t>
         return nullptr;
     }
 
+    const PaDeviceInfoEx *findDevice(const DeviceRange &list,
+                                     unsigned int deviceIndex) const noexcept
+    {
+        assert(deviceIndex < list.size());
+        if (deviceIndex < list.size()) return &list[deviceIndex];
+        return nullptr;
+    }
+
     const PaDeviceInfoEx *
     findDeviceByGlobalIndex(unsigned int globalDeviceIndex) const noexcept
     {
         return findDevice(m_devices, globalDeviceIndex);
     }
+    // The row itself, to set up a stream on that survives refresh().
+    PaDeviceInfoEx *findDeviceByGlobalIndex(unsigned int globalDeviceIndex)
+    {
+        devices();
+        if (globalDeviceIndex < m_devices.size())
+            return &m_devices[globalDeviceIndex];
+        return nullptr;
+    }
 
     const PaDeviceInfoEx *findDevice(
         const int apiIndex, unsigned int deviceIndex,
@@ -688,46 +2443,37 @@ struct enumerator_t : detail::no_copy<enumerator_t>
         auto api = findApi(apiIndex);
         assert(api);
         if (!api) return nullptr;
+        return findDevice(*api, deviceIndex, type);
+    }
+
+    // deviceIndex is the api's input, output or duplex device index (per
+    // `type`), not the global device index.
+    const PaDeviceInfoEx *findDevice(
+        const PaHostApiInfoEx &api, unsigned int deviceIndex,
+        const DeviceType::types type = DeviceType::types::output) const noexcept
+    {
+        const DeviceRange *range = nullptr;
         if (type == DeviceType::types::output)
-        {
-            if (deviceIndex >= api->outputDevices().size())
-            {
-                assert("Are you sending me the correct index? For an output "
-                       "device, for example, send the OUTPUT DEVICE api index"
-                       " (not the global device index -- just the OUTPUT "
-                       "device index." == nullptr);
-                return nullptr;
-            }
-            return &api->outputDevices().at(deviceIndex);
-        }
+            range = &api.outputDevices();
         else if (type == DeviceType::types::input)
-        {
-            if (deviceIndex >= api->outputDevices().size())
-            {
-                assert("Are you sending me the correct index? For an input "
-                       "device, for example, send the INPUT DEVICE api index"
-                       " (not the global device index -- just the INPUT device "
-                       "index." == nullptr);
-                return nullptr;
-            }
-            return &api->inputDevices().at(deviceIndex);
-        }
+            range = &api.inputDevices();
         else
         {
             assert(type == DeviceType::types::duplex &&
                    "findDevice: You should either want an input device, an "
                    "output device, or a duplex device. Which is it?" !=
                        nullptr);
-            return &api->duplexDevices().at(deviceIndex);
+            range = &api.duplexDevices();
         }
-    }
-
-    const PaDeviceInfoEx *findDevice(
-        const PaHostApiInfoEx &, unsigned int,
-        const DeviceType::types = DeviceType::types::output) const noexcept
-    {
-        assert(0);
-        return nullptr;
+        if (deviceIndex >= range->size())
+        {
+            assert("Are you sending me the correct index? For an output "
+                   "device, for example, send the OUTPUT DEVICE api index"
+                   " (not the global device index -- just the OUTPUT "
+                   "device index." == nullptr);
+            return nullptr;
+        }
+        return &(*range)[deviceIndex];
     }
 
     const PaDeviceInfoEx *
@@ -742,19 +2488,188 @@ struct enumerator_t : detail::no_copy<enumerator_t>
         return nullptr;
     }
 
-    const PaDeviceInfoEx *findDevice(const PaHostApiInfoEx &,
-                                     std::string_view) const noexcept
+    const PaDeviceInfoEx *findDevice(const PaHostApiInfoEx &api,
+                                     std::string_view deviceName) const noexcept
+    {
+        return findDeviceByName(deviceName, api.api_index);
+    }
+
+    // O(1) by name hash. With apiIndex < 0, the first device of that name
+    // in any api.
+    const PaDeviceInfoEx *findDeviceByName(std::string_view deviceName,
+                                           int apiIndex = -1) const noexcept
     {
+        const uint64_t nh = detail::hash_name(deviceName);
+        const auto &map = apiIndex < 0 ? m_byName : m_byApiName;
+        const uint64_t key =
+            apiIndex < 0 ? nh : detail::hash_mix(nh, (uint64_t)apiIndex);
+        auto it = map.find(key);
+        if (it == map.end()) return nullptr;
+        const auto &d = m_devices[it->second];
+        if (deviceName == d.info->name &&
+            (apiIndex < 0 || d.info->hostApi == apiIndex))
+            return &d;
+        // a hash collision: fall back to looking
+        for (const auto &dev : m_devices)
+        {
+            if (deviceName == dev.info->name &&
+                (apiIndex < 0 || dev.info->hostApi == apiIndex))
+                return &dev;
+        }
         return nullptr;
     }
 
   private:
+    // The device table, one row per global device index. m_nameHash and
+    // m_identity run parallel to it; the per-api lists and the name maps
+    // hold row indices only.
     mutable hostApiList m_apis;
     mutable deviceList m_devices;
-    mutable deviceList m_input_devices;
-    mutable deviceList m_output_devices;
-    mutable apiDeviceList m_apiDeviceList;
-    deviceList &devices_non_const() noexcept { return m_devices; }
+    mutable std::vector<uint64_t> m_nameHash;
+    mutable std::vector<uint64_t> m_identity; // name, api type, channels
+    mutable std::unordered_map<uint64_t, int> m_byName;
+    mutable std::unordered_map<uint64_t, int> m_byApiName;
+
+    // refresh(), and the first fill of the table that the const accessors
+    // do on demand
+    DeviceChanges rebuild() const
+    {
+        DeviceChanges changes;
+        const int count = (std::max)(Pa_GetDeviceCount(), 0);
+
+        // identity of what we had -> old row
+        std::unordered_multimap<uint64_t, int> old;
+        old.reserve(m_devices.size());
+        for (size_t i = 0; i < m_identity.size(); ++i)
+            old.emplace(m_identity[i], (int)i);
+        std::vector<char> kept(m_devices.size(), 0);
+        // old global index -> new one, paNoDevice once it has gone
+        std::vector<int> renumbered(m_devices.size(), paNoDevice);
+
+        deviceList rows;
+        std::vector<uint64_t> nameHash, identity;
+        rows.reserve(count);
+        nameHash.reserve(count);
+        identity.reserve(count);
+        for (int i = 0; i < count; ++i)
+        {
+            const PaDeviceInfo *inf = Pa_GetDeviceInfo(i);
+            const PaHostApiInfo *api_inf = Pa_GetHostApiInfo(inf->hostApi);
+            assert(api_inf != nullptr);
+            const uint64_t nh = detail::hash_name(inf->name);
+            uint64_t id = detail::hash_mix(nh, (uint64_t)api_inf->type);
+            id = detail::hash_mix(id, (uint64_t)inf->maxInputChannels);
+            id = detail::hash_mix(id, (uint64_t)inf->maxOutputChannels);
+
+            PaDeviceInfoEx row;
+            bool reused = false;
+            for (auto [it, last] = old.equal_range(id); it != last; ++it)
+            {
+                const int o = it->second;
+                if (kept[o]) continue;
+                kept[o] = 1;
+                renumbered[o] = i;
+                row = m_devices[o];
+                reused = true;
+                break;
+            }
+            if (!reused) changes.added.push_back(i);
+            row.info = inf;
+            row.hostApiInfo = api_inf;
+            row.global_device_index = i;
+            row.deviceType = DeviceType::DeviceTypeFromInfo(inf);
+            rows.push_back(row);
+            nameHash.push_back(nh);
+            identity.push_back(id);
+        }
+        for (size_t o = 0; o < kept.size(); ++o)
+        {
+            if (!kept[o]) changes.removed.push_back((int)o);
+        }
+        for (auto &row : rows)
+        {
+            auto &info = row.streamSetupInfo;
+            for (auto *params : {&info.inParams, &info.outParams})
+            {
+                if (params->device >= 0 &&
+                    (size_t)params->device < renumbered.size())
+                    params->device = renumbered[params->device];
+            }
+            // belonged to the old PortAudio session
+            info.stream = nullptr;
+        }
+
+        m_devices.swap(rows);
+        m_nameHash.swap(nameHash);
+        m_identity.swap(identity);
+        m_apis = detail::enum_apis();
+        index();
+        return changes;
+    }
+
+    // one pass over the devices of each api: api-local indices, the per-api
+    // lists and the name maps.
+    void index() const
+    {
+        m_byName.clear();
+        m_byApiName.clear();
+        m_byName.reserve(m_devices.size());
+        m_byApiName.reserve(m_devices.size());
+        for (size_t i = 0; i < m_devices.size(); ++i)
+        {
+            const int api = m_devices[i].info->hostApi;
+            m_byName.emplace(m_nameHash[i], (int)i);
+            m_byApiName.emplace(detail::hash_mix(m_nameHash[i], (uint64_t)api),
+                                (int)i);
+        }
+
+        for (auto &api : m_apis)
+        {
+            DeviceRange *ranges[] = {&api.m_allDevices, &api.m_inputDevices,
+                                     &api.m_outputDevices,
+                                     &api.m_duplexDevices};
+            for (auto *r : ranges)
+            {
+                r->m_rows = &m_devices;
+                r->m_index.clear();
+                r->m_index.reserve(api.info.deviceCount);
+            }
+            auto &all = api.m_allDevices.m_index;
+            auto &ins = api.m_inputDevices.m_index;
+            auto &outs = api.m_outputDevices.m_index;
+            auto &dups = api.m_duplexDevices.m_index;
+
+            for (int i = 0; i < api.info.deviceCount; ++i)
+            {
+                const int g =
+                    Pa_HostApiDeviceIndexToDeviceIndex(api.api_index, i);
+                assert(g >= 0 && (size_t)g < m_devices.size());
+                auto &dev = m_devices[g];
+                dev.api_device_index = i;
+                dev.input_api_device_index = INVALID_PA_DEVICE_INDEX;
+                dev.output_api_device_index = INVALID_PA_DEVICE_INDEX;
+                dev.duplex_api_device_index = INVALID_PA_DEVICE_INDEX;
+                all.push_back(g);
+                if (dev.deviceType.is_input_only() ||
+                    dev.deviceType.is_duplex())
+                {
+                    dev.input_api_device_index = (int)ins.size();
+                    ins.push_back(g);
+                }
+                if (dev.deviceType.is_output_only() ||
+                    dev.deviceType.is_duplex())
+                {
+                    dev.output_api_device_index = (int)outs.size();
+                    outs.push_back(g);
+                }
+                if (dev.deviceType.is_duplex())
+                {
+                    dev.duplex_api_device_index = (int)dups.size();
+                    dups.push_back(g);
+                }
+            }
+        }
+    }
 };
 
 [[maybe_unused]] static inline StreamSetupInfo
@@ -806,57 +2721,288 @@ makeStreamSetupInfo(const PaDeviceInfoEx &devInfo, PaStreamParameters *inParams,
 namespace detail
 {
 
-// We generate our own time stamps, since, at least on Linux,
-// All Portaudio's currentTime() api calls just always return zero!
-class TimeStampGen
+// A consistent reading of a StreamClock, taken at one buffer boundary.
+struct ClockSnapshot
+{
+    uint64_t frames = 0;         // exact count of frames processed so far
+    double time = 0;             // filtered monotonic time (s) at `frames`
+    double secondsPerFrame = 0;  // filtered; 1 / actual sample rate
+    double paTimeOffset = 0;     // PortAudio stream time minus monotonic
+    double outputLatency = 0;    // outputBufferDacTime - currentTime
+    unsigned int nominalRate = 0;
+
+    double actualSamplerate() const noexcept
+    {
+        return secondsPerFrame > 0 ? 1.0 / secondsPerFrame : 0;
+    }
+    // how far the device clock runs from nominal, in parts per million.
+    double driftPpm() const noexcept
+    {
+        if (!nominalRate || secondsPerFrame <= 0) return 0;
+        return (actualSamplerate() / nominalRate - 1.0) * 1e6;
+    }
+    // monotonic time at which `frame` was (or will be) at the buffer
+    // boundary, extrapolated along the filtered rate.
+    double timeOfFrame(uint64_t frame) const noexcept
+    {
+        return time + ((double)frame - (double)frames) * secondsPerFrame;
+    }
+    // the frame position the stream will have reached at monotonic time t.
+    uint64_t frameAt(double t) const noexcept
+    {
+        if (secondsPerFrame <= 0) return frames;
+        const double f = (double)frames + (t - time) / secondsPerFrame;
+        return f <= 0 ? 0 : (uint64_t)(f + 0.5);
+    }
+};
+
+// Sample-accurate stream clock.
+// The frame counter is exact; elapsed time is derived from it, so it
+// cannot drift. Each buffer is also correlated with CLOCK_MONOTONIC (and
+// PortAudio's own stream time, where the host API provides one) through a
+// second-order delay-locked loop, which estimates the device's real sample
+// rate and lets other threads map between frames and wall time.
+// advance() is called only by the audio thread; every getter is lock-free.
+class StreamClock
 {
   public:
-    TimeStampGen() {}
-    TimeStampGen(const TimeStampGen &rhs) = delete;
-    TimeStampGen &operator=(const TimeStampGen &rhs) = delete;
-    TimeStampGen &operator=(TimeStampGen &&rhs) = delete;
+    StreamClock() = default;
+    StreamClock(const StreamClock &rhs) = delete;
+    StreamClock &operator=(const StreamClock &rhs) = delete;
 
-    TimeStampGen(TimeStampGen &&rhs)
-        : m_CurrentMillis(rhs.m_CurrentMillis.load()),
-          m_Samplerate(rhs.m_Samplerate.load()), m_nframes(rhs.m_nframes.load())
+    static double monotonicNow() noexcept
     {
-
-        rhs.m_Samplerate = 0;
+        using namespace std::chrono;
+        return duration<double>(steady_clock::now().time_since_epoch())
+            .count();
     }
+
     int samplerate() const noexcept { return m_Samplerate; }
-    uint64_t elapsedMillis() const noexcept { return m_CurrentMillis; }
-    uint64_t nframes() const noexcept { return m_nframes; }
+    uint64_t nframes() const noexcept
+    {
+        return m_nframes.load(std::memory_order_acquire);
+    }
+    uint64_t elapsedMillis() const noexcept
+    {
+        const auto sr = m_Samplerate.load();
+        return sr ? nframes() * 1000 / sr : 0;
+    }
     double elapsedSeconds() const noexcept
     {
-        auto ret = (double)elapsedMillis()/ 1000.0;
-        return ret;
+        const auto sr = m_Samplerate.load();
+        return sr ? (double)nframes() / sr : 0;
+    }
+
+    ClockSnapshot clockSnapshot() const noexcept
+    {
+        ClockSnapshot s;
+        uint64_t before, after;
+        do
+        {
+            before = m_seq.load(std::memory_order_acquire);
+            s.frames = m_pubFrames.load(std::memory_order_relaxed);
+            s.time = m_pubTime.load(std::memory_order_relaxed);
+            s.secondsPerFrame = m_pubSpf.load(std::memory_order_relaxed);
+            s.paTimeOffset = m_pubPaOffset.load(std::memory_order_relaxed);
+            s.outputLatency = m_pubLatency.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = m_seq.load(std::memory_order_relaxed);
+        } while ((before & 1) || before != after);
+        s.nominalRate = m_Samplerate;
+        return s;
     }
+    double actualSamplerate() const noexcept
+    {
+        return clockSnapshot().actualSamplerate();
+    }
+    double driftPpm() const noexcept { return clockSnapshot().driftPpm(); }
 
   protected:
+    // Not safe while the audio thread is running.
     void reset(const unsigned int newSamplerate)
     {
         assert(newSamplerate > 0);
         m_Samplerate = newSamplerate;
-        m_CurrentMillis = 0;
         m_nframes = 0;
+        m_primed = false;
+        m_spf = 1.0 / newSamplerate;
+        publish(0, 0, 0);
     }
-    // the portaudio methods for getting stream time are flaky.
-    // On Linux, I get a forever current time as 0. So use this instead
-    PaTime generateTimeStamps(unsigned long frameCount) noexcept
-    {
 
-        const auto frames_now = (m_nframes += frameCount);
+    // Called once per buffer, from the callback, before the user sees it.
+    // Returns the elapsed stream time at the end of this buffer.
+    PaTime advance(unsigned long frameCount,
+                   const PaStreamCallbackTimeInfo *timeInfo,
+                   double now = monotonicNow()) noexcept
+    {
         assert(m_Samplerate);
-        const uint64_t samples_per_ms = m_Samplerate / 1000;
-        m_CurrentMillis = frames_now / samples_per_ms;
-        return elapsedSeconds();
+        const uint64_t start = m_nframes.load(std::memory_order_relaxed);
+        if (!m_primed)
+        {
+            // loop bandwidth ~0.1Hz, scaled to the actual period size.
+            const double omega =
+                2 * M_PI * kBandwidthHz * frameCount / m_Samplerate;
+            m_b = std::sqrt(2.0) * omega;
+            m_c = omega * omega;
+            m_t0 = now;
+            m_t1 = now + m_spf * frameCount;
+            m_primed = true;
+        }
+        else
+        {
+            // e: how late this buffer boundary is versus the prediction.
+            const double e = now - m_t1;
+            m_t0 = m_t1;
+            m_t1 += m_b * e + m_spf * frameCount;
+            m_spf += m_c * e / frameCount;
+        }
+        if (timeInfo && timeInfo->currentTime != 0)
+        {
+            m_paOffset = timeInfo->currentTime - now;
+            if (timeInfo->outputBufferDacTime != 0)
+                m_latency =
+                    timeInfo->outputBufferDacTime - timeInfo->currentTime;
+        }
+        publish(start, m_t0, m_spf);
+        const uint64_t end = start + frameCount;
+        m_nframes.store(end, std::memory_order_release);
+        return (double)end / m_Samplerate;
     }
 
   private:
-    std::atomic<uint64_t> m_CurrentMillis = {0};
+    static constexpr double kBandwidthHz = 0.1;
+
+    void publish(uint64_t frames, double t, double spf) noexcept
+    {
+        const uint64_t seq = m_seq.load(std::memory_order_relaxed);
+        m_seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        m_pubFrames.store(frames, std::memory_order_relaxed);
+        m_pubTime.store(t, std::memory_order_relaxed);
+        m_pubSpf.store(spf, std::memory_order_relaxed);
+        m_pubPaOffset.store(m_paOffset, std::memory_order_relaxed);
+        m_pubLatency.store(m_latency, std::memory_order_relaxed);
+        m_seq.store(seq + 2, std::memory_order_release);
+    }
+
     std::atomic<unsigned int> m_Samplerate = {0};
     std::atomic<uint64_t> m_nframes = {0};
-}; // TimeStampGen
+
+    // DLL state, audio thread only
+    bool m_primed = false;
+    double m_b = 0, m_c = 0;
+    double m_t0 = 0, m_t1 = 0;
+    double m_spf = 0;
+    double m_paOffset = 0;
+    double m_latency = 0;
+
+    // published
+    std::atomic<uint64_t> m_seq = {0};
+    std::atomic<uint64_t> m_pubFrames = {0};
+    std::atomic<double> m_pubTime = {0};
+    std::atomic<double> m_pubSpf = {0};
+    std::atomic<double> m_pubPaOffset = {0};
+    std::atomic<double> m_pubLatency = {0};
+}; // StreamClock
+
+// true if the user callback takes the typed AudioBlock rather than the
+// untyped CallbackInfo. Resolved at compile time, so the dispatcher carries
+// no runtime branch or indirection for it.
+template <typename CB, typename SAMPLE, size_t NCH,
+          Layout LAYOUT = Layout::Interleaved>
+static constexpr bool is_block_callback_v =
+    std::is_invocable_r_v<CallbackResult, CB &,
+                          AudioBlock<SAMPLE, NCH, LAYOUT> &>;
+
+// A one-word set of event flags that the audio thread can raise without
+// taking a lock or allocating, and that other threads can block on with a
+// timeout. On Linux this is a futex, on Windows WaitOnAddress; elsewhere
+// it falls back to a 1ms poll.
+class AudioEvents
+{
+  public:
+    AudioEvents() = default;
+    AudioEvents(const AudioEvents &) = delete;
+    AudioEvents &operator=(const AudioEvents &) = delete;
+
+    void clear(uint32_t bits) noexcept
+    {
+        m_bits.fetch_and(~bits, std::memory_order_acq_rel);
+    }
+    uint32_t raised() const noexcept
+    {
+        return m_bits.load(std::memory_order_acquire);
+    }
+
+    // Real-time safe. Only the first raise of a bit makes a syscall.
+    void raise(uint32_t bits) noexcept
+    {
+        const uint32_t was = m_bits.fetch_or(bits, std::memory_order_acq_rel);
+        if ((was & bits) != bits) wake();
+    }
+
+    // Blocks until any of `bits` is raised. A negative timeout waits
+    // forever. Returns false on timeout.
+    bool wait_any(uint32_t bits, double timeoutSecs = -1) const noexcept
+    {
+        using namespace std::chrono;
+        const auto deadline =
+            steady_clock::now() + duration_cast<steady_clock::duration>(
+                                      duration<double>(
+                                          timeoutSecs < 0 ? 0 : timeoutSecs));
+        for (;;)
+        {
+            const uint32_t v = raised();
+            if (v & bits) return true;
+            double left = -1;
+            if (timeoutSecs >= 0)
+            {
+                left = duration<double>(deadline - steady_clock::now()).count();
+                if (left <= 0) return false;
+            }
+            block(v, left);
+        }
+    }
+
+  private:
+    mutable std::atomic<uint32_t> m_bits{0};
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+                  "futex word must be a plain 32-bit integer");
+
+    // sleep while the word still equals `expected`, for at most `secs`.
+    void block(uint32_t expected, double secs) const noexcept
+    {
+#if defined(__linux__)
+        timespec ts;
+        timespec *pts = nullptr;
+        if (secs >= 0)
+        {
+            ts.tv_sec = (time_t)secs;
+            ts.tv_nsec = (long)((secs - (double)ts.tv_sec) * 1e9);
+            pts = &ts;
+        }
+        syscall(SYS_futex, (uint32_t *)&m_bits, FUTEX_WAIT_PRIVATE, expected,
+                pts, nullptr, 0);
+#elif defined(_WIN32)
+        WaitOnAddress((volatile VOID *)&m_bits, &expected, sizeof(expected),
+                      secs < 0 ? INFINITE : (DWORD)(secs * 1000.0) + 1);
+#else
+        (void)expected;
+        std::this_thread::sleep_for(std::chrono::duration<double>(
+            secs < 0 ? 0.001 : (std::min)(secs, 0.001)));
+#endif
+    }
+
+    void wake() noexcept
+    {
+#if defined(__linux__)
+        syscall(SYS_futex, (uint32_t *)&m_bits, FUTEX_WAKE_PRIVATE, INT32_MAX,
+                nullptr, nullptr, 0);
+#elif defined(_WIN32)
+        WakeByAddressAll((PVOID)&m_bits);
+#endif
+    }
+};
 
 struct StreamBase
 {
@@ -870,47 +3016,313 @@ struct StreamBase
 
 } // namespace detail
 
-template <typename AUDIOCALLBACK, typename SAMPLE = float, size_t NCH = 2>
-class Stream : public detail::TimeStampGen, public detail::StreamBase
+template <typename AUDIOCALLBACK, typename SAMPLE = float, size_t NCH = 2,
+          Layout LAYOUT = Layout::Interleaved>
+class Stream : public detail::StreamClock, public detail::StreamBase
 {
+  public:
+    // SAMPLE and LAYOUT are the single source of truth for the stream
+    // format: the device is always opened natively in it, so PortAudio need
+    // not convert or (de)interleave.
+    static constexpr PaSampleFormat sample_format =
+        sample_traits<SAMPLE>::format |
+        (LAYOUT == Layout::Planar ? paNonInterleaved : 0);
+
   private:
     dsp::EnvelopeFollower<NCH, SAMPLE> m_env;
     PaDeviceInfoEx m_device = {};
     std::atomic<int> m_runstate{0};
     void setRunState(int newState) { m_runstate = newState; }
 
+    // raised by the audio thread, waited on by Stop() and friends.
+    enum : uint32_t
+    {
+        EvFadeDone = 1,
+        EvFinished = 2
+    };
+    detail::AudioEvents m_events;
+
+    // PortAudio calls this once the stream has really finished: after a
+    // Complete has drained, an Abort, or a stop.
+    static void finished_dispatcher(void *userData)
+    {
+        ((Stream *)userData)->m_events.raise(EvFinished);
+    }
+
     static inline int
     callback_dispatcher(const void *input, void *output,
                         unsigned long frameCount,
                         const PaStreamCallbackTimeInfo *timeInfo,
                         PaStreamCallbackFlags statusFlags, void *userData)
     {
-        Stream *p = (Stream *)userData;
-        assert(p && "stream context not set. FATAL");
-        const SAMPLE *samples = (const SAMPLE *)input;
-        if (!samples) samples = (SAMPLE *)output;
-        p->m_env.Process(frameCount, &samples);
+        Stream *p = (Stream *)userData;
+        assert(p && "stream context not set. FATAL");
+        const void *meter = input ? input : output;
+        if constexpr (LAYOUT == Layout::Planar)
+        {
+            p->m_env.Process(frameCount, (const SAMPLE *const *)meter);
+        }
+        else
+        {
+            p->m_env.ProcessInterleaved(frameCount, (const SAMPLE *)meter);
+        }
+
+        const uint64_t position = p->nframes();
+        p->advance(frameCount, timeInfo);
+        // The buffer is cut wherever an event falls, so each one lands on
+        // its frame. With nothing scheduled it goes to the callback whole.
+        auto &aq = p->m_automation;
+        aq.collect();
+        CallbackResult ret = CallbackResult::Continue;
+        unsigned long done = 0;
+        while (done < frameCount && ret == CallbackResult::Continue)
+        {
+            AutomationEvent e;
+            while (aq.popDue(position + done, e))
+                p->apply(e);
+            const auto n = (unsigned long)aq.framesUntilNext(
+                position + done, frameCount - done);
+            ret = p->run(input, output, done, n, timeInfo, statusFlags,
+                         (double)(position + done + n) / p->samplerate());
+            done += n;
+        }
+        if (done < frameCount) p->silence(output, done, frameCount - done);
+        if (ret != CallbackResult::Continue)
+        {
+            p->setRunState(
+                0); // we don't call StopStream() here due to possible deadlock,
+            // but we set the runstate so anyone waiting on isRunning() knows we
+            // have stopped.
+            p->m_events.raise(EvFinished);
+        }
+        return (int)ret;
+    }
+
+    // Interleaved samples per frame, for finding a frame inside the host
+    // buffers.
+    int inStride() const noexcept
+    {
+        return m_device.streamSetupInfo.inParams.channelCount;
+    }
+    int outStride() const noexcept
+    {
+        return m_device.streamSetupInfo.outParams.channelCount;
+    }
+
+    // The callback and the fader, over `frames` frames from `offset` on.
+    CallbackResult run(const void *input, void *output, unsigned long offset,
+                       unsigned long frames,
+                       const PaStreamCallbackTimeInfo *timeInfo,
+                       PaStreamCallbackFlags statusFlags,
+                       PaTime elapsed_time) noexcept
+    {
+        PaStreamCallbackTimeInfo shifted;
+        if (offset && timeInfo)
+        {
+            const double dt = (double)offset / samplerate();
+            shifted = *timeInfo;
+            shifted.inputBufferAdcTime += dt;
+            shifted.outputBufferDacTime += dt;
+            timeInfo = &shifted;
+        }
+        std::array<const SAMPLE *, NCH> inCh{};
+        std::array<SAMPLE *, NCH> outCh{};
+        if constexpr (LAYOUT == Layout::Planar)
+        {
+            // PortAudio's pointer arrays hold channelCount entries, which
+            // openSpecific() made NCH
+            for (size_t ch = 0; ch < NCH; ++ch)
+            {
+                if (input)
+                    inCh[ch] = ((const SAMPLE *const *)input)[ch] + offset;
+                if (output)
+                    outCh[ch] = ((SAMPLE *const *)output)[ch] + offset;
+            }
+            if (input) input = inCh.data();
+            if (output) output = outCh.data();
+        }
+        else if (offset)
+        {
+            if (input)
+                input = (const SAMPLE *)input + offset * (size_t)inStride();
+            if (output)
+                output = (SAMPLE *)output + offset * (size_t)outStride();
+        }
+
+        CallbackResult ret;
+        if constexpr (detail::is_block_callback_v<AUDIOCALLBACK, SAMPLE, NCH,
+                                                  LAYOUT>)
+        {
+            // filled in place: no temporaries, passed by reference.
+            auto &blk = m_block;
+            blk.input = (decltype(blk.input))input;
+            blk.output = (decltype(blk.output))output;
+            blk.frameCount = frames;
+            blk.timeInfo = timeInfo;
+            blk.statusFlags = statusFlags;
+            blk.elapsed_time = elapsed_time;
+            blk.samplerate = samplerate();
+            blk.params = m_params.data();
+            ret = m_cb(blk);
+        }
+        else
+        {
+            ret = m_cb({elapsed_time, input, output, frames, timeInfo,
+                        statusFlags, this, samplerate()});
+        }
+        // an input-only stream has nothing to fade
+        if (output && m_fader.needed())
+        {
+            if constexpr (LAYOUT == Layout::Planar)
+            {
+                m_fader.processPlanar(frames, (SAMPLE *const *)output,
+                                      (int)NCH);
+            }
+            else
+            {
+                m_fader.processSamples(frames, (SAMPLE *)output, outStride());
+            }
+        }
+        if (m_notifyFade && !m_fader.active())
+        {
+            m_notifyFade = false;
+            m_events.raise(EvFadeDone);
+        }
+        return ret;
+    }
+
+    // what is left of the buffer once the callback has finished early
+    void silence(void *output, unsigned long offset,
+                 unsigned long frames) noexcept
+    {
+        if (!output) return;
+        const SAMPLE zero = sample_traits<SAMPLE>::from_float(0.0f);
+        if constexpr (LAYOUT == Layout::Planar)
+        {
+            for (size_t ch = 0; ch < NCH; ++ch)
+            {
+                SAMPLE *c = ((SAMPLE *const *)output)[ch] + offset;
+                std::fill(c, c + frames, zero);
+            }
+        }
+        else
+        {
+            SAMPLE *o = (SAMPLE *)output + offset * (size_t)outStride();
+            std::fill(o, o + frames * (size_t)outStride(), zero);
+        }
+    }
+
+    // Audio thread. Gain, mute and the transport all steer the one fader.
+    void apply(const AutomationEvent &e) noexcept
+    {
+        using Kind = AutomationEvent::Kind;
+        switch (e.kind)
+        {
+        case Kind::Gain: m_gain = e.value; break;
+        case Kind::Mute: m_muted = e.value != 0; break;
+        case Kind::Param:
+            if (e.param < MaxAutomationParams) m_params[e.param] = e.value;
+            return;
+        case Kind::Transport:
+            m_transport = e.value;
+            // Stop() is waiting for the fade to silence
+            m_notifyFade = e.value == 0;
+            break;
+        }
+        const float dest = m_muted ? 0.0f : m_transport * m_gain;
+        m_fader.arm(dest, (float)samplerate(), e.seconds, e.shape);
+    }
+
+    // Sits between PortAudio and callback_dispatcher when the device runs
+    // at another rate. The output side sets the pace: the callback is asked
+    // for as many frames as the output resampler needs to fill the device
+    // buffer, so their number varies by a frame or so from call to call.
+    static int resampling_dispatcher(const void *input, void *output,
+                                     unsigned long frameCount,
+                                     const PaStreamCallbackTimeInfo *timeInfo,
+                                     PaStreamCallbackFlags statusFlags,
+                                     void *userData)
+    {
+        Stream *p = (Stream *)userData;
+        auto &rs = *p->m_rs;
+        size_t frames = output ? rs.out.inputNeeded(frameCount) : 0;
+        if (input)
+        {
+            rs.in.push((const float *)input, frameCount);
+            if (!output) frames = rs.in.available();
+            frames = (std::min)(frames, rs.maxAppFrames);
+            const size_t got = rs.in.pull(rs.appIn.data(), frames);
+            std::fill(rs.appIn.begin() + got * NCH,
+                      rs.appIn.begin() + frames * NCH, 0.0f);
+        }
+        frames = (std::min)(frames, rs.maxAppFrames);
+        int ret = paContinue;
+        if (frames)
+        {
+            ret = callback_dispatcher(input ? rs.appIn.data() : nullptr,
+                                      output ? rs.appOut.data() : nullptr,
+                                      frames, timeInfo, statusFlags,
+                                      userData);
+        }
+        if (output)
+        {
+            rs.out.push(rs.appOut.data(), frames);
+            const size_t made = rs.out.pull((float *)output, frameCount);
+            std::fill((float *)output + made * NCH,
+                      (float *)output + frameCount * NCH, 0.0f);
+        }
+        return ret;
+    }
+
+    // The resamplers and the callback's buffers, when the device and the
+    // callback run at different rates.
+    struct Resampling
+    {
+        dsp::Resampler<NCH> in;  // device -> callback
+        dsp::Resampler<NCH> out; // callback -> device
+        std::vector<float> appIn, appOut;
+        size_t maxAppFrames = 0;
+    };
+    std::unique_ptr<Resampling> m_rs;
 
-        const auto elapsed_time = p->generateTimeStamps(frameCount);
-        const auto ret =
-            p->m_cb({elapsed_time, input, output, frameCount, timeInfo,
-                     statusFlags, userData, p->samplerate()});
-        if (p->m_fader.active())
+    void setupResampling(const StreamSetupInfo &info)
+    {
+        if constexpr (std::is_same_v<SAMPLE, float> &&
+                      LAYOUT == Layout::Interleaved)
         {
-            p->m_fader.processSamples(
-                frameCount, (float *)output,
-                p->m_device.streamSetupInfo.outputChannelCount);
+            const double app = info.samplerate, dev = info.deviceSamplerate;
+            const size_t n = info.framesPerBuffer;
+            auto rs = std::make_unique<Resampling>();
+            rs->out.setup(app, dev, n, info.resamplerQuality);
+            rs->maxAppFrames =
+                (size_t)ceil((double)n * app / dev * 1.02) + rs->out.taps() + 4;
+            rs->in.setup(dev, app, (std::max)(n, rs->maxAppFrames),
+                         info.resamplerQuality);
+            // full duplex: a few frames of slack, so the input side keeps up
+            // with the output side's varying demand. Start() does the same.
+            rs->in.reset(4);
+            rs->appIn.assign(rs->maxAppFrames * NCH, 0.0f);
+            rs->appOut.assign(rs->maxAppFrames * NCH, 0.0f);
+            m_rs = std::move(rs);
         }
-        if (ret != CallbackResult::Continue)
+        else
         {
-            p->setRunState(
-                0); // we don't call StopStream() here due to possible deadlock,
-            // but we set the runstate so anyone waiting on isRunning() knows we
-            // have stopped.
+            (void)info;
+            throw Exception(-1, "openSpecific: resampling to deviceSamplerate "
+                                "needs a float, interleaved stream");
         }
-        return (int)ret;
     }
-    dsp::fader<float> m_fader;
+
+    dsp::fader<SAMPLE> m_fader;
+
+    // automation: posted by any thread, applied by the callback
+    AutomationQueue m_automation;
+    // audio thread only
+    std::array<float, MaxAutomationParams> m_params{};
+    float m_gain = 1.0f;
+    float m_transport = 0.0f;
+    bool m_muted = false;
+    bool m_notifyFade = false;
 
     // yes, this is meant to be private. I just use it for delegation
     // so the object is fully constructed even if we are calling back from a
@@ -943,6 +3355,14 @@ class Stream : public detail::TimeStampGen, public detail::StreamBase
     Stream &&operator=(Stream &&rhs) = delete;
     bool isRunning() const { return m_runstate > 0; }
 
+    // Blocks until the callback returns Complete or Abort, or PortAudio
+    // reports the stream finished. A negative timeout waits forever.
+    // Returns false on timeout.
+    bool waitUntilFinished(double timeoutSecs = -1) const
+    {
+        return m_events.wait_any(EvFinished, timeoutSecs);
+    }
+
     StreamSetupInfo actualStreamInfo()
     {
         auto stream = m_device.streamSetupInfo.stream;
@@ -961,7 +3381,17 @@ class Stream : public detail::TimeStampGen, public detail::StreamBase
         StreamSetupInfo ret = m_device.streamSetupInfo;
         ret.inputLatency = painfo->inputLatency;
         ret.outputLatency = painfo->outputLatency;
-        ret.samplerate = (unsigned int)painfo->sampleRate;
+        if (m_rs)
+        {
+            // the callback's rate stays what was asked for
+            ret.deviceSamplerate = (unsigned int)painfo->sampleRate;
+            ret.inputLatency += (m_rs->in.delay() + 4) / painfo->sampleRate;
+            ret.outputLatency += m_rs->out.delay() / ret.samplerate;
+        }
+        else
+        {
+            ret.samplerate = (unsigned int)painfo->sampleRate;
+        }
 
         return ret;
     }
@@ -976,6 +3406,13 @@ class Stream : public detail::TimeStampGen, public detail::StreamBase
                                 "outParams must be set.");
 
         if (info.framesPerBuffer == 0) info.framesPerBuffer = 512;
+        info.sampleFormat = sample_format;
+        info.inParams.sampleFormat = sample_format;
+        info.outParams.sampleFormat = sample_format;
+        // the typed block, the meter and the fader all assume NCH channels,
+        // and a planar stream's callback reads NCH channel pointers
+        info.inParams.channelCount = (int)NCH;
+        info.outParams.channelCount = (int)NCH;
         std::string devname;
         // we refer right back to PortAudio here so that any diagnostic
         // output will show us which device he's *really* trying to open.
@@ -992,172 +3429,1135 @@ class Stream : public detail::TimeStampGen, public detail::StreamBase
             info.outParams.device == paNoDevice ? nullptr : &info.outParams;
         if (info.inParams.device != paNoDevice)
         {
-            devname = Pa_GetDeviceInfo(info.inParams.device)->name;
+            devname = Pa_GetDeviceInfo(info.inParams.device)->name;
+        }
+        if (devname.empty() && info.outParams.device != paNoDevice)
+        {
+            devname = Pa_GetDeviceInfo(info.outParams.device)->name;
+        }
+        if (devname.empty())
+        {
+            devname = "[unexpected: no device]";
+        }
+
+        /*/
+        #ifdef _WIN32
+                PaWasapiStreamInfo w = {};
+
+                if (device.hostApiInfo->type == PaHostApiTypeId::paWASAPI)
+                {
+
+                    // w.threadPriority = eThreadPriorityProAudio;
+                    // if (a->exclusive) {
+                    //     w.flags = (paWinWasapiExclusive |
+        paWinWasapiThreadPriority);
+                    //}
+
+                    w.hostApiType = paWASAPI;
+                    w.size = sizeof(PaWasapiStreamOption);
+                    w.version = 1;
+
+                    // info.inParam.hostApiSpecificStreamInfo = &w;
+                    // info.outParam.hostApiSpecificStreamInfo = &w;
+                }
+
+        #endif
+        /*/
+        const auto flags = info.dither
+                               ? withDitherMode(info.flags, *info.dither)
+                               : info.flags;
+        const bool resample = info.deviceSamplerate != 0 &&
+                              info.deviceSamplerate != info.samplerate;
+        m_rs.reset();
+        if (resample) setupResampling(info);
+        const auto err = Pa_OpenStream(
+            &info.stream, myInParams, myOutParams,
+            resample ? info.deviceSamplerate : info.samplerate,
+            info.framesPerBuffer, flags,
+            resample ? resampling_dispatcher : callback_dispatcher,
+            (void *)this);
+
+        if (err)
+        {
+            throw Exception(
+                err, "Failed to openSpecificStream(), for device: ", devname);
+        }
+
+        Pa_SetStreamFinishedCallback(info.stream, finished_dispatcher);
+        m_device = device;
+        device.streamSetupInfo = actualStreamInfo();
+
+        m_env.Setup(device.streamSetupInfo.samplerate, 20, 500);
+        StreamClock::reset(device.streamSetupInfo.samplerate);
+    }
+
+    void Stop(float fadeOutSecs = 0.25)
+    {
+        if (!m_device.streamSetupInfo.stream)
+        {
+            throw Exception(-1, "Stop(): unexpected: no stream to start");
+        }
+
+        if (m_runstate)
+        {
+            m_events.clear(EvFadeDone);
+            // the fade is armed by the callback itself, on its next buffer
+            const bool posted = m_automation.post(
+                {0, AutomationEvent::Kind::Transport, 0, 0.0f, fadeOutSecs});
+            if (posted &&
+                m_device.streamSetupInfo.outParams.device != paNoDevice)
+            {
+                // woken by the callback that finishes the fade, or by the
+                // stream ending under us. The timeout only guards against
+                // a device that has stopped calling back.
+                m_events.wait_any(EvFadeDone | EvFinished, fadeOutSecs + 5.0);
+            }
+        }
+
+        int ret = Pa_StopStream(m_device.streamSetupInfo.stream);
+        if (ret && ret != paStreamIsStopped)
+        {
+            throw Exception(ret, "Error Stopping Stream");
+        }
+
+        m_runstate = 0;
+        // only now is the audio thread no longer advancing the clock.
+        StreamClock::reset(m_device.streamSetupInfo.samplerate);
+    }
+
+    void Start(float fadeInSecs = 0.1)
+    {
+        auto &info = m_device.streamSetupInfo;
+        StreamClock::reset(info.samplerate);
+
+        if (!info.stream)
+        {
+            throw Exception(-1, "Start(): unexpected: no stream to start");
+        }
+
+        // the callback is not running: nothing left over from the last run
+        // may fire on this one's clock
+        if (Pa_IsStreamStopped(info.stream) == 1) m_automation.clear();
+        m_automation.post(
+            {0, AutomationEvent::Kind::Transport, 0, 1.0f, fadeInSecs});
+        m_events.clear(EvFadeDone | EvFinished);
+        if (m_rs)
+        {
+            // nothing left over from before the last Stop()
+            m_rs->in.reset(4);
+            m_rs->out.reset();
+        }
+        int ret = Pa_StartStream(info.stream);
+        if (ret)
+        {
+            throw Exception(ret, "Error Starting Stream");
+        }
+        m_runstate = 1;
+    }
+
+    void Abort()
+    {
+        auto &info = m_device.streamSetupInfo;
+        if (info.stream)
+        {
+            Pa_AbortStream(info.stream);
+            info.stream = nullptr;
+        }
+    }
+
+    void Close()
+    {
+        auto &info = m_device.streamSetupInfo;
+        if (info.stream)
+        {
+            try
+            {
+                Stop(0.5);
+            }
+            catch (...)
+            {
+            }
+            Pa_CloseStream(info.stream);
+            info.stream = nullptr;
+        }
+    }
+
+    // normalized to [0, 1] whatever the sample format
+    float envelope(unsigned int channel) const
+    {
+        return this->m_env[channel];
+    }
+    // every channel's envelope, peak and RMS from one buffer boundary.
+    // Lock-free; safe to poll from a UI or telemetry thread.
+    dsp::MeterSnapshot<(int)NCH> meters() const noexcept
+    {
+        return m_env.snapshot();
+    }
+    // Callback execution time and jitter percentiles plus xrun counts,
+    // since the stream was opened or the last resetProfile(). Lock-free;
+    // safe to poll while the stream runs.
+    PaStreamProfile profile() const noexcept
+    {
+        PaStreamProfile p{};
+        if (m_device.streamSetupInfo.stream)
+            Pa_GetStreamProfile(m_device.streamSetupInfo.stream, &p);
+        return p;
+    }
+    void resetProfile() noexcept
+    {
+        if (m_device.streamSetupInfo.stream)
+            Pa_ResetStreamProfile(m_device.streamSetupInfo.stream);
+    }
+
+    std::string_view id() const noexcept { return m_sid; }
+    void id(std::string_view newId) { m_sid = newId; }
+
+    // Automation, from any thread. atFrame is a position on this stream's
+    // clock, see nframes(); Now, or a position already passed, takes effect
+    // at the start of the next buffer. Each returns false if the queue was
+    // full and the change was dropped.
+    static constexpr uint64_t Now = 0;
+    bool schedule(const AutomationEvent &e) noexcept
+    {
+        return m_automation.post(e);
+    }
+    bool setGain(float gain, float rampSecs = 0.005f, uint64_t atFrame = Now,
+                 dsp::FadeShape shape = dsp::FadeShape::Linear) noexcept
+    {
+        return schedule(
+            {atFrame, AutomationEvent::Kind::Gain, 0, gain, rampSecs, shape});
+    }
+    bool setMute(bool mute, float rampSecs = 0.005f,
+                 uint64_t atFrame = Now) noexcept
+    {
+        return schedule({atFrame, AutomationEvent::Kind::Mute, 0,
+                         mute ? 1.0f : 0.0f, rampSecs});
+    }
+    bool setParam(unsigned int id, float value,
+                  uint64_t atFrame = Now) noexcept
+    {
+        return schedule(
+            {atFrame, AutomationEvent::Kind::Param, id, value, 0.0f});
+    }
+    // A user parameter as of the frame being processed. For the callback;
+    // AudioBlock::param() is the same thing.
+    float param(unsigned int id) const noexcept
+    {
+        assert(id < MaxAutomationParams);
+        return m_params[id];
+    }
+    uint64_t automationOverruns() const noexcept
+    {
+        return m_automation.overruns();
+    }
+
+    // true when the device was opened at deviceSamplerate and the stream
+    // resamples for the callback.
+    bool isResampling() const noexcept { return m_rs != nullptr; }
+
+    // Clock drift correction for a resampling stream: positive ppm has the
+    // callback produce and consume that much more audio per device frame.
+    // Safe from any thread.
+    void resamplerDrift(double ppm) noexcept
+    {
+        if (!m_rs) return;
+        m_rs->out.setDrift(ppm);
+        m_rs->in.setDrift(-ppm);
+    }
+
+  private:
+    AUDIOCALLBACK m_cb;
+    std::string m_sid;
+    AudioBlock<SAMPLE, NCH, LAYOUT> m_block;
+
+}; // namespace portaudio
+namespace detail{
+[[maybe_unused]]
+static inline void deviceSanityForOpenStream(PaDeviceInfoEx& device){
+
+    if (device.streamSetupInfo.outParams.device == paNoDevice &&
+        device.deviceType.is_output_only())
+    {
+        throw Exception(-1, "Output device: invalid argument (no internal device set for PortAudio)");
+    }
+    if (device.streamSetupInfo.inParams.device == paNoDevice &&
+        device.deviceType.is_input_only())
+    {
+        throw Exception(-1, "Input device: invalid argument (no internal device set for PortAudio)");
+    }
+
+    if (device.deviceType.is_duplex()){
+        if (device.streamSetupInfo.inParams.device == paNoDevice){
+            throw Exception(-1, "Duplex device requires both an input and output device to be set!. There is no device in 'inParams'");
+        }
+        if (device.streamSetupInfo.outParams.device == paNoDevice){
+            throw Exception(-1, "Duplex device requires both an input and output device to be set!. There is no device in 'outParams'");
+        }
+    }
+}
+}
+// A pull-model stream: read() and write() move any number of NCH-channel
+// interleaved frames and return once all of them have been transferred.
+// Mode::Native uses PortAudio's own blocking API. Mode::Fifo opens a
+// callback stream and connects it to the caller through an SpscAudioFifo
+// for each direction. In that mode the callback only wakes a blocked reader
+// or writer once the FIFO reaches the watermark, rather than every period,
+// so a large transfer costs a handful of wakeups. Mode::Auto tries the
+// native API first and falls back to the FIFOs for host APIs that cannot
+// open a blocking stream.
+// One thread reads and one thread writes; they may be different threads.
+template <typename SAMPLE = float, size_t NCH = 2> class BlockingStream
+{
+  public:
+    enum class Mode : unsigned int
+    {
+        Auto,
+        Native,
+        Fifo
+    };
+    static constexpr PaSampleFormat sample_format =
+        sample_traits<SAMPLE>::format;
+    using fifo_type = SpscAudioFifo<SAMPLE, NCH>;
+
+    // fifoFrames sizes each FIFO in Fifo mode; 0 means eight buffers. The
+    // channel count of the device's stream parameters is replaced by NCH.
+    BlockingStream(PaDeviceInfoEx &device, Mode mode = Mode::Auto,
+                   size_t fifoFrames = 0)
+        : m_device(device)
+    {
+        open(mode, fifoFrames);
+    }
+    ~BlockingStream() { Close(); }
+    BlockingStream(const BlockingStream &) = delete;
+    BlockingStream &operator=(const BlockingStream &) = delete;
+
+    bool isNative() const noexcept { return m_native; }
+    bool isActive() const noexcept
+    {
+        return m_stream && Pa_IsStreamActive(m_stream) == 1;
+    }
+    unsigned int samplerate() const noexcept
+    {
+        return m_device.streamSetupInfo.samplerate;
+    }
+
+    void Start()
+    {
+        const PaError err =
+            m_stream ? Pa_StartStream(m_stream) : paBadStreamPtr;
+        if (err) throw Exception(err, "BlockingStream: failed to start");
+    }
+    void Stop()
+    {
+        if (!m_stream) return;
+        const PaError err = Pa_StopStream(m_stream);
+        if (err && err != paStreamIsStopped)
+            throw Exception(err, "BlockingStream: failed to stop");
+        m_events.raise(EvReadable | EvWritable); // release any waiter
+    }
+    void Close()
+    {
+        if (!m_stream) return;
+        Pa_CloseStream(m_stream);
+        m_stream = nullptr;
+        m_device.streamSetupInfo.stream = nullptr;
+        m_events.raise(EvReadable | EvWritable);
+    }
+
+    // In Fifo mode a blocked read() is woken once `readFrames` frames are
+    // ready and a blocked write() once there is room for `writeFrames`; the
+    // default is half the FIFO. waitReadable() and waitWritable() use the
+    // same thresholds in both modes.
+    void watermarks(size_t readFrames, size_t writeFrames) noexcept
+    {
+        m_readWatermark.store((std::max)(readFrames, (size_t)1),
+                              std::memory_order_relaxed);
+        m_writeWatermark.store((std::max)(writeFrames, (size_t)1),
+                               std::memory_order_relaxed);
+    }
+
+    // frames that read() / write() could transfer right now without waiting.
+    size_t readAvailable() const
+    {
+        if (!m_native) return m_in ? m_in->size() : 0;
+        const long n = m_stream ? Pa_GetStreamReadAvailable(m_stream) : 0;
+        if (n < 0)
+            throw Exception((PaError)n, "BlockingStream::readAvailable()");
+        return (size_t)n;
+    }
+    size_t writeAvailable() const
+    {
+        if (!m_native) return m_out ? m_out->space() : 0;
+        const long n = m_stream ? Pa_GetStreamWriteAvailable(m_stream) : 0;
+        if (n < 0)
+            throw Exception((PaError)n, "BlockingStream::writeAvailable()");
+        return (size_t)n;
+    }
+
+    // input frames lost because the reader fell behind, and output frames
+    // played as silence because the writer did. Native mode can only tell
+    // that it happened, so each report counts as one.
+    uint64_t overruns() const noexcept
+    {
+        return m_native ? m_overruns.load() : (m_in ? m_in->overruns() : 0);
+    }
+    uint64_t underruns() const noexcept
+    {
+        return m_native ? m_underruns.load() : (m_out ? m_out->underruns() : 0);
+    }
+
+    size_t read(SAMPLE *interleaved, size_t frames)
+    {
+        if (m_native)
+        {
+            const PaError err = Pa_ReadStream(m_stream, interleaved, frames);
+            if (err == paInputOverflowed)
+                m_overruns.fetch_add(1, std::memory_order_relaxed);
+            else if (err)
+                throw Exception(err, "BlockingStream::read() failed");
+            return frames;
+        }
+        if (!m_in) throw Exception(paCanNotReadFromAnOutputOnlyStream);
+        size_t done = 0;
+        while (done < frames)
+        {
+            done += m_in->read(interleaved + done * NCH, frames - done);
+            if (done < frames)
+                wait_for(EvReadable, [&] { return m_in->size(); },
+                         frames - done, m_readWatermark);
+        }
+        return done;
+    }
+    size_t read(FrameSpan<SAMPLE> to) { return read(to.data, to.frames); }
+
+    size_t write(const SAMPLE *interleaved, size_t frames)
+    {
+        if (m_native)
+        {
+            const PaError err = Pa_WriteStream(m_stream, interleaved, frames);
+            if (err == paOutputUnderflowed)
+                m_underruns.fetch_add(1, std::memory_order_relaxed);
+            else if (err)
+                throw Exception(err, "BlockingStream::write() failed");
+            return frames;
+        }
+        if (!m_out) throw Exception(paCanNotWriteToAnInputOnlyStream);
+        size_t done = 0;
+        while (done < frames)
+        {
+            done += m_out->write(interleaved + done * NCH, frames - done);
+            if (done < frames)
+                wait_for(EvWritable, [&] { return m_out->space(); },
+                         frames - done, m_writeWatermark);
+        }
+        return done;
+    }
+    size_t write(FrameSpan<const SAMPLE> from)
+    {
+        return write(from.data, from.frames);
+    }
+
+    // Block until the read / write watermark is reached, without moving
+    // any data. A negative timeout waits forever. False on timeout.
+    bool waitReadable(double timeoutSecs = -1) const
+    {
+        return wait_level(EvReadable, [this] { return readAvailable(); },
+                          m_readWatermark, timeoutSecs);
+    }
+    bool waitWritable(double timeoutSecs = -1) const
+    {
+        return wait_level(EvWritable, [this] { return writeAvailable(); },
+                          m_writeWatermark, timeoutSecs);
+    }
+
+  private:
+    enum : uint32_t
+    {
+        EvReadable = 1,
+        EvWritable = 2
+    };
+
+    PaDeviceInfoEx m_device;
+    PaStream *m_stream = nullptr;
+    bool m_native = false;
+    std::unique_ptr<fifo_type> m_in;  // filled by the callback
+    std::unique_ptr<fifo_type> m_out; // drained by the callback
+    std::atomic<size_t> m_readWatermark{1};
+    std::atomic<size_t> m_writeWatermark{1};
+    std::atomic<uint64_t> m_overruns{0};
+    std::atomic<uint64_t> m_underruns{0};
+    mutable detail::AudioEvents m_events;
+
+    // Fifo mode callback. The events are only raised, at most once per
+    // period, while a FIFO sits past its watermark; a raise that finds the
+    // bit already set costs no syscall.
+    static int fifo_dispatcher(const void *input, void *output,
+                               unsigned long frameCount,
+                               const PaStreamCallbackTimeInfo *,
+                               PaStreamCallbackFlags, void *userData)
+    {
+        auto *s = (BlockingStream *)userData;
+        if (input)
+        {
+            s->m_in->write((const SAMPLE *)input, frameCount);
+            if (s->m_in->size() >=
+                s->m_readWatermark.load(std::memory_order_relaxed))
+                s->m_events.raise(EvReadable);
         }
-        if (devname.empty() && info.outParams.device != paNoDevice)
+        if (output)
         {
-            devname = Pa_GetDeviceInfo(info.outParams.device)->name;
+            AudioBlock<SAMPLE, NCH> blk;
+            blk.output = (SAMPLE *)output;
+            blk.frameCount = frameCount;
+            s->m_out->pop(blk);
+            if (s->m_out->space() >=
+                s->m_writeWatermark.load(std::memory_order_relaxed))
+                s->m_events.raise(EvWritable);
         }
-        if (devname.empty())
+        return paContinue;
+    }
+
+    // Fifo mode: sleep until level() reaches the smaller of what is still
+    // needed and the watermark. The event is cleared before the level is
+    // checked, so a raise in between is never lost.
+    template <typename LEVEL>
+    void wait_for(uint32_t ev, LEVEL &&level, size_t needed,
+                  const std::atomic<size_t> &watermark)
+    {
+        const size_t want = (std::min)(needed, watermark.load());
+        for (;;)
         {
-            devname = "[unexpected: no device]";
+            m_events.clear(ev);
+            if (level() >= want) return;
+            if (!isActive())
+                throw Exception(paStreamIsStopped,
+                                "BlockingStream: the stream is not running");
+            m_events.wait_any(ev, 0.25);
         }
+    }
 
-        /*/
-        #ifdef _WIN32
-                PaWasapiStreamInfo w = {};
-
-                if (device.hostApiInfo->type == PaHostApiTypeId::paWASAPI)
-                {
-
-                    // w.threadPriority = eThreadPriorityProAudio;
-                    // if (a->exclusive) {
-                    //     w.flags = (paWinWasapiExclusive |
-        paWinWasapiThreadPriority);
-                    //}
-
-                    w.hostApiType = paWASAPI;
-                    w.size = sizeof(PaWasapiStreamOption);
-                    w.version = 1;
-
-                    // info.inParam.hostApiSpecificStreamInfo = &w;
-                    // info.outParam.hostApiSpecificStreamInfo = &w;
-                }
-
-        #endif
-        /*/
-        const auto err =
-            Pa_OpenStream(&info.stream, myInParams, myOutParams,
-                          info.samplerate, info.framesPerBuffer, info.flags,
-                          callback_dispatcher, (void *)this);
+    template <typename LEVEL>
+    bool wait_level(uint32_t ev, LEVEL &&level,
+                    const std::atomic<size_t> &watermark,
+                    double timeoutSecs) const
+    {
+        using namespace std::chrono;
+        const auto start = steady_clock::now();
+        for (;;)
+        {
+            if (!m_native) m_events.clear(ev);
+            const size_t have = level();
+            const size_t want = watermark.load();
+            if (have >= want) return true;
+            double left = 0.25;
+            if (timeoutSecs >= 0)
+            {
+                left = timeoutSecs -
+                       duration<double>(steady_clock::now() - start).count();
+                if (left <= 0) return false;
+            }
+            if (!m_native)
+                m_events.wait_any(ev, (std::min)(left, 0.25));
+            else // no wakeup to wait on: sleep until it should be there
+                std::this_thread::sleep_for(duration<double>((std::min)(
+                    left, (std::max)(0.001, (double)(want - have) /
+                                                samplerate()))));
+        }
+    }
 
-        if (err)
+    void open(Mode mode, size_t fifoFrames)
+    {
+        auto &info = m_device.streamSetupInfo;
+        if (info.inParams.device == paNoDevice &&
+            info.outParams.device == paNoDevice)
+            throw Exception(-1, "BlockingStream: Either or both inParams and "
+                                "outParams must be set.");
+        if (info.framesPerBuffer == 0) info.framesPerBuffer = 512;
+        info.sampleFormat = sample_format;
+        PaStreamParameters in = info.inParams, out = info.outParams;
+        in.sampleFormat = out.sampleFormat = sample_format;
+        in.channelCount = out.channelCount = (int)NCH;
+        const auto pin = in.device == paNoDevice ? nullptr : &in;
+        const auto pout = out.device == paNoDevice ? nullptr : &out;
+        const auto flags =
+            info.dither ? withDitherMode(info.flags, *info.dither) : info.flags;
+
+        PaError err = paNoError;
+        if (mode != Mode::Fifo)
         {
-            throw Exception(
-                err, "Failed to openSpecificStream(), for device: ", devname);
+            err = Pa_OpenStream(&m_stream, pin, pout, info.samplerate,
+                                info.framesPerBuffer, flags, nullptr, nullptr);
+            m_native = err == paNoError;
+            if (err && mode == Mode::Native)
+                throw Exception(err, "BlockingStream: failed to open a "
+                                     "blocking stream");
         }
+        const size_t frames =
+            fifoFrames ? fifoFrames : 8 * (size_t)info.framesPerBuffer;
+        if (!m_native)
+        {
+            if (pin) m_in = std::make_unique<fifo_type>(frames);
+            if (pout) m_out = std::make_unique<fifo_type>(frames);
+            err = Pa_OpenStream(&m_stream, pin, pout, info.samplerate,
+                                info.framesPerBuffer, flags, fifo_dispatcher,
+                                this);
+            if (err) throw Exception(err, "BlockingStream: failed to open");
+        }
+        watermarks(frames / 2, frames / 2);
+        info.stream = m_stream;
+        if (pin) info.inParams.channelCount = (int)NCH;
+        if (pout) info.outParams.channelCount = (int)NCH;
+    }
+};
 
-        m_device = device;
-        device.streamSetupInfo = actualStreamInfo();
+// The mixing core of a Mixer, usable without a device: a fixed table of
+// sources, each rendering NCH interleaved float channels, summed with a
+// per-source gain, pan and mute through the simd mix kernel.
+// add(), remove() and the setters may be called from any control thread
+// while render() runs on the audio thread, and neither side takes a lock.
+// render() never allocates, and never calls a source once remove() has
+// returned; the source is destroyed by remove(), on the calling thread.
+template <size_t NCH = 2> class MixBus
+{
+  public:
+    // Renders `frames` frames of NCH interleaved channels into `out`,
+    // overwriting it. Called on the audio thread.
+    using Source = std::function<void(float *out, size_t frames)>;
+    // Identifies one add(). Stale after remove(), even once the slot has
+    // been reused.
+    using SourceId = uint64_t;
+    static constexpr SourceId InvalidSource = 0;
+
+    // maxFrames is the most render() asks of a source at once; longer
+    // buffers are mixed in pieces.
+    explicit MixBus(size_t maxSources = 32, size_t maxFrames = 4096)
+        : m_slots(std::make_unique<Slot[]>(maxSources)),
+          m_capacity(maxSources), m_maxFrames(maxFrames),
+          m_scratch(maxFrames * NCH)
+    {
+    }
+    MixBus(const MixBus &) = delete;
+    MixBus &operator=(const MixBus &) = delete;
 
-        m_env.Setup(device.streamSetupInfo.samplerate, 20, 500);
-        TimeStampGen::reset(info.samplerate);
+    size_t capacity() const noexcept { return m_capacity; }
+    size_t size() const noexcept
+    {
+        return m_count.load(std::memory_order_relaxed);
     }
 
-    void Stop(float fadeOutSecs = 0.25)
+    // InvalidSource if every slot is taken. The source fades in over the
+    // first buffer it plays in.
+    SourceId add(Source fn, float gain = 1.0f, float pan = 0.0f)
     {
-        TimeStampGen::reset(m_device.streamSetupInfo.samplerate);
-        if (!m_device.streamSetupInfo.stream)
+        for (size_t i = 0; i < m_capacity; ++i)
         {
-            throw Exception(-1, "Stop(): unexpected: no stream to start");
+            Slot &s = m_slots[i];
+            uint32_t expected = Free;
+            if (!s.state.compare_exchange_strong(expected, Claimed)) continue;
+            s.fn = std::move(fn);
+            s.gain.store(gain, std::memory_order_relaxed);
+            s.pan.store(pan, std::memory_order_relaxed);
+            s.mute.store(false, std::memory_order_relaxed);
+            s.fresh = true;
+            const uint32_t gen = s.generation.load() + 1;
+            s.generation.store(gen);
+            s.state.store(Active); // publishes all of the above
+            m_count.fetch_add(1, std::memory_order_relaxed);
+            return ((SourceId)gen << 32) | i;
         }
+        return InvalidSource;
+    }
 
-        if (m_runstate)
+    // Waits for a render() in progress to finish, so the source is never
+    // called again. It stops abruptly; setGain(id, 0) a buffer earlier
+    // for a click-free removal.
+    bool remove(SourceId id)
+    {
+        Slot *s = find(id);
+        uint32_t expected = Active;
+        if (!s || !s->state.compare_exchange_strong(expected, Removing))
+            return false;
+        // a render() that started before the store above may still be
+        // calling the source; any later one will see Removing. Removers
+        // take turns, as each one clears the bit the others wait on.
+        std::lock_guard<std::mutex> lock(m_removeMutex);
+        m_rendered.clear(EvRendered);
+        const uint64_t seq = m_renderSeq.load();
+        if (seq & 1)
         {
-            m_fader.arm(0, (float)this->samplerate(), fadeOutSecs);
+            while (m_renderSeq.load() == seq)
+            {
+                m_rendered.wait_any(EvRendered);
+                m_rendered.clear(EvRendered);
+            }
+        }
+        s->fn = nullptr;
+        s->state.store(Free);
+        m_count.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Changes are ramped across the next buffer.
+    bool setGain(SourceId id, float gain) noexcept
+    {
+        return set(id, &Slot::gain, gain);
+    }
+    // -1 is hard left, 1 hard right. A balance control: at the centre both
+    // channels play at unity. Only used when NCH == 2.
+    bool setPan(SourceId id, float pan) noexcept
+    {
+        return set(id, &Slot::pan, (std::max)(-1.0f, (std::min)(1.0f, pan)));
+    }
+    bool setMute(SourceId id, bool mute) noexcept
+    {
+        return set(id, &Slot::mute, mute);
+    }
 
-            int slept = 0;
-            while (m_fader.active())
+    // Audio thread. Overwrites `out` with the sum of every live source.
+    void render(float *out, size_t frames) noexcept
+    {
+        m_renderSeq.fetch_add(1); // odd while rendering
+        std::fill(out, out + frames * NCH, 0.0f);
+        const auto &k = dsp::simd::best_kernels();
+        for (size_t done = 0; done < frames;)
+        {
+            const size_t n = (std::min)(frames - done, m_maxFrames);
+            float *dst = out + done * NCH;
+            for (size_t i = 0; i < m_capacity; ++i)
             {
-                Pa_Sleep(10);
-                slept += 10;
-                if (slept >= 5000)
+                Slot &s = m_slots[i];
+                if (s.state.load() != Active) continue;
+                std::array<float, NCH> g;
+                targets(s, g);
+                if (s.fresh)
                 {
-                    break;
+                    s.applied.fill(0.0f);
+                    s.fresh = false;
                 }
-            };
+                s.fn(m_scratch.data(), n);
+                if (g == s.applied)
+                {
+                    if (g != std::array<float, NCH>{})
+                        k.mix(dst, m_scratch.data(), n, NCH, g.data());
+                }
+                else
+                {
+                    mix_ramp(dst, m_scratch.data(), n, s.applied, g);
+                    s.applied = g;
+                }
+            }
+            done += n;
         }
+        m_renderSeq.fetch_add(1);
+        m_rendered.raise(EvRendered); // a syscall only if remove() cleared it
+    }
 
-        int ret = Pa_StopStream(m_device.streamSetupInfo.stream);
-        if (ret && ret != paStreamIsStopped)
-        {
-            throw Exception(ret, "Error Stopping Stream");
-        }
+  private:
+    enum : uint32_t
+    {
+        EvRendered = 1
+    };
+    enum : uint32_t
+    {
+        Free,
+        Claimed, // being filled in by add()
+        Active,
+        Removing
+    };
 
-        m_runstate = 0;
+    struct Slot
+    {
+        std::atomic<uint32_t> state{Free};
+        std::atomic<uint32_t> generation{0};
+        std::atomic<float> gain{1.0f};
+        std::atomic<float> pan{0.0f};
+        std::atomic<bool> mute{false};
+        Source fn;
+        // audio thread only, once Active
+        std::array<float, NCH> applied{};
+        bool fresh = true;
+    };
+
+    std::unique_ptr<Slot[]> m_slots;
+    const size_t m_capacity;
+    const size_t m_maxFrames;
+    std::vector<float> m_scratch;
+    std::atomic<size_t> m_count{0};
+    std::atomic<uint64_t> m_renderSeq{0};
+    detail::AudioEvents m_rendered; // raised after every render()
+    std::mutex m_removeMutex;
+
+    Slot *find(SourceId id) noexcept
+    {
+        const size_t i = (size_t)(id & 0xffffffffu);
+        if (id == InvalidSource || i >= m_capacity) return nullptr;
+        Slot &s = m_slots[i];
+        return s.generation.load() == (uint32_t)(id >> 32) ? &s : nullptr;
     }
 
-    void Start(float fadeInSecs = 0.1)
+    template <typename T, typename V>
+    bool set(SourceId id, std::atomic<T> Slot::*field, V value) noexcept
     {
-        auto &info = m_device.streamSetupInfo;
-        TimeStampGen::reset(info.samplerate);
+        Slot *s = find(id);
+        if (!s || s->state.load() != Active) return false;
+        (s->*field).store(value, std::memory_order_relaxed);
+        return true;
+    }
 
-        if (!info.stream)
+    static void targets(const Slot &s, std::array<float, NCH> &g) noexcept
+    {
+        const float gain = s.mute.load(std::memory_order_relaxed)
+                               ? 0.0f
+                               : s.gain.load(std::memory_order_relaxed);
+        g.fill(gain);
+        if constexpr (NCH == 2)
         {
-            throw Exception(-1, "Start(): unexpected: no stream to start");
+            const float pan = s.pan.load(std::memory_order_relaxed);
+            if (pan > 0) g[0] *= 1.0f - pan;
+            if (pan < 0) g[1] *= 1.0f + pan;
         }
+    }
 
-        m_fader.arm(1.0f, (float)this->samplerate(), fadeInSecs);
-        int ret = Pa_StartStream(info.stream);
-        if (ret)
+    // gain changes glide linearly across one buffer, so they don't click
+    static void mix_ramp(float *dst, const float *src, size_t frames,
+                         const std::array<float, NCH> &from,
+                         const std::array<float, NCH> &to) noexcept
+    {
+        const float step = 1.0f / (float)frames;
+        for (size_t f = 0; f < frames; ++f)
         {
-            throw Exception(ret, "Error Starting Stream");
+            const float t = (float)(f + 1) * step;
+            for (size_t ch = 0; ch < NCH; ++ch, ++dst, ++src)
+                *dst += *src * (from[ch] + (to[ch] - from[ch]) * t);
         }
-        m_runstate = 1;
     }
+};
 
-    void Abort()
+// One output stream on a device, playing the sum of any number of
+// sources. Several sources then share one host stream rather than opening
+// one each, which some devices would refuse anyway.
+template <size_t NCH = 2> class Mixer : public MixBus<NCH>
+{
+    struct Render
     {
-        auto &info = m_device.streamSetupInfo;
-        if (info.stream)
+        Mixer *mixer;
+        CallbackResult operator()(AudioBlock<float, NCH> &b) noexcept
         {
-            Pa_AbortStream(info.stream);
-            info.stream = nullptr;
+            if (b.hasOutput()) mixer->render(b.output, b.frames());
+            return CallbackResult::Continue;
         }
+    };
+
+  public:
+    using stream_type = Stream<Render, float, NCH>;
+
+    Mixer(PaDeviceInfoEx &device, size_t maxSources = 32,
+          size_t maxFrames = 4096)
+        : MixBus<NCH>(maxSources, maxFrames),
+          m_stream(device, Render{this})
+    {
     }
 
-    void Close()
+    stream_type &stream() noexcept { return m_stream; }
+    void Start(float fadeInSecs = 0.1f) { m_stream.Start(fadeInSecs); }
+    void Stop(float fadeOutSecs = 0.25f) { m_stream.Stop(fadeOutSecs); }
+
+  private:
+    stream_type m_stream; // after the bus: closed before it goes away
+};
+
+// The clock-independent half of DeviceBridge: capture() runs on the input
+// device's audio thread, render() on the output device's, and a FIFO joins
+// them. The two devices never agree exactly on their rates, so render()
+// resamples by a fine ratio that a PI loop steers to hold the FIFO at
+// `targetFrames`. Latency then stays put and nothing is dropped or
+// repeated. The integral term settles at the drift between the two clocks,
+// which is what driftPpm() reports.
+// Both sides pass the time of the call, in seconds on any clock they
+// share. The fill is judged as if the input arrived continuously, from
+// when the last input buffer came in, rather than by what happens to be
+// in the FIFO at the moment: otherwise the two callbacks slowly slipping
+// past one another would look like a buffer's worth of drift.
+template <size_t NCH = 2> class DriftBridge
+{
+  public:
+    // maxFrames is the longest buffer either device delivers or asks for.
+    // responseSecs is roughly how long the loop takes to correct a step
+    // in the fill; longer is smoother.
+    DriftBridge(double inRate, double outRate, size_t maxFrames,
+                size_t targetFrames,
+                dsp::ResamplerQuality quality = dsp::ResamplerQuality::Medium,
+                double responseSecs = 4.0)
+        : m_fifo(4 * targetFrames + 4 * maxFrames),
+          m_rs(inRate, outRate, maxFrames, quality), m_inRate(inRate),
+          m_outRate(outRate),
+          m_target((double)targetFrames),
+          m_kp(2.0 / (responseSecs * inRate)),
+          m_ki(1.0 / (responseSecs * responseSecs * inRate))
     {
-        auto &info = m_device.streamSetupInfo;
-        if (info.stream)
+        if (targetFrames == 0)
+            throw std::invalid_argument(
+                "DriftBridge: targetFrames must be > 0");
+    }
+    DriftBridge(const DriftBridge &) = delete;
+    DriftBridge &operator=(const DriftBridge &) = delete;
+
+    // Input device's audio thread. Frames that do not fit are dropped and
+    // counted as overruns.
+    void capture(const float *in, size_t frames, double now) noexcept
+    {
+        const uint64_t written = m_captured + m_fifo.write(in, frames);
+        m_captured = written;
+        const uint32_t seq = m_stampSeq.load(std::memory_order_relaxed);
+        m_stampSeq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        m_stampFrames.store(written, std::memory_order_relaxed);
+        m_stampTime.store(now, std::memory_order_relaxed);
+        m_stampBlock.store((uint32_t)frames, std::memory_order_relaxed);
+        m_stampSeq.store(seq + 2, std::memory_order_release);
+    }
+
+    // Output device's audio thread. Plays silence until the FIFO first
+    // reaches its target, and again after an underrun until it has
+    // refilled.
+    void render(float *out, size_t frames, double now) noexcept
+    {
+        const double level = fill_at(now);
+        if (m_priming)
         {
-            try
-            {
-                Stop(0.5);
-            }
-            catch (...)
+            if (level < m_target)
             {
+                std::fill(out, out + frames * NCH, 0.0f);
+                return;
             }
-            Pa_CloseStream(info.stream);
-            info.stream = nullptr;
+            m_priming = false;
+            m_level = level;
+        }
+        steer(level, frames);
+
+        const auto reg = m_fifo.readRegions(m_rs.inputNeeded(frames));
+        m_rs.push(reg.first.data, reg.first.frames);
+        m_rs.push(reg.second.data, reg.second.frames);
+        m_fifo.commitRead(reg.frames());
+        m_consumed += reg.frames();
+        const size_t made = m_rs.pull(out, frames);
+        if (made < frames)
+        {
+            std::fill(out + made * NCH, out + frames * NCH, 0.0f);
+            m_underruns.fetch_add(1, std::memory_order_relaxed);
+            m_priming = true;
         }
     }
 
-    SAMPLE envelope(unsigned int channel) const { return this->m_env[channel]; }
-
-    std::string_view id() const noexcept { return m_sid; }
-    void id(std::string_view newId) { m_sid = newId; }
+    size_t targetFrames() const noexcept { return (size_t)m_target; }
+    // frames waiting in the FIFO; a snapshot.
+    size_t fill() const noexcept { return m_fifo.size(); }
+    // the FIFO's fill, smoothed as the loop sees it
+    float averageFill() const noexcept
+    {
+        return m_pubLevel.load(std::memory_order_relaxed);
+    }
+    // how much faster the input clock runs than the output clock believes
+    float driftPpm() const noexcept
+    {
+        return m_pubDrift.load(std::memory_order_relaxed);
+    }
+    // the correction applied right now: drift plus the fill error term
+    float correctionPpm() const noexcept
+    {
+        return m_pubCorrection.load(std::memory_order_relaxed);
+    }
+    uint64_t overruns() const noexcept { return m_fifo.overruns(); }
+    uint64_t underruns() const noexcept
+    {
+        return m_underruns.load(std::memory_order_relaxed);
+    }
 
   private:
-    AUDIOCALLBACK m_cb;
-    std::string m_sid;
-
-}; // namespace portaudio
-namespace detail{
-[[maybe_unused]]
-static inline void deviceSanityForOpenStream(PaDeviceInfoEx& device){
+    static constexpr double LevelSecs = 0.25; // fill smoothing
+    static constexpr double MaxPpm = 1000;
 
-    if (device.streamSetupInfo.outParams.device == paNoDevice &&
-        device.deviceType.is_output_only())
+    // The input's stamp, if it can be read without waiting on the input
+    // thread; a few attempts, then the last good one does.
+    double fill_at(double now) noexcept
     {
-        throw Exception(-1, "Output device: invalid argument (no internal device set for PortAudio)");
+        for (int attempt = 0; attempt < 4; ++attempt)
+        {
+            const uint32_t before =
+                m_stampSeq.load(std::memory_order_acquire);
+            if (before & 1) continue;
+            const auto frames = m_stampFrames.load(std::memory_order_relaxed);
+            const auto time = m_stampTime.load(std::memory_order_relaxed);
+            const auto block = m_stampBlock.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (m_stampSeq.load(std::memory_order_relaxed) != before) continue;
+            m_seenFrames = frames;
+            m_seenTime = time;
+            m_seenBlock = block;
+            break;
+        }
+        // how much has arrived since, at most a couple of buffers' worth
+        const double since = (std::min)(
+            (std::max)(0.0, (now - m_seenTime) * m_inRate),
+            2.0 * (double)m_seenBlock);
+        return (double)m_seenFrames - (double)m_consumed + since;
     }
-    if (device.streamSetupInfo.inParams.device == paNoDevice &&
-        device.deviceType.is_input_only())
+
+    // one PI step, once per output buffer
+    void steer(double level, size_t frames) noexcept
     {
-        throw Exception(-1, "Input device: invalid argument (no internal device set for PortAudio)");
+        const double dt = (double)frames / m_outRate;
+        m_level += (1.0 - exp(-dt / LevelSecs)) * (level - m_level);
+        const double err = m_level - m_target;
+        const double p = m_kp * err * 1e6;
+        const double i = m_integral + m_ki * err * dt * 1e6;
+        // no wind-up while the correction is pinned at its limit
+        if (std::abs(p + i) < MaxPpm) m_integral = i;
+        const double ppm =
+            (std::max)(-MaxPpm, (std::min)(MaxPpm, p + m_integral));
+        m_rs.setDrift(ppm);
+        m_pubLevel.store((float)m_level, std::memory_order_relaxed);
+        m_pubDrift.store((float)m_integral, std::memory_order_relaxed);
+        m_pubCorrection.store((float)ppm, std::memory_order_relaxed);
     }
 
-    if (device.deviceType.is_duplex()){
-        if (device.streamSetupInfo.inParams.device == paNoDevice){
-            throw Exception(-1, "Duplex device requires both an input and output device to be set!. There is no device in 'inParams'");
+    SpscAudioFifo<float, NCH> m_fifo;
+
+    // input thread only
+    uint64_t m_captured = 0;
+
+    // when the last input buffer arrived, under a sequence counter
+    alignas(64) std::atomic<uint32_t> m_stampSeq{0};
+    std::atomic<uint64_t> m_stampFrames{0};
+    std::atomic<double> m_stampTime{0};
+    std::atomic<uint32_t> m_stampBlock{0};
+
+    // output thread only
+    alignas(64) dsp::Resampler<NCH> m_rs;
+    const double m_inRate;
+    const double m_outRate;
+    const double m_target;
+    const double m_kp, m_ki; // per frame of fill error
+    double m_level = 0;
+    double m_integral = 0; // ppm
+    bool m_priming = true;
+    uint64_t m_consumed = 0;
+    uint64_t m_seenFrames = 0;
+    double m_seenTime = 0;
+    uint32_t m_seenBlock = 0;
+
+    // published by the output thread
+    std::atomic<float> m_pubLevel{0};
+    std::atomic<float> m_pubDrift{0};
+    std::atomic<float> m_pubCorrection{0};
+    std::atomic<uint64_t> m_underruns{0};
+};
+
+// Full duplex across two devices with their own clocks: an input stream
+// on one, an output stream on the other, joined by a DriftBridge. Each
+// device keeps its own rate and buffer size, and the channel counts of
+// both are set to NCH. latencySecs is the FIFO fill the bridge holds.
+template <size_t NCH = 2> class DeviceBridge : public DriftBridge<NCH>
+{
+    struct Capture
+    {
+        DeviceBridge *bridge;
+        CallbackResult operator()(AudioBlock<float, NCH> &b) noexcept
+        {
+            if (b.hasInput()) bridge->capture(b.input, b.frames(), now());
+            return CallbackResult::Continue;
         }
-        if (device.streamSetupInfo.outParams.device == paNoDevice){
-            throw Exception(-1, "Duplex device requires both an input and output device to be set!. There is no device in 'outParams'");
+    };
+    struct Play
+    {
+        DeviceBridge *bridge;
+        CallbackResult operator()(AudioBlock<float, NCH> &b) noexcept
+        {
+            if (b.hasOutput()) bridge->render(b.output, b.frames(), now());
+            return CallbackResult::Continue;
         }
+    };
+
+    // the two devices' stream times need not share a clock; this does
+    static double now() noexcept
+    {
+        return std::chrono::duration<double>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
     }
-}
-}
+
+    static PaDeviceInfoEx one_way(const PaDeviceInfoEx &device, bool input)
+    {
+        PaDeviceInfoEx d = device;
+        auto &info = d.streamSetupInfo;
+        if (info.framesPerBuffer == 0) info.framesPerBuffer = 512;
+        (input ? info.outParams : info.inParams).device = paNoDevice;
+        (input ? info.inParams : info.outParams).channelCount = (int)NCH;
+        return d;
+    }
+    static size_t target_for(const PaDeviceInfoEx &in,
+                             const PaDeviceInfoEx &out, double latencySecs)
+    {
+        const auto &i = in.streamSetupInfo;
+        const auto &o = out.streamSetupInfo;
+        // at least an input buffer plus an output buffer's worth, or the
+        // loop could never hold it
+        const double blocks = (double)i.framesPerBuffer +
+                              (double)o.framesPerBuffer * i.samplerate /
+                                  o.samplerate;
+        return (size_t)ceil(
+            (std::max)(latencySecs * i.samplerate, 1.5 * blocks));
+    }
+
+  public:
+    using input_stream = Stream<Capture, float, NCH>;
+    using output_stream = Stream<Play, float, NCH>;
+
+    DeviceBridge(const PaDeviceInfoEx &inDevice,
+                 const PaDeviceInfoEx &outDevice, double latencySecs = 0.02,
+                 dsp::ResamplerQuality quality = dsp::ResamplerQuality::Medium)
+        : DeviceBridge(OneWay{}, one_way(inDevice, true),
+                       one_way(outDevice, false), latencySecs, quality)
+    {
+    }
+
+    input_stream &inputStream() noexcept { return m_in; }
+    output_stream &outputStream() noexcept { return m_out; }
+    // The output side starts first and plays silence until the input has
+    // filled the FIFO.
+    void Start(float fadeInSecs = 0.1f)
+    {
+        m_out.Start(fadeInSecs);
+        m_in.Start(0);
+    }
+    void Stop(float fadeOutSecs = 0.25f)
+    {
+        m_out.Stop(fadeOutSecs);
+        m_in.Stop(0);
+    }
+
+  private:
+    struct OneWay
+    {
+    };
+    DeviceBridge(OneWay, PaDeviceInfoEx in, PaDeviceInfoEx out,
+                 double latencySecs, dsp::ResamplerQuality quality)
+        : DriftBridge<NCH>(in.streamSetupInfo.samplerate,
+                           out.streamSetupInfo.samplerate,
+                           (std::max)(in.streamSetupInfo.framesPerBuffer,
+                                      out.streamSetupInfo.framesPerBuffer),
+                           target_for(in, out, latencySecs), quality),
+          m_inDevice(in), m_outDevice(out), m_out(m_outDevice, Play{this}),
+          m_in(m_inDevice, Capture{this})
+    {
+    }
+
+    PaDeviceInfoEx m_inDevice, m_outDevice;
+    // after the bridge: both are closed before it goes away
+    output_stream m_out;
+    input_stream m_in;
+};
+
 class Portaudio
 {
   public:
@@ -1165,16 +4565,22 @@ class Portaudio
     {
         return detail::StreamBase::StreamsActive();
     }
-    Portaudio(const std::string_view id = "")
+    // flags are passed to Pa_InitializeWithFlags(). With
+    // paInitializeParallel the host APIs come up concurrently. With
+    // paInitializeDeferProbe device enumeration is also left until the
+    // first call to enumerator(), since listing the devices completes their
+    // probes.
+    Portaudio(const std::string_view id = "",
+              PaInitializeFlags flags = paInitializeDefault)
         : info(*Pa_GetVersionInfo()), m_id(id)
     {
-        PaError err = Pa_Initialize();
+        PaError err = Pa_InitializeWithFlags(flags);
         if (err != PaErrorCode::paNoError)
         {
             throw std::runtime_error(Pa_GetErrorText(err));
         }
         m_instances++;
-        m_enum.populate();
+        if (!(flags & paInitializeDeferProbe)) m_enum.populate();
     }
     ~Portaudio() noexcept
     {
@@ -1183,7 +4589,16 @@ class Portaudio
     }
     const PaVersionInfo info;
     static int instances() noexcept { return m_instances; }
-    const enumerator_t &enumerator() const noexcept { return m_enum; }
+    const enumerator_t &enumerator() const
+    {
+        m_enum.apis(); // enumerates, if the constructor did not
+        return m_enum;
+    }
+    enumerator_t &enumerator()
+    {
+        m_enum.apis();
+        return m_enum;
+    }
     std::string_view id() const noexcept { return m_id; }
 
     template <typename CALLBACK> auto openDefaultStream(CALLBACK &&cb)
@@ -1192,32 +4607,58 @@ class Portaudio
         return s;
     }
 
-    template <typename CALLBACK>
+    // SAMPLE, NCH and LAYOUT only need to be given explicitly when the
+    // callback takes a typed AudioBlock other than interleaved stereo float.
+    template <typename SAMPLE = float, size_t NCH = 2,
+              Layout LAYOUT = Layout::Interleaved, typename CALLBACK>
     auto openStream(portaudio::PaDeviceInfoEx &device, CALLBACK &&cb)
     {
         detail::deviceSanityForOpenStream(device);
-        Stream s(device, std::forward<CALLBACK>(cb));
+        Stream<CALLBACK, SAMPLE, NCH, LAYOUT> s(device,
+                                                std::forward<CALLBACK>(cb));
         return s;
     }
 
-    auto openAndRunStream(PaDeviceInfoEx &device, AudioCallback &cb)
+    // a pull-model stream, see BlockingStream.
+    template <typename SAMPLE = float, size_t NCH = 2>
+    auto openBlockingStream(
+        PaDeviceInfoEx &device,
+        typename BlockingStream<SAMPLE, NCH>::Mode mode =
+            BlockingStream<SAMPLE, NCH>::Mode::Auto,
+        size_t fifoFrames = 0)
     {
-        std::atomic<CallbackResult> streamRetVal(CallbackResult::Continue);
+        detail::deviceSanityForOpenStream(device);
+        return BlockingStream<SAMPLE, NCH>(device, mode, fifoFrames);
+    }
 
-        Stream s(device, [&](CallbackInfo info) {
-            auto rv = cb.onCallback(info);
-            if (rv != CallbackResult::Continue)
-            {
-                streamRetVal = rv;
-            }
-            return rv;
-        });
+    // one stream mixing many sources, see Mixer.
+    template <size_t NCH = 2>
+    auto openMixer(PaDeviceInfoEx &device, size_t maxSources = 32,
+                   size_t maxFrames = 4096)
+    {
+        detail::deviceSanityForOpenStream(device);
+        return Mixer<NCH>(device, maxSources, maxFrames);
+    }
+
+    // input from one device, output to another, see DeviceBridge.
+    template <size_t NCH = 2>
+    auto openBridge(PaDeviceInfoEx &inDevice, PaDeviceInfoEx &outDevice,
+                    double latencySecs = 0.02)
+    {
+        if (inDevice.streamSetupInfo.inParams.device == paNoDevice ||
+            outDevice.streamSetupInfo.outParams.device == paNoDevice)
+            throw Exception(-1, "openBridge: the input device needs inParams "
+                                "and the output device outParams");
+        return DeviceBridge<NCH>(inDevice, outDevice, latencySecs);
+    }
+
+    auto openAndRunStream(PaDeviceInfoEx &device, AudioCallback &cb)
+    {
+        Stream s(device,
+                 [&](CallbackInfo info) { return cb.onCallback(info); });
 
         s.Start();
-        while (streamRetVal == CallbackResult::Continue)
-        {
-            sleep_ms(50);
-        }
+        s.waitUntilFinished();
         s.Stop();
     }
 
@@ -1271,6 +4712,43 @@ makeStreamParams(const Portaudio &pa, PaDeviceInfoEx *device = nullptr) noexcept
 namespace dsp
 {
 
+// Typed version: writes the tone in the block's native sample format.
+template <typename SAMPLE, size_t NCH>
+static inline void fill_buffer_sine(unsigned int &nsample,
+                                    AudioBlock<SAMPLE, NCH> &blk,
+                                    int freq = 440)
+{
+    SAMPLE *out = blk.output;
+    for (unsigned int i = 0; i < blk.frameCount; i++)
+    {
+        const auto v = sample_traits<SAMPLE>::from_float(
+            next_sine_sample(nsample, blk.samplerate, freq));
+        for (size_t ch = 0; ch < NCH; ++ch)
+        {
+            *out++ = v;
+        }
+    }
+}
+
+// Planar version: the tone is rendered once into the first channel, then
+// copied to the others, so each channel is a single contiguous pass.
+template <typename SAMPLE, size_t NCH>
+static inline void
+fill_buffer_sine(unsigned int &nsample,
+                 AudioBlock<SAMPLE, NCH, Layout::Planar> &blk, int freq = 440)
+{
+    SAMPLE *first = blk.outChannel(0);
+    for (unsigned int i = 0; i < blk.frameCount; i++)
+    {
+        first[i] = sample_traits<SAMPLE>::from_float(
+            next_sine_sample(nsample, blk.samplerate, freq));
+    }
+    for (size_t ch = 1; ch < NCH; ++ch)
+    {
+        std::copy(first, first + blk.frameCount, blk.outChannel(ch));
+    }
+}
+
 [[maybe_unused]] static inline void
 fill_buffer_sine(unsigned int &nsample, portaudio::CallbackInfo &info,
                  const unsigned int nch, int freq = 440)
@@ -78,7 +78,7 @@ void Dialog::on_cboHostApi_currentIndexChanged(int index)
     popDevices(index);
 }
 
-void Dialog::popDevices(const portaudio::deviceList &devices, QComboBox *cbo)
+void Dialog::popDevices(const portaudio::DeviceRange &devices, QComboBox *cbo)
 {
     cbo->clear();
     m_bpopping = true;
@@ -49,7 +49,7 @@ class Dialog : public QDialog
     void Pasetup();
     void Log(const QString &s);
     void popDevices(int apiIndex);
-    void popDevices(const portaudio::deviceList &devices, QComboBox *cbo);
+    void popDevices(const portaudio::DeviceRange &devices, QComboBox *cbo);
     int m_hostApiIndex = -1;
     int m_inputDeviceIndex = -1;
     int m_outputDeviceIndex = -1;